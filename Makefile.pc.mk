@@ -34,6 +34,7 @@ SPP_FILES            := $(foreach dir,$(SRC_DIRS),$(wildcard $(dir)/*.S))
 GODDARD_C_FILES      := $(foreach dir,$(GODDARD_SRC_DIRS),$(wildcard $(dir)/*.c))
 RAW_MODEL_C_FILES    := $(wildcard actors/*/model.inc.c) $(wildcard levels/*/*/model.inc.c) $(wildcard levels/*/areas/*/*/model.inc.c) $(wildcard levels/*/areas/*/model.inc.c)
 CONV_MODEL_C_FILES   := $(RAW_MODEL_C_FILES:%.c=$(BUILD_DIR)/%.processed.c)
+BAKED_COLLISION_C_FILES := $(patsubst %.inc.c,$(BUILD_DIR)/%.baked.inc.c,$(wildcard levels/*/areas/*/collision.inc.c))
 GENERATED_C_FILES    := $(foreach name,$(notdir $(basename $(wildcard textures/skyboxes/*.png))),$(BUILD_DIR)/bin/$(name)_skybox.c) $(BUILD_DIR)/sfx_defs.generated.c
 
 C_FILES := $(filter-out src/game/main.c,$(C_FILES))
@@ -255,9 +256,9 @@ $(BUILD_DIR)/soundtable $(BUILD_DIR)/sounddata &: $(SOUND_SAMPLE_BINS) $(SOUND_B
 >	$(V)mv $(BUILD_DIR)/soundtable.tmp $(BUILD_DIR)/soundtable
 >	$(V)mv $(BUILD_DIR)/sounddata.tmp $(BUILD_DIR)/sounddata
 
-$(BUILD_DIR)/sfx_defs.generated.c: sound/sequences/00_sound_player.s $(TOOLS_DIR)/sound_player_to_c.py
+$(BUILD_DIR)/sfx_defs.generated.c: sound/sequences/00_sound_player.s $(SOUND_BANK_FILES) $(TOOLS_DIR)/sound_player_to_c.py
 >	$(call print,Compiling sound effect definitions:,$<,$@)
->	$(V)$(PYTHON) $(TOOLS_DIR)/sound_player_to_c.py $(VERSION) $< $@
+>	$(V)$(PYTHON) $(TOOLS_DIR)/sound_player_to_c.py $(VERSION) $< sound/sound_banks $@
 
 #==============================================================================#
 # Segment Generation                                                           #
@@ -398,7 +399,13 @@ $(CONV_MODEL_C_FILES): $(BUILD_DIR)/%.processed.c: %.c $(TOOLS_DIR)/preprocess_g
 >	$(V)mkdir -p $(dir $@)
 >	$(V)$(PYTHON) $(TOOLS_DIR)/preprocess_graphics.py $< $@ $(C_DEFINES)
 
-$(BUILD_DIR)/%.processed.c: %.c $(CONV_MODEL_C_FILES) $(TOOLS_DIR)/preprocess_graphics.py
+# area collision gets partitioned into the grid ahead of time, leveldata.c includes the result
+$(BAKED_COLLISION_C_FILES): $(BUILD_DIR)/%.baked.inc.c: %.inc.c $(TOOLS_DIR)/bake_collision.py
+>	$(call print,Baking collision:,$<,$@)
+>	$(V)mkdir -p $(dir $@)
+>	$(V)$(PYTHON) $(TOOLS_DIR)/bake_collision.py $< $@ $(C_DEFINES)
+
+$(BUILD_DIR)/%.processed.c: %.c $(CONV_MODEL_C_FILES) $(BAKED_COLLISION_C_FILES) $(TOOLS_DIR)/preprocess_graphics.py
 >	$(call print,Preprocessing graphics:,$<,$@)
 >	$(V)mkdir -p $(dir $@)
 >	$(V)$(PYTHON) $(TOOLS_DIR)/preprocess_graphics.py $< $@ $(C_DEFINES)
@@ -476,7 +483,15 @@ test: $(OUTPUT)
 debug: $(OUTPUT)
 >	@gdb -q -iex "set debuginfod enabled off" -ex run -- $<
 
-.PHONY: all clean distclean default test debug
+# runs every demo headlessly and writes per frame stats to $(BUILD_DIR)/bench
+# BENCH_BASELINE=<summary.json of an earlier run> fails on regressions, BENCH_FRAMES=<n> cuts the demos short
+# BENCH_BEHAVIORS=<n> times the behavior interpreter, next to a BHV_UNDECODED build's if BENCH_BEHAVIORS_BASELINE=<its sm64>
+BENCH_DEMOS ?= $(wildcard assets/demos/*.bin)
+bench-pc: $(OUTPUT)
+>	$(PYTHON) $(TOOLS_DIR)/bench_pc.py $< $(BUILD_DIR)/bench $(BENCH_DEMOS) $(if $(BENCH_FRAMES),--frames $(BENCH_FRAMES)) $(if $(BENCH_BASELINE),--baseline $(BENCH_BASELINE)) \
+>		$(if $(BENCH_BEHAVIORS),--bench-behaviors $(BENCH_BEHAVIORS)) $(if $(BENCH_BEHAVIORS_BASELINE),--behaviors-baseline $(BENCH_BEHAVIORS_BASELINE))
+
+.PHONY: all clean distclean default test debug bench-pc
 # with no prerequisites, .SECONDARY causes no intermediate target to be removed
 .SECONDARY:
 
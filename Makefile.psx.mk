@@ -41,6 +41,7 @@ SPP_FILES            := $(foreach dir,$(SRC_DIRS),$(wildcard $(dir)/*.S))
 GODDARD_C_FILES      := $(foreach dir,$(GODDARD_SRC_DIRS),$(wildcard $(dir)/*.c))
 RAW_MODEL_C_FILES    := $(wildcard actors/*/model.inc.c) $(foreach dir,$(LEVEL_DIRS),$(wildcard levels/$(dir)*/model.inc.c) $(wildcard levels/$(dir)areas/*/*/model.inc.c) $(wildcard levels/$(dir)areas/*/model.inc.c))
 CONV_MODEL_C_FILES   := $(RAW_MODEL_C_FILES:%.c=$(BUILD_DIR)/%.processed.c)
+BAKED_COLLISION_C_FILES := $(patsubst %.inc.c,$(BUILD_DIR)/%.baked.inc.c,$(foreach dir,$(LEVEL_DIRS),$(wildcard levels/$(dir)areas/*/collision.inc.c)))
 GENERATED_C_FILES    := $(BUILD_DIR)/sfx_defs.generated.c
 #$(foreach name,$(notdir $(basename $(wildcard textures/skyboxes/*.png))),$(BUILD_DIR)/bin/$(name)_skybox.c)
 
@@ -123,8 +124,9 @@ TARGET_CFLAGS := -Wall -Wextra -Werror -Wno-maybe-uninitialized -Wno-error=cpp -
 TARGET_CFLAGS += -O2
 
 # necessary ABI and environment flags
+# (k0/k1 are left alone, the interrupt handler in irq_psx.s needs them for the cd reads and the xa looping)
 TARGET_CFLAGS += -march=r3000 -mtune=r3000 \
-	-mabi=eabi -mno-abicalls -EL -fcall-used-k0 -fcall-used-k1 -freg-struct-return \
+	-mabi=eabi -mno-abicalls -EL -freg-struct-return \
 	-mfp32 -msingle-float -fsingle-precision-constant -mno-fp-exceptions -msoft-float \
 	-fno-builtin -nostdinc -nostdlib -mno-mt -fno-pic -fno-PIC -fsigned-char \
 	-static -mno-shared -fomit-frame-pointer -fno-stack-protector -mno-llsc \
@@ -203,6 +205,7 @@ TEXTCONV              := $(TOOLS_DIR)/textconv
 #VADPCM_ENC            := $(TOOLS_DIR)/vadpcm_enc
 EXTRACT_DATA_FOR_MIO  := $(TOOLS_DIR)/extract_data_for_mio
 SKYCONV               := $(TOOLS_DIR)/skyconv
+PRECOMPILE_DL         := $(TOOLS_DIR)/precompile_dl
 PRINT = printf
 
 ifeq ($(COLOR),1)
@@ -298,13 +301,13 @@ $(PNGS_WITH_BLACK_TRANSPARENCY:%.png=$(BUILD_DIR)/%.fulldata): $(BUILD_DIR)/%.fu
 ALL_PNGS := $(foreach png,$(filter-out %/cake.png %/cake_eu.png %/skyboxes/%.png,$(filter %.png,$(file <.assets-local.txt))),$(wildcard $(png))) dualshock_graphic.png
 ALL_FULLDATAS := $(ALL_PNGS:%.png=$(BUILD_DIR)/%.fulldata)
 
-$(BUILD_DIR)/tex_pack: $(ALL_FULLDATAS) tools/pack_textures.py
+$(BUILD_DIR)/tex_pack: $(ALL_FULLDATAS) tools/pack_textures.py levels/level_defines.h
 >	@$(PRINT) "$(GREEN)Packing all images$(NO_COL)\n"
 >	$(V)rm -f $(BUILD_DIR)/fulldata_list.txt
 >	$(V)for fulldata in $(ALL_FULLDATAS); do \
 >		echo $$fulldata >> $(BUILD_DIR)/fulldata_list.txt ;\
 >	done
->	$(V)$(PYTHON) tools/pack_textures.py $@.tmp $(BUILD_DIR)/fulldata_list.txt
+>	$(V)$(PYTHON) tools/pack_textures.py $@.tmp $(BUILD_DIR)/fulldata_list.txt levels/level_defines.h $(BUILD_DIR)/tex_atlases.inc.c
 >	$(V)for png in $(ALL_PNGS); do \
 >		hexdump -v -e '1/1 "0x%X,"' $(BUILD_DIR)/$${png%.png}.texheader > $(BUILD_DIR)/$${png%.png}.inc.c ;\
 >	done
@@ -317,6 +320,9 @@ ALL_TEX_HEADER_FILES := $(ALL_PNGS:%.png=$(BUILD_DIR)/%.inc.c)
 
 $(ALL_TEX_HEADER_FILES):
 
+# the level texture atlas table is written along with the pack
+$(BUILD_DIR)/src/port/psx/gfx_texture_psx.o: $(BUILD_DIR)/tex_pack
+
 #==============================================================================#
 # Audio Generation                                                             #
 #==============================================================================#
@@ -366,19 +372,25 @@ $(BUILD_DIR)/soundtable $(BUILD_DIR)/sounddata &: $(SOUND_SAMPLE_BINS) $(SOUND_B
 >	$(V)mv $(BUILD_DIR)/soundtable.tmp $(BUILD_DIR)/soundtable
 >	$(V)mv $(BUILD_DIR)/sounddata.tmp $(BUILD_DIR)/sounddata
 
-$(BUILD_DIR)/sfx_defs.generated.c: sound/sequences/00_sound_player.s $(TOOLS_DIR)/sound_player_to_c.py
+$(BUILD_DIR)/sfx_defs.generated.c: sound/sequences/00_sound_player.s $(SOUND_BANK_FILES) $(TOOLS_DIR)/sound_player_to_c.py
 >	$(call print,Compiling sound effect definitions:,$<,$@)
->	$(V)$(PYTHON) $(TOOLS_DIR)/sound_player_to_c.py $(VERSION) $< $@
+>	$(V)$(PYTHON) $(TOOLS_DIR)/sound_player_to_c.py $(VERSION) $< sound/sound_banks $@
 
 #==============================================================================#
 # Segment Generation                                                           #
 #==============================================================================#
 
+# Display lists in actor groups and level data get compiled ahead of time, see precompile_dl.c
+# The menu, intro and ending levels are drawn in ortho mode, so they're left to the runtime compiler
+PRECOMPILE_DL_EXCLUDED_LEVELS := menu intro ending
+$(GROUP_SEG_FILES): PRECOMPILE_DL_SEGMENT := 1
+
 # Link segment file to resolve external labels
 $(BUILD_DIR)/%.elf: $(BUILD_DIR)/%.o2
 >	$(call print,Linking asset ELF file (at $(SEGMENT_ADDRESS)):,$<,$@)
 >	$(V)$(EXT_LD) -e 0 -Tdata=$(SEGMENT_ADDRESS) -EL -no-pie -G0 -Text_files_elf.ld --unresolved-symbols=ignore-all -Map $@.map -o $@.tmp $<
 >	$(V)$(OBJCOPY) -j .data $@.tmp
+>	$(if $(PRECOMPILE_DL_SEGMENT),$(V)$(PRECOMPILE_DL) $@.tmp)
 >	$(V)mv $@.tmp $@
 # Override for leveldata.elf, which otherwise matches the above pattern
 .SECONDEXPANSION:
@@ -386,6 +398,7 @@ $(BUILD_DIR)/levels/%/leveldata.elf: $(BUILD_DIR)/levels/%/leveldata.o2 $(BUILD_
 >	$(call print,Linking leveldata ELF file (at $(SEGMENT_ADDRESS)):,$<,$@)
 >	$(V)$(EXT_LD) -e 0 -Tdata=$(SEGMENT_ADDRESS) -EL -no-pie -G0 -Text_files_elf.ld --unresolved-symbols=ignore-all -Map $@.map --just-symbols=$(BUILD_DIR)/bin/$(TEXTURE_BIN).elf -o $@.tmp $<
 >	$(V)$(OBJCOPY) -j .data $@.tmp
+>	$(if $(filter $(PRECOMPILE_DL_EXCLUDED_LEVELS),$*),,$(V)$(PRECOMPILE_DL) $@.tmp $(BUILD_DIR)/bin/$(TEXTURE_BIN).elf)
 >	$(V)mv $@.tmp $@
 
 .SECONDEXPANSION:
@@ -530,7 +543,13 @@ $(CONV_MODEL_C_FILES): $(BUILD_DIR)/%.processed.c: %.c $(TOOLS_DIR)/preprocess_g
 >	$(V)mkdir -p $(dir $@)
 >	$(V)$(PYTHON) $(TOOLS_DIR)/preprocess_graphics.py $< $@ $(C_DEFINES)
 
-$(BUILD_DIR)/%.processed.c: %.c $(CONV_MODEL_C_FILES) $(TOOLS_DIR)/preprocess_graphics.py
+# area collision gets partitioned into the grid ahead of time, leveldata.c includes the result
+$(BAKED_COLLISION_C_FILES): $(BUILD_DIR)/%.baked.inc.c: %.inc.c $(TOOLS_DIR)/bake_collision.py
+>	$(call print,Baking collision:,$<,$@)
+>	$(V)mkdir -p $(dir $@)
+>	$(V)$(PYTHON) $(TOOLS_DIR)/bake_collision.py $< $@ $(C_DEFINES)
+
+$(BUILD_DIR)/%.processed.c: %.c $(CONV_MODEL_C_FILES) $(BAKED_COLLISION_C_FILES) $(TOOLS_DIR)/preprocess_graphics.py
 >	$(call print,Preprocessing graphics:,$<,$@)
 >	$(V)mkdir -p $(dir $@)
 >	$(V)$(PYTHON) $(TOOLS_DIR)/preprocess_graphics.py $< $@ $(C_DEFINES)
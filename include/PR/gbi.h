@@ -134,7 +134,8 @@
 #define G_RESERVED0		2	/* not implemeted */
 #define G_MOVEMEM		3	/* move a block of memory (up to 4 words) to dmem */
 #define G_VTX			4
-#define G_RESERVED1		5	/* not implemeted */
+//#define G_RESERVED1		5	/* not implemeted */
+#define G_PORT_CULL		0x05
 #define G_DL			6
 //#define G_RESERVED2		7	/* not implemeted */
 #define G_PORT_QUAD		0x07
@@ -4897,6 +4898,12 @@ typedef union {
         v0 << 24 | v1 << 16 | v2 << 8 | v3                                 \
 }}
 
+#define gsSPPortCullSphere(sphere)                                         \
+{{                                                                         \
+        (_SHIFTL(G_PORT_CULL, 24, 8)),                                     \
+        (uintptr_t)(sphere)                                                \
+}}
+
 #undef gsSP2Triangles
 #define gsSP2Triangles(t0i0, t0i1, t0i2, flags0, t1i0, t1i1, t1i2, flags1) \
 {{                                                                         \
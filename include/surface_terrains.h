@@ -171,6 +171,7 @@
 #define TERRAIN_LOAD_END         0x0042 // End the collision list
 #define TERRAIN_LOAD_OBJECTS     0x0043 // Loads in certain objects for level start
 #define TERRAIN_LOAD_ENVIRONMENT 0x0044 // Loads water/HMC gas
+#define TERRAIN_LOAD_BAKED       0x0045 // Surfaces already partitioned at build time, see tools/bake_collision.py
 
 #define TERRAIN_LOAD_IS_SURFACE_TYPE_LOW(cmd)  (cmd < 0x40)
 #define TERRAIN_LOAD_IS_SURFACE_TYPE_HIGH(cmd) (cmd >= 0x65)
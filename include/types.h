@@ -270,6 +270,7 @@ struct Object
     } ptrData;
 #endif
     const BehaviorScript *curBhvCommand;
+    struct BhvOp *curBhvOp; // curBhvCommand decoded, see behavior_script.c
     u32 bhvStackIndex;
     uintptr_t bhvStack[8];
     s16 bhvDelayTimer;
@@ -5,6 +5,9 @@
 #include "level_commands.h"
 
 #include "levels/intro/header.h"
+#ifdef TARGET_PC
+#include <port/pc/bench_pc.h>
+#endif
 
 #include "make_const_nonconst.h"
 
@@ -29,3 +32,15 @@ const LevelScript level_script_entry[] = {
 };
 
 #endif
+
+#ifdef TARGET_PC
+
+// boots straight into the level of the demo given with --demo, like the title screen does when starting a demo
+const LevelScript level_script_bench_entry[] = {
+    INIT_LEVEL(),
+    BLACKOUT(/*active*/ FALSE),
+    CALL(/*arg*/ 0, /*func*/ lvl_start_bench_demo),
+    EXIT_AND_EXECUTE_DYN(/*seg*/ 0x15, _scriptsSegmentRomStart, _scriptsSegmentRomEnd, DYN_level_main_scripts_entry)
+};
+
+#endif
@@ -95,9 +95,9 @@ void seq_player_unlower_volume(UNUSED u8 player, UNUSED u16 fadeDuration) {}
 void set_audio_muted(UNUSED u8 muted) {}
 void sound_init(void) {}
 void get_currently_playing_sound(UNUSED u8 bank, UNUSED u8 *numPlayingSounds, UNUSED u8 *numSoundsInBank, UNUSED u8 *soundId) {}
-void stop_sound(UNUSED u32 soundBits, UNUSED f32 *pos) {}
-void stop_sounds_from_source(UNUSED f32 *pos) {}
-void stop_sounds_in_continuous_banks(void) {}
+//void stop_sound(UNUSED u32 soundBits, UNUSED f32 *pos) {}
+//void stop_sounds_from_source(UNUSED f32 *pos) {}
+//void stop_sounds_in_continuous_banks(void) {}
 void sound_banks_disable(UNUSED u8 player, UNUSED u16 bankMask) {}
 void sound_banks_enable(UNUSED u8 player, UNUSED u16 bankMask) {}
 u8 unused_803209D8(UNUSED u8 player, UNUSED u8 channelIndex, UNUSED u8 arg2) {
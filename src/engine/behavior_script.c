@@ -1,4 +1,5 @@
 #include <ultra64.h>
+#include <assert.h>
 
 #include "sm64.h"
 #include "behavior_data.h"
@@ -11,23 +12,97 @@
 #include "game/obj_behaviors_2.h"
 #include "game/object_helpers.h"
 #include "game/object_list_processor.h"
+#include "game/profiler.h"
 #include "graph_node.h"
 #include "surface_collision.h"
 #include <port/psx/scratchpad_call.h>
 
-// Macros for retrieving arguments from behavior scripts.
-#define BHV_CMD_GET_1ST_U8(index)  (u8)((gCurBhvCommand[index] >> 24) & 0xFF) // unused
-#define BHV_CMD_GET_2ND_U8(index)  (u8)((gCurBhvCommand[index] >> 16) & 0xFF)
-#define BHV_CMD_GET_3RD_U8(index)  (u8)((gCurBhvCommand[index] >> 8) & 0xFF)
-#define BHV_CMD_GET_4TH_U8(index)  (u8)((gCurBhvCommand[index]) & 0xFF)
+#ifndef BHV_UNDECODED
+/**
+ * Behavior scripts get decoded into ops the first time an object runs them,
+ * so the interpreter doesn't have to pull the command and its arguments apart
+ * every frame. Each command becomes one op, in the same order, holding the
+ * arguments that fit in the first two words of the command. The ops of a
+ * script are found by its address in a small table, like compiled display lists
+ * are found by their tag.
+ */
+struct BhvOp {
+    const BehaviorScript *cmd; // The command this op was decoded from.
+    u8 opcode;
+    u8 field;  // 2nd byte of the command
+    s16 arg;   // 2nd halfword of the command
+    union {
+        uintptr_t word; // 2nd word of the command
+        struct BhvOp *target; // for CALL and GOTO, decoded when they first run
+    };
+};
+
+// Ops that don't come from a single command.
+enum BhvOpcodes {
+    // BEGIN_LOOP() CALL_NATIVE(func)... END_LOOP(), once the loop started.
+    // field is the number of functions.
+    BHV_OP_LOOP_NATIVES = 0x39,
+};
+
+#define BHV_OP_POOL_SIZE 1536
+#define BHV_SCRIPT_CACHE_SIZE 512
+
+// The ops decoded since the objects were last cleared.
+static struct BhvOp sBhvOps[BHV_OP_POOL_SIZE];
+static s32 sNumBhvOps;
+static struct BhvScriptCacheEntry {
+    const BehaviorScript *script;
+    struct BhvOp *ops;
+} sBhvScriptCache[BHV_SCRIPT_CACHE_SIZE];
+static s32 sNumCachedBhvScripts;
+// Bumped whenever the ops get thrown away because the pool or the table filled up.
+static u32 sBhvFlushCount;
+
+// The op being run.
+static struct BhvOp *sCurBhvOp;
+#define BHV_CUR_OP sCurBhvOp
+#define BHV_CUR_CMD sCurBhvOp->cmd
+#define BHV_OP_OPCODE sCurBhvOp->opcode
+
+// The arguments the op holds.
+#define BHV_OP_FIELD sCurBhvOp->field
+#define BHV_OP_ARG sCurBhvOp->arg
+#define BHV_OP_WORD sCurBhvOp->word
+
+// The op after this one, whose command comes length words after this one's.
+#define BHV_NEXT_OP(length) (sCurBhvOp++)
+#define BHV_OP_AFTER(length) (sCurBhvOp + 1)
+#define BHV_JUMP_TARGET() bhv_jump_target()
+#define BHV_STACK_POP_OP() cur_obj_bhv_stack_pop_op()
+#else
+/**
+ * BHV_UNDECODED builds the interpreter the way it was before the scripts got
+ * decoded, running the commands themselves, so the benchmark has something
+ * to compare the decoded ops against.
+ */
+#define BHV_CUR_OP gCurBhvCommand
+#define BHV_CUR_CMD gCurBhvCommand
+#define BHV_OP_OPCODE (*gCurBhvCommand >> 24)
+
+#define BHV_OP_FIELD BHV_CMD_GET_2ND_U8(0)
+#define BHV_OP_ARG BHV_CMD_GET_2ND_S16(0)
+#define BHV_OP_WORD gCurBhvCommand[1]
+
+#define BHV_NEXT_OP(length) (gCurBhvCommand += (length))
+#define BHV_OP_AFTER(length) (gCurBhvCommand + (length))
+#define BHV_JUMP_TARGET() ((const BehaviorScript *) segmented_to_virtual(BHV_CMD_GET_VPTR(1)))
+#define BHV_STACK_POP_OP() ((const BehaviorScript *) cur_obj_bhv_stack_pop())
+#endif
 
-#define BHV_CMD_GET_1ST_S16(index) (s16)(gCurBhvCommand[index] >> 16)
-#define BHV_CMD_GET_2ND_S16(index) (s16)(gCurBhvCommand[index] & 0xFFFF)
+// Macros for retrieving arguments from behavior scripts that aren't in the op.
+#define BHV_CMD_GET_2ND_U8(index)  (u8)((BHV_CUR_CMD[index] >> 16) & 0xFF)
+#define BHV_CMD_GET_3RD_U8(index)  (u8)((BHV_CUR_CMD[index] >> 8) & 0xFF)
+#define BHV_CMD_GET_4TH_U8(index)  (u8)((BHV_CUR_CMD[index]) & 0xFF)
 
-#define BHV_CMD_GET_U32(index)     (u32)(gCurBhvCommand[index])
-#define BHV_CMD_GET_VPTR(index)    (void *)(gCurBhvCommand[index])
+#define BHV_CMD_GET_1ST_S16(index) (s16)(BHV_CUR_CMD[index] >> 16)
+#define BHV_CMD_GET_2ND_S16(index) (s16)(BHV_CUR_CMD[index] & 0xFFFF)
 
-#define BHV_CMD_GET_ADDR_OF_CMD(index) (uintptr_t)(&gCurBhvCommand[index])
+#define BHV_CMD_GET_VPTR(index)    (void *)(BHV_CUR_CMD[index])
 
 static u16 gRandomSeed16;
 
@@ -120,12 +195,28 @@ static uintptr_t cur_obj_bhv_stack_pop(void) {
     return bhvAddr;
 }
 
+#ifndef BHV_UNDECODED
+static struct BhvOp *decode_behavior(const BehaviorScript *script);
+
+// Retrieve an op address from the object's behavior stack. Ops pushed before
+// the decoded behaviors were flushed were turned back into tagged command
+// addresses, and get decoded again.
+static struct BhvOp *cur_obj_bhv_stack_pop_op(void) {
+    uintptr_t bhvAddr = cur_obj_bhv_stack_pop();
+
+    if (bhvAddr & 1) {
+        return decode_behavior((const BehaviorScript *) (bhvAddr & ~1));
+    }
+    return (struct BhvOp *) bhvAddr;
+}
+#endif
+
 // Command 0x22: Hides the current object.
 // Usage: HIDE()
 BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_hide(void) {
     cur_obj_hide();
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -134,7 +225,7 @@ BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_hide(void) {
 BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_disable_rendering(void) {
     gCurrentObject->header.gfx.node.flags &= ~GRAPH_RENDER_ACTIVE;
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -143,38 +234,38 @@ BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_disable_rendering(void) {
 static s32 bhv_cmd_billboard(void) {
     gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_BILLBOARD;
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x1B: Sets the current model ID of the object.
 // Usage: SET_MODEL(modelID)
 static s32 bhv_cmd_set_model(void) {
-    s32 modelID = BHV_CMD_GET_2ND_S16(0);
+    s32 modelID = BHV_OP_ARG;
 
     gCurrentObject->header.gfx.sharedChild = gLoadedGraphNodes[modelID];
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x1C: Spawns a child object with the specified model and behavior.
 // Usage: SPAWN_CHILD(modelID, behavior)
 BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_spawn_child(void) {
-    u32 model = BHV_CMD_GET_U32(1);
+    u32 model = BHV_OP_WORD;
     const BehaviorScript *behavior = BHV_CMD_GET_VPTR(2);
 
     struct Object *child = spawn_object_at_origin(gCurrentObject, 0, model, behavior);
     obj_copy_pos_and_angle(child, gCurrentObject);
 
-    gCurBhvCommand += 3;
+    BHV_NEXT_OP(3);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x2C: Spawns a new object with the specified model and behavior.
 // Usage: SPAWN_OBJ(modelID, behavior)
 BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_spawn_obj(void) {
-    u32 model = BHV_CMD_GET_U32(1);
+    u32 model = BHV_OP_WORD;
     const BehaviorScript *behavior = BHV_CMD_GET_VPTR(2);
 
     struct Object *object = spawn_object_at_origin(gCurrentObject, 0, model, behavior);
@@ -182,22 +273,22 @@ BHV_CMD_EXTRA_FUNC static s32 bhv_cmd_spawn_obj(void) {
     // TODO: Does this cmd need renaming? This line is the only difference between this and the above func.
     gCurrentObject->prevObj = object;
 
-    gCurBhvCommand += 3;
+    BHV_NEXT_OP(3);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x29: Spawns a child object with the specified model and behavior, plus a behavior param.
 // Usage: SPAWN_CHILD_WITH_PARAM(bhvParam, modelID, behavior)
 static s32 bhv_cmd_spawn_child_with_param(void) {
-    u32 bhvParam = BHV_CMD_GET_2ND_S16(0);
-    u32 modelID = BHV_CMD_GET_U32(1);
+    u32 bhvParam = BHV_OP_ARG;
+    u32 modelID = BHV_OP_WORD;
     const BehaviorScript *behavior = BHV_CMD_GET_VPTR(2);
 
     struct Object *child = spawn_object_at_origin(gCurrentObject, 0, modelID, behavior);
     obj_copy_pos_and_angle(child, gCurrentObject);
     child->oBehParams2ndByte = bhvParam;
 
-    gCurBhvCommand += 3;
+    BHV_NEXT_OP(3);
     return BHV_PROC_CONTINUE;
 }
 
@@ -220,15 +311,28 @@ static s32 bhv_cmd_break(void) {
 //    return BHV_PROC_BREAK;
 //}
 
+#ifndef BHV_UNDECODED
+// Find the ops a CALL or GOTO jumps to.
+static struct BhvOp *bhv_jump_target(void) {
+    struct BhvOp *target = sCurBhvOp->target;
+    u32 flushCount = sBhvFlushCount;
+
+    if (target == NULL) {
+        target = decode_behavior(segmented_to_virtual(BHV_CMD_GET_VPTR(1)));
+        // after a flush, sCurBhvOp may now be the slot of some other op
+        if (flushCount == sBhvFlushCount) {
+            sCurBhvOp->target = target;
+        }
+    }
+    return target;
+}
+#endif
+
 // Command 0x02: Jumps to a new behavior command and stores the return address in the object's behavior stack.
 // Usage: CALL(addr)
 static s32 bhv_cmd_call(void) {
-    const BehaviorScript *jumpAddress;
-    gCurBhvCommand++;
-
-    cur_obj_bhv_stack_push(BHV_CMD_GET_ADDR_OF_CMD(1)); // Store address of the next bhv command in the stack.
-    jumpAddress = segmented_to_virtual(BHV_CMD_GET_VPTR(0));
-    gCurBhvCommand = jumpAddress; // Jump to the new address.
+    cur_obj_bhv_stack_push((uintptr_t) BHV_OP_AFTER(2)); // Store address of the next bhv command in the stack.
+    BHV_CUR_OP = BHV_JUMP_TARGET(); // Jump to the new address.
 
     return BHV_PROC_CONTINUE;
 }
@@ -236,20 +340,20 @@ static s32 bhv_cmd_call(void) {
 // Command 0x03: Jumps back to the behavior command stored in the object's behavior stack. Used after CALL.
 // Usage: RETURN()
 static s32 bhv_cmd_return(void) {
-    gCurBhvCommand = (const BehaviorScript *) cur_obj_bhv_stack_pop(); // Retrieve command address and jump to it.
+    BHV_CUR_OP = BHV_STACK_POP_OP(); // Retrieve command address and jump to it.
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x01: Delays the behavior script for a certain number of frames.
 // Usage: DELAY(num)
 static s32 bhv_cmd_delay(void) {
-    s16 num = BHV_CMD_GET_2ND_S16(0);
+    s16 num = BHV_OP_ARG;
 
     if (gCurrentObject->bhvDelayTimer < num - 1) {
         gCurrentObject->bhvDelayTimer++; // Increment timer
     } else {
         gCurrentObject->bhvDelayTimer = 0;
-        gCurBhvCommand++; // Delay ended, move to next bhv command (note: following commands will not execute until next frame)
+        BHV_NEXT_OP(1); // Delay ended, move to next bhv command (note: following commands will not execute until next frame)
     }
 
     return BHV_PROC_BREAK;
@@ -258,14 +362,14 @@ static s32 bhv_cmd_delay(void) {
 // Command 0x25: Delays the behavior script for the number of frames given by the value of the specified field.
 // Usage: DELAY_VAR(field)
 static s32 bhv_cmd_delay_var(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
+    u8 field = BHV_OP_FIELD;
     s32 num = cur_obj_get_int(field);
 
     if (gCurrentObject->bhvDelayTimer < num - 1) {
         gCurrentObject->bhvDelayTimer++; // Increment timer
     } else {
         gCurrentObject->bhvDelayTimer = 0;
-        gCurBhvCommand++; // Delay ended, move to next bhv command
+        BHV_NEXT_OP(1); // Delay ended, move to next bhv command
     }
 
     return BHV_PROC_BREAK;
@@ -274,8 +378,7 @@ static s32 bhv_cmd_delay_var(void) {
 // Command 0x04: Jumps to a new behavior script without saving anything.
 // Usage: GOTO(addr)
 static s32 bhv_cmd_goto(void) {
-    gCurBhvCommand++; // Useless
-    gCurBhvCommand = segmented_to_virtual(BHV_CMD_GET_VPTR(0)); // Jump directly to address
+    BHV_CUR_OP = BHV_JUMP_TARGET(); // Jump directly to address
     return BHV_PROC_CONTINUE;
 }
 
@@ -295,12 +398,12 @@ static s32 bhv_cmd_goto(void) {
 // Command 0x05: Marks the start of a loop that will repeat a certain number of times.
 // Usage: BEGIN_REPEAT(count)
 static s32 bhv_cmd_begin_repeat(void) {
-    s32 count = BHV_CMD_GET_2ND_S16(0);
+    s32 count = BHV_OP_ARG;
 
-    cur_obj_bhv_stack_push(BHV_CMD_GET_ADDR_OF_CMD(1)); // Store address of the first command of the loop in the stack
+    cur_obj_bhv_stack_push((uintptr_t) BHV_OP_AFTER(1)); // Store address of the first command of the loop in the stack
     cur_obj_bhv_stack_push(count); // Store repeat count in the stack too
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -311,13 +414,13 @@ static s32 bhv_cmd_end_repeat(void) {
     count--;
 
     if (count != 0) {
-        gCurBhvCommand = (const BehaviorScript *) cur_obj_bhv_stack_pop(); // Jump back to the first command in the loop
+        BHV_CUR_OP = BHV_STACK_POP_OP(); // Jump back to the first command in the loop
         // Save address and count to the stack again
-        cur_obj_bhv_stack_push(BHV_CMD_GET_ADDR_OF_CMD(0));
+        cur_obj_bhv_stack_push((uintptr_t) BHV_CUR_OP);
         cur_obj_bhv_stack_push(count);
     } else { // Finished iterating over the loop
         cur_obj_bhv_stack_pop(); // Necessary to remove address from the stack
-        gCurBhvCommand++;
+        BHV_NEXT_OP(1);
     }
 
     // Don't execute following commands until next frame
@@ -331,13 +434,13 @@ static s32 bhv_cmd_end_repeat_continue(void) {
     count--;
 
     if (count != 0) {
-        gCurBhvCommand = (const BehaviorScript *) cur_obj_bhv_stack_pop(); // Jump back to the first command in the loop
+        BHV_CUR_OP = BHV_STACK_POP_OP(); // Jump back to the first command in the loop
         // Save address and count to the stack again
-        cur_obj_bhv_stack_push(BHV_CMD_GET_ADDR_OF_CMD(0));
+        cur_obj_bhv_stack_push((uintptr_t) BHV_CUR_OP);
         cur_obj_bhv_stack_push(count);
     } else { // Finished iterating over the loop
         cur_obj_bhv_stack_pop(); // Necessary to remove address from the stack
-        gCurBhvCommand++;
+        BHV_NEXT_OP(1);
     }
 
     // Start executing following commands immediately
@@ -347,17 +450,17 @@ static s32 bhv_cmd_end_repeat_continue(void) {
 // Command 0x08: Marks the beginning of an infinite loop.
 // Usage: BEGIN_LOOP()
 static s32 bhv_cmd_begin_loop(void) {
-    cur_obj_bhv_stack_push(BHV_CMD_GET_ADDR_OF_CMD(1)); // Store address of the first command of the loop in the stack
+    cur_obj_bhv_stack_push((uintptr_t) BHV_OP_AFTER(1)); // Store address of the first command of the loop in the stack
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x09: Marks the end of an infinite loop.
 // Usage: END_LOOP()
 static s32 bhv_cmd_end_loop(void) {
-    gCurBhvCommand = (const BehaviorScript *) cur_obj_bhv_stack_pop(); // Jump back to the first command in the loop
-    cur_obj_bhv_stack_push(BHV_CMD_GET_ADDR_OF_CMD(0)); // Save address to the stack again
+    BHV_CUR_OP = BHV_STACK_POP_OP(); // Jump back to the first command in the loop
+    cur_obj_bhv_stack_push((uintptr_t) BHV_CUR_OP); // Save address to the stack again
 
     return BHV_PROC_BREAK;
 }
@@ -365,44 +468,69 @@ static s32 bhv_cmd_end_loop(void) {
 // Command 0x0C: Executes a native game function. Function must not take or return any values.
 // Usage: CALL_NATIVE(func)
 typedef void (*NativeBhvFunc)(void);
+#ifdef TARGET_PC
+// Lets the benchmark time the interpreter on its own.
+static bool sSkipBhvNatives;
+#define CALL_BHV_NATIVE(func) if (!sSkipBhvNatives) (func)()
+#else
+#define CALL_BHV_NATIVE(func) (func)()
+#endif
 static s32 bhv_cmd_call_native(void) {
-    NativeBhvFunc behaviorFunc = BHV_CMD_GET_VPTR(1);
+    NativeBhvFunc behaviorFunc = (NativeBhvFunc) BHV_OP_WORD;
 
-    behaviorFunc();
+    CALL_BHV_NATIVE(behaviorFunc);
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
+// Command 0x38: Executes a native game function every frame from here on.
+// Usage: LOOP_NATIVE(func)
 static s32 bhv_cmd_loop_native(void) {
-    NativeBhvFunc behaviorFunc = BHV_CMD_GET_VPTR(1);
+    NativeBhvFunc behaviorFunc = (NativeBhvFunc) BHV_OP_WORD;
+
+    CALL_BHV_NATIVE(behaviorFunc);
+
+    return BHV_PROC_BREAK;
+}
 
-    behaviorFunc();
+#ifndef BHV_UNDECODED
+// Op 0x39: The body of a loop that only executes native game functions, which
+// is run like END_LOOP would, without touching the stack it leaves as it was.
+static s32 bhv_op_loop_natives(void) {
+    const BehaviorScript *cmd = sCurBhvOp->cmd;
+    s32 i;
+
+    for (i = 0; i < sCurBhvOp->field; i++) {
+        CALL_BHV_NATIVE((NativeBhvFunc) cmd[1]);
+        cmd += 2;
+    }
 
     return BHV_PROC_BREAK;
 }
+#endif
 
 // Command 0x0E: Sets the specified field to a float.
 // Usage: SET_FLOAT(field, value)
 static s32 bhv_cmd_set_float(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 value = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 value = BHV_OP_ARG;
 
     cur_obj_set_q32(field, q(value));
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x10: Sets the specified field to an integer.
 // Usage: SET_INT(field, value)
 static s32 bhv_cmd_set_int(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s16 value = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s16 value = BHV_OP_ARG;
 
     cur_obj_set_int(field, value);
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -420,52 +548,52 @@ static s32 bhv_cmd_set_int(void) {
 // Command 0x14: Sets the specified field to a random float in the given range.
 // Usage: SET_RANDOM_FLOAT(field, min, range)
 static s32 bhv_cmd_set_random_float(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 min = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 min = BHV_OP_ARG;
     s32 range = BHV_CMD_GET_1ST_S16(1);
 
     cur_obj_set_q32(field, q(min) + range * random_q32());
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x15: Sets the specified field to a random integer in the given range.
 // Usage: SET_RANDOM_INT(field, min, range)
 static s32 bhv_cmd_set_random_int(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 min = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 min = BHV_OP_ARG;
     s32 range = BHV_CMD_GET_1ST_S16(1);
 
     cur_obj_set_int(field, (s32)(range * random_float()) + min);
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x13: Gets a random short, right shifts it the specified amount and adds min to it, then sets the specified field to that value.
 // Usage: SET_INT_RAND_RSHIFT(field, min, rshift)
 static s32 bhv_cmd_set_int_rand_rshift(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 min = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 min = BHV_OP_ARG;
     s32 rshift = BHV_CMD_GET_1ST_S16(1);
 
     cur_obj_set_int(field, (random_u16() >> rshift) + min);
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x16: Adds a random float in the given range to the specified field.
 // Usage: ADD_RANDOM_FLOAT(field, min, range)
 static s32 bhv_cmd_add_random_float(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 min = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 min = BHV_OP_ARG;
     s32 range = BHV_CMD_GET_1ST_S16(1);
 
     cur_obj_set_q32(field, cur_obj_get_q32(field) + q(min) + range * random_q32());
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
@@ -486,24 +614,24 @@ static s32 bhv_cmd_add_random_float(void) {
 // Command 0x0D: Adds a float to the specified field.
 // Usage: ADD_FLOAT(field, value)
 static s32 bhv_cmd_add_float(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 value = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 value = BHV_OP_ARG;
 
     cur_obj_add_q32(field, q(value));
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x0F: Adds an integer to the specified field.
 // Usage: ADD_INT(field, value)
 static s32 bhv_cmd_add_int(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s16 value = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s16 value = BHV_OP_ARG;
 
     cur_obj_add_int(field, value);
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -511,49 +639,49 @@ static s32 bhv_cmd_add_int(void) {
 // Usually used to set an object's flags.
 // Usage: OR_INT(field, value)
 static s32 bhv_cmd_or_int(void) {
-    u8 objectOffset = BHV_CMD_GET_2ND_U8(0);
-    s32 value = BHV_CMD_GET_2ND_S16(0);
+    u8 objectOffset = BHV_OP_FIELD;
+    s32 value = BHV_OP_ARG;
 
     value &= 0xFFFF;
     cur_obj_or_int(objectOffset, value);
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x12: Performs a bit clear with the specified short. Unused.
 // Usage: BIT_CLEAR(field, value)
 static s32 bhv_cmd_bit_clear(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 value = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s32 value = BHV_OP_ARG;
 
     value = (value & 0xFFFF) ^ 0xFFFF;
     cur_obj_and_int(field, value);
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x27: Loads the animations for the object. <field> is always set to oAnimations.
 // Usage: LOAD_ANIMATIONS(field, anims)
 static s32 bhv_cmd_load_animations(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
+    u8 field = BHV_OP_FIELD;
 
-    cur_obj_set_vptr(field, BHV_CMD_GET_VPTR(1));
+    cur_obj_set_vptr(field, BHV_OP_WORD);
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x28: Begins animation and sets the object's current animation index to the specified value.
 // Usage: ANIMATE(animIndex)
 static s32 bhv_cmd_animate(void) {
-    s32 animIndex = BHV_CMD_GET_2ND_U8(0);
+    s32 animIndex = BHV_OP_FIELD;
     struct Animation **animations = gCurrentObject->oAnimations;
 
     geo_obj_init_animation(&gCurrentObject->header.gfx, &animations[animIndex]);
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -568,7 +696,7 @@ static s32 bhv_cmd_drop_to_floor(void) {
     QSETFIELD(gCurrentObject, oPosY, floorq);
     gCurrentObject->oMoveFlags |= OBJ_MOVE_ON_GROUND;
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -602,26 +730,26 @@ static s32 bhv_cmd_drop_to_floor(void) {
 // Command 0x1F: Sets the destination float field to the sum of the values of the given float fields.
 // Usage: SUM_FLOAT(fieldDst, fieldSrc1, fieldSrc2)
 static s32 bhv_cmd_sum_float(void) {
-    u32 fieldDst = BHV_CMD_GET_2ND_U8(0);
+    u32 fieldDst = BHV_OP_FIELD;
     u32 fieldSrc1 = BHV_CMD_GET_3RD_U8(0);
     u32 fieldSrc2 = BHV_CMD_GET_4TH_U8(0);
 
     cur_obj_set_q32(fieldDst, cur_obj_get_q32(fieldSrc1) + cur_obj_get_q32(fieldSrc2));
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x20: Sets the destination integer field to the sum of the values of the given integer fields. Unused.
 // Usage: SUM_INT(fieldDst, fieldSrc1, fieldSrc2)
 static s32 bhv_cmd_sum_int(void) {
-    u32 fieldDst = BHV_CMD_GET_2ND_U8(0);
+    u32 fieldDst = BHV_OP_FIELD;
     u32 fieldSrc1 = BHV_CMD_GET_3RD_U8(0);
     u32 fieldSrc2 = BHV_CMD_GET_4TH_U8(0);
 
     cur_obj_set_int(fieldDst, cur_obj_get_int(fieldSrc1) + cur_obj_get_int(fieldSrc2));
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -634,7 +762,7 @@ static s32 bhv_cmd_set_hitbox(void) {
     gCurrentObject->hitboxRadius_s16 = radius;
     gCurrentObject->hitboxHeight_s16 = height;
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
@@ -647,7 +775,7 @@ static s32 bhv_cmd_set_hurtbox(void) {
     gCurrentObject->hurtboxRadius_s16 = radius;
     gCurrentObject->hurtboxHeight_s16 = height;
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
@@ -662,7 +790,7 @@ static s32 bhv_cmd_set_hitbox_with_offset(void) {
     gCurrentObject->hitboxHeight_s16 = height;
     gCurrentObject->hitboxDownOffset_s16 = downOffset;
 
-    gCurBhvCommand += 3;
+    BHV_NEXT_OP(3);
     return BHV_PROC_CONTINUE;
 }
 
@@ -694,7 +822,7 @@ static s32 bhv_cmd_begin(void) {
     if (cur_obj_has_behavior(bhvMessagePanel)) {
         QSETFIELD(gCurrentObject, oCollisionDistance, q(150));
     }
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -745,11 +873,11 @@ static s32 bhv_cmd_set_int_random_from_table(void) {
 // Command 0x2A: Loads collision data for the object.
 // Usage: LOAD_COLLISION_DATA(collisionData)
 static s32 bhv_cmd_load_collision_data(void) {
-    u32 *collisionData = segmented_to_virtual(BHV_CMD_GET_VPTR(1));
+    u32 *collisionData = segmented_to_virtual((void *) BHV_OP_WORD);
 
     gCurrentObject->collisionData = collisionData;
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
@@ -760,37 +888,36 @@ static s32 bhv_cmd_set_home(void) {
     QSETFIELD(gCurrentObject, oHomeY, QFIELD(gCurrentObject, oPosY));
     QSETFIELD(gCurrentObject, oHomeZ, QFIELD(gCurrentObject, oPosZ));
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x2F: Sets the object's interaction type.
 // Usage: SET_INTERACT_TYPE(type)
 static s32 bhv_cmd_set_interact_type(void) {
-    gCurrentObject->oInteractType = BHV_CMD_GET_U32(1);
+    gCurrentObject->oInteractType = BHV_OP_WORD;
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x31: Sets the object's interaction subtype. Unused.
 // Usage: SET_INTERACT_SUBTYPE(subtype)
 static s32 bhv_cmd_set_interact_subtype(void) {
-    gCurrentObject->oInteractionSubtype = BHV_CMD_GET_U32(1);
+    gCurrentObject->oInteractionSubtype = BHV_OP_WORD;
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x32: Sets the object's size to the specified percentage.
 // Usage: SCALE(unusedField, percent)
 static s32 bhv_cmd_scale(void) {
-    UNUSED u8 unusedField = BHV_CMD_GET_2ND_U8(0);
-    s16 percent = BHV_CMD_GET_2ND_S16(0);
+    s16 percent = BHV_OP_ARG;
 
     cur_obj_scaleq(q(percent) / 100);
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -805,7 +932,7 @@ static s32 bhv_cmd_set_obj_physics(void) {
     QSETFIELD(gCurrentObject, oFriction, q(BHV_CMD_GET_1ST_S16(3)) / 100);
     QSETFIELD(gCurrentObject, oBuoyancy, q(BHV_CMD_GET_2ND_S16(3)) / 100);
 
-    gCurBhvCommand += 4; //5;
+    BHV_NEXT_OP(4);
     return BHV_PROC_CONTINUE;
 }
 
@@ -813,39 +940,39 @@ static s32 bhv_cmd_set_obj_physics(void) {
 // Used for clearing active particle flags fron Mario's object.
 // Usage: PARENT_BIT_CLEAR(field, value)
 static s32 bhv_cmd_parent_bit_clear(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s32 value = BHV_CMD_GET_U32(1);
+    u8 field = BHV_OP_FIELD;
+    s32 value = BHV_OP_WORD;
 
     value = value ^ 0xFFFFFFFF;
     obj_and_int(gCurrentObject->parentObj, field, value);
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x37: Spawns a water droplet with the given parameters.
 // Usage: SPAWN_WATER_DROPLET(dropletParams)
 static s32 bhv_cmd_spawn_water_droplet(void) {
-    struct WaterDropletParams *dropletParams = BHV_CMD_GET_VPTR(1);
+    struct WaterDropletParams *dropletParams = (struct WaterDropletParams *) BHV_OP_WORD;
 
     spawn_water_droplet(gCurrentObject, dropletParams);
 
-    gCurBhvCommand += 2;
+    BHV_NEXT_OP(2);
     return BHV_PROC_CONTINUE;
 }
 
 // Command 0x34: Animates an object using texture animation. <field> is always set to oAnimState.
 // Usage: ANIMATE_TEXTURE(field, rate)
 static s32 bhv_cmd_animate_texture(void) {
-    u8 field = BHV_CMD_GET_2ND_U8(0);
-    s16 rate = BHV_CMD_GET_2ND_S16(0);
+    u8 field = BHV_OP_FIELD;
+    s16 rate = BHV_OP_ARG;
 
     // Increase the field (oAnimState) by 1 every <rate> frames.
     if ((gGlobalTimer % rate) == 0) {
         cur_obj_add_int(field, 1);
     }
 
-    gCurBhvCommand++;
+    BHV_NEXT_OP(1);
     return BHV_PROC_CONTINUE;
 }
 
@@ -909,12 +1036,164 @@ static s32 bhv_cmd_animate_texture(void) {
 // 	[56] = bhv_cmd_loop_native
 // };
 
+#ifndef BHV_UNDECODED
+// How many words each command takes up, 0 for the ones that can't be run.
+static const u8 sBhvCmdLengths[] = {
+    1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 1, 0, 2, 1, 1, 1,
+    1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 3, 1, 1, 1,
+    1, 1, 1, 2, 0, 1, 0, 2, 1, 3, 2, 3, 3, 1, 2, 2,
+    4, 2, 1, 2, 1, 1, 0, 2, 2,
+};
+
+// Whether the script can't go on past the command, so nothing after it needs decoding.
+static s32 bhv_cmd_ends_script(u32 opcode) {
+    switch (opcode) {
+        case 0x03: // RETURN
+        case 0x04: // GOTO
+        case 0x09: // END_LOOP
+        case 0x0A: // BREAK
+        case 0x1D: // DEACTIVATE
+        case 0x38: // LOOP_NATIVE
+            return TRUE;
+    }
+    return FALSE;
+}
+
+// Decode the script into the op pool, NULL if it doesn't fit.
+BHV_CMD_EXTRA_FUNC static struct BhvOp *decode_ops(const BehaviorScript *script) {
+    struct BhvOp *ops, *op;
+    const BehaviorScript *cmd = script;
+    u32 opcode;
+    s32 numNatives;
+
+    ops = &sBhvOps[sNumBhvOps];
+    do {
+        opcode = *cmd >> 24;
+        assertm(opcode < ARRAY_COUNT(sBhvCmdLengths) && sBhvCmdLengths[opcode] != 0, "unknown behavior command");
+        if (sNumBhvOps >= BHV_OP_POOL_SIZE) {
+            return NULL;
+        }
+
+        op = &sBhvOps[sNumBhvOps++];
+        op->cmd = cmd;
+        op->opcode = opcode;
+        op->field = (*cmd >> 16) & 0xFF;
+        op->arg = *cmd & 0xFFFF;
+        op->word = sBhvCmdLengths[opcode] > 1 && opcode != 0x02 && opcode != 0x04 ? cmd[1] : 0;
+        cmd += sBhvCmdLengths[opcode];
+
+        // A loop that only calls functions runs as one op.
+        if (opcode == 0x08) {
+            for (numNatives = 0; (cmd[numNatives * 2] >> 24) == 0x0C; numNatives++) {
+            }
+            if (numNatives != 0 && numNatives <= 0xFF && (cmd[numNatives * 2] >> 24) == 0x09) {
+                if (sNumBhvOps >= BHV_OP_POOL_SIZE) {
+                    return NULL;
+                }
+                op = &sBhvOps[sNumBhvOps++];
+                op->cmd = cmd;
+                op->opcode = BHV_OP_LOOP_NATIVES;
+                op->field = numNatives;
+                op->arg = 0;
+                op->word = 0;
+                break;
+            }
+        }
+    } while (!bhv_cmd_ends_script(opcode));
+
+    return ops;
+}
+
+/**
+ * Throw away every decoded op while objects are still running them, when a
+ * level decodes more than the pool or the table can hold. The objects decode
+ * their current command again on their next update, and the ops on their
+ * behavior stacks are turned back into command addresses, tagged with the low
+ * bit so cur_obj_bhv_stack_pop_op knows to decode them again.
+ */
+BHV_CMD_EXTRA_FUNC static void flush_decoded_behaviors(void) {
+    struct Object *obj;
+    uintptr_t entry;
+    s32 i;
+    u32 j;
+
+    for (i = 0; i < OBJECT_POOL_CAPACITY; i++) {
+        obj = &gObjectPool[i];
+        obj->curBhvOp = NULL;
+        for (j = 0; j < obj->bhvStackIndex; j++) {
+            entry = obj->bhvStack[j];
+            // repeat counts share the stack, only the addresses inside the pool are ops
+            if (entry >= (uintptr_t) sBhvOps && entry < (uintptr_t) &sBhvOps[BHV_OP_POOL_SIZE]) {
+                obj->bhvStack[j] = (uintptr_t) ((struct BhvOp *) entry)->cmd | 1;
+            }
+        }
+    }
+    clear_decoded_behaviors();
+    sBhvFlushCount++;
+}
+
+/**
+ * Return the ops for the behavior script starting at the given command,
+ * decoding it if it hasn't been run since the objects were last cleared.
+ */
+BHV_CMD_EXTRA_FUNC static struct BhvOp *decode_behavior(const BehaviorScript *script) {
+    u32 hash = ((u32) ((uintptr_t) script >> 2) * 2654435761u >> 16) % BHV_SCRIPT_CACHE_SIZE;
+    u32 slot = hash;
+    struct BhvOp *ops;
+
+    while (sBhvScriptCache[slot].script != NULL) {
+        if (sBhvScriptCache[slot].script == script) {
+            return sBhvScriptCache[slot].ops;
+        }
+        slot = (slot + 1) % BHV_SCRIPT_CACHE_SIZE;
+    }
+
+    // the table is kept at most half full so the probing stays short
+    ops = sNumCachedBhvScripts < BHV_SCRIPT_CACHE_SIZE / 2 ? decode_ops(script) : NULL;
+    if (ops == NULL) {
+        flush_decoded_behaviors();
+        slot = hash;
+        ops = decode_ops(script);
+        if (ops == NULL) {
+            abortf("behavior script at %p is too long to decode\n", script);
+        }
+    }
+
+    sBhvScriptCache[slot].script = script;
+    sBhvScriptCache[slot].ops = ops;
+    sNumCachedBhvScripts++;
+    return ops;
+}
+
+// Forget every decoded script, once no object is running them anymore.
+void clear_decoded_behaviors(void) {
+    s32 i;
+
+    for (i = 0; i < BHV_SCRIPT_CACHE_SIZE; i++) {
+        sBhvScriptCache[i].script = NULL;
+    }
+    sNumCachedBhvScripts = 0;
+    sNumBhvOps = 0;
+}
+#else
+void clear_decoded_behaviors(void) {
+}
+#endif
+
 BHV_CMD_ICACHE_FUNC static void run_bhv() {
     s32 bhvProcResult;
+#ifdef BHV_UNDECODED
     gCurBhvCommand = gCurrentObject->curBhvCommand;
+#else
+    // curBhvCommand is also set when an object spawns or its behavior gets changed
+    sCurBhvOp = gCurrentObject->curBhvOp;
+    if (sCurBhvOp == NULL || sCurBhvOp->cmd != gCurrentObject->curBhvCommand) {
+        sCurBhvOp = decode_behavior(gCurrentObject->curBhvCommand);
+    }
+#endif
     do {
         //bhvProcResult = (bhv_cmd_jump_table[*gCurBhvCommand >> 24])();
-        switch(*gCurBhvCommand >> 24) {
+        switch(BHV_OP_OPCODE) {
 			case 0: bhvProcResult = bhv_cmd_begin(); break;
 			case 1: bhvProcResult = bhv_cmd_delay(); break;
 			case 2: bhvProcResult = bhv_cmd_call(); break;
@@ -972,13 +1251,48 @@ BHV_CMD_ICACHE_FUNC static void run_bhv() {
 			//case 54: bhvProcResult = nullptr(); break;
 			case 55: bhvProcResult = bhv_cmd_spawn_water_droplet(); break;
 			case 56: bhvProcResult = bhv_cmd_loop_native(); break;
+#ifndef BHV_UNDECODED
+			case BHV_OP_LOOP_NATIVES: bhvProcResult = bhv_op_loop_natives(); break;
+#endif
         }
     } while(bhvProcResult == BHV_PROC_CONTINUE);
+#ifdef BHV_UNDECODED
     gCurrentObject->curBhvCommand = gCurBhvCommand;
+#else
+    gCurrentObject->curBhvOp = sCurBhvOp;
+    gCurrentObject->curBhvCommand = sCurBhvOp->cmd;
+#endif
 }
 
+#ifdef TARGET_PC
+// Whether the object is in a loop that only calls native functions, so it can
+// be stepped over and over by the benchmark without anything changing.
+s32 bench_behavior_steppable(struct Object *obj) {
+    const BehaviorScript *cmd = obj->curBhvCommand;
+
+    if ((*cmd >> 24) == 0x38) {
+        return TRUE;
+    }
+    while ((*cmd >> 24) == 0x0C) {
+        cmd += 2;
+    }
+    return cmd != obj->curBhvCommand && (*cmd >> 24) == 0x09 && obj->bhvStackIndex != 0;
+}
+
+// Step the object's script once without calling its native functions, from
+// its decoded ops, or from its commands in a BHV_UNDECODED build.
+void bench_step_behavior(struct Object *obj) {
+    gCurrentObject = obj;
+    sSkipBhvNatives = TRUE;
+    run_bhv();
+    sSkipBhvNatives = FALSE;
+}
+#endif
+
 // Execute the behavior script of the current object, process the object flags, and other miscellaneous code for updating objects.
 void cur_obj_update(void) {
+    PROFILER_SCOPE(PROFILER_ZONE_OBJECT, gCurrentObject->behavior);
+    PROFILER_COUNT(PROFILER_COUNTER_OBJECTS, 1);
     s16 objFlags = gCurrentObject->oFlags;
     q32 distanceFromMarioq;
 
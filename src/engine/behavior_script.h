@@ -31,5 +31,10 @@ q32 random_q32(void);
 s32 random_sign(void);
 
 void cur_obj_update(void);
+void clear_decoded_behaviors(void);
+#ifdef TARGET_PC
+s32 bench_behavior_steppable(struct Object *obj);
+void bench_step_behavior(struct Object *obj);
+#endif
 
 #endif // BEHAVIOR_SCRIPT_H
@@ -778,6 +778,68 @@ s32 retrieve_animation_index(s32 frame, u16 **attributes, u32* next_index) {
     return result;
 }
 
+// Layout of the channels of animations compressed by tools/mario_anims_converter.py
+#define ANIM_CHANNEL_COUNT_MASK 0x7FFF
+#define ANIM_CHANNEL_BYTE_DELTAS 0x8000
+
+static s32 get_compressed_keyframe_value(const u8 *keyValues, u32 i, u32 header, s32 isRotation) {
+    if (isRotation) {
+        return (s16) (keyValues[i] << 8);
+    } else if (header & ANIM_CHANNEL_BYTE_DELTAS) {
+        return (s16) (keyValues[0] | keyValues[1] << 8) + keyValues[2 + i];
+    } else {
+        return (s16) (keyValues[i * 2] | keyValues[i * 2 + 1] << 8);
+    }
+}
+
+/**
+ * Retrieves the value of an attribute of an animation with ANIM_FLAG_7 and
+ * advances the attribute pointer past it. Such attributes are either a
+ * constant, when the first u16 is 0 and the second one is the value, or a
+ * number of keyframes and a byte offset into the values. There, the u8 gaps
+ * between the keyframes come first, then the keyframe values: the top byte of
+ * an angle, a s16 translation, or a s16 base followed by a u8 offset from it
+ * for each keyframe. Frames between keyframes are interpolated linearly, and
+ * past the last one the attribute holds its value.
+ */
+s32 retrieve_compressed_animation_value(s32 frame, u16 **attributes, const s16 *values, s32 isRotation) {
+    u32 header = (*attributes)[0];
+    u32 offset = (*attributes)[1];
+    u32 count;
+    const u8 *gaps;
+    const u8 *keyValues;
+    u32 i = 0;
+    u32 keyFrame = 0;
+    s32 value;
+    s32 diff;
+
+    *attributes += 2;
+
+    if (header == 0) {
+        return (s16) offset;
+    }
+
+    count = header & ANIM_CHANNEL_COUNT_MASK;
+    gaps = (const u8 *) values + offset;
+    keyValues = gaps + count - 1;
+
+    while (i + 1 < count && (u32) frame >= keyFrame + gaps[i]) {
+        keyFrame += gaps[i];
+        i++;
+    }
+
+    value = get_compressed_keyframe_value(keyValues, i, header, isRotation);
+    if (i + 1 < count) {
+        diff = get_compressed_keyframe_value(keyValues, i + 1, header, isRotation) - value;
+        if (isRotation) {
+            diff = (s16) diff;
+        }
+        value += diff * (s32) ((u32) frame - keyFrame) / gaps[i];
+    }
+
+    return value;
+}
+
 /**
  * Update the animation frame of an object. The animation flags determine
  * whether it plays forwards or backwards, and whether it stops or loops at
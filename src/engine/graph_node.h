@@ -13,6 +13,8 @@
 #define GRAPH_RENDER_Z_BUFFER       (1 << 3)
 #define GRAPH_RENDER_INVISIBLE      (1 << 4)
 #define GRAPH_RENDER_HAS_ANIMATION  (1 << 5)
+// Set by the renderer when an object was drawn, cleared by the object update scheduler
+#define GRAPH_RENDER_IN_VIEW        (1 << 6)
 
 // Whether the node type has a function pointer of type GraphNodeFunc
 #define GRAPH_NODE_TYPE_FUNCTIONAL            0x100
@@ -418,6 +420,7 @@ void geo_obj_init_animation(struct GraphNodeObject *graphNode, struct Animation
 void geo_obj_init_animation_accel(struct GraphNodeObject *graphNode, struct Animation **animPtrAddr, u32 animAccel);
 
 s32 retrieve_animation_index(s32 frame, u16 **attributes, u32* next_index);
+s32 retrieve_compressed_animation_value(s32 frame, u16 **attributes, const s16 *values, s32 isRotation);
 
 s16 geo_update_animation_frame(struct AnimInfo *obj, s32 *accelAssist);
 void geo_retreive_animation_translation(struct GraphNodeObject *obj, Vec3f position);
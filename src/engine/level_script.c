@@ -418,7 +418,9 @@ static void level_cmd_clear_level(void) {
 
 static void level_cmd_alloc_level_pool(void) {
     if(!sLevelPool) {
+        enum MemoryArena prevArena = main_pool_set_arena(MEMORY_ARENA_LEVEL_POOL);
         sLevelPool = alloc_only_pool_init(main_pool_available() - sizeof(struct AllocOnlyPool), MEMORY_POOL_LEFT);
+        main_pool_set_arena(prevArena);
     }
     sCurrentCmd = CMD_NEXT;
 }
@@ -436,6 +438,8 @@ static void level_cmd_free_level_pool(void) {
         }
     }
 
+    main_pool_report_footprint(gCurrLevelNum);
+
     sCurrentCmd = CMD_NEXT;
 }
 
@@ -1404,6 +1408,7 @@ static void level_cmd_get_or_set_var(void) {
 }
 
 [[gnu::noinline]] struct LevelCommand *level_script_execute(struct LevelCommand *cmd) {
+    PROFILER_SCOPE(PROFILER_ZONE_LEVEL_SCRIPT, 0);
     sScriptStatus = SCRIPT_RUNNING;
     sCurrentCmd = cmd;
 
@@ -7,11 +7,134 @@
 #include "game/object_list_processor.h"
 #include "surface_collision.h"
 #include "surface_load.h"
+#ifdef TARGET_PC
+#include <port/pc/bench_pc.h>
+#endif
 
 /**************************************************
  *                      WALLS                     *
  **************************************************/
 
+/**
+ * Push the point away from a wall it's too close to, returns whether it was.
+ */
+static inline s32 push_from_wall(struct Surface *surf, struct WallCollisionData *data,
+                                 q32 xq, q32 yq, q32 zq, q32 radiusq) {
+    register q32 offsetq;
+    register q32 pxq, pzq;
+    register q32 w1q, w2q, w3q;
+    register q32 y1q, y2q, y3q;
+
+    offsetq = q(
+        xq / ONE * surf->compressed_normal.x / COMPRESSED_NORMAL_ONE +
+        yq / ONE * surf->compressed_normal.y / COMPRESSED_NORMAL_ONE +
+        zq / ONE * surf->compressed_normal.z / COMPRESSED_NORMAL_ONE
+    ) + surf->originOffsetq;
+
+    if (offsetq < -radiusq || offsetq > radiusq) {
+        return FALSE;
+    }
+
+    pxq = xq;
+    pzq = zq;
+
+    //! (Quantum Tunneling) Due to issues with the vertices walls choose and
+    //  the fact they are floating point, certain floating point positions
+    //  along the seam of two walls may collide with neither wall or both walls.
+    if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
+        w1q = -q(surf->vertex1[2]);            w2q = -q(surf->vertex2[2]);            w3q = q(-surf->vertex3[2]);
+        y1q = q(surf->vertex1[1]);            y2q = q(surf->vertex2[1]);            y3q = q(surf->vertex3[1]);
+
+        if (surf->compressed_normal.x > 0) {
+            if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - -pzq) / (q32) 16, (y2q - y1q) / (q32) 16) > 0) {
+                return FALSE;
+            }
+            if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - -pzq) / (q32) 16, (y3q - y2q) / (q32) 16) > 0) {
+                return FALSE;
+            }
+            if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - -pzq) / (q32) 16, (y1q - y3q) / (q32) 16) > 0) {
+                return FALSE;
+            }
+        } else {
+            if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - -pzq) / (q32) 16, (y2q - y1q) / (q32) 16) < 0) {
+                return FALSE;
+            }
+            if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - -pzq) / (q32) 16, (y3q - y2q) / (q32) 16) < 0) {
+                return FALSE;
+            }
+            if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - -pzq) / (q32) 16, (y1q - y3q) / (q32) 16) < 0) {
+                return FALSE;
+            }
+        }
+    } else {
+        w1q = q(surf->vertex1[0]);            w2q = q(surf->vertex2[0]);            w3q = q(surf->vertex3[0]);
+        y1q = q(surf->vertex1[1]);            y2q = q(surf->vertex2[1]);            y3q = q(surf->vertex3[1]);
+
+        if (surf->compressed_normal.z > 0) {
+            if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - pxq) / (q32) 16, (y2q - y1q) / (q32) 16) > 0) {
+                return FALSE;
+            }
+            if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - pxq) / (q32) 16, (y3q - y2q) / (q32) 16) > 0) {
+                return FALSE;
+            }
+            if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - pxq) / (q32) 16, (y1q - y3q) / (q32) 16) > 0) {
+                return FALSE;
+            }
+        } else {
+            if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - pxq) / (q32) 16, (y2q - y1q) / (q32) 16) < 0) {
+                return FALSE;
+            }
+            if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - pxq) / (q32) 16, (y3q - y2q) / (q32) 16) < 0) {
+                return FALSE;
+            }
+            if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - pxq) / (q32) 16, (y1q - y3q) / (q32) 16) < 0) {
+                return FALSE;
+            }
+        }
+    }
+
+    // Determine if checking for the camera or not.
+    if (gCheckingSurfaceCollisionsForCamera) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return FALSE;
+        }
+    } else {
+        // Ignore camera only surfaces.
+        if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+            return FALSE;
+        }
+
+        // If an object can pass through a vanish cap wall, pass through.
+        if (surf->type == SURFACE_VANISH_CAP_WALLS) {
+            // If an object can pass through a vanish cap wall, pass through.
+            if (gCurrentObject != NULL
+                && (gCurrentObject->activeFlags & ACTIVE_FLAG_MOVE_THROUGH_GRATE)) {
+                return FALSE;
+            }
+
+            // If Mario has a vanish cap, pass through the vanish cap wall.
+            if (gCurrentObject != NULL && gCurrentObject == gMarioObject
+                && (gMarioState->flags & MARIO_VANISH_CAP)) {
+                return FALSE;
+            }
+        }
+    }
+
+    //! (Wall Overlaps) Because this doesn't update the x and z local variables,
+    //  multiple walls can push mario more than is required.
+    data->xq += surf->compressed_normal.x * (radiusq - offsetq) / COMPRESSED_NORMAL_ONE;
+    data->zq += surf->compressed_normal.z * (radiusq - offsetq) / COMPRESSED_NORMAL_ONE;
+
+    //! (Unreferenced Walls) Since this only returns the first four walls,
+    //  this can lead to wall interaction being missed. Typically unreferenced walls
+    //  come from only using one wall, however.
+    if (data->numWalls < 4) {
+        data->walls[data->numWalls++] = surf;
+    }
+
+    return TRUE;
+}
+
 /**
  * Iterate through the list of walls until all walls are checked and
  * have given their wall push.
@@ -19,14 +142,10 @@
 static s32 find_wall_collisions_from_list(struct SurfaceNode *surfaceNode,
                                           struct WallCollisionData *data) {
     register struct Surface *surf;
-    register q32 offsetq;
     register q32 radiusq = data->radiusq;
     register q32 xq = data->xq;
     register q32 yq = data->yq + data->offsetYq;
     register q32 zq = data->zq;
-    register q32 pxq, pzq;
-    register q32 w1q, w2q, w3q;
-    register q32 y1q, y2q, y3q;
     s32 numCols = 0;
 
     // Max collision radius = 200
@@ -44,119 +163,58 @@ static s32 find_wall_collisions_from_list(struct SurfaceNode *surfaceNode,
             continue;
         }
 
-        offsetq = q(
-            xq / ONE * surf->compressed_normal.x / COMPRESSED_NORMAL_ONE +
-            yq / ONE * surf->compressed_normal.y / COMPRESSED_NORMAL_ONE +
-            zq / ONE * surf->compressed_normal.z / COMPRESSED_NORMAL_ONE
-        ) + surf->originOffsetq;
-
-        if (offsetq < -radiusq || offsetq > radiusq) {
-            continue;
-        }
-
-        pxq = xq;
-        pzq = zq;
-
-        //! (Quantum Tunneling) Due to issues with the vertices walls choose and
-        //  the fact they are floating point, certain floating point positions
-        //  along the seam of two walls may collide with neither wall or both walls.
-        if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
-            w1q = -q(surf->vertex1[2]);            w2q = -q(surf->vertex2[2]);            w3q = q(-surf->vertex3[2]);
-            y1q = q(surf->vertex1[1]);            y2q = q(surf->vertex2[1]);            y3q = q(surf->vertex3[1]);
-
-            if (surf->compressed_normal.x > 0) {
-                if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - -pzq) / (q32) 16, (y2q - y1q) / (q32) 16) > 0) {
-                    continue;
-                }
-                if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - -pzq) / (q32) 16, (y3q - y2q) / (q32) 16) > 0) {
-                    continue;
-                }
-                if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - -pzq) / (q32) 16, (y1q - y3q) / (q32) 16) > 0) {
-                    continue;
-                }
-            } else {
-                if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - -pzq) / (q32) 16, (y2q - y1q) / (q32) 16) < 0) {
-                    continue;
-                }
-                if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - -pzq) / (q32) 16, (y3q - y2q) / (q32) 16) < 0) {
-                    continue;
-                }
-                if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - -pzq) / (q32) 16, (y1q - y3q) / (q32) 16) < 0) {
-                    continue;
-                }
-            }
-        } else {
-            w1q = q(surf->vertex1[0]);            w2q = q(surf->vertex2[0]);            w3q = q(surf->vertex3[0]);
-            y1q = q(surf->vertex1[1]);            y2q = q(surf->vertex2[1]);            y3q = q(surf->vertex3[1]);
-
-            if (surf->compressed_normal.z > 0) {
-                if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - pxq) / (q32) 16, (y2q - y1q) / (q32) 16) > 0) {
-                    continue;
-                }
-                if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - pxq) / (q32) 16, (y3q - y2q) / (q32) 16) > 0) {
-                    continue;
-                }
-                if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - pxq) / (q32) 16, (y1q - y3q) / (q32) 16) > 0) {
-                    continue;
-                }
-            } else {
-                if (qmul((y1q - yq) / (q32) 16, (w2q - w1q) / (q32) 16) - qmul((w1q - pxq) / (q32) 16, (y2q - y1q) / (q32) 16) < 0) {
-                    continue;
-                }
-                if (qmul((y2q - yq) / (q32) 16, (w3q - w2q) / (q32) 16) - qmul((w2q - pxq) / (q32) 16, (y3q - y2q) / (q32) 16) < 0) {
-                    continue;
-                }
-                if (qmul((y3q - yq) / (q32) 16, (w1q - w3q) / (q32) 16) - qmul((w3q - pxq) / (q32) 16, (y1q - y3q) / (q32) 16) < 0) {
-                    continue;
-                }
-            }
-        }
+        numCols += push_from_wall(surf, data, xq, yq, zq, radiusq);
+    }
 
-        // Determine if checking for the camera or not.
-        if (gCheckingSurfaceCollisionsForCamera) {
-            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
-                continue;
-            }
-        } else {
-            // Ignore camera only surfaces.
-            if (surf->type == SURFACE_CAMERA_BOUNDARY) {
-                continue;
-            }
+    return numCols;
+}
 
-            // If an object can pass through a vanish cap wall, pass through.
-            if (surf->type == SURFACE_VANISH_CAP_WALLS) {
-                // If an object can pass through a vanish cap wall, pass through.
-                if (gCurrentObject != NULL
-                    && (gCurrentObject->activeFlags & ACTIVE_FLAG_MOVE_THROUGH_GRATE)) {
-                    continue;
-                }
+/**
+ * Same as find_wall_collisions_from_list, for a list of baked surfaces.
+ */
+static s32 find_wall_collisions_from_baked_list(const u16 *index, struct WallCollisionData *data) {
+    register q32 radiusq = data->radiusq;
+    register q32 xq = data->xq;
+    register q32 yq = data->yq + data->offsetYq;
+    register q32 zq = data->zq;
+    s32 numCols = 0;
 
-                // If Mario has a vanish cap, pass through the vanish cap wall.
-                if (gCurrentObject != NULL && gCurrentObject == gMarioObject
-                    && (gMarioState->flags & MARIO_VANISH_CAP)) {
-                    continue;
-                }
-            }
-        }
+    if (radiusq > q(200)) {
+        radiusq = q(200);
+    }
 
-        //! (Wall Overlaps) Because this doesn't update the x and z local variables,
-        //  multiple walls can push mario more than is required.
-        data->xq += surf->compressed_normal.x * (radiusq - offsetq) / COMPRESSED_NORMAL_ONE;
-        data->zq += surf->compressed_normal.z * (radiusq - offsetq) / COMPRESSED_NORMAL_ONE;
+    for (; *index != NO_BAKED_SURFACE; index++) {
+        const struct SurfaceYRange *range = &gBakedGrid.yRanges[*index];
 
-        //! (Unreferenced Walls) Since this only returns the first four walls,
-        //  this can lead to wall interaction being missed. Typically unreferenced walls
-        //  come from only using one wall, however.
-        if (data->numWalls < 4) {
-            data->walls[data->numWalls++] = surf;
+        // The ranges are read in order, the surfaces only when they're needed.
+        if (yq < q(range->lowerY) || yq > q(range->upperY)) {
+            continue;
         }
 
-        numCols++;
+        numCols += push_from_wall(&gBakedGrid.surfaces[*index], data, xq, yq, zq, radiusq);
     }
 
     return numCols;
 }
 
+/**
+ * Find the baked list of a type of surface for a point, which has to be in
+ * the level boundaries.
+ */
+static const u16 *baked_surface_list(s32 x, s32 z, s32 type) {
+    const struct BakedCell *cell;
+    s32 subShift;
+
+    x += LEVEL_BOUNDARY_MAX;
+    z += LEVEL_BOUNDARY_MAX;
+    cell = &gBakedGrid.cells[z >> CELL_SIZE_SHIFT][x >> CELL_SIZE_SHIFT];
+    subShift = CELL_SIZE_SHIFT - cell->split;
+    x = (x & (CELL_SIZE - 1)) >> subShift;
+    z = (z & (CELL_SIZE - 1)) >> subShift;
+
+    return &gBakedGrid.indices[gBakedGrid.lists[cell->lists + ((z << cell->split) + x) * 3 + type]];
+}
+
 /**
  * Formats the position and wall search for find_wall_collisions.
  */
@@ -211,8 +269,23 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
     numCollisions += find_wall_collisions_from_list(node, colData);
 
     // Check for surfaces that are a part of level geometry.
-    node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
-    numCollisions += find_wall_collisions_from_list(node, colData);
+#ifdef TARGET_PC
+    bench_record_collision_query('w', cellX, cellZ, colData->xq, colData->yq + colData->offsetYq, colData->zq, colData->radiusq);
+#endif
+    if (gBakedGrid.surfaces != NULL) {
+        // The subcell lists only hold the walls that can reach into them, so they
+        // can only be used if walls of objects haven't pushed the point out of the cell.
+        x = qtrunc(colData->xq);
+        z = qtrunc(colData->zq);
+        if (((x + LEVEL_BOUNDARY_MAX) >> CELL_SIZE_SHIFT) == cellX && ((z + LEVEL_BOUNDARY_MAX) >> CELL_SIZE_SHIFT) == cellZ) {
+            numCollisions += find_wall_collisions_from_baked_list(baked_surface_list(x, z, SPATIAL_PARTITION_WALLS), colData);
+        } else {
+            numCollisions += find_wall_collisions_from_baked_list(&gBakedGrid.indices[gBakedGrid.cells[cellZ][cellX].walls], colData);
+        }
+    } else {
+        node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
+        numCollisions += find_wall_collisions_from_list(node, colData);
+    }
 
     // Increment the debug tracker.
     gNumCalls.wall += 1;
@@ -224,84 +297,108 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
  *                     CEILINGS                   *
  **************************************************/
 
+/**
+ * Check if a ceiling is over a given point, and find its height there if it is.
+ */
+static inline s32 ceil_height_at(struct Surface *surf, s32 x, s32 y, s32 z, q32 *pheightq) {
+    register s32 x1, z1, x2, z2, x3, z3;
+    q32 nxq, nyq, nzq;
+    q32 ooq;
+    q32 heightq;
+
+    x1 = surf->vertex1[0];
+    z1 = surf->vertex1[2];
+    z2 = surf->vertex2[2];
+    x2 = surf->vertex2[0];
+
+    // Checking if point is in bounds of the triangle laterally.
+    if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) > 0) {
+        return FALSE;
+    }
+
+    // Slight optimization by checking these later.
+    x3 = surf->vertex3[0];
+    z3 = surf->vertex3[2];
+    if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) > 0) {
+        return FALSE;
+    }
+    if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) > 0) {
+        return FALSE;
+    }
+
+    // Determine if checking for the camera or not.
+    if (gCheckingSurfaceCollisionsForCamera != 0) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return FALSE;
+        }
+    }
+    // Ignore camera only surfaces.
+    else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+        return FALSE;
+    }
+
+    nxq = (q32) surf->compressed_normal.x * QONE / COMPRESSED_NORMAL_ONE;
+    nyq = (q32) surf->compressed_normal.y * QONE / COMPRESSED_NORMAL_ONE;
+    nzq = (q32) surf->compressed_normal.z * QONE / COMPRESSED_NORMAL_ONE;
+    ooq = surf->originOffsetq;
+
+    // If a wall, ignore it. Likely a remnant, should never occur.
+    if (nyq == 0) {
+        return FALSE;
+    }
+
+    // Find the ceil height at the specific point.
+    heightq = qdiv((q32) -(x * nxq + nzq * z + ooq), nyq);
+
+    // Checks for ceiling interaction with a 78 unit buffer.
+    //! (Exposed Ceilings) Because any point above a ceiling counts
+    //  as interacting with a ceiling, ceilings far below can cause
+    // "invisible walls" that are really just exposed ceilings.
+    if (y - qtrunc(heightq + q(78)) > 0) {
+        return FALSE;
+    }
+
+    *pheightq = heightq;
+    return TRUE;
+}
+
 /**
  * Iterate through the list of ceilings and find the first ceiling over a given point.
  */
 static struct Surface *find_ceil_from_list(struct SurfaceNode *surfaceNode, s32 x, s32 y, s32 z, q32 *pheightq) {
     register struct Surface *surf;
-    register s32 x1, z1, x2, z2, x3, z3;
-    struct Surface *ceil = NULL;
-
-    ceil = NULL;
 
     // Stay in this loop until out of ceilings.
     while (surfaceNode != NULL) {
         surf = surfaceNode->surface;
         surfaceNode = surfaceNode->next;
 
-        x1 = surf->vertex1[0];
-        z1 = surf->vertex1[2];
-        z2 = surf->vertex2[2];
-        x2 = surf->vertex2[0];
-
-        // Checking if point is in bounds of the triangle laterally.
-        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) > 0) {
-            continue;
+        if (ceil_height_at(surf, x, y, z, pheightq)) {
+            //! (Surface Cucking) Since only the first ceil is returned and not the lowest,
+            //  lower ceilings can be "cucked" by higher ceilings.
+            return surf;
         }
+    }
 
-        // Slight optimization by checking these later.
-        x3 = surf->vertex3[0];
-        z3 = surf->vertex3[2];
-        if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) > 0) {
-            continue;
-        }
-        if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) > 0) {
-            continue;
-        }
+    return NULL;
+}
 
-        // Determine if checking for the camera or not.
-        if (gCheckingSurfaceCollisionsForCamera != 0) {
-            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
-                continue;
-            }
-        }
-        // Ignore camera only surfaces.
-        else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+/**
+ * Same as find_ceil_from_list, for a list of baked surfaces.
+ */
+static struct Surface *find_ceil_from_baked_list(const u16 *index, s32 x, s32 y, s32 z, q32 *pheightq) {
+    for (; *index != NO_BAKED_SURFACE; index++) {
+        // Skip the ceilings that are too low to be hit from here without reading them.
+        if (y > gBakedGrid.yRanges[*index].upperY) {
             continue;
         }
 
-        {
-            q32 nxq = (q32) surf->compressed_normal.x * QONE / COMPRESSED_NORMAL_ONE;
-            q32 nyq = (q32) surf->compressed_normal.y * QONE / COMPRESSED_NORMAL_ONE;
-            q32 nzq = (q32) surf->compressed_normal.z * QONE / COMPRESSED_NORMAL_ONE;
-            q32 ooq = surf->originOffsetq;
-            q32 heightq;
-
-            // If a wall, ignore it. Likely a remnant, should never occur.
-            if (nyq == 0) {
-                continue;
-            }
-
-            // Find the ceil height at the specific point.
-            heightq = qdiv((q32) -(x * nxq + nzq * z + ooq), nyq);
-
-            // Checks for ceiling interaction with a 78 unit buffer.
-            //! (Exposed Ceilings) Because any point above a ceiling counts
-            //  as interacting with a ceiling, ceilings far below can cause
-            // "invisible walls" that are really just exposed ceilings.
-            if (y - qtrunc(heightq + q(78)) > 0) {
-                continue;
-            }
-
-            *pheightq = heightq;
-            ceil = surf;
-            break;
+        if (ceil_height_at(&gBakedGrid.surfaces[*index], x, y, z, pheightq)) {
+            return &gBakedGrid.surfaces[*index];
         }
     }
 
-    //! (Surface Cucking) Since only the first ceil is returned and not the lowest,
-    //  lower ceilings can be "cucked" by higher ceilings.
-    return ceil;
+    return NULL;
 }
 
 /**
@@ -339,8 +436,15 @@ q32 find_ceilq(q32 posXq, q32 posYq, q32 posZq, struct Surface **pceil) {
     dynamicCeil = find_ceil_from_list(surfaceList, x, y, z, &dynamicHeightq);
 
     // Check for surfaces that are a part of level geometry.
-    surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
-    ceil = find_ceil_from_list(surfaceList, x, y, z, &heightq);
+#ifdef TARGET_PC
+    bench_record_collision_query('c', cellX, cellZ, posXq, posYq, posZq, 0);
+#endif
+    if (gBakedGrid.surfaces != NULL) {
+        ceil = find_ceil_from_baked_list(baked_surface_list(x, z, SPATIAL_PARTITION_CEILS), x, y, z, &heightq);
+    } else {
+        surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
+        ceil = find_ceil_from_list(surfaceList, x, y, z, &heightq);
+    }
 
     if (dynamicHeightq < heightq) {
         ceil = dynamicCeil;
@@ -396,77 +500,148 @@ q32 find_floor_height_and_dataq(q32 xPosq, q32 yPosq, q32 zPosq, struct FloorGeo
 }
 
 /**
- * Iterate through the list of floors and find the first floor under a given point.
+ * Check if a floor is under a given point, and find its height there if it is.
+ * @param minCross 0 to count the edges of the triangle as in it, 1 to leave them out
  */
-static struct Surface *find_floor_from_listq(struct SurfaceNode *surfaceNode, s32 x, s32 y, s32 z, q32 *pheightq) {
-    register struct Surface *surf;
+static inline s32 floor_height_at(struct Surface *surf, s32 x, s32 y, s32 z, s32 minCross, q32 *pheightq) {
     register s32 x1, z1, x2, z2, x3, z3;
     q32 nxq, nyq, nzq;
     q32 ooq;
     q32 heightq;
-    struct Surface *floor = NULL;
+
+    x1 = surf->vertex1[0];
+    z1 = surf->vertex1[2];
+    x2 = surf->vertex2[0];
+    z2 = surf->vertex2[2];
+
+    // Check that the point is within the triangle bounds.
+    if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) < minCross) {
+        return FALSE;
+    }
+
+    // To slightly save on computation time, set this later.
+    x3 = surf->vertex3[0];
+    z3 = surf->vertex3[2];
+
+    if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) < minCross) {
+        return FALSE;
+    }
+    if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) < minCross) {
+        return FALSE;
+    }
+
+    // Determine if we are checking for the camera or not.
+    if (gCheckingSurfaceCollisionsForCamera != 0) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return FALSE;
+        }
+    }
+    // If we are not checking for the camera, ignore camera only floors.
+    else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+        return FALSE;
+    }
+
+    nxq = (q32) surf->compressed_normal.x * QONE / COMPRESSED_NORMAL_ONE;
+    nyq = (q32) surf->compressed_normal.y * QONE / COMPRESSED_NORMAL_ONE;
+    nzq = (q32) surf->compressed_normal.z * QONE / COMPRESSED_NORMAL_ONE;
+    ooq = surf->originOffsetq;
+
+    // If a wall, ignore it. Likely a remnant, should never occur.
+    if (nyq == 0) {
+        return FALSE;
+    }
+
+    // Find the height of the floor at a given location.
+    heightq = qdiv((q32) -(x * nxq + nzq * z + ooq), nyq);
+    // Checks for floor interaction with a 78 unit buffer.
+    if (y - qtrunc(heightq - q(78)) < 0) {
+        return FALSE;
+    }
+
+    *pheightq = heightq;
+    return TRUE;
+}
+
+/**
+ * Iterate through the list of floors and find the first floor under a given point.
+ */
+static struct Surface *find_floor_from_listq(struct SurfaceNode *surfaceNode, s32 x, s32 y, s32 z, q32 *pheightq) {
+    register struct Surface *surf;
 
     // Iterate through the list of floors until there are no more floors.
     while (surfaceNode != NULL) {
         surf = surfaceNode->surface;
         surfaceNode = surfaceNode->next;
 
-        x1 = surf->vertex1[0];
-        z1 = surf->vertex1[2];
-        x2 = surf->vertex2[0];
-        z2 = surf->vertex2[2];
-
-        // Check that the point is within the triangle bounds.
-        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) < 0) {
-            continue;
+        if (floor_height_at(surf, x, y, z, 0, pheightq)) {
+            //! (Surface Cucking) Since only the first floor is returned and not the highest,
+            //  higher floors can be "cucked" by lower floors.
+            return surf;
         }
+    }
 
-        // To slightly save on computation time, set this later.
-        x3 = surf->vertex3[0];
-        z3 = surf->vertex3[2];
+    return NULL;
+}
 
-        if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) < 0) {
-            continue;
-        }
-        if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) < 0) {
+/**
+ * Same as find_floor_from_listq, for a list of baked surfaces.
+ */
+static struct Surface *find_floor_from_baked_list(const u16 *index, s32 x, s32 y, s32 z, q32 *pheightq) {
+    for (; *index != NO_BAKED_SURFACE; index++) {
+        // Skip the floors that are too high to be hit from here without reading them.
+        if (y < gBakedGrid.yRanges[*index].lowerY) {
             continue;
         }
 
-        // Determine if we are checking for the camera or not.
-        if (gCheckingSurfaceCollisionsForCamera != 0) {
-            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
-                continue;
-            }
-        }
-        // If we are not checking for the camera, ignore camera only floors.
-        else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
-            continue;
+        if (floor_height_at(&gBakedGrid.surfaces[*index], x, y, z, 0, pheightq)) {
+            return &gBakedGrid.surfaces[*index];
         }
+    }
 
-        nxq = (q32) surf->compressed_normal.x * QONE / COMPRESSED_NORMAL_ONE;
-        nyq = (q32) surf->compressed_normal.y * QONE / COMPRESSED_NORMAL_ONE;
-        nzq = (q32) surf->compressed_normal.z * QONE / COMPRESSED_NORMAL_ONE;
-        ooq = surf->originOffsetq;
+    return NULL;
+}
 
-        // If a wall, ignore it. Likely a remnant, should never occur.
-        if (nyq == 0) {
-            continue;
-        }
+/**
+ * The last static floor found by each object (hashed by its address), which
+ * is checked first the next time. Objects mostly stay on the same floor from
+ * frame to frame, and get their floor queried several times a frame.
+ */
+#define FLOOR_CACHE_SIZE 64
+static struct Surface *sFloorCache[FLOOR_CACHE_SIZE];
 
-        // Find the height of the floor at a given location.
-        heightq = qdiv((q32) -(x * nxq + nzq * z + ooq), nyq);
-        // Checks for floor interaction with a 78 unit buffer.
-        if (y - qtrunc(heightq - q(78)) < 0) {
-            continue;
-        }
+/**
+ * Forget the cached floors, they belong to the terrain of the previous area.
+ */
+void clear_floor_cache(void) {
+    s32 i;
+
+    for (i = 0; i < FLOOR_CACHE_SIZE; i++) {
+        sFloorCache[i] = NULL;
+    }
+}
+
+/**
+ * Find the first baked floor under a point, trying the current object's last
+ * floor before walking the list. A point strictly inside that floor and below
+ * its cache limit can't hit any floor that comes before it in the list, see
+ * bake_collision.py, so the walk would have found the same floor.
+ */
+static struct Surface *find_floor_from_baked_list_cached(const u16 *index, s32 x, s32 y, s32 z, q32 *pheightq) {
+    struct Surface **cached = &sFloorCache[(uintptr_t) gCurrentObject / sizeof(struct Object) % FLOOR_CACHE_SIZE];
+    struct Surface *floor = *cached;
+
+    if (floor != NULL && y < gBakedGrid.yRanges[floor - gBakedGrid.surfaces].upperY
+        && floor_height_at(floor, x, y, z, 1, pheightq)) {
+        gNumCalls.floorCacheHit += 1;
+        return floor;
+    }
 
-        *pheightq = heightq;
-        floor = surf;
-        break;
+    gNumCalls.floorCacheMiss += 1;
+    floor = find_floor_from_baked_list(index, x, y, z, pheightq);
+    if (floor != NULL) {
+        *cached = floor;
     }
 
-    //! (Surface Cucking) Since only the first floor is returned and not the highest,
-    //  higher floors can be "cucked" by lower floors.
     return floor;
 }
 
@@ -515,6 +690,7 @@ q32 find_floorq(q32 xPosq, q32 yPosq, q32 zPosq, struct Surface **pfloor) {
 
     struct Surface *floor, *dynamicFloor;
     struct SurfaceNode *surfaceList;
+    const u16 *bakedList;
 
     q32 heightq = q(FLOOR_LOWER_LIMIT);
     q32 dynamicHeightq = q(FLOOR_LOWER_LIMIT);
@@ -544,8 +720,16 @@ q32 find_floorq(q32 xPosq, q32 yPosq, q32 zPosq, struct Surface **pfloor) {
     dynamicFloor = find_floor_from_listq(surfaceList, x, y, z, &dynamicHeightq);
 
     // Check for surfaces that are a part of level geometry.
-    surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
-    floor = find_floor_from_listq(surfaceList, x, y, z, &heightq);
+#ifdef TARGET_PC
+    bench_record_collision_query('f', cellX, cellZ, xPosq, yPosq, zPosq, 0);
+#endif
+    if (gBakedGrid.surfaces != NULL) {
+        bakedList = baked_surface_list(x, z, SPATIAL_PARTITION_FLOORS);
+        floor = find_floor_from_baked_list_cached(bakedList, x, y, z, &heightq);
+    } else {
+        surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
+        floor = find_floor_from_listq(surfaceList, x, y, z, &heightq);
+    }
 
     // To prevent the Merry-Go-Round room from loading when Mario passes above the hole that leads
     // there, SURFACE_INTANGIBLE is used. This prevent the wrong room from loading, but can also allow
@@ -556,7 +740,14 @@ q32 find_floorq(q32 xPosq, q32 yPosq, q32 zPosq, struct Surface **pfloor) {
         //  (happens when there is no floor under the SURFACE_INTANGIBLE floor) but returns the height
         //  of the SURFACE_INTANGIBLE floor instead of the typical -11000 returned for a NULL floor.
         if (floor != NULL && floor->type == SURFACE_INTANGIBLE) {
-            floor = find_floor_from_listq(surfaceList, x, qtrunc(heightq) - 200, z, &heightq);
+#ifdef TARGET_PC
+            bench_record_collision_query('f', cellX, cellZ, xPosq, q(qtrunc(heightq) - 200), zPosq, 0);
+#endif
+            if (gBakedGrid.surfaces != NULL) {
+                floor = find_floor_from_baked_list(bakedList, x, qtrunc(heightq) - 200, z, &heightq);
+            } else {
+                floor = find_floor_from_listq(surfaceList, x, qtrunc(heightq) - 200, z, &heightq);
+            }
         }
     } else {
         // To prevent accidentally leaving the floor tangible, stop checking for it.
@@ -684,6 +875,19 @@ static s32 surface_list_length(struct SurfaceNode *list) {
     return count;
 }
 
+/**
+ * Finds the length of a baked surface list for debug purposes.
+ */
+static s32 baked_list_length(const u16 *list) {
+    s32 count = 0;
+
+    while (list[count] != NO_BAKED_SURFACE) {
+        count++;
+    }
+
+    return count;
+}
+
 /**
  * Print the area,number of walls, how many times they were called,
  * and some allocation information.
@@ -715,6 +919,15 @@ void debug_surface_list_infoq(q32 xPosq, q32 zPosq) {
     list = gDynamicSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_CEILS].next;
     numCeils += surface_list_length(list);
 
+    // For baked terrain, the subcell lists that the queries at this point use.
+    if (gBakedGrid.surfaces != NULL
+        && qtrunc(xPosq) > -LEVEL_BOUNDARY_MAX && qtrunc(xPosq) < LEVEL_BOUNDARY_MAX
+        && qtrunc(zPosq) > -LEVEL_BOUNDARY_MAX && qtrunc(zPosq) < LEVEL_BOUNDARY_MAX) {
+        numFloors += baked_list_length(baked_surface_list(qtrunc(xPosq), qtrunc(zPosq), SPATIAL_PARTITION_FLOORS));
+        numWalls += baked_list_length(baked_surface_list(qtrunc(xPosq), qtrunc(zPosq), SPATIAL_PARTITION_WALLS));
+        numCeils += baked_list_length(baked_surface_list(qtrunc(xPosq), qtrunc(zPosq), SPATIAL_PARTITION_CEILS));
+    }
+
     print_debug_top_down_mapinfo("area   %x", cellZ * NUM_CELLS + cellX);
 
     // Names represent ground, walls, and roofs as found in SMS.
@@ -735,9 +948,15 @@ void debug_surface_list_infoq(q32 xPosq, q32 zPosq) {
     print_debug_top_down_mapinfo("statbg %d", gNumStaticSurfaces);
     print_debug_top_down_mapinfo("movebg %d", gSurfacesAllocated - gNumStaticSurfaces);
 
+    // Floor cache hits and misses.
+    print_debug_top_down_mapinfo("fc %d", gNumCalls.floorCacheHit);
+    print_debug_top_down_mapinfo("fm %d", gNumCalls.floorCacheMiss);
+
     gNumCalls.floor = 0;
     gNumCalls.ceil = 0;
     gNumCalls.wall = 0;
+    gNumCalls.floorCacheHit = 0;
+    gNumCalls.floorCacheMiss = 0;
 }
 
 /**
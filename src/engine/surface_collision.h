@@ -8,7 +8,8 @@
 // Range level area is 16384x16384 (-8192 to +8192 in x and z)
 #define LEVEL_BOUNDARY_MAX  0x2000 // 8192
 
-#define CELL_SIZE           (1 << 10) // 0x400
+#define CELL_SIZE_SHIFT     10
+#define CELL_SIZE           (1 << CELL_SIZE_SHIFT) // 0x400
 
 #define CELL_HEIGHT_LIMIT           20000
 #define FLOOR_LOWER_LIMIT           -11000
@@ -44,6 +45,7 @@ q32 find_ceilq(q32 posXq, q32 posYq, q32 posZq, struct Surface **pceil);
 q32 find_floor_height_and_dataq(q32 xPosq, q32 yPosq, q32 zPosq, struct FloorGeometry **floorGeo);
 q32 find_floor_heightq(q32 xq, q32 yq, q32 zq);
 q32 find_floorq(q32 xPosq, q32 yPosq, q32 zPosq, struct Surface **pfloor);
+void clear_floor_cache(void);
 f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor);
 q32 find_water_levelq(q32 xq, q32 zq);
 f32 find_water_level(f32 x, f32 z);
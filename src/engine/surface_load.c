@@ -16,6 +16,10 @@
 #include "surface_load.h"
 #include "math_util.h"
 #include <assert.h>
+#include <stdio.h>
+#ifdef TARGET_PSX
+#include <ps1/gte.h>
+#endif
 
 /**
  * Partitions for course and object surfaces. The arrays represent
@@ -24,6 +28,11 @@
 SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
 SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
 
+/**
+ * Takes the place of the static partition when the area's terrain was baked.
+ */
+struct BakedGrid gBakedGrid;
+
 /**
  * Pools of data to contain either surface nodes or surfaces.
  */
@@ -32,20 +41,56 @@ struct Surface *sSurfacePool;
 
 u8 unused8038EEA8[0x30];
 
+/**
+ * Where the surfaces of an object were loaded into the surface pool, and what
+ * they were loaded with. The pool is refilled in the same order every frame,
+ * so if an object's surfaces start in the same place as the frame before,
+ * nothing has written over them, and they can be used again as long as the
+ * object hasn't moved.
+ */
+struct ObjectSurfaceCache {
+    struct Object *object;
+    void *collisionData;
+    ShortMatrix transform;
+    u16 generation;
+    s16 firstSurface;
+    s16 numSurfaces;
+};
+
+#define OBJECT_SURFACE_CACHE_SIZE 32
+static struct ObjectSurfaceCache sObjectSurfaceCache[OBJECT_SURFACE_CACHE_SIZE];
+
+/**
+ * How many times the dynamic surfaces were cleared.
+ */
+static u16 sDynamicSurfaceGeneration;
+
+/**
+ * The most surfaces and surface nodes that were in use at once since the
+ * pools were last allocated, static and object ones together. The pool sizes
+ * come from these, see report_surface_pool_peaks.
+ */
+static s32 sSurfacesPeak;
+static s32 sSurfaceNodesPeak;
+
 /**
  * Allocate the part of the surface node pool to contain a surface node.
  */
 static struct SurfaceNode *alloc_surface_node(void) {
-    struct SurfaceNode *node = &sSurfaceNodePool[gSurfaceNodesAllocated];
-    gSurfaceNodesAllocated++;
-
-    node->next = NULL;
+    struct SurfaceNode *node;
 
     //! A bounds check! If there's more surface nodes than 7000 allowed,
     //  we, um...
     // Perhaps originally just debug feedback?
-    // replaced it with an assert
-    assertm(gSurfaceNodesAllocated < SURFACE_NODE_POOL_LEN, "surface node pool full");
+    // replaced it with an abort, which release builds keep
+    if (gSurfaceNodesAllocated >= SURFACE_NODE_POOL_LEN) {
+        abortf("surface node pool full (%d nodes)\n", SURFACE_NODE_POOL_LEN);
+    }
+
+    node = &sSurfaceNodePool[gSurfaceNodesAllocated];
+    gSurfaceNodesAllocated++;
+
+    node->next = NULL;
 
     return node;
 }
@@ -55,14 +100,18 @@ static struct SurfaceNode *alloc_surface_node(void) {
  * initialize the surface.
  */
 static struct Surface *alloc_surface(void) {
-    struct Surface *surface = &sSurfacePool[gSurfacesAllocated];
-    gSurfacesAllocated++;
+    struct Surface *surface;
 
     //! A bounds check! If there's more surfaces than the 2300 allowed,
     //  we, um...
     // Perhaps originally just debug feedback?
-    // replaced with an assert
-    assertm(gSurfacesAllocated < SURFACE_POOL_LEN, "surface pool full");
+    // replaced with an abort, which release builds keep
+    if (gSurfacesAllocated >= SURFACE_POOL_LEN) {
+        abortf("surface pool full (%d surfaces)\n", SURFACE_POOL_LEN);
+    }
+
+    surface = &sSurfacePool[gSurfacesAllocated];
+    gSurfacesAllocated++;
 
     surface->type = 0;
     surface->force = 0;
@@ -93,6 +142,8 @@ static void clear_spatial_partition(SpatialPartitionCell *cells) {
  */
 static void clear_static_surfaces(void) {
     clear_spatial_partition(&gStaticSurfacePartition[0][0]);
+    gBakedGrid.surfaces = NULL;
+    clear_floor_cache();
 }
 
 /**
@@ -517,11 +568,44 @@ static void load_environmental_regions(s16 **data) {
 }
 
 /**
- * Allocate some of the main pool for surfaces (2300 surf) and for surface nodes (7000 nodes).
+ * Use the surfaces of an area that were read and partitioned at build time.
+ * They're queried where they are in the level data, so nothing is allocated.
+ */
+static void load_baked_surfaces(const struct BakedTerrain *baked) {
+    gBakedGrid.surfaces = segmented_to_virtual(baked->surfaces);
+    gBakedGrid.yRanges = segmented_to_virtual(baked->yRanges);
+    gBakedGrid.indices = segmented_to_virtual(baked->indices);
+    gBakedGrid.lists = segmented_to_virtual(baked->lists);
+    gBakedGrid.cells = baked->cells;
+}
+
+/**
+ * Print how full the surface pools got since they were last allocated, which
+ * covers the level that was just left. Like the main pool footprint, only on
+ * the pc build and over the serial link.
+ */
+void report_surface_pool_peaks(void) {
+#if defined(TARGET_PC) || defined(SERIAL)
+    if (sSurfacesPeak != 0) {
+        printf("surface pools peak: %d/%d surfaces, %d/%d nodes\n", sSurfacesPeak, SURFACE_POOL_LEN,
+               sSurfaceNodesPeak, SURFACE_NODE_POOL_LEN);
+    }
+#endif
+    sSurfacesPeak = 0;
+    sSurfaceNodesPeak = 0;
+}
+
+/**
+ * Allocate some of the main pool for surfaces and surface nodes. Baked
+ * terrain doesn't use them, so they only need to fit object surfaces.
  */
 void alloc_surface_pools(void) {
+    report_surface_pool_peaks();
+
+    enum MemoryArena prevArena = main_pool_set_arena(MEMORY_ARENA_SURFACES);
     sSurfaceNodePool = main_pool_alloc(SURFACE_NODE_POOL_LEN * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
     sSurfacePool = main_pool_alloc(SURFACE_POOL_LEN * sizeof(struct Surface), MEMORY_POOL_LEFT);
+    main_pool_set_arena(prevArena);
 
     gCCMEnteredSlide = 0;
     reset_red_coins_collected();
@@ -558,6 +642,10 @@ u32 get_area_terrain_size(s16 *data) {
                 data += 6 * numRegions;
                 break;
 
+            case TERRAIN_LOAD_BAKED:
+                data = ((struct BakedCollision *) (data - 1))->data;
+                break;
+
             case TERRAIN_LOAD_CONTINUE:
                 continue;
 
@@ -585,6 +673,7 @@ u32 get_area_terrain_size(s16 *data) {
 void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects) {
     s16 terrainLoadType;
     s16 *vertexData = NULL;
+    s32 i;
 
     // Initialize the data for this.
     gEnvironmentRegions = NULL;
@@ -593,6 +682,11 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
 
     clear_static_surfaces();
 
+    if (*data == TERRAIN_LOAD_BAKED) {
+        load_baked_surfaces(segmented_to_virtual(((struct BakedCollision *) data)->baked));
+        data = ((struct BakedCollision *) data)->data;
+    }
+
     // A while loop iterating through each section of the level data. Sections of data
     // are prefixed by a terrain "type." This type is reused for surfaces as the surface
     // type.
@@ -633,6 +727,11 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
 
     gNumStaticSurfaceNodes = gSurfaceNodesAllocated;
     gNumStaticSurfaces = gSurfacesAllocated;
+
+    // The static surfaces may have been loaded over the object surfaces.
+    for (i = 0; i < OBJECT_SURFACE_CACHE_SIZE; i++) {
+        sObjectSurfaceCache[i].object = NULL;
+    }
 }
 
 /**
@@ -640,52 +739,99 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
  */
 void clear_dynamic_surfaces(void) {
     if (!(gTimeStopState & TIME_STOP_ACTIVE)) {
+        // the pools are at their fullest for this frame right before being cleared
+        if (gSurfacesAllocated > sSurfacesPeak) {
+            sSurfacesPeak = gSurfacesAllocated;
+        }
+        if (gSurfaceNodesAllocated > sSurfaceNodesPeak) {
+            sSurfaceNodesPeak = gSurfaceNodesAllocated;
+        }
         gSurfacesAllocated = gNumStaticSurfaces;
         gSurfaceNodesAllocated = gNumStaticSurfaceNodes;
+        sDynamicSurfaceGeneration++;
 
         clear_spatial_partition(&gDynamicSurfacePartition[0][0]);
     }
 }
 
+/**
+ * Get the transformation (with scale) to apply to the current object's vertices.
+ */
+static void get_object_transform(ShortMatrix *mq) {
+    ShortMatrix *objectTransformq = &gCurrentObject->transformq;
+
+    if(!gCurrentObject->header.gfx.throwMatrixq) {
+        gCurrentObject->header.gfx.throwMatrixq = objectTransformq;
+        obj_build_transform_from_pos_and_angle(gCurrentObject, O_POS_INDEX, O_FACE_ANGLE_INDEX);
+    }
+
+    obj_apply_scale_to_mtxq(gCurrentObject, mq, objectTransformq);
+}
+
 /**
  * Applies an object's transformation to the object's vertices.
  */
-void transform_object_vertices(s16 **data, s16 *vertexData) {
+void transform_object_vertices(s16 **data, s16 *vertexData, const ShortMatrix *mq) {
     register s16 *vertices;
     register s32 vxi, vyi, vzi;
     register s32 numVertices;
 
-    ShortMatrix* objectTransformq;
-    ShortMatrix mq;
-
-    objectTransformq = &gCurrentObject->transformq;
-
     numVertices = *(*data);
     (*data)++;
 
     vertices = *data;
+    *data += numVertices * 3;
+
+    //! No bounds check on vertex data
+#ifdef TARGET_PSX
+    // MVMVA multiplies by the rows of the rotation matrix, the vertices are
+    // multiplied by the columns of mq. With the translation added before the
+    // shift, the results are the same as the C version below.
+    gte_setRotationMatrix(
+        mq->m[0][0], mq->m[1][0], mq->m[2][0],
+        mq->m[0][1], mq->m[1][1], mq->m[2][1],
+        mq->m[0][2], mq->m[1][2], mq->m[2][2]
+    );
+    gte_setControlReg(GTE_TRX, mq->t[0]);
+    gte_setControlReg(GTE_TRY, mq->t[1]);
+    gte_setControlReg(GTE_TRZ, mq->t[2]);
+
+    if (numVertices > 0) {
+        gte_setV0(vertices[0], vertices[1], vertices[2]);
+        vertices += 3;
+    }
+
+    while (numVertices--) {
+        gte_commandAfterLoad(GTE_CMD_MVMVA | GTE_SF | GTE_V_V0 | GTE_MX_RT | GTE_CV_TR);
+
+        // Fetch the next vertex while this one is transformed.
+        if (numVertices > 0) {
+            vxi = *(vertices++);
+            vyi = *(vertices++);
+            vzi = *(vertices++);
+        }
 
-    if(!gCurrentObject->header.gfx.throwMatrixq) {
-        gCurrentObject->header.gfx.throwMatrixq = objectTransformq;
-        obj_build_transform_from_pos_and_angle(gCurrentObject, O_POS_INDEX, O_FACE_ANGLE_INDEX);
-    }
-
-    obj_apply_scale_to_mtxq(gCurrentObject, &mq, objectTransformq);
+        *vertexData++ = gte_getDataReg(GTE_MAC1);
+        *vertexData++ = gte_getDataReg(GTE_MAC2);
+        *vertexData++ = gte_getDataReg(GTE_MAC3);
 
+        if (numVertices > 0) {
+            gte_setV0(vxi, vyi, vzi);
+        }
+    }
+#else
     // Go through all vertices, rotating and translating them to transform the object.
+    // The sums are kept in 64 bits like in the GTE, so they can't overflow differently.
     while(numVertices--) {
         vxi = *(vertices++);
         vyi = *(vertices++);
         vzi = *(vertices++);
 
-        //! No bounds check on vertex data
-        // TODO: optimize with GTE?
-        *vertexData++ = qtrunc(vxi * (q32) mq.m[0][0] + vyi * (q32) mq.m[1][0] + vzi * (q32) mq.m[2][0]) + mq.t[0];
-        *vertexData++ = qtrunc(vxi * (q32) mq.m[0][1] + vyi * (q32) mq.m[1][1] + vzi * (q32) mq.m[2][1]) + mq.t[1];
-        *vertexData++ = qtrunc(vxi * (q32) mq.m[0][2] + vyi * (q32) mq.m[1][2] + vzi * (q32) mq.m[2][2]) + mq.t[2];
+        *vertexData++ = (q32) (((q64) vxi * mq->m[0][0] + (q64) vyi * mq->m[1][0] + (q64) vzi * mq->m[2][0]) >> FRACT_BITS) + mq->t[0];
+        *vertexData++ = (q32) (((q64) vxi * mq->m[0][1] + (q64) vyi * mq->m[1][1] + (q64) vzi * mq->m[2][1]) >> FRACT_BITS) + mq->t[1];
+        *vertexData++ = (q32) (((q64) vxi * mq->m[0][2] + (q64) vyi * mq->m[1][2] + (q64) vzi * mq->m[2][2]) >> FRACT_BITS) + mq->t[2];
     }
-
-    *data = vertices;
+#endif
 }
 
 /**
@@ -744,11 +890,57 @@ void load_object_surfaces(s16 **data, s16 *vertexData) {
     }
 }
 
+/**
+ * Check whether two transformations are the same.
+ */
+static s32 transforms_equal(const ShortMatrix *a, const ShortMatrix *b) {
+    s32 i, j;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            if (a->m[i][j] != b->m[i][j]) {
+                return FALSE;
+            }
+        }
+        if (a->t[i] != b->t[i]) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Add the surfaces the current object loaded last frame to the partition
+ * again, if they're still where they were and it hasn't moved since.
+ * Returns whether they were.
+ */
+static s32 reload_cached_object_surfaces(struct ObjectSurfaceCache *cache, const ShortMatrix *mq) {
+    s32 i;
+
+    if (cache->object != gCurrentObject || cache->collisionData != gCurrentObject->collisionData
+        || cache->generation != (u16) (sDynamicSurfaceGeneration - 1)
+        || cache->firstSurface != gSurfacesAllocated || !transforms_equal(&cache->transform, mq)) {
+        return FALSE;
+    }
+
+    // Same order as they were added in, so the cell lists come out the same.
+    for (i = 0; i < cache->numSurfaces; i++) {
+        add_surface(&sSurfacePool[cache->firstSurface + i], TRUE);
+    }
+    gSurfacesAllocated += cache->numSurfaces;
+    cache->generation = sDynamicSurfaceGeneration;
+
+    return TRUE;
+}
+
 /**
  * Transform an object's vertices, reload them, and render the object.
  */
 void load_object_collision_model(void) {
     s16 vertexData[600];
+    ShortMatrix mq;
+    struct ObjectSurfaceCache *cache;
 
     s16 *collisionData = gCurrentObject->collisionData;
     q32 marioDistq = QFIELD(gCurrentObject, oDistanceToMario);
@@ -770,11 +962,24 @@ void load_object_collision_model(void) {
     if (!(gTimeStopState & TIME_STOP_ACTIVE) && marioDistq < tangibleDistq
         && !(gCurrentObject->activeFlags & ACTIVE_FLAG_IN_DIFFERENT_ROOM)) {
         collisionData++;
-        transform_object_vertices(&collisionData, vertexData);
+        get_object_transform(&mq);
+        cache = &sObjectSurfaceCache[(uintptr_t) gCurrentObject / sizeof(struct Object) % OBJECT_SURFACE_CACHE_SIZE];
+
+        if (!reload_cached_object_surfaces(cache, &mq)) {
+            cache->object = gCurrentObject;
+            cache->collisionData = gCurrentObject->collisionData;
+            cache->transform = mq;
+            cache->generation = sDynamicSurfaceGeneration;
+            cache->firstSurface = gSurfacesAllocated;
+
+            transform_object_vertices(&collisionData, vertexData, &mq);
+
+            // TERRAIN_LOAD_CONTINUE acts as an "end" to the terrain data.
+            while (*collisionData != TERRAIN_LOAD_CONTINUE) {
+                load_object_surfaces(&collisionData, vertexData);
+            }
 
-        // TERRAIN_LOAD_CONTINUE acts as an "end" to the terrain data.
-        while (*collisionData != TERRAIN_LOAD_CONTINUE) {
-            load_object_surfaces(&collisionData, vertexData);
+            cache->numSurfaces = gSurfacesAllocated - cache->firstSurface;
         }
     }
 
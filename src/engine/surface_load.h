@@ -24,18 +24,73 @@ enum
 
 typedef struct SurfaceNode SpatialPartitionCell[3];
 
+#define NO_BAKED_SURFACE 0xFFFF
+// baked cells can be split into up to 4x4 subcells of 256 units
+#define BAKED_CELL_MAX_SPLIT 2
+
+// the heights a query can be at to hit a surface, see bake_collision.py
+// floors only need lowerY, their upperY is how high a query in them can be for the floor cache to return them
+struct SurfaceYRange
+{
+    s16 lowerY;
+    s16 upperY;
+};
+
+struct BakedCell
+{
+    // where the floor, ceiling and wall lists of the subcells start in lists
+    u16 lists;
+    // the wall list of the whole cell, for when walls pushed the query out of it
+    u16 walls;
+    // the cell is split into (1 << split) x (1 << split) subcells
+    u16 split;
+};
+
+// the static surfaces of an area, read and sorted into cells at build time by tools/bake_collision.py
+struct BakedTerrain
+{
+    struct Surface *surfaces;
+    const struct SurfaceYRange *yRanges;
+    // the surface indices of every list, each one terminated by NO_BAKED_SURFACE, the first one is empty
+    const u16 *indices;
+    // where each list starts in indices
+    const u16 *lists;
+    struct BakedCell cells[NUM_CELLS][NUM_CELLS];
+};
+
+// replaces the vertices and triangles at the start of the terrain data
+struct BakedCollision
+{
+    Collision cmd; // TERRAIN_LOAD_BAKED
+    const struct BakedTerrain *baked;
+    Collision data[];
+};
+
+// the baked terrain of the current area with its addresses resolved, surfaces is NULL if it wasn't baked
+struct BakedGrid
+{
+    struct Surface *surfaces;
+    const struct SurfaceYRange *yRanges;
+    const u16 *indices;
+    const u16 *lists;
+    const struct BakedCell (*cells)[NUM_CELLS];
+};
+
 // Needed for bs bss reordering memes.
 extern s32 unused8038BE90;
 
 extern SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
 extern SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
+extern struct BakedGrid gBakedGrid;
 extern struct SurfaceNode *sSurfaceNodePool;
 extern struct Surface *sSurfacePool;
 
+// baked terrain doesn't take anything from these, to be shrunk to what report_surface_pool_peaks prints
 #define SURFACE_NODE_POOL_LEN 6000 // originally 7000
 #define SURFACE_POOL_LEN 2300 // originally 2300
 
 void alloc_surface_pools(void);
+void report_surface_pool_peaks(void);
 #ifdef NO_SEGMENTED_MEMORY
 u32 get_area_terrain_size(s16 *data);
 #endif
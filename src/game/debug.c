@@ -8,6 +8,7 @@
 #include "main.h"
 #include "object_constants.h"
 #include "object_fields.h"
+#include "object_collision.h"
 #include "object_helpers.h"
 #include "object_list_processor.h"
 #include "print.h"
@@ -316,6 +317,8 @@ void debug_unknown_level_select_check(void) {
         gNumCalls.floor = 0;
         gNumCalls.ceil = 0;
         gNumCalls.wall = 0;
+        gNumCalls.floorCacheHit = 0;
+        gNumCalls.floorCacheMiss = 0;
     }
 }
 
@@ -466,6 +469,10 @@ void try_print_debug_mario_object_info(void) {
     }
 
     print_debug_top_down_mapinfo("obj  %d", gObjectCounter);
+    print_debug_top_down_mapinfo("pair %d", gObjectPairTests);
+#ifdef OBJECT_LOD
+    print_debug_top_down_mapinfo("skip %d", gNumObjectUpdatesSkipped);
+#endif
 
     if (gNumFindFloorMisses) {
         print_debug_bottom_up("NULLBG %d", gNumFindFloorMisses);
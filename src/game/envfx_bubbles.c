@@ -10,6 +10,7 @@
 #include "engine/behavior_script.h"
 #include "audio/external.h"
 #include "textures.h"
+#include "port/gfx/gfx.h"
 
 /**
  * This file implements environment effects that are not snow:
@@ -21,20 +22,12 @@
  */
 
 s16 gEnvFxBubbleConfig[10];
-static Gfx *sGfxCursor; // points to end of display list for bubble particles
 static s32 sBubbleParticleCount;
 static s32 sBubbleParticleMaxCount;
 
 UNUSED s32 D_80330690 = 0;
 UNUSED s32 D_80330694 = 0;
 
-/// Template for a bubble particle triangle
-Vtx_t gBubbleTempVtx[3] = {
-    { { 0, 0, 0 }, 0, { 1544, 964 }, { 0xFF, 0xFF, 0xFF, 0xFF } },
-    { { 0, 0, 0 }, 0, { 522, -568 }, { 0xFF, 0xFF, 0xFF, 0xFF } },
-    { { 0, 0, 0 }, 0, { -498, 964 }, { 0xFF, 0xFF, 0xFF, 0xFF } },
-};
-
 /**
  * Check whether the particle with the given index is
  * laterally within distance of point (x, z). Used to
@@ -361,81 +354,38 @@ s32 envfx_init_bubble(s32 mode) {
 
 /**
  * Update particles depending on mode.
- * Also sets the given vertices to the correct shape for each mode,
- * though they are not being rotated yet.
+ * Also sets the size of the quads drawing them, and how far above their
+ * position the quads are centered.
  */
-void envfx_bubbles_update_switch(s32 mode, Vec3s camTo, Vec3s vertex1, Vec3s vertex2, Vec3s vertex3) {
+void envfx_bubbles_update_switch(s32 mode, Vec3s camTo, s16 *halfSize, s16 *lift) {
     switch (mode) {
         case ENVFX_FLOWERS:
             envfx_update_flower(camTo);
-            vertex1[0] = 50;  vertex1[1] = 0;  vertex1[2] = 0;
-            vertex2[0] = 0;   vertex2[1] = 75; vertex2[2] = 0;
-            vertex3[0] = -50; vertex3[1] = 0;  vertex3[2] = 0;
+            *halfSize = 25; *lift = 23;
             break;
 
         case ENVFX_LAVA_BUBBLES:
             envfx_update_lava(camTo);
-            vertex1[0] = 100;  vertex1[1] = 0;   vertex1[2] = 0;
-            vertex2[0] = 0;    vertex2[1] = 150; vertex2[2] = 0;
-            vertex3[0] = -100; vertex3[1] = 0;   vertex3[2] = 0;
+            *halfSize = 50; *lift = 47;
             break;
 
         case ENVFX_WHIRLPOOL_BUBBLES:
             envfx_update_whirlpool();
-            vertex1[0] = 40;  vertex1[1] = 0;  vertex1[2] = 0;
-            vertex2[0] = 0;   vertex2[1] = 60; vertex2[2] = 0;
-            vertex3[0] = -40; vertex3[1] = 0;  vertex3[2] = 0;
+            *halfSize = 20; *lift = 19;
             break;
 
         case ENVFX_JETSTREAM_BUBBLES:
             envfx_update_jetstream();
-            vertex1[0] = 40;  vertex1[1] = 0;  vertex1[2] = 0;
-            vertex2[0] = 0;   vertex2[1] = 60; vertex2[2] = 0;
-            vertex3[0] = -40; vertex3[1] = 0;  vertex3[2] = 0;
+            *halfSize = 20; *lift = 19;
             break;
     }
 }
 
 /**
- * Append 15 vertices to 'gfx', which is enough for 5 bubbles starting at
- * 'index'. The 3 input vertices represent the rotated triangle around (0,0,0)
- * that will be translated to bubble positions to draw the bubble image
- */
-void append_bubble_vertex_buffer(Gfx *gfx, s32 index, Vec3s vertex1, Vec3s vertex2, Vec3s vertex3,
-                                 Vtx *template) {
-    s32 i = 0;
-    Vtx *vertBuf = alloc_display_list(15 * sizeof(Vtx));
-
-    if (vertBuf == NULL) {
-        return;
-    }
-
-    for (i = 0; i < 15; i += 3) {
-        vertBuf[i] = template[0];
-        (vertBuf + i)->v.ob[0] = (gEnvFxBuffer + (index + i / 3))->xPos + vertex1[0];
-        (vertBuf + i)->v.ob[1] = (gEnvFxBuffer + (index + i / 3))->yPos + vertex1[1];
-        (vertBuf + i)->v.ob[2] = (gEnvFxBuffer + (index + i / 3))->zPos + vertex1[2];
-
-        vertBuf[i + 1] = template[1];
-        (vertBuf + i + 1)->v.ob[0] = (gEnvFxBuffer + (index + i / 3))->xPos + vertex2[0];
-        (vertBuf + i + 1)->v.ob[1] = (gEnvFxBuffer + (index + i / 3))->yPos + vertex2[1];
-        (vertBuf + i + 1)->v.ob[2] = (gEnvFxBuffer + (index + i / 3))->zPos + vertex2[2];
-
-        vertBuf[i + 2] = template[2];
-        (vertBuf + i + 2)->v.ob[0] = (gEnvFxBuffer + (index + i / 3))->xPos + vertex3[0];
-        (vertBuf + i + 2)->v.ob[1] = (gEnvFxBuffer + (index + i / 3))->yPos + vertex3[1];
-        (vertBuf + i + 2)->v.ob[2] = (gEnvFxBuffer + (index + i / 3))->zPos + vertex3[2];
-    }
-
-    gSPVertex(gfx, VIRTUAL_TO_PHYSICAL(vertBuf), 15, 0);
-}
-
-/**
- * Appends to the enfvx display list a command setting the appropriate texture
- * for a specific particle. The display list is not passed as parameter but uses
- * the global sGfxCursor instead.
+ * Returns the texture of a specific particle. Flowers and lava bubbles
+ * have frame animations.
  */
-void envfx_set_bubble_texture(s32 mode, s16 index) {
+void *envfx_get_bubble_texture(s32 mode, s16 index) {
     void **imageArr;
     s16 frame = (gEnvFxBuffer + index)->animFrame;
 
@@ -452,58 +402,52 @@ void envfx_set_bubble_texture(s32 mode, s16 index) {
 
         case ENVFX_WHIRLPOOL_BUBBLES:
         case ENVFX_JETSTREAM_BUBBLES:
+        default:
             imageArr = segmented_to_virtual(&bubble_ptr_0B006848);
             frame = 0;
             break;
     }
 
-    gDPSetTextureImage(sGfxCursor++, G_IM_FMT_RGBA, G_IM_SIZ_16b, 1, *(imageArr + frame));
-    gSPDisplayList(sGfxCursor++, &tiny_bubble_dl_0B006D68);
+    return segmented_to_virtual(*(imageArr + frame));
 }
 
 /**
- * Updates the bubble particle positions, then generates and returns a display
- * list drawing them.
+ * Updates the bubble particle positions, then draws them as batches of camera
+ * facing quads, one per run of particles sharing a texture.
  */
-Gfx *envfx_update_bubble_particles(s32 mode, UNUSED Vec3s marioPos, Vec3s camFrom, Vec3s camTo) {
-    s32 i;
-    s16 radius, pitch, yaw;
-
-    Vec3s vertex1;
-    Vec3s vertex2;
-    Vec3s vertex3;
-
-    Gfx *gfxStart;
-
-    gfxStart = alloc_display_list(((sBubbleParticleMaxCount / 5) * 10 + sBubbleParticleMaxCount + 3)
-                                  * sizeof(Gfx));
-    if (gfxStart == NULL) {
-        return NULL;
-    }
-
-    sGfxCursor = gfxStart;
-
-    orbit_from_positions(camTo, camFrom, &radius, &pitch, &yaw);
-    envfx_bubbles_update_switch(mode, camTo, vertex1, vertex2, vertex3);
-    rotate_triangle_vertices(vertex1, vertex2, vertex3, pitch, yaw);
-
-    gSPDisplayList(sGfxCursor++, &tiny_bubble_dl_0B006D38);
+void envfx_update_bubble_particles(s32 mode, UNUSED Vec3s marioPos, UNUSED Vec3s camFrom, Vec3s camTo) {
+    s32 i, j;
+    s32 runStart;
+    s16 halfSize, lift;
+    void *texture;
+    ParticleBatch *batch;
+    s16 *x, *y, *z;
+
+    envfx_bubbles_update_switch(mode, camTo, &halfSize, &lift);
+
+    // like the original display list, groups of 5 particles take the texture of their first one
+    for (runStart = 0; runStart < sBubbleParticleMaxCount; runStart = i) {
+        texture = envfx_get_bubble_texture(mode, runStart);
+        for (i = runStart + 5; i < sBubbleParticleMaxCount; i += 5) {
+            if (envfx_get_bubble_texture(mode, i) != texture) {
+                break;
+            }
+        }
+        if (i > sBubbleParticleMaxCount) {
+            i = sBubbleParticleMaxCount;
+        }
 
-    for (i = 0; i < sBubbleParticleMaxCount; i += 5) {
-        gDPPipeSync(sGfxCursor++);
-        envfx_set_bubble_texture(mode, i);
-        append_bubble_vertex_buffer(sGfxCursor++, i, vertex1, vertex2, vertex3, (Vtx *) gBubbleTempVtx);
-        gSP1Triangle(sGfxCursor++, 0, 1, 2, 0);
-        gSP1Triangle(sGfxCursor++, 3, 4, 5, 0);
-        gSP1Triangle(sGfxCursor++, 6, 7, 8, 0);
-        gSP1Triangle(sGfxCursor++, 9, 10, 11, 0);
-        gSP1Triangle(sGfxCursor++, 12, 13, 14, 0);
+        gfx_emit_tex(texture);
+        batch = gfx_emit_particles(i - runStart, halfSize, lift);
+        x = batch->pos;
+        y = x + batch->count;
+        z = y + batch->count;
+        for (j = 0; j < batch->count; j++) {
+            x[j] = (gEnvFxBuffer + runStart + j)->xPos;
+            y[j] = (gEnvFxBuffer + runStart + j)->yPos;
+            z[j] = (gEnvFxBuffer + runStart + j)->zPos;
+        }
     }
-
-    gSPDisplayList(sGfxCursor++, &tiny_bubble_dl_0B006AB0);
-    gSPEndDisplayList(sGfxCursor++);
-
-    return gfxStart;
 }
 
 /**
@@ -524,41 +468,34 @@ void envfx_set_max_bubble_particles(s32 mode) {
 /**
  * Update bubble-like environment effects. Assumes the mode is larger than 10,
  * lower modes are snow effects which are updated in a different function.
- * Returns a display list drawing the particles.
+ * Draws the particles.
  */
-Gfx *envfx_update_bubbles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom) {
-    Gfx *gfx;
-
+void envfx_update_bubbles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom) {
     if (gEnvFxMode == 0 && !envfx_init_bubble(mode)) {
-        return NULL;
+        return;
     }
 
     envfx_set_max_bubble_particles(mode);
 
     if (sBubbleParticleMaxCount == 0) {
-        return NULL;
+        return;
     }
 
     switch (mode) {
         case ENVFX_FLOWERS:
-            gfx = envfx_update_bubble_particles(ENVFX_FLOWERS, marioPos, camFrom, camTo);
+            envfx_update_bubble_particles(ENVFX_FLOWERS, marioPos, camFrom, camTo);
             break;
 
         case ENVFX_LAVA_BUBBLES:
-            gfx = envfx_update_bubble_particles(ENVFX_LAVA_BUBBLES, marioPos, camFrom, camTo);
+            envfx_update_bubble_particles(ENVFX_LAVA_BUBBLES, marioPos, camFrom, camTo);
             break;
 
         case ENVFX_WHIRLPOOL_BUBBLES:
-            gfx = envfx_update_bubble_particles(ENVFX_WHIRLPOOL_BUBBLES, marioPos, camFrom, camTo);
+            envfx_update_bubble_particles(ENVFX_WHIRLPOOL_BUBBLES, marioPos, camFrom, camTo);
             break;
 
         case ENVFX_JETSTREAM_BUBBLES:
-            gfx = envfx_update_bubble_particles(ENVFX_JETSTREAM_BUBBLES, marioPos, camFrom, camTo);
+            envfx_update_bubble_particles(ENVFX_JETSTREAM_BUBBLES, marioPos, camFrom, camTo);
             break;
-
-        default:
-            return NULL;
     }
-
-    return gfx;
 }
@@ -17,6 +17,6 @@
 
 // Used to communicate from whirlpool behavior to envfx
 extern s16 gEnvFxBubbleConfig[10];
-Gfx *envfx_update_bubbles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom);
+void envfx_update_bubbles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom);
 
 #endif // ENVFX_BUBBLES_H
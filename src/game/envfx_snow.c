@@ -12,12 +12,14 @@
 #include "engine/behavior_script.h"
 #include "audio/external.h"
 #include "obj_behaviors.h"
+#include "port/gfx/gfx.h"
 
 /**
  * This file contains the function that handles 'environment effects',
  * which are particle effects related to the level type that, unlike
- * object-based particle effects, are rendered more efficiently by manually
- * generating display lists instead of drawing each particle separately.
+ * object-based particle effects, are rendered more efficiently by emitting
+ * all the particles as one batch of camera facing quads instead of drawing
+ * each particle separately.
  * This file implements snow effects, while in 'envfx_bubbles.c' the
  * implementation for flowers (unused), lava bubbles and jet stream bubbles
  * can be found.
@@ -25,13 +27,6 @@
  * called from geo_envfx_main in level_geo.c
  */
 
-// Might be duplicate
-struct SnowFlakeVertex {
-    s16 x;
-    s16 y;
-    s16 z;
-};
-
 struct EnvFxParticle *gEnvFxBuffer;
 Vec3i gSnowCylinderLastPos;
 s16 gSnowParticleCount;
@@ -41,17 +36,9 @@ s16 gSnowParticleMaxCount;
 s8 gEnvFxMode = 0;
 UNUSED s32 D_80330644 = 0;
 
-/// Template for a snow particle triangle
-Vtx gSnowTempVtx[3] = { { { { -5, 5, 0 }, 0, { 0, 0 }, { 0x7F, 0x7F, 0x7F, 0xFF } } },
-                        { { { -5, -5, 0 }, 0, { 0, 960 }, { 0x7F, 0x7F, 0x7F, 0xFF } } },
-                        { { { 5, 5, 0 }, 0, { 960, 0 }, { 0x7F, 0x7F, 0x7F, 0xFF } } } };
-
-// Change these to make snowflakes smaller or bigger
-struct SnowFlakeVertex gSnowFlakeVertex1 = { -5, 5, 0 };
-struct SnowFlakeVertex gSnowFlakeVertex2 = { -5, -5, 0 };
-struct SnowFlakeVertex gSnowFlakeVertex3 = { 5, 5, 0 };
+// Half the width of a snowflake, change this to make snowflakes smaller or bigger
+s16 gSnowFlakeSize = 5;
 
-extern Gfx tiny_bubble_dl_0B006AB0[];
 extern Gfx tiny_bubble_dl_0B006A50[];
 extern Gfx tiny_bubble_dl_0B006CD8[];
 
@@ -300,98 +287,15 @@ void envfx_update_snow_water(s32 snowCylinderX, s32 snowCylinderY, s32 snowCylin
 }
 
 /**
- * Rotates the input vertices according to the give pitch and yaw. This
- * is needed for billboarding of particles.
- */
-void rotate_triangle_vertices(Vec3s vertex1, Vec3s vertex2, Vec3s vertex3, s16 pitch, s16 yaw) {
-    f32 cosPitch = coss(pitch);
-    f32 sinPitch = sins(pitch);
-    f32 cosMYaw = coss(-yaw);
-    f32 sinMYaw = sins(-yaw);
-
-    Vec3f v1, v2, v3;
-
-    v1[0] = vertex1[0];
-    v1[1] = vertex1[1];
-    v1[2] = vertex1[2];
-
-    v2[0] = vertex2[0];
-    v2[1] = vertex2[1];
-    v2[2] = vertex2[2];
-
-    v3[0] = vertex3[0];
-    v3[1] = vertex3[1];
-    v3[2] = vertex3[2];
-
-    vertex1[0] = v1[0] * cosMYaw + v1[1] * (sinPitch * sinMYaw) + v1[2] * (-sinMYaw * cosPitch);
-    vertex1[1] = v1[1] * cosPitch + v1[2] * sinPitch;
-    vertex1[2] = v1[0] * sinMYaw + v1[1] * (-sinPitch * cosMYaw) + v1[2] * (cosPitch * cosMYaw);
-
-    vertex2[0] = v2[0] * cosMYaw + v2[1] * (sinPitch * sinMYaw) + v2[2] * (-sinMYaw * cosPitch);
-    vertex2[1] = v2[1] * cosPitch + v2[2] * sinPitch;
-    vertex2[2] = v2[0] * sinMYaw + v2[1] * (-sinPitch * cosMYaw) + v2[2] * (cosPitch * cosMYaw);
-
-    vertex3[0] = v3[0] * cosMYaw + v3[1] * (sinPitch * sinMYaw) + v3[2] * (-sinMYaw * cosPitch);
-    vertex3[1] = v3[1] * cosPitch + v3[2] * sinPitch;
-    vertex3[2] = v3[0] * sinMYaw + v3[1] * (-sinPitch * cosMYaw) + v3[2] * (cosPitch * cosMYaw);
-}
-
-/**
- * Append 15 vertices to 'gfx', which is enough for 5 snowflakes starting at
- * 'index' in the buffer. The 3 input vertices represent the rotated triangle
- * around (0,0,0) that will be translated to snowflake positions to draw the
- * snowflake image.
- */
-void append_snowflake_vertex_buffer(Gfx *gfx, s32 index, Vec3s vertex1, Vec3s vertex2, Vec3s vertex3) {
-    s32 i = 0;
-    Vtx *vertBuf = (Vtx *) alloc_display_list(15 * sizeof(Vtx));
-
-    if (vertBuf == NULL) {
-        return;
-    }
-
-    for (i = 0; i < 15; i += 3) {
-        vertBuf[i] = gSnowTempVtx[0];
-        (vertBuf + i)->v.ob[0] = (gEnvFxBuffer + (index + i / 3))->xPos + vertex1[0];
-        (vertBuf + i)->v.ob[1] = (gEnvFxBuffer + (index + i / 3))->yPos + vertex1[1];
-        (vertBuf + i)->v.ob[2] = (gEnvFxBuffer + (index + i / 3))->zPos + vertex1[2];
-
-        vertBuf[i + 1] = gSnowTempVtx[1];
-        (vertBuf + i + 1)->v.ob[0] = (gEnvFxBuffer + (index + i / 3))->xPos + vertex2[0];
-        (vertBuf + i + 1)->v.ob[1] = (gEnvFxBuffer + (index + i / 3))->yPos + vertex2[1];
-        (vertBuf + i + 1)->v.ob[2] = (gEnvFxBuffer + (index + i / 3))->zPos + vertex2[2];
-
-        vertBuf[i + 2] = gSnowTempVtx[2];
-        (vertBuf + i + 2)->v.ob[0] = (gEnvFxBuffer + (index + i / 3))->xPos + vertex3[0];
-        (vertBuf + i + 2)->v.ob[1] = (gEnvFxBuffer + (index + i / 3))->yPos + vertex3[1];
-        (vertBuf + i + 2)->v.ob[2] = (gEnvFxBuffer + (index + i / 3))->zPos + vertex3[2];
-    }
-
-    gSPVertex(gfx, VIRTUAL_TO_PHYSICAL(vertBuf), 15, 0);
-}
-
-/**
- * Updates positions of snow particles and returns a pointer to a display list
- * drawing all snowflakes.
+ * Updates positions of snow particles and draws all snowflakes as one batch
+ * of camera facing quads.
  */
-Gfx *envfx_update_snow(s32 snowMode, Vec3s marioPos, Vec3s camFrom, Vec3s camTo) {
+void envfx_update_snow(s32 snowMode, Vec3s marioPos, Vec3s camFrom, Vec3s camTo) {
     s32 i;
     s16 radius, pitch, yaw;
     Vec3s snowCylinderPos;
-    struct SnowFlakeVertex vertex1, vertex2, vertex3;
-    Gfx *gfxStart;
-    Gfx *gfx;
-
-    vertex1 = gSnowFlakeVertex1;
-    vertex2 = gSnowFlakeVertex2;
-    vertex3 = gSnowFlakeVertex3;
-
-    gfxStart = (Gfx *) alloc_display_list((gSnowParticleCount * 6 + 3) * sizeof(Gfx));
-    gfx = gfxStart;
-
-    if (gfxStart == NULL) {
-        return NULL;
-    }
+    ParticleBatch *batch;
+    s16 *x, *y, *z;
 
     envfx_update_snowflake_count(snowMode, marioPos);
 
@@ -434,38 +338,33 @@ Gfx *envfx_update_snow(s32 snowMode, Vec3s marioPos, Vec3s camFrom, Vec3s camTo)
             break;
     }
 
-    rotate_triangle_vertices((s16 *) &vertex1, (s16 *) &vertex2, (s16 *) &vertex3, pitch, yaw);
+    if (gSnowParticleCount == 0) {
+        return;
+    }
 
     if (snowMode == ENVFX_SNOW_NORMAL || snowMode == ENVFX_SNOW_BLIZZARD) {
-        gSPDisplayList(gfx++, &tiny_bubble_dl_0B006A50); // snowflake with gray edge
+        gfx_emit_call(segmented_to_virtual(tiny_bubble_dl_0B006A50)); // snowflake with gray edge
     } else if (snowMode == ENVFX_SNOW_WATER) {
-        gSPDisplayList(gfx++, &tiny_bubble_dl_0B006CD8); // snowflake with blue edge
+        gfx_emit_call(segmented_to_virtual(tiny_bubble_dl_0B006CD8)); // snowflake with blue edge
     }
 
-    for (i = 0; i < gSnowParticleCount; i += 5) {
-        append_snowflake_vertex_buffer(gfx++, i, (s16 *) &vertex1, (s16 *) &vertex2, (s16 *) &vertex3);
-
-        gSP1Triangle(gfx++, 0, 1, 2, 0);
-        gSP1Triangle(gfx++, 3, 4, 5, 0);
-        gSP1Triangle(gfx++, 6, 7, 8, 0);
-        gSP1Triangle(gfx++, 9, 10, 11, 0);
-        gSP1Triangle(gfx++, 12, 13, 14, 0);
+    batch = gfx_emit_particles(gSnowParticleCount, gSnowFlakeSize, 0);
+    x = batch->pos;
+    y = x + gSnowParticleCount;
+    z = y + gSnowParticleCount;
+    for (i = 0; i < gSnowParticleCount; i++) {
+        x[i] = (gEnvFxBuffer + i)->xPos;
+        y[i] = (gEnvFxBuffer + i)->yPos;
+        z[i] = (gEnvFxBuffer + i)->zPos;
     }
-
-    gSPDisplayList(gfx++, &tiny_bubble_dl_0B006AB0) gSPEndDisplayList(gfx++);
-
-    return gfxStart;
 }
 
 /**
- * Updates the environment effects (snow, flowers, bubbles)
- * and returns a display list drawing them.
+ * Updates the environment effects (snow, flowers, bubbles) and draws them.
  */
-Gfx *envfx_update_particles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom) {
-    Gfx *gfx;
-
+void envfx_update_particles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom) {
     if (get_dialog_id() != DIALOG_NONE) {
-        return NULL;
+        return;
     }
 
     if (gEnvFxMode != 0 && mode != gEnvFxMode) {
@@ -473,34 +372,29 @@ Gfx *envfx_update_particles(s32 mode, Vec3s marioPos, Vec3s camTo, Vec3s camFrom
     }
 
     if (mode >= ENVFX_BUBBLE_START) {
-        gfx = envfx_update_bubbles(mode, marioPos, camTo, camFrom);
-        return gfx;
+        envfx_update_bubbles(mode, marioPos, camTo, camFrom);
+        return;
     }
 
     if (gEnvFxMode == 0 && envfx_init_snow(mode) == 0) {
-        return NULL;
+        return;
     }
 
     switch (mode) {
         case ENVFX_MODE_NONE:
             envfx_cleanup_snow(gEnvFxBuffer);
-            return NULL;
+            break;
 
         case ENVFX_SNOW_NORMAL:
-            gfx = envfx_update_snow(1, marioPos, camFrom, camTo);
+            envfx_update_snow(1, marioPos, camFrom, camTo);
             break;
 
         case ENVFX_SNOW_WATER:
-            gfx = envfx_update_snow(2, marioPos, camFrom, camTo);
+            envfx_update_snow(2, marioPos, camFrom, camTo);
             break;
 
         case ENVFX_SNOW_BLIZZARD:
-            gfx = envfx_update_snow(3, marioPos, camFrom, camTo);
+            envfx_update_snow(3, marioPos, camFrom, camTo);
             break;
-
-        default:
-            return NULL;
     }
-
-    return gfx;
 }
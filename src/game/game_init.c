@@ -22,6 +22,9 @@
 #include <prevent_bss_reordering.h>
 #include <levels/scripts.h>
 #include <port/gfx/gfx.h>
+#ifdef TARGET_PC
+#include <port/pc/bench_pc.h>
+#endif
 
 // First 3 controller slots
 struct Controller gControllers[3];
@@ -332,6 +335,11 @@ void thread5_game_loop(UNUSED void *arg) {
     // Point levelCommandAddr to the entry point into the level script data.
     //levelCommandAddr = segmented_to_virtual(level_script_entry);
 	levelCommandAddr = (void*) level_script_entry;
+#ifdef TARGET_PC
+	if(bench_has_demo()) {
+		levelCommandAddr = (void*) level_script_bench_entry;
+	}
+#endif
 
     play_music(SEQ_PLAYER_SFX, SEQUENCE_ARGS(0, SEQ_SOUND_PLAYER), 0);
     set_sound_mode(save_file_get_sound_mode());
@@ -377,7 +385,15 @@ void game_loop_one_iteration(void) {
             compilation_happened_this_frame = false;
         }
         print_text_fmt_int(0, y -= 16, "POLY %d", debug_processed_poly_count);
+        print_text_fmt_int(176, y, "VTX SAVED %d", debug_saved_vtx_transform_count);
         debug_processed_poly_count = 0;
+        debug_saved_vtx_transform_count = 0;
+#ifdef TARGET_PSX
+        print_text_fmt_int(0, y -= 16, "TEX HIT %d", tex_cache_last_frame_stats.hits);
+        print_text_fmt_int(176, y, "MISS %d", tex_cache_last_frame_stats.misses);
+        print_text_fmt_int(0, y -= 16, "EVICT %d", tex_cache_last_frame_stats.evictions);
+        print_text_fmt_int(176, y, "UP %d", tex_cache_last_frame_stats.bytes_uploaded);
+#endif
 	}
 
 	display_and_vsync();
@@ -8,17 +8,17 @@
 #include "camera.h"
 #include "envfx_snow.h"
 #include "level_geo.h"
+#include "port/gfx/gfx.h"
 
 /**
- * Geo function that generates a displaylist for environment effects such as
- * snow or jet stream bubbles.
+ * Geo function that draws environment effects such as snow or jet stream
+ * bubbles. The particles are emitted straight into the frame's display list
+ * under the current modelview, so no display list is returned.
  */
 Gfx *geo_envfx_main(s32 callContext, struct GraphNode *node, const ShortMatrix* mtxq) {
     Vec3s marioPos;
     Vec3s camFrom;
     Vec3s camTo;
-    void *particleList;
-    Gfx *gfx = NULL;
 
     if (callContext == GEO_CONTEXT_RENDER && gCurGraphNodeCamera != NULL) {
         struct GraphNodeGenerated *execNode = (struct GraphNodeGenerated *) node;
@@ -32,16 +32,13 @@ Gfx *geo_envfx_main(s32 callContext, struct GraphNode *node, const ShortMatrix*
             vec3q_to_vec3s(camTo, gCurGraphNodeCamera->focusq);
             vec3q_to_vec3s(camFrom, gCurGraphNodeCamera->posq);
             vec3q_to_vec3s(marioPos, gPlayerCameraState->posq);
-            particleList = envfx_update_particles(snowMode, marioPos, camTo, camFrom);
-            if (particleList != NULL) {
-                Mtx *mtx = alloc_display_list(sizeof(*mtx));
+            if (snowMode != ENVFX_MODE_NONE) {
+                ShortMatrix *mtx = alloc_display_list(sizeof(*mtx));
 
-                gfx = alloc_display_list(2 * sizeof(*gfx));
-                mtxq_to_mtx(mtx, mtxq);
-                gSPMatrix(&gfx[0], VIRTUAL_TO_PHYSICAL(mtx), G_MTX_MODELVIEW | G_MTX_LOAD | G_MTX_NOPUSH);
-                gSPBranchList(&gfx[1], VIRTUAL_TO_PHYSICAL(particleList));
-                execNode->fnNode.node.flags = (execNode->fnNode.node.flags & 0xFF) | 0x400;
+                *mtx = *mtxq;
+                gfx_emit_mtx_set(mtx);
             }
+            envfx_update_particles(snowMode, marioPos, camTo, camFrom);
             SET_HIGH_U16_OF_32(*params, gAreaUpdateCounter);
         }
     } else if (callContext == GEO_CONTEXT_AREA_INIT) {
@@ -52,7 +49,7 @@ Gfx *geo_envfx_main(s32 callContext, struct GraphNode *node, const ShortMatrix*
         envfx_update_particles(ENVFX_MODE_NONE, marioPos, camTo, camFrom);
     }
 
-    return gfx;
+    return NULL;
 }
 
 /**
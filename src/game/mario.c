@@ -192,9 +192,15 @@ s16 find_mario_anim_flags_and_translation(struct Object *obj, s32 yaw, Vec3s tra
     f32 s = (f32) sins(yaw);
     f32 c = (f32) coss(yaw);
 
-    dx = *(animValues + (retrieve_animation_index(animFrame, &animIndex, NULL))) / 4.0f;
-    translation[1] = *(animValues + (retrieve_animation_index(animFrame, &animIndex, NULL))) / 4.0f;
-    dz = *(animValues + (retrieve_animation_index(animFrame, &animIndex, NULL))) / 4.0f;
+    if (curAnim->flags & ANIM_FLAG_7) {
+        dx = retrieve_compressed_animation_value(animFrame, &animIndex, animValues, FALSE) / 4.0f;
+        translation[1] = retrieve_compressed_animation_value(animFrame, &animIndex, animValues, FALSE) / 4.0f;
+        dz = retrieve_compressed_animation_value(animFrame, &animIndex, animValues, FALSE) / 4.0f;
+    } else {
+        dx = *(animValues + (retrieve_animation_index(animFrame, &animIndex, NULL))) / 4.0f;
+        translation[1] = *(animValues + (retrieve_animation_index(animFrame, &animIndex, NULL))) / 4.0f;
+        dz = *(animValues + (retrieve_animation_index(animFrame, &animIndex, NULL))) / 4.0f;
+    }
 
     translation[0] = (dx * c) + (dz * s);
     translation[2] = (-dx * s) + (dz * c);
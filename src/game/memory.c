@@ -11,13 +11,16 @@
 
 #include "buffers/buffers.h"
 #include "decompress.h"
+#include "area.h"
 #include "game_init.h"
 #include "main.h"
 #include "memory.h"
 #include "segment_symbols.h"
 #include "segments.h"
 #include "platform_info.h"
+#include "rendering_graph_node.h"
 #include <port/cd.h>
+#include <port/gfx/gfx.h>
 #ifdef TARGET_PSX
 #include <ps1/gpu.h>
 #endif
@@ -40,6 +43,7 @@ struct MainPoolState {
 
 struct MainPoolBlock {
 	struct MainPoolBlock* prev;
+	u32 arena;
 };
 
 struct MemoryBlock {
@@ -66,6 +70,21 @@ void* main_pool_end_addr;
 
 static struct MainPoolState* gMainPoolState = NULL;
 
+static const char* const arena_names[MEMORY_ARENA_COUNT] = {
+	[MEMORY_ARENA_OTHER] = "other",
+	[MEMORY_ARENA_SEGMENTS] = "segments",
+	[MEMORY_ARENA_LEVEL_POOL] = "level pool",
+	[MEMORY_ARENA_SURFACES] = "surfaces",
+	[MEMORY_ARENA_OBJECTS] = "objects",
+	[MEMORY_ARENA_DISPLAY_LISTS] = "display lists",
+	[MEMORY_ARENA_AUDIO] = "audio",
+};
+static enum MemoryArena main_pool_arena = MEMORY_ARENA_OTHER;
+// in bytes, including the block headers
+static u32 arena_used[MEMORY_ARENA_COUNT];
+static u32 arena_peak[MEMORY_ARENA_COUNT];
+static u32 main_pool_lowest_available;
+
 uintptr_t set_segment_base_addr(s32 segment, void *addr) {
 	assert(segment < 25);
 	sSegmentTable[segment] = (uintptr_t) addr;
@@ -110,6 +129,30 @@ void main_pool_init(void* start, void* end) {
 	main_pool_head_right = (struct MainPoolBlock*) end - 1;
 	main_pool_start_addr = start;
 	main_pool_end_addr = end;
+	main_pool_lowest_available = main_pool_available();
+}
+
+// frees and pops can drop any number of blocks at once, so the usage just gets recounted from both block lists
+static void main_pool_recount_arenas(void) {
+	for(s32 i = 0; i < MEMORY_ARENA_COUNT; i++) {
+		arena_used[i] = 0;
+	}
+	for(struct MainPoolBlock* next = main_pool_head_left; next != main_pool_start_addr; next = next->prev) {
+		arena_used[next->prev->arena] += (uintptr_t) next - (uintptr_t) next->prev;
+	}
+	for(struct MainPoolBlock* block = main_pool_head_right; block != (struct MainPoolBlock*) main_pool_end_addr - 1; block = block->prev) {
+		arena_used[block->arena] += (uintptr_t) block->prev - (uintptr_t) block;
+	}
+}
+
+/**
+ * Attribute the following main pool allocations to the given arena.
+ * Return the previous arena, so that it can be restored afterwards.
+ */
+enum MemoryArena main_pool_set_arena(enum MemoryArena arena) {
+	enum MemoryArena prev = main_pool_arena;
+	main_pool_arena = arena;
+	return prev;
 }
 
 /**
@@ -119,19 +162,28 @@ void main_pool_init(void* start, void* end) {
  */
 void *main_pool_alloc(u32 size, u32 side) {
 	size = ALIGNPTR(size);
-	assertmf(main_pool_available() >= size, "main pool full", "required %d bytes, only %d available\n", size, main_pool_available());
+	// not abortf, so that the message still shows on screen
+	assertmf(main_pool_available() >= size, "main pool full", "the %s arena required %d bytes, only %d available\n", arena_names[main_pool_arena], (int) size, (int) main_pool_available());
+	struct MainPoolBlock* new_block;
 	if(side == MEMORY_POOL_LEFT) {
-		struct MainPoolBlock* new_block = main_pool_head_left;
+		new_block = main_pool_head_left;
 		main_pool_head_left = (struct MainPoolBlock*) ((u8*) (main_pool_head_left + 1) + size);
 		main_pool_head_left->prev = new_block;
-		return new_block + 1;
 	} else {
 		struct MainPoolBlock* prev = main_pool_head_right;
 		main_pool_head_right = (struct MainPoolBlock*) ((u8*) (main_pool_head_right - 1) - size);
-		struct MainPoolBlock* new_block = main_pool_head_right;
+		new_block = main_pool_head_right;
 		new_block->prev = prev;
-		return new_block + 1;
 	}
+	new_block->arena = main_pool_arena;
+	u32 used = arena_used[main_pool_arena] += size + sizeof(struct MainPoolBlock);
+	if(used > arena_peak[main_pool_arena]) {
+		arena_peak[main_pool_arena] = used;
+	}
+	if(main_pool_available() < main_pool_lowest_available) {
+		main_pool_lowest_available = main_pool_available();
+	}
+	return new_block + 1;
 }
 
 /**
@@ -148,6 +200,7 @@ u32 main_pool_free(void* addr) {
 	} else {
 		assert(false);
 	}
+	main_pool_recount_arenas();
 	return main_pool_available();
 }
 
@@ -164,6 +217,13 @@ void* main_pool_realloc(void* addr, u32 size) {
 	main_pool_head_left = (struct MainPoolBlock*) ((u8*) (prev + 1) + size);
 	main_pool_head_left->prev = prev;
 	assert(main_pool_head_left + 1 <= main_pool_head_right);
+	main_pool_recount_arenas();
+	if(arena_used[prev->arena] > arena_peak[prev->arena]) {
+		arena_peak[prev->arena] = arena_used[prev->arena];
+	}
+	if(main_pool_available() < main_pool_lowest_available) {
+		main_pool_lowest_available = main_pool_available();
+	}
 	return addr;
 }
 
@@ -197,9 +257,25 @@ u32 main_pool_pop_state(void) {
 	main_pool_head_left = gMainPoolState->listHeadL;
 	main_pool_head_right = gMainPoolState->listHeadR;
 	gMainPoolState = gMainPoolState->prev;
+	main_pool_recount_arenas();
 	return main_pool_available();
 }
 
+/**
+ * Print how much of the main pool each arena takes up right after a level got
+ * loaded, along with the highest usage seen so far. Only on the pc build and
+ * over the serial link, there's nowhere to print it otherwise.
+ */
+void main_pool_report_footprint(UNUSED s16 level) {
+#if defined(TARGET_PC) || defined(SERIAL)
+	printf("level %d memory footprint:\n", level);
+	for(s32 i = 0; i < MEMORY_ARENA_COUNT; i++) {
+		printf("  %-14s %7u bytes, peak %7u\n", arena_names[i], (unsigned) arena_used[i], (unsigned) arena_peak[i]);
+	}
+	printf("  %-14s %7u bytes, lowest %7u\n", "free", (unsigned) main_pool_available(), (unsigned) main_pool_lowest_available);
+#endif
+}
+
 /**
  * Perform a DMA read from ROM. The transfer is split into 4KB blocks, and this
  * function blocks until completion.
@@ -213,6 +289,16 @@ void dma_read(u8 *dest, const u8 *srcStart, const u8 *srcEnd) {
 	cd_read(dest, (uintptr_t) srcStart - 4096, (uintptr_t) srcEnd - (uintptr_t) srcStart);
 }
 
+/**
+ * Start a read from ROM without waiting for it to finish, wait for the returned
+ * request with cd_read_wait before touching the destination.
+ */
+CdRequest dma_read_submit(u8 *dest, const u8 *srcStart, const u8 *srcEnd) {
+	assert(!((uintptr_t) dest % 4));
+	assert((uintptr_t) srcStart >= 4096 && srcStart < srcEnd);
+	return cd_read_submit(dest, (uintptr_t) srcStart - 4096, (uintptr_t) srcEnd - (uintptr_t) srcStart, NULL, NULL);
+}
+
 /**
  * Perform a DMA read from ROM, allocating space in the memory pool to write to.
  * Return the destination address.
@@ -237,6 +323,7 @@ static void *dynamic_dma_read(const u8 *srcStart, const u8 *srcEnd, u32 side) {
  * address to this block.
  */
 #include <stdio.h>
+void audio_backend_load_level(s16 level); // in the audio backend, loads the sample banks the level uses
 void *load_segment(s32 segment, const u8 *srcStart, const u8 *srcEnd, u32 side) {
 	if((uintptr_t) srcStart <= 1) {
 		if((uintptr_t) srcStart == 0) {
@@ -245,12 +332,19 @@ void *load_segment(s32 segment, const u8 *srcStart, const u8 *srcEnd, u32 side)
 		return 0;
 	}
 	//printf("loading segment %02x from %x:%x\n", segment, srcStart, srcEnd);
+	enum MemoryArena prev_arena = main_pool_set_arena(MEMORY_ARENA_SEGMENTS);
 	void *addr = dynamic_dma_read(srcStart, srcEnd, side);
+	main_pool_set_arena(prev_arena);
 	//printf("loaded segment %02x from %x:%x into %x\n", segment, srcStart, srcEnd, addr);
 
 	if (addr != NULL) {
 		set_segment_base_addr(segment, addr);
 	}
+	// the level's own textures aren't loaded individually, see pack_textures.py
+	if(segment == 7) {
+		gfx_load_level_textures(gCurrLevelNum);
+		audio_backend_load_level(gCurrLevelNum);
+	}
 	return addr;
 }
 
@@ -458,16 +552,15 @@ s32 load_patchable_table(struct DmaHandlerList *list, s32 index) {
 }
 
 #define ANIM_TABLE_SIZE 1680
-#define ANIM_SEGMENT_SIZE 190324
-#define ANIM_MAIN_DATA_SIZE (ANIM_SEGMENT_SIZE - ANIM_TABLE_SIZE)
 
 #ifdef TARGET_PSX
 
 #if 0
 
-static u8 mario_anim_buffer[(ANIM_SEGMENT_SIZE + 2047) / 2048 * 2048];
+static u8* mario_anim_buffer;
 
 u32 setup_mario_anims(struct DmaHandlerList *list, void *segment_start, void *segment_end, void *buffer) {
+	mario_anim_buffer = main_pool_alloc((segment_end - segment_start + 2047) / 2048 * 2048, MEMORY_POOL_LEFT);
 	dma_read(mario_anim_buffer, segment_start, segment_end);
 	list->dmaTable = (struct DmaTable*) mario_anim_buffer;
 	list->currentAddr = NULL;
@@ -481,26 +574,32 @@ static void receive(uint8_t* buf, uint32_t start, uint32_t len) {
 
 #else
 
+// the animations are compressed by tools/mario_anims_converter.py, the strip only takes as many rows as they need
 #define VRAM_X 640
 #define VRAM_Y 0
 #define VRAM_WIDTH 384
 #define VRAM_ROW_BYTES (VRAM_WIDTH * 2)
-#define VRAM_HEIGHT ((ANIM_MAIN_DATA_SIZE + VRAM_ROW_BYTES - 1) / VRAM_ROW_BYTES)
-#define VRAM_PART (VRAM_ROW_BYTES * VRAM_HEIGHT)
-STATIC_ASSERT(VRAM_HEIGHT < 256, "mario animations won't fit in the designated vram area");
+#define VRAM_MAX_HEIGHT 256
 
-u32 setup_mario_anims(struct DmaHandlerList *list, void *segment_start, UNUSED void *segment_end, void *buffer) {
-	void* seg_buf = main_pool_alloc((ANIM_SEGMENT_SIZE + 2047) / 2048 * 2048, MEMORY_POOL_LEFT);
-	dma_read(seg_buf, segment_start, segment_start + ANIM_SEGMENT_SIZE);
+static u32 anim_vram_height;
+
+u32 setup_mario_anims(struct DmaHandlerList *list, void *segment_start, void *segment_end, void *buffer) {
+	u32 segment_size = segment_end - segment_start;
+	void* seg_buf = main_pool_alloc((segment_size + 2047) / 2048 * 2048, MEMORY_POOL_LEFT);
+	dma_read(seg_buf, segment_start, segment_end);
 	u32 just_table_size = ((struct DmaTable*) seg_buf)->count * sizeof(struct OffsetSizePair) + sizeof(struct DmaTable);
+	assert(just_table_size == ANIM_TABLE_SIZE);
+	u32 data_size = segment_size - just_table_size;
+	anim_vram_height = (data_size + VRAM_ROW_BYTES - 1) / VRAM_ROW_BYTES;
+	assertm(anim_vram_height < VRAM_MAX_HEIGHT, "mario animations won't fit in the designated vram area");
 
-	sendVRAMData(seg_buf + just_table_size, VRAM_X, VRAM_Y, VRAM_WIDTH, VRAM_HEIGHT);
+	sendVRAMData(seg_buf + just_table_size, VRAM_X, VRAM_Y, VRAM_WIDTH, anim_vram_height);
 
 	seg_buf = main_pool_realloc(seg_buf, just_table_size);
 	list->dmaTable = (struct DmaTable*) seg_buf;
 	list->currentAddr = NULL;
 	list->bufTarget = buffer;
-	return ANIM_MAIN_DATA_SIZE;
+	return data_size;
 }
 
 static void receive(uint8_t* buf, uint32_t start, uint32_t len) {
@@ -508,7 +607,7 @@ static void receive(uint8_t* buf, uint32_t start, uint32_t len) {
 	if(len % 2 != 0) {
 		len++;
 	}
-	assert(start + len < VRAM_ROW_BYTES * VRAM_HEIGHT);
+	assert(start + len < VRAM_ROW_BYTES * anim_vram_height);
 	u32 y = VRAM_Y + start / VRAM_ROW_BYTES;
 	while(len) {
 		u32 inner_x = start % VRAM_ROW_BYTES / 2;
@@ -553,6 +652,8 @@ s32 load_mario_anim(struct DmaHandlerList *list, s32 index) {
 			list->currentAddr = (void*) (uintptr_t) full_off;
 			u32 size = table->anim[index].size;
 			receive(list->bufTarget, full_off - ANIM_TABLE_SIZE, size);
+			// every animation is loaded to the same address, the poses decoded from the last one are stale
+			geo_forget_animation_poses(list->bufTarget);
 			return true;
 		}
 	}
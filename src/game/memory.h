@@ -4,10 +4,23 @@
 #include <PR/ultratypes.h>
 
 #include "types.h"
+#include <port/cd.h>
 
 #define MEMORY_POOL_LEFT  0
 #define MEMORY_POOL_RIGHT 1
 
+// every main pool block is attributed to the arena that was current when it got allocated
+enum MemoryArena {
+	MEMORY_ARENA_OTHER,
+	MEMORY_ARENA_SEGMENTS,
+	MEMORY_ARENA_LEVEL_POOL,
+	MEMORY_ARENA_SURFACES,
+	MEMORY_ARENA_OBJECTS,
+	MEMORY_ARENA_DISPLAY_LISTS,
+	MEMORY_ARENA_AUDIO,
+	MEMORY_ARENA_COUNT
+};
+
 struct AllocOnlyPool {
 	u32 size;
 	void* free_ptr;
@@ -51,9 +64,12 @@ void *main_pool_realloc(void *addr, u32 size);
 u32 main_pool_available(void);
 u32 main_pool_push_state(void);
 u32 main_pool_pop_state(void);
+enum MemoryArena main_pool_set_arena(enum MemoryArena arena);
+void main_pool_report_footprint(s16 level);
 
 #ifndef NO_SEGMENTED_MEMORY
 void dma_read(u8 *dest, const u8 *srcStart, const u8 *srcEnd);
+CdRequest dma_read_submit(u8 *dest, const u8 *srcStart, const u8 *srcEnd);
 void *load_segment(s32 segment, const u8 *srcStart, const u8 *srcEnd, u32 side);
 //void *load_to_fixed_pool_addr(u8 *destAddr, u8 *srcStart, u8 *srcEnd);
 void *load_segment_decompress(s32 segment, const u8 *srcStart, const u8 *srcEnd);
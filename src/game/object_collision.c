@@ -4,8 +4,43 @@
 #include "debug.h"
 #include "interaction.h"
 #include "mario.h"
+#include "object_collision.h"
 #include "object_list_processor.h"
 #include "spawn_object.h"
+#include "engine/surface_collision.h"
+
+/**
+ * The tangible objects are sorted into a grid over the level every frame by
+ * where they are, so each object only gets checked against the ones in the
+ * cells around it instead of whole lists. The candidates are still checked
+ * in list order, and the ones left out can't overlap (see object_reach), so
+ * the results are the same as checking everything.
+ */
+#define OBJ_GRID_CELL_SIZE_SHIFT 10
+#define OBJ_GRID_CELLS (2 * LEVEL_BOUNDARY_MAX >> OBJ_GRID_CELL_SIZE_SHIFT)
+// Objects that reach further than this go in a list that's always checked instead.
+#define OBJ_GRID_MAX_REACH (1 << (OBJ_GRID_CELL_SIZE_SHIFT - 1))
+#define OBJ_GRID_END 0xFF
+
+// The lists the objects are checked against, in the order they get numbered in.
+static const u8 sObjGridLists[] = {
+    OBJ_LIST_PLAYER, OBJ_LIST_POLELIKE, OBJ_LIST_LEVEL, OBJ_LIST_GENACTOR,
+    OBJ_LIST_PUSHABLE, OBJ_LIST_SURFACE, OBJ_LIST_DESTRUCTIVE,
+};
+
+// Objects are linked by their index in gObjectPool, in the order they're numbered in.
+static u8 sObjGridHeads[OBJ_GRID_CELLS][OBJ_GRID_CELLS];
+static u8 sObjGridTails[OBJ_GRID_CELLS][OBJ_GRID_CELLS];
+static u8 sLargeObjsHead;
+static u8 sLargeObjsTail;
+static u8 sObjGridNext[OBJECT_POOL_CAPACITY];
+// Where each object is in its list, counting on from the previous lists.
+static u8 sObjGridOrder[OBJECT_POOL_CAPACITY];
+static u8 sObjGridListStart[NUM_OBJ_LISTS];
+static u8 sObjGridListEnd[NUM_OBJ_LISTS];
+static s16 sObjGridMaxReach;
+
+s32 gObjectPairTests;
 
 struct Object *debug_print_obj_collision(struct Object *a) {
     struct Object *sp24;
@@ -97,6 +132,117 @@ s32 detect_object_hurtbox_overlap(struct Object *a, struct Object *b) {
 #endif
 }
 
+/**
+ * How far from its position an object's hitbox can be found to overlap another
+ * one's in X or Z. The sqrtf in detect_object_hitbox_overlap can be up to 3.5%
+ * short, which the extra 1/16 covers, and positions are truncated here.
+ */
+static s32 object_reach(struct ObjectHotFields *hot) {
+    return hot->hitboxRadius + (hot->hitboxRadius >> 4) + 2;
+}
+
+/**
+ * The fields the broad phase reads of an object. The benchmark can also have
+ * them read from the object itself instead, the way it was before gObjectHot;
+ * the game always passes FALSE, which folds away once this is inlined.
+ */
+ALWAYS_INLINE static struct ObjectHotFields *object_grid_fields(s32 index, struct ObjectHotFields *fields,
+                                                                 s32 direct) {
+    struct Object *obj;
+
+    if (!direct) {
+        return &gObjectHot[index];
+    }
+    obj = &gObjectPool[index];
+    fields->posX = qtrunc(QFIELD(obj, oPosX));
+    fields->posZ = qtrunc(QFIELD(obj, oPosZ));
+    fields->hitboxRadius = obj->hitboxRadius_s16;
+    fields->tangible = obj->oIntangibleTimer == 0;
+    return fields;
+}
+
+static s32 obj_grid_cell(s32 coord) {
+    coord = (coord + LEVEL_BOUNDARY_MAX) >> OBJ_GRID_CELL_SIZE_SHIFT;
+    if (coord < 0) {
+        return 0;
+    }
+    if (coord >= OBJ_GRID_CELLS) {
+        return OBJ_GRID_CELLS - 1;
+    }
+    return coord;
+}
+
+/**
+ * Sort the objects that can be collided with into the grid. Intangible
+ * objects are never checked, and their timers don't change until next frame.
+ * Only the hot fields of the objects are read from here on, until a pair of
+ * them gets close enough.
+ */
+ALWAYS_INLINE static void build_object_grid(s32 direct) {
+    struct ObjectNode *listHead;
+    struct Object *obj;
+    struct ObjectHotFields *hot;
+    struct ObjectHotFields fields;
+    s32 i, order = 0;
+    s32 index, reach, cellX, cellZ;
+    u8 *tail;
+
+    for (cellZ = 0; cellZ < OBJ_GRID_CELLS; cellZ++) {
+        for (cellX = 0; cellX < OBJ_GRID_CELLS; cellX++) {
+            sObjGridHeads[cellZ][cellX] = OBJ_GRID_END;
+        }
+    }
+    sLargeObjsHead = OBJ_GRID_END;
+    sObjGridMaxReach = 0;
+
+    for (i = 0; i < (s32) ARRAY_COUNT(sObjGridLists); i++) {
+        listHead = &gObjectLists[sObjGridLists[i]];
+        sObjGridListStart[sObjGridLists[i]] = order;
+
+        for (obj = (struct Object *) listHead->next; obj != (struct Object *) listHead;
+             obj = (struct Object *) obj->header.next) {
+            index = obj - gObjectPool;
+            hot = object_grid_fields(index, &fields, direct);
+            sObjGridOrder[index] = order++;
+            if (!hot->tangible) {
+                continue;
+            }
+
+            reach = object_reach(hot);
+            if (reach > OBJ_GRID_MAX_REACH) {
+                tail = sLargeObjsHead == OBJ_GRID_END ? &sLargeObjsHead : &sObjGridNext[sLargeObjsTail];
+                sLargeObjsTail = index;
+            } else {
+                if (reach > sObjGridMaxReach) {
+                    sObjGridMaxReach = reach;
+                }
+                cellX = obj_grid_cell(hot->posX);
+                cellZ = obj_grid_cell(hot->posZ);
+                tail = sObjGridHeads[cellZ][cellX] == OBJ_GRID_END ? &sObjGridHeads[cellZ][cellX]
+                                                                   : &sObjGridNext[sObjGridTails[cellZ][cellX]];
+                sObjGridTails[cellZ][cellX] = index;
+            }
+            *tail = index;
+            sObjGridNext[index] = OBJ_GRID_END;
+        }
+
+        sObjGridListEnd[sObjGridLists[i]] = order;
+    }
+}
+
+/**
+ * Add the objects of a grid cell numbered from start to end to the candidates.
+ */
+static s32 add_grid_candidates(u8 *candidates, s32 numCandidates, s32 index, s32 start, s32 end) {
+    for (; index != OBJ_GRID_END; index = sObjGridNext[index]) {
+        if (sObjGridOrder[index] >= start && sObjGridOrder[index] < end) {
+            candidates[numCandidates++] = index;
+        }
+    }
+
+    return numCandidates;
+}
+
 void clear_object_collision(struct Object *a) {
     struct Object *sp4 = (struct Object *) a->header.next;
 
@@ -110,15 +256,81 @@ void clear_object_collision(struct Object *a) {
     }
 }
 
-void check_collision_in_list(struct Object *a, struct Object *b, struct Object *c) {
-    if (a->oIntangibleTimer == 0) {
-        while (b != c) {
-            if (b->oIntangibleTimer == 0) {
-                if (detect_object_hitbox_overlap(a, b) && b->hurtboxRadius_s16 != 0) {
-                    detect_object_hurtbox_overlap(a, b);
-                }
-            }
-            b = (struct Object *) b->header.next;
+/**
+ * Find the objects in a list that are close enough to an object to touch it,
+ * in list order, optionally only the ones after it in its own list.
+ */
+ALWAYS_INLINE static s32 find_collision_candidates(u8 *candidates, struct Object *a, s32 list, s32 afterA,
+                                                   s32 direct) {
+    s32 numCandidates = 0;
+    s32 start, end, reach, i, j;
+    s32 x, z, cellX, cellZ;
+    s32 minCellX, maxCellX, minCellZ, maxCellZ;
+    struct ObjectHotFields aFields, bFields;
+    struct ObjectHotFields *aHot = object_grid_fields(a - gObjectPool, &aFields, direct);
+    struct ObjectHotFields *bHot;
+    u8 index;
+
+    if (!aHot->tangible) {
+        return 0;
+    }
+
+    start = afterA ? sObjGridOrder[a - gObjectPool] + 1 : sObjGridListStart[list];
+    end = sObjGridListEnd[list];
+    if (start >= end) {
+        return 0;
+    }
+
+    x = aHot->posX;
+    z = aHot->posZ;
+    reach = object_reach(aHot) + sObjGridMaxReach;
+    minCellX = obj_grid_cell(x - reach);
+    maxCellX = obj_grid_cell(x + reach);
+    minCellZ = obj_grid_cell(z - reach);
+    maxCellZ = obj_grid_cell(z + reach);
+
+    for (cellZ = minCellZ; cellZ <= maxCellZ; cellZ++) {
+        for (cellX = minCellX; cellX <= maxCellX; cellX++) {
+            numCandidates = add_grid_candidates(candidates, numCandidates, sObjGridHeads[cellZ][cellX], start, end);
+        }
+    }
+    numCandidates = add_grid_candidates(candidates, numCandidates, sLargeObjsHead, start, end);
+
+    // Back in list order, there are only ever a few of them.
+    for (i = 1; i < numCandidates; i++) {
+        index = candidates[i];
+        for (j = i; j > 0 && sObjGridOrder[candidates[j - 1]] > sObjGridOrder[index]; j--) {
+            candidates[j] = candidates[j - 1];
+        }
+        candidates[j] = index;
+    }
+
+    for (i = 0, j = 0; i < numCandidates; i++) {
+        bHot = object_grid_fields(candidates[i], &bFields, direct);
+        reach = object_reach(aHot) + object_reach(bHot);
+        if (ABS(bHot->posX - x) < reach && ABS(bHot->posZ - z) < reach) {
+            candidates[j++] = candidates[i];
+        }
+    }
+
+    return j;
+}
+
+/**
+ * Check an object against the ones in a list that are close enough to touch
+ * it, in list order, optionally only the ones after it in its own list.
+ */
+void check_collision_in_list(struct Object *a, s32 list, s32 afterA) {
+    u8 candidates[OBJECT_POOL_CAPACITY];
+    s32 numCandidates = find_collision_candidates(candidates, a, list, afterA, FALSE);
+    struct Object *b;
+    s32 i;
+
+    for (i = 0; i < numCandidates; i++) {
+        gObjectPairTests++;
+        b = &gObjectPool[candidates[i]];
+        if (detect_object_hitbox_overlap(a, b) && b->hurtboxRadius_s16 != 0) {
+            detect_object_hurtbox_overlap(a, b);
         }
     }
 }
@@ -128,19 +340,13 @@ void check_player_object_collision(void) {
     struct Object *sp18 = (struct Object *) sp1C->header.next;
 
     while (sp18 != sp1C) {
-        check_collision_in_list(sp18, (struct Object *) sp18->header.next, sp1C);
-        check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_POLELIKE].next,
-                      (struct Object *) &gObjectLists[OBJ_LIST_POLELIKE]);
-        check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_LEVEL].next,
-                      (struct Object *) &gObjectLists[OBJ_LIST_LEVEL]);
-        check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_GENACTOR].next,
-                      (struct Object *) &gObjectLists[OBJ_LIST_GENACTOR]);
-        check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_PUSHABLE].next,
-                      (struct Object *) &gObjectLists[OBJ_LIST_PUSHABLE]);
-        check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_SURFACE].next,
-                      (struct Object *) &gObjectLists[OBJ_LIST_SURFACE]);
-        check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_DESTRUCTIVE].next,
-                      (struct Object *) &gObjectLists[OBJ_LIST_DESTRUCTIVE]);
+        check_collision_in_list(sp18, OBJ_LIST_PLAYER, TRUE);
+        check_collision_in_list(sp18, OBJ_LIST_POLELIKE, FALSE);
+        check_collision_in_list(sp18, OBJ_LIST_LEVEL, FALSE);
+        check_collision_in_list(sp18, OBJ_LIST_GENACTOR, FALSE);
+        check_collision_in_list(sp18, OBJ_LIST_PUSHABLE, FALSE);
+        check_collision_in_list(sp18, OBJ_LIST_SURFACE, FALSE);
+        check_collision_in_list(sp18, OBJ_LIST_DESTRUCTIVE, FALSE);
         sp18 = (struct Object *) sp18->header.next;
     }
 }
@@ -150,7 +356,7 @@ void check_pushable_object_collision(void) {
     struct Object *sp18 = (struct Object *) sp1C->header.next;
 
     while (sp18 != sp1C) {
-        check_collision_in_list(sp18, (struct Object *) sp18->header.next, sp1C);
+        check_collision_in_list(sp18, OBJ_LIST_PUSHABLE, TRUE);
         sp18 = (struct Object *) sp18->header.next;
     }
 }
@@ -161,13 +367,10 @@ void check_destructive_object_collision(void) {
 
     while (sp18 != sp1C) {
         if (FFIELD(sp18, oDistanceToMario) < 2000.0f && !(sp18->activeFlags & ACTIVE_FLAG_UNK9)) {
-            check_collision_in_list(sp18, (struct Object *) sp18->header.next, sp1C);
-            check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_GENACTOR].next,
-                          (struct Object *) &gObjectLists[OBJ_LIST_GENACTOR]);
-            check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_PUSHABLE].next,
-                          (struct Object *) &gObjectLists[OBJ_LIST_PUSHABLE]);
-            check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_SURFACE].next,
-                          (struct Object *) &gObjectLists[OBJ_LIST_SURFACE]);
+            check_collision_in_list(sp18, OBJ_LIST_DESTRUCTIVE, TRUE);
+            check_collision_in_list(sp18, OBJ_LIST_GENACTOR, FALSE);
+            check_collision_in_list(sp18, OBJ_LIST_PUSHABLE, FALSE);
+            check_collision_in_list(sp18, OBJ_LIST_SURFACE, FALSE);
         }
         sp18 = (struct Object *) sp18->header.next;
     }
@@ -181,7 +384,71 @@ void detect_object_collisions(void) {
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_LEVEL]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_SURFACE]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_DESTRUCTIVE]);
+    build_object_grid(FALSE);
+    gObjectPairTests = 0;
     check_player_object_collision();
     check_destructive_object_collision();
     check_pushable_object_collision();
 }
+
+#ifdef TARGET_PC
+/**
+ * The grid build and the checks of detect_object_collisions, without checking
+ * any hitboxes. Returns how many pairs got close enough to be checked.
+ */
+ALWAYS_INLINE static s32 bench_find_object_pairs(s32 direct) {
+    static const u8 playerLists[] = {
+        OBJ_LIST_POLELIKE, OBJ_LIST_LEVEL, OBJ_LIST_GENACTOR,
+        OBJ_LIST_PUSHABLE, OBJ_LIST_SURFACE, OBJ_LIST_DESTRUCTIVE,
+    };
+    static const u8 destructiveLists[] = { OBJ_LIST_GENACTOR, OBJ_LIST_PUSHABLE, OBJ_LIST_SURFACE };
+    u8 candidates[OBJECT_POOL_CAPACITY];
+    struct ObjectNode *listHead;
+    struct Object *obj;
+    s32 pairs = 0;
+    u32 i;
+
+    build_object_grid(direct);
+
+    listHead = &gObjectLists[OBJ_LIST_PLAYER];
+    for (obj = (struct Object *) listHead->next; obj != (struct Object *) listHead;
+         obj = (struct Object *) obj->header.next) {
+        pairs += find_collision_candidates(candidates, obj, OBJ_LIST_PLAYER, TRUE, direct);
+        for (i = 0; i < ARRAY_COUNT(playerLists); i++) {
+            pairs += find_collision_candidates(candidates, obj, playerLists[i], FALSE, direct);
+        }
+    }
+
+    listHead = &gObjectLists[OBJ_LIST_DESTRUCTIVE];
+    for (obj = (struct Object *) listHead->next; obj != (struct Object *) listHead;
+         obj = (struct Object *) obj->header.next) {
+        if (FFIELD(obj, oDistanceToMario) < 2000.0f && !(obj->activeFlags & ACTIVE_FLAG_UNK9)) {
+            pairs += find_collision_candidates(candidates, obj, OBJ_LIST_DESTRUCTIVE, TRUE, direct);
+            for (i = 0; i < ARRAY_COUNT(destructiveLists); i++) {
+                pairs += find_collision_candidates(candidates, obj, destructiveLists[i], FALSE, direct);
+            }
+        }
+    }
+
+    listHead = &gObjectLists[OBJ_LIST_PUSHABLE];
+    for (obj = (struct Object *) listHead->next; obj != (struct Object *) listHead;
+         obj = (struct Object *) obj->header.next) {
+        pairs += find_collision_candidates(candidates, obj, OBJ_LIST_PUSHABLE, TRUE, direct);
+    }
+
+    return pairs;
+}
+
+/**
+ * Find the pairs of objects detect_object_collisions would check, reading the
+ * objects from gObjectHot after copying them over like every frame does, or
+ * straight from the objects like before it.
+ */
+s32 bench_object_broad_phase(s32 direct) {
+    if (direct) {
+        return bench_find_object_pairs(TRUE);
+    }
+    copy_object_hot_fields();
+    return bench_find_object_pairs(FALSE);
+}
+#endif
@@ -1,6 +1,11 @@
 #ifndef OBJECT_COLLISION_H
 #define OBJECT_COLLISION_H
 
+// how many pairs of objects got their hitboxes checked against each other this frame
+extern s32 gObjectPairTests;
+
 void detect_object_collisions(void);
+// finds the pairs of objects whose hitboxes would get checked, through gObjectHot or the objects themselves
+s32 bench_object_broad_phase(s32 direct);
 
 #endif // OBJECT_COLLISION_H
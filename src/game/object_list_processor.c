@@ -8,8 +8,10 @@
 #include "debug.h"
 #include "engine/behavior_script.h"
 #include "engine/graph_node.h"
+#include "engine/math_util.h"
 #include "engine/surface_collision.h"
 #include "engine/surface_load.h"
+#include "game_init.h"
 #include "interaction.h"
 #include "level_update.h"
 #include "mario.h"
@@ -19,6 +21,7 @@
 #include "object_list_processor.h"
 #include "platform_displacement.h"
 #include "profiler.h"
+#include "rendering_graph_node.h"
 #include "spawn_object.h"
 
 
@@ -69,6 +72,11 @@ u32 gTimeStopState;
  */
 struct Object gObjectPool[OBJECT_POOL_CAPACITY];
 
+/**
+ * The hot fields of the objects in gObjectPool, see copy_object_hot_fields.
+ */
+struct ObjectHotFields gObjectHot[OBJECT_POOL_CAPACITY];
+
 /**
  * A special object whose purpose is to act as a parent for macro objects.
  */
@@ -287,6 +295,125 @@ void bhv_mario_update(void) {
     }
 }
 
+#ifdef OBJECT_LOD
+/**
+ * The number of objects whose update was skipped this frame because they were
+ * far away and off screen.
+ */
+s32 gNumObjectUpdatesSkipped;
+
+/**
+ * Objects that are always updated every frame, because something the player
+ * will notice depends on them even when Mario isn't looking, like racers,
+ * bosses, and objects that count what Mario does elsewhere.
+ */
+static const BehaviorScript *const sAlwaysUpdatedBehaviors[] = {
+    bhvKoopa,
+    bhvKoopaRaceEndpoint,
+    bhvRacingPenguin,
+    bhvTuxiesMother,
+    bhvSmallPenguin,
+    bhvBowser,
+    bhvBowserBodyAnchor,
+    bhvKingBobomb,
+    bhvWhompKingBoss,
+    bhvEyerokBoss,
+    bhvBigBully,
+    bhvBigBullyWithMinions,
+    bhvGhostHuntBigBoo,
+    bhvBalconyBigBoo,
+    bhvMerryGoRoundBigBoo,
+    bhvWigglerHead,
+    bhvWigglerBody,
+    bhvChainChomp,
+    bhvUkiki,
+    bhvMips,
+    bhvKlepto,
+    bhvMantaRay,
+    bhvSnowmansBottom,
+    bhvHiddenStar,
+    bhvHiddenRedCoinStar,
+    bhvBowserBomb,
+};
+
+/**
+ * Return how many frames apart the object should be updated (1, 2 or 4), or 0
+ * if it shouldn't be updated until Mario comes back. Only objects that don't
+ * hold surfaces, aren't touching anything this frame, and would otherwise be
+ * left alone by the game when out of range are ever slowed down.
+ */
+static s32 object_update_interval(struct Object *obj, s32 listIndex) {
+    s32 inView = obj->header.gfx.node.flags & GRAPH_RENDER_IN_VIEW;
+    struct ObjectHotFields *hot, *marioHot;
+    u32 distSq, drawingDist;
+    u32 i;
+
+    // The renderer sets this again if the object gets drawn this frame.
+    obj->header.gfx.node.flags &= ~GRAPH_RENDER_IN_VIEW;
+
+    if (listIndex != OBJ_LIST_GENACTOR && listIndex != OBJ_LIST_PUSHABLE && listIndex != OBJ_LIST_LEVEL
+        && listIndex != OBJ_LIST_DESTRUCTIVE && listIndex != OBJ_LIST_DEFAULT) {
+        return 1;
+    }
+    if (inView || gMarioObject == NULL || obj->curBhvCommand == obj->behavior) {
+        return 1;
+    }
+    if ((obj->oFlags & (OBJ_FLAG_ACTIVE_FROM_AFAR | OBJ_FLAG_TRANSFORM_RELATIVE_TO_PARENT))
+        || obj->collisionData != NULL || obj->numCollidedObjs != 0 || obj->oHeldState != HELD_FREE
+        || (obj->activeFlags & ACTIVE_FLAG_INITIATED_TIME_STOP)) {
+        return 1;
+    }
+
+    // Squared, the distances are capped so this can't overflow.
+    hot = &gObjectHot[obj - gObjectPool];
+    marioHot = &gObjectHot[gMarioObject - gObjectPool];
+    distSq = sqr(MIN(ABS(hot->posX - marioHot->posX), 16000))
+           + sqr(MIN(ABS(hot->posY - marioHot->posY), 16000))
+           + sqr(MIN(ABS(hot->posZ - marioHot->posZ), 16000));
+    if (distSq < sqr(2000)) {
+        return 1;
+    }
+
+    for (i = 0; i < ARRAY_COUNT(sAlwaysUpdatedBehaviors); i++) {
+        if (obj_has_behavior(obj, sAlwaysUpdatedBehaviors[i])) {
+            return 1;
+        }
+    }
+
+    // Objects already hidden by their draw distance (see cur_obj_update) stay
+    // as they are, they'll be updated again once Mario is back in range. The
+    // extra 1/16 covers the error of the sqrtf that cur_obj_update goes by.
+    if ((obj->activeFlags & ACTIVE_FLAG_FAR_AWAY) && (obj->oFlags & OBJ_FLAG_COMPUTE_DIST_TO_MARIO)
+        && obj->oRoom == -1) {
+        drawingDist = qtrunc(QFIELD(obj, oDrawingDistance));
+        drawingDist += drawingDist >> 4;
+        if (drawingDist < 16000 && distSq > sqr(drawingDist)) {
+            return 0;
+        }
+    }
+
+    return distSq < sqr(4000) ? 2 : 4;
+}
+
+/**
+ * Whether the object's turn to be updated is this frame. Objects sharing an
+ * interval are spread across frames by where they are in the pool.
+ */
+static s32 should_update_object(struct Object *obj, s32 listIndex) {
+    s32 interval = object_update_interval(obj, listIndex);
+
+    if (interval == 1) {
+        return TRUE;
+    }
+    if (interval != 0 && ((gGlobalTimer + (obj - gObjectPool)) & (interval - 1)) == 0) {
+        return TRUE;
+    }
+
+    gNumObjectUpdatesSkipped++;
+    return FALSE;
+}
+#endif
+
 /**
  * Update every object that occurs after firstObj in the given object list,
  * including firstObj itself. Return the number of objects that were updated.
@@ -297,6 +424,13 @@ s32 update_objects_starting_at(struct ObjectNode *objList, struct ObjectNode *fi
     while (objList != firstObj) {
         gCurrentObject = (struct Object *) firstObj;
 
+#ifdef OBJECT_LOD
+        if (!should_update_object(gCurrentObject, objList - gObjectLists)) {
+            firstObj = firstObj->next;
+            count += 1;
+            continue;
+        }
+#endif
         gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_HAS_ANIMATION;
         cur_obj_update();
 
@@ -539,18 +673,55 @@ void clear_objects(void) {
 
     init_free_object_list();
     clear_object_lists(gObjectListArray);
+    clear_decoded_behaviors();
+    geo_clear_pose_cache();
 
     for (i = 0; i < OBJECT_POOL_CAPACITY; i++) {
         gObjectPool[i].activeFlags = ACTIVE_FLAG_DEACTIVATED;
         geo_reset_object_node(&gObjectPool[i].header.gfx);
     }
 
+    enum MemoryArena prevArena = main_pool_set_arena(MEMORY_ARENA_OBJECTS);
     gObjectMemoryPool = mem_pool_init(DOUBLE_SIZE_ON_64_BIT(0x800), MEMORY_POOL_LEFT);
+    main_pool_set_arena(prevArena);
     gObjectLists = gObjectListArray;
 
     clear_dynamic_surfaces();
 }
 
+/**
+ * The lists of the objects whose hot fields are read, by object collision
+ * detection and the object update scheduler.
+ */
+static const s8 sHotObjectLists[] = {
+    OBJ_LIST_PLAYER,   OBJ_LIST_DESTRUCTIVE, OBJ_LIST_GENACTOR, OBJ_LIST_PUSHABLE,
+    OBJ_LIST_LEVEL,    OBJ_LIST_DEFAULT,     OBJ_LIST_SURFACE,  OBJ_LIST_POLELIKE,
+};
+
+/**
+ * Copy the hot fields out of every object that they're read for.
+ */
+void copy_object_hot_fields(void) {
+    struct ObjectNode *listHead;
+    struct Object *obj;
+    struct ObjectHotFields *hot;
+    u32 i;
+
+    for (i = 0; i < ARRAY_COUNT(sHotObjectLists); i++) {
+        listHead = &gObjectLists[sHotObjectLists[i]];
+
+        for (obj = (struct Object *) listHead->next; obj != (struct Object *) listHead;
+             obj = (struct Object *) obj->header.next) {
+            hot = &gObjectHot[obj - gObjectPool];
+            hot->posX = qtrunc(QFIELD(obj, oPosX));
+            hot->posY = qtrunc(QFIELD(obj, oPosY));
+            hot->posZ = qtrunc(QFIELD(obj, oPosZ));
+            hot->hitboxRadius = obj->hitboxRadius_s16;
+            hot->tangible = obj->oIntangibleTimer == 0;
+        }
+    }
+}
+
 /**
  * Update spawner and surface objects.
  */
@@ -598,6 +769,7 @@ void unload_deactivated_objects(void) {
  * and object surface management.
  */
 void update_objects(UNUSED s32 unused) {
+    PROFILER_SCOPE(PROFILER_ZONE_UPDATE_OBJECTS, 0);
     s64 cycleCounts[30];
 
     cycleCounts[0] = get_current_clock();
@@ -607,6 +779,9 @@ void update_objects(UNUSED s32 unused) {
     gNumRoomedObjectsInMarioRoom = 0;
     gNumRoomedObjectsNotInMarioRoom = 0;
     gCheckingSurfaceCollisionsForCamera = FALSE;
+#ifdef OBJECT_LOD
+    gNumObjectUpdatesSkipped = 0;
+#endif
 
     reset_debug_objectinfo();
     stub_debug_5();
@@ -621,6 +796,9 @@ void update_objects(UNUSED s32 unused) {
     cycleCounts[2] = get_clock_difference(cycleCounts[0]);
     update_terrain_objects();
 
+    // Compute how far each rotating platform carries its riders this frame
+    update_platform_displacements();
+
     // If Mario was touching a moving platform at the end of last frame, apply
     // displacement now
     //! If the platform object unloaded and a different object took its place,
@@ -629,6 +807,7 @@ void update_objects(UNUSED s32 unused) {
 
     // Detect which objects are intersecting
     cycleCounts[3] = get_clock_difference(cycleCounts[0]);
+    copy_object_hot_fields();
     detect_object_collisions();
 
     // Update all other objects that haven't been updated yet
@@ -25,6 +25,20 @@
  */
 #define OBJECT_POOL_CAPACITY 200 // reduced from 240
 
+/**
+ * The fields of an object that the loops over all objects read every frame,
+ * kept in a dense array indexed like gObjectPool so those loops don't have to
+ * go through the objects themselves. They're copied right before object
+ * collisions are detected, so they hold until the objects get updated.
+ */
+struct ObjectHotFields {
+    s32 posX; // truncated
+    s32 posY;
+    s32 posZ;
+    s16 hitboxRadius;
+    u8 tangible;
+};
+
 /**
  * Every object is categorized into an object list, which controls the order
  * they are processed and which objects they can collide with.
@@ -71,6 +85,8 @@ struct NumTimesCalled {
     /*0x00*/ s16 floor;
     /*0x02*/ s16 ceil;
     /*0x04*/ s16 wall;
+    /*0x06*/ s16 floorCacheHit;
+    /*0x08*/ s16 floorCacheMiss;
 };
 
 extern struct NumTimesCalled gNumCalls;
@@ -80,6 +96,7 @@ extern s16 gDebugInfoOverwrite[][8];
 
 extern u32 gTimeStopState;
 extern struct Object gObjectPool[];
+extern struct ObjectHotFields gObjectHot[];
 extern struct Object gMacroObjectDefaultParent;
 extern struct ObjectNode *gObjectLists;
 extern struct ObjectNode gFreeObjectList;
@@ -114,6 +131,9 @@ extern s16 gNumRoomedObjectsInMarioRoom;
 extern s16 gNumRoomedObjectsNotInMarioRoom;
 extern s16 gWDWWaterLevelChanging;
 extern s16 gMarioOnMerryGoRound;
+#ifdef OBJECT_LOD
+extern s32 gNumObjectUpdatesSkipped;
+#endif
 
 
 void bhv_mario_update(void);
@@ -121,6 +141,7 @@ void set_object_respawn_info_bits(struct Object *obj, u8 bits);
 void unload_objects_from_area(UNUSED s32 unused, s32 areaIndex);
 void spawn_objects_from_info(UNUSED s32 unused, struct SpawnInfo *spawnInfo);
 void clear_objects(void);
+void copy_object_hot_fields(void);
 void update_objects(UNUSED s32 unused);
 
 
@@ -2,6 +2,7 @@
 
 #include "engine/math_util.h"
 #include "engine/surface_collision.h"
+#include "game_init.h"
 #include "level_update.h"
 #include "object_fields.h"
 #include "object_helpers.h"
@@ -10,12 +11,34 @@
 #include "port/gfx/gfx.h"
 #include "types.h"
 
+#ifdef TARGET_PSX
+#include <ps1/gte.h>
+#endif
+
 u16 D_8032FEC0 = 0;
 
 u32 unused_8032FEC4[4] = { 0 };
 
 struct Object *gMarioPlatform = NULL;
 
+/**
+ * The rotation a platform carries its riders by this frame, see
+ * compute_platform_delta. Only the few rotating platforms need one, so they're
+ * kept here rather than on every object.
+ */
+struct PlatformDelta {
+    struct Object *platform;
+    u32 timer;
+    ShortMatrix deltaq;
+};
+
+#define PLATFORM_DELTA_CACHE_SIZE 16
+static struct PlatformDelta sPlatformDeltas[PLATFORM_DELTA_CACHE_SIZE];
+
+static struct PlatformDelta *get_platform_delta_slot(struct Object *platform) {
+    return &sPlatformDeltas[(uintptr_t) platform / sizeof(struct Object) % PLATFORM_DELTA_CACHE_SIZE];
+}
+
 /**
  * Determine if Mario is standing on a platform object, meaning that he is
  * within 4 units of the floor. Set his referenced platform object accordingly.
@@ -85,6 +108,115 @@ void set_mario_posi(s16 xi, s16 yi, s16 zi) {
     gMarioStates[0].pos[2] = zi;
 }
 
+/**
+ * Compute the rotation that carries a rider of the platform from the
+ * platform's orientation last frame to its current one, that is the inverse
+ * of the previous face angle rotation followed by the current one. The
+ * translation is the platform's position, so a rider's offset from the
+ * platform goes through the delta with a single multiply. Both rotations are
+ * in the row vector layout of mtx_rotation_zxy.
+ */
+static const ShortMatrix *compute_platform_delta(struct Object *platform) {
+    ShortMatrix prevq;
+    ShortMatrix curq;
+    struct PlatformDelta *delta = get_platform_delta_slot(platform);
+    ShortMatrix *deltaq = &delta->deltaq;
+    Vec3s rotation;
+
+    rotation[0] = platform->oFaceAnglePitch - platform->oAngleVelPitch;
+    rotation[1] = platform->oFaceAngleYaw - platform->oAngleVelYaw;
+    rotation[2] = platform->oFaceAngleRoll - platform->oAngleVelRoll;
+    prevq = mtx_rotation_zxy(rotation);
+
+    rotation[0] = platform->oFaceAnglePitch;
+    rotation[1] = platform->oFaceAngleYaw;
+    rotation[2] = platform->oFaceAngleRoll;
+    curq = mtx_rotation_zxy(rotation);
+
+#ifdef TARGET_PSX
+    // The rows of the rotation matrix are the columns of prevq, so each column
+    // of curq multiplied by it gives the same column of the delta.
+    gte_setRotationMatrix(
+        prevq.m[0][0], prevq.m[1][0], prevq.m[2][0],
+        prevq.m[0][1], prevq.m[1][1], prevq.m[2][1],
+        prevq.m[0][2], prevq.m[1][2], prevq.m[2][2]
+    );
+    gte_setV0(curq.m[0][0], curq.m[1][0], curq.m[2][0]);
+    gte_setV1(curq.m[0][1], curq.m[1][1], curq.m[2][1]);
+    gte_setV2(curq.m[0][2], curq.m[1][2], curq.m[2][2]);
+
+    gte_commandAfterLoad(GTE_CMD_MVMVA | GTE_SF | GTE_V_V0 | GTE_MX_RT | GTE_CV_NONE);
+    deltaq->m[0][0] = gte_getDataReg(GTE_MAC1);
+    deltaq->m[1][0] = gte_getDataReg(GTE_MAC2);
+    deltaq->m[2][0] = gte_getDataReg(GTE_MAC3);
+    gte_commandNoNop(GTE_CMD_MVMVA | GTE_SF | GTE_V_V1 | GTE_MX_RT | GTE_CV_NONE);
+    deltaq->m[0][1] = gte_getDataReg(GTE_MAC1);
+    deltaq->m[1][1] = gte_getDataReg(GTE_MAC2);
+    deltaq->m[2][1] = gte_getDataReg(GTE_MAC3);
+    gte_commandNoNop(GTE_CMD_MVMVA | GTE_SF | GTE_V_V2 | GTE_MX_RT | GTE_CV_NONE);
+    deltaq->m[0][2] = gte_getDataReg(GTE_MAC1);
+    deltaq->m[1][2] = gte_getDataReg(GTE_MAC2);
+    deltaq->m[2][2] = gte_getDataReg(GTE_MAC3);
+#else
+    for (s32 i = 0; i < 3; i++) {
+        for (s32 j = 0; j < 3; j++) {
+            deltaq->m[i][j] = (s32) (prevq.m[0][i] * curq.m[0][j] + prevq.m[1][i] * curq.m[1][j]
+                                     + prevq.m[2][i] * curq.m[2][j]) >> FRACT_BITS;
+        }
+    }
+#endif
+
+    deltaq->t[0] = IFIELD(platform, oPosX);
+    deltaq->t[1] = IFIELD(platform, oPosY);
+    deltaq->t[2] = IFIELD(platform, oPosZ);
+    delta->platform = platform;
+    delta->timer = gGlobalTimer;
+
+    return deltaq;
+}
+
+/**
+ * Get this frame's delta of a platform, computing it if it isn't there.
+ * Two platforms in the same slot just take turns computing theirs.
+ */
+static const ShortMatrix *get_platform_delta(struct Object *platform) {
+    struct PlatformDelta *delta = get_platform_delta_slot(platform);
+
+    if (delta->platform != platform || delta->timer != gGlobalTimer) {
+        return compute_platform_delta(platform);
+    }
+    return &delta->deltaq;
+}
+
+/**
+ * Drop the delta of an object that is being unloaded, so that an object
+ * spawned in its place later in the frame doesn't get it.
+ */
+void forget_platform_displacement(struct Object *obj) {
+    struct PlatformDelta *delta = get_platform_delta_slot(obj);
+
+    if (delta->platform == obj) {
+        delta->platform = NULL;
+    }
+}
+
+/**
+ * Compute the displacement of every rotating surface object once, after they
+ * have all moved for the frame, so that their riders only have to apply it.
+ * Platforms outside of the surface list get theirs when first ridden.
+ */
+void update_platform_displacements(void) {
+    struct ObjectNode *listHead = &gObjectLists[OBJ_LIST_SURFACE];
+    struct Object *obj = (struct Object *) listHead->next;
+
+    while (obj != (struct Object *) listHead) {
+        if (obj->oAngleVelPitch != 0 || obj->oAngleVelYaw != 0 || obj->oAngleVelRoll != 0) {
+            compute_platform_delta(obj);
+        }
+        obj = (struct Object *) obj->header.next;
+    }
+}
+
 /**
  * Apply one frame of platform rotation to Mario or an object using the given
  * platform. If isMario is false, use gCurrentObject.
@@ -93,17 +225,10 @@ void apply_platform_displacement(u32 isMario, struct Object *platform) {
     s16 xi;
     s16 yi;
     s16 zi;
-    s16 platformPosXi;
-    s16 platformPosYi;
-    s16 platformPosZi;
-    ShortVec currentObjectOffseti;
-    ShortVec relativeOffseti;
-    ShortVec newObjectOffseti;
-    Vec3s rotation;
-
-    rotation[0] = platform->oAngleVelPitch;
-    rotation[1] = platform->oAngleVelYaw;
-    rotation[2] = platform->oAngleVelRoll;
+    s32 offsetXi;
+    s32 offsetYi;
+    s32 offsetZi;
+    const ShortMatrix *deltaq;
 
     if (isMario) {
         D_8032FEC0 = 0;
@@ -117,38 +242,36 @@ void apply_platform_displacement(u32 isMario, struct Object *platform) {
     xi += IFIELD(platform, oVelX);
     zi += IFIELD(platform, oVelZ);
 
-    if (rotation[0] != 0 || rotation[1] != 0 || rotation[2] != 0) {
+    if (platform->oAngleVelPitch != 0 || platform->oAngleVelYaw != 0 || platform->oAngleVelRoll != 0) {
         if (isMario) {
-            gMarioStates[0].faceAngle[1] += rotation[1];
+            gMarioStates[0].faceAngle[1] += platform->oAngleVelYaw;
         }
 
-        platformPosXi = IFIELD(platform, oPosX);
-        platformPosYi = IFIELD(platform, oPosY);
-        platformPosZi = IFIELD(platform, oPosZ);
-
-        currentObjectOffseti.vx = xi - platformPosXi;
-        currentObjectOffseti.vy = yi - platformPosYi;
-        currentObjectOffseti.vz = zi - platformPosZi;
-
-        rotation[0] = platform->oFaceAnglePitch - platform->oAngleVelPitch;
-        rotation[1] = platform->oFaceAngleYaw - platform->oAngleVelYaw;
-        rotation[2] = platform->oFaceAngleRoll - platform->oAngleVelRoll;
+        deltaq = get_platform_delta(platform);
 
-        scratch_mtx = mtx_rotation_zxy_and_translation(currentObjectOffseti.elems, rotation);
-        mtx_transpose(&scratch_mtx);
-        relativeOffseti = mtx_apply(&currentObjectOffseti, &scratch_mtx);
+        offsetXi = xi - deltaq->t[0];
+        offsetYi = yi - deltaq->t[1];
+        offsetZi = zi - deltaq->t[2];
 
-        rotation[0] = platform->oFaceAnglePitch;
-        rotation[1] = platform->oFaceAngleYaw;
-        rotation[2] = platform->oFaceAngleRoll;
-
-        scratch_mtx = mtx_rotation_zxy_and_translation(currentObjectOffseti.elems, rotation);
-        mtx_transpose(&scratch_mtx);
-        newObjectOffseti = mtx_apply(&relativeOffseti, &scratch_mtx);
-
-        xi = platformPosXi + newObjectOffseti.vx;
-        yi = platformPosYi + newObjectOffseti.vy;
-        zi = platformPosZi + newObjectOffseti.vz;
+#ifdef TARGET_PSX
+        gte_setRotationMatrix(
+            deltaq->m[0][0], deltaq->m[1][0], deltaq->m[2][0],
+            deltaq->m[0][1], deltaq->m[1][1], deltaq->m[2][1],
+            deltaq->m[0][2], deltaq->m[1][2], deltaq->m[2][2]
+        );
+        gte_setControlReg(GTE_TRX, deltaq->t[0]);
+        gte_setControlReg(GTE_TRY, deltaq->t[1]);
+        gte_setControlReg(GTE_TRZ, deltaq->t[2]);
+        gte_setV0(offsetXi, offsetYi, offsetZi);
+        gte_commandAfterLoad(GTE_CMD_MVMVA | GTE_SF | GTE_V_V0 | GTE_MX_RT | GTE_CV_TR);
+        xi = gte_getDataReg(GTE_MAC1);
+        yi = gte_getDataReg(GTE_MAC2);
+        zi = gte_getDataReg(GTE_MAC3);
+#else
+        xi = ((offsetXi * deltaq->m[0][0] + offsetYi * deltaq->m[1][0] + offsetZi * deltaq->m[2][0]) >> FRACT_BITS) + deltaq->t[0];
+        yi = ((offsetXi * deltaq->m[0][1] + offsetYi * deltaq->m[1][1] + offsetZi * deltaq->m[2][1]) >> FRACT_BITS) + deltaq->t[1];
+        zi = ((offsetXi * deltaq->m[0][2] + offsetYi * deltaq->m[1][2] + offsetZi * deltaq->m[2][2]) >> FRACT_BITS) + deltaq->t[2];
+#endif
     }
 
     if (isMario) {
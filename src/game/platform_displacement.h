@@ -8,6 +8,8 @@
 void update_mario_platform(void);
 void get_mario_posi(s16 *xi, s16 *yi, s16 *zi);
 void set_mario_posi(s16 xi, s16 yi, s16 zi);
+void update_platform_displacements(void);
+void forget_platform_displacement(struct Object *obj);
 void apply_platform_displacement(u32 isMario, struct Object *platform);
 void apply_mario_platform_displacement(void);
 #ifndef VERSION_JP
@@ -7,6 +7,15 @@
 #include "game_init.h"
 #include <port/gfx/gfx.h>
 #include <game/print.h>
+#include <assert.h>
+#ifdef PROFILE_ZONES
+#include <PR/os_libc.h>
+#ifdef TARGET_PC
+#include <stdio.h>
+#else
+#include <vendor/printf.h>
+#endif
+#endif
 
 // the thread 3 info is logged on the opposite profiler from what is used by
 // the thread4 and 5 loggers. It's likely because the sound thread runs at a
@@ -23,12 +32,19 @@ struct ProfilerFrameData gProfilerFrameData[2];
 #define PROFILER_FRAME_US (1000000 / 30)
 #define PROFILER_FRAME_WIDTH (XPOS(4))
 
+#ifdef PROFILE_ZONES
+static void profiler_next_sample(void);
+#endif
+
 // log the current osTime to the appropriate idx for current thread5 processes.
 void profiler_log_thread5_time(enum ProfilerGameEvent eventID) {
     gProfilerFrameData[gCurrentFrameIndex1].gameTimes[eventID] = osGetTime();
 
     if (eventID == THREAD5_END) {
         gCurrentFrameIndex1 ^= 1;
+#ifdef PROFILE_ZONES
+        profiler_next_sample();
+#endif
     }
 }
 
@@ -129,3 +145,172 @@ void draw_profiler(void) {
     gfx_emit_env_color_alpha_full(0x28FF28);
     draw_profiler_bar(clockBase, profiler->gameTimes[3], profiler->gameTimes[4], 212 - 16, -1);
 }
+
+#ifdef PROFILE_ZONES
+// zones are logged as begin/end events into a ring buffer, so the last few frames can be exported as a chrome trace
+// (chrome://tracing or ui.perfetto.dev), and summed up into per frame samples
+#ifdef TARGET_PC
+#define PROFILER_EVENT_COUNT 65536
+#else
+#define PROFILER_EVENT_COUNT 4096
+#endif
+#define PROFILER_SAMPLE_COUNT 64
+#define PROFILER_MAX_DEPTH 32
+
+typedef struct {
+    u32 time; // in profiler ticks
+    u8 zone;
+    bool is_end;
+    u32 arg;
+} ProfilerEvent;
+
+typedef struct {
+    u32 start_time;
+    u32 zone_time[PROFILER_ZONE_COUNT]; // includes the time of nested zones
+    u32 counters[PROFILER_COUNTER_COUNT];
+} ProfilerSample;
+
+static const char* const zone_names[PROFILER_ZONE_COUNT] = {
+    [PROFILER_ZONE_LEVEL_SCRIPT] = "level_script_execute",
+    [PROFILER_ZONE_UPDATE_OBJECTS] = "update_objects",
+    [PROFILER_ZONE_OBJECT] = "object",
+    [PROFILER_ZONE_GEO_PROCESS] = "geo_process_root",
+    [PROFILER_ZONE_RUN_DL] = "gfx_run_compiled_dl",
+    [PROFILER_ZONE_DL_CALL] = "dl",
+    [PROFILER_ZONE_LOAD_TEXTURE] = "gfx_load_texture",
+    [PROFILER_ZONE_CD_READ] = "cd_read",
+    [PROFILER_ZONE_AUDIO_TICK] = "audio_tick",
+};
+
+static const char* const counter_names[PROFILER_COUNTER_COUNT] = {
+    [PROFILER_COUNTER_OBJECTS] = "objects",
+    [PROFILER_COUNTER_DL_CALLS] = "dl calls",
+    [PROFILER_COUNTER_TEXTURE_BYTES] = "texture bytes",
+    [PROFILER_COUNTER_CD_BYTES] = "cd bytes",
+};
+
+static ProfilerEvent events[PROFILER_EVENT_COUNT];
+static u32 event_count = 0; // not wrapped
+static ProfilerSample samples[PROFILER_SAMPLE_COUNT];
+static u32 sample_count = 0; // not wrapped, the last one is the current frame
+static u32 zone_starts[PROFILER_MAX_DEPTH];
+static u8 zone_stack[PROFILER_MAX_DEPTH];
+static u32 zone_depth = 0;
+
+static void log_event(u32 time, enum ProfilerZone zone, bool is_end, u32 arg) {
+    ProfilerEvent* event = &events[event_count++ % PROFILER_EVENT_COUNT];
+    event->time = time;
+    event->zone = zone;
+    event->is_end = is_end;
+    event->arg = arg;
+}
+
+u8 profiler_zone_begin(enum ProfilerZone zone, u32 arg) {
+    u32 now = profiler_ticks();
+    assert(zone_depth < PROFILER_MAX_DEPTH);
+    zone_starts[zone_depth] = now;
+    zone_stack[zone_depth++] = zone;
+    log_event(now, zone, false, arg);
+    return zone;
+}
+
+void profiler_zone_end(enum ProfilerZone zone) {
+    u32 now = profiler_ticks();
+    assert(zone_depth > 0 && zone_stack[zone_depth - 1] == zone);
+    zone_depth--;
+    samples[sample_count % PROFILER_SAMPLE_COUNT].zone_time[zone] += now - zone_starts[zone_depth];
+    log_event(now, zone, true, 0);
+}
+
+void profiler_zone_end_scope(u8* zone) {
+    profiler_zone_end(*zone);
+}
+
+void profiler_count(enum ProfilerCounter counter, u32 amount) {
+    samples[sample_count % PROFILER_SAMPLE_COUNT].counters[counter] += amount;
+}
+
+static void profiler_next_sample(void) {
+    ProfilerSample* sample = &samples[++sample_count % PROFILER_SAMPLE_COUNT];
+    bzero(sample, sizeof(ProfilerSample));
+    sample->start_time = profiler_ticks();
+}
+
+#ifdef TARGET_PC
+static FILE* trace_file;
+#define trace_printf(...) fprintf(trace_file, __VA_ARGS__)
+#else
+// goes over the serial link with SERIAL=1, tools/serial_server.py picks it up between the markers
+#define trace_printf(...) printf(__VA_ARGS__)
+#endif
+
+// trace timestamps are in us, with the fraction the ticks give
+static void print_trace_time(u32 ticks) {
+    u32 ns = (u64) ticks * 1000000000 / PROFILER_TICK_RATE % 1000;
+    trace_printf("%u.%03u", (unsigned) ((u64) ticks * 1000000 / PROFILER_TICK_RATE), (unsigned) ns);
+}
+
+void profiler_export_trace(void) {
+    u32 first_event = event_count > PROFILER_EVENT_COUNT ? event_count - PROFILER_EVENT_COUNT : 0;
+    u32 first_sample = sample_count >= PROFILER_SAMPLE_COUNT ? sample_count - PROFILER_SAMPLE_COUNT + 1 : 0;
+    if(first_event == event_count) {
+        return;
+    }
+    u32 base_time = events[first_event % PROFILER_EVENT_COUNT].time;
+    bool first = true;
+
+#ifdef TARGET_PC
+    trace_file = fopen("profile_trace.json", "w");
+    if(!trace_file) {
+        return;
+    }
+#else
+    trace_printf("\n--- profiler trace begin ---\n");
+#endif
+    trace_printf("{\"traceEvents\":[\n");
+
+    // the oldest events may end zones whose beginning got overwritten, skip those
+    u32 depth = 0;
+    for(u32 i = first_event; i != event_count; i++) {
+        ProfilerEvent* event = &events[i % PROFILER_EVENT_COUNT];
+        if(event->is_end) {
+            if(depth == 0) {
+                continue;
+            }
+            depth--;
+        } else {
+            depth++;
+        }
+        trace_printf("%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":", first ? "" : ",\n",
+            zone_names[event->zone], event->is_end ? 'E' : 'B');
+        print_trace_time(event->time - base_time);
+        trace_printf(",\"pid\":1,\"tid\":1");
+        if(!event->is_end && event->arg) {
+            trace_printf(",\"args\":{\"arg\":\"0x%08X\"}", (unsigned) event->arg);
+        }
+        trace_printf("}");
+        first = false;
+    }
+
+    // counters are per frame, the current one isn't finished yet
+    for(u32 i = first_sample; i != sample_count; i++) {
+        ProfilerSample* sample = &samples[i % PROFILER_SAMPLE_COUNT];
+        if((s32) (sample->start_time - base_time) < 0) {
+            continue;
+        }
+        for(s32 counter = 0; counter < PROFILER_COUNTER_COUNT; counter++) {
+            trace_printf(",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":", counter_names[counter]);
+            print_trace_time(sample->start_time - base_time);
+            trace_printf(",\"pid\":1,\"args\":{\"value\":%u}}", (unsigned) sample->counters[counter]);
+        }
+    }
+
+    trace_printf("\n]}\n");
+#ifdef TARGET_PC
+    fclose(trace_file);
+    printf("profiler: wrote profile_trace.json\n");
+#else
+    trace_printf("--- profiler trace end ---\n");
+#endif
+}
+#endif
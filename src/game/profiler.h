@@ -5,6 +5,7 @@
 #include <PR/os_time.h>
 
 #include "types.h"
+#include "macros.h"
 
 extern u64 osClockRate;
 
@@ -27,7 +28,57 @@ enum ProfilerGameEvent {
     THREAD5_END
 };
 
+// nestable zones, recorded with PROFILE=1
+enum ProfilerZone {
+    PROFILER_ZONE_LEVEL_SCRIPT,
+    PROFILER_ZONE_UPDATE_OBJECTS,
+    PROFILER_ZONE_OBJECT, // arg: behavior script
+    PROFILER_ZONE_GEO_PROCESS,
+    PROFILER_ZONE_RUN_DL,
+    PROFILER_ZONE_DL_CALL, // arg: called display list
+    PROFILER_ZONE_LOAD_TEXTURE, // arg: texture header
+    PROFILER_ZONE_CD_READ, // arg: size
+    PROFILER_ZONE_AUDIO_TICK,
+    PROFILER_ZONE_COUNT
+};
+
+enum ProfilerCounter {
+    PROFILER_COUNTER_OBJECTS,
+    PROFILER_COUNTER_DL_CALLS,
+    PROFILER_COUNTER_TEXTURE_BYTES,
+    PROFILER_COUNTER_CD_BYTES,
+    PROFILER_COUNTER_COUNT
+};
+
 void profiler_log_thread5_time(enum ProfilerGameEvent eventID);
 void draw_profiler(void);
 
+// the zones are timed in ticks of the finest timer there is, and only turned into us when exported
+#ifdef TARGET_PC
+#define PROFILER_TICK_RATE 1000000
+#else
+#define PROFILER_TICK_RATE (33868800 / 8) // root counter 2 at sysclk/8
+#endif
+u32 profiler_ticks(void);
+
+#ifdef PROFILE_ZONES
+u8 profiler_zone_begin(enum ProfilerZone zone, u32 arg);
+void profiler_zone_end(enum ProfilerZone zone);
+void profiler_zone_end_scope(u8* zone);
+void profiler_count(enum ProfilerCounter counter, u32 amount);
+void profiler_export_trace(void);
+
+#define PROFILER_BEGIN(zone, arg) profiler_zone_begin(zone, (u32) (uintptr_t) (arg))
+#define PROFILER_END(zone) profiler_zone_end(zone)
+// the zone ends when the enclosing scope is left, early returns included
+#define PROFILER_SCOPE(zone, arg) [[gnu::cleanup(profiler_zone_end_scope)]] UNUSED u8 profiler_scope = PROFILER_BEGIN(zone, arg)
+#define PROFILER_COUNT(counter, amount) profiler_count(counter, amount)
+#else
+#define PROFILER_BEGIN(zone, arg)
+#define PROFILER_END(zone)
+#define PROFILER_SCOPE(zone, arg)
+#define PROFILER_COUNT(counter, amount)
+#define profiler_export_trace()
+#endif
+
 #endif // PROFILER_H
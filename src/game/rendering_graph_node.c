@@ -10,6 +10,7 @@
 #include "memory.h"
 #include "port/gfx/gfx_internal.h"
 #include "print.h"
+#include "profiler.h"
 #include "rendering_graph_node.h"
 #include "shadow.h"
 #include "sm64.h"
@@ -70,6 +71,7 @@ static void geo_append_display_list(Gfx* display_list, UNUSED s16 layer) {
 
 // the entry point: process the root of the graph
 void geo_process_root(struct GraphNodeRoot* node, UNUSED Vp* b, UNUSED Vp* c, UNUSED s32 clearColor) {
+	PROFILER_SCOPE(PROFILER_ZONE_GEO_PROCESS, 0);
 	if(node->node.flags & GRAPH_RENDER_ACTIVE) {
 		// prep work for a frame
 		//geo_using_zbuffer = false;
@@ -214,6 +216,29 @@ u16* gCurrAnimAttribute;
 const s16* gCurAnimData;
 static bool is_anim_compressed = false;
 
+// Decoded poses shared by every object playing the same frame of the same animation. An entry holds the values of the
+// animated parts in the order they're drawn: the first part's translation axes, then three rotation angles per part.
+// Decoding is sequential, so the nth part drawn always gets the nth values no matter which object draws it.
+#define POSE_CACHE_SIZE 16
+#define POSE_MAX_PARTS 40
+
+struct PoseCacheEntry {
+	const struct Animation* anim; // NULL if free
+	u16* attribute_end; // where decoding continues past the recorded parts
+	u32 last_used;
+	s16 frame;
+	u8 num_values;
+	s16 values[3 + 3 * POSE_MAX_PARTS];
+};
+
+static struct PoseCacheEntry pose_cache[POSE_CACHE_SIZE];
+static u32 pose_cache_clock = 0;
+static const struct Animation* pose_anim = NULL; // looked up when the object's first animated part is drawn
+static struct PoseCacheEntry* cur_pose = NULL;
+static u32 cur_pose_pos = 0;
+u32 gPoseCacheHits = 0;
+u32 gPoseCacheMisses = 0;
+
 static void geo_set_animation_globals(struct AnimInfo* node, s32 hasAnimation) {
 	struct Animation* anim = node->curAnim;
 	if(hasAnimation) {
@@ -235,6 +260,8 @@ static void geo_set_animation_globals(struct AnimInfo* node, s32 hasAnimation) {
 	gCurAnimEnabled = !(anim->flags & ANIM_FLAG_5);
 	gCurrAnimAttribute = segmented_to_virtual(anim->index);
 	gCurAnimData = segmented_to_virtual(anim->values);
+	pose_anim = anim;
+	cur_pose = NULL;
 
 	if (anim->animYTransDivisor) {
 		gCurAnimTranslationMultiplierq = q(node->animYTrans) / anim->animYTransDivisor;
@@ -270,6 +297,7 @@ static void geo_process_object(struct Object* node) {
 		}
 
 		if(obj_is_in_view(&node->header.gfx, modelview.t)) {
+			node->header.gfx.node.flags |= GRAPH_RENDER_IN_VIEW;
 			if(node->header.gfx.sharedChild) {
 				gCurGraphNodeObject = (struct GraphNodeObject*) node;
 				node->header.gfx.sharedChild->parent = &node->header.gfx.node;
@@ -447,49 +475,140 @@ static void geo_process_scale(struct GraphNodeScale* node) {
 	matrix_changed = true;
 }
 
-#define POS_STEP 2
-#define ROT_STEP 2
-
 #include <assert.h>
 
+static s32 decode_anim_translation(u32 frame) {
+	if(is_anim_compressed) {
+		return retrieve_compressed_animation_value(frame, &gCurrAnimAttribute, gCurAnimData, FALSE);
+	}
+	u32 idx = retrieve_animation_index(frame, &gCurrAnimAttribute, NULL);
+	s32 value = gCurAnimData[idx];
+	assert(value > -2147400);
+	return value;
+}
+
+static s32 decode_anim_rotation(u32 frame) {
+	if(is_anim_compressed) {
+		return retrieve_compressed_animation_value(frame, &gCurrAnimAttribute, gCurAnimData, TRUE);
+	}
+	u32 idx = retrieve_animation_index(frame, &gCurrAnimAttribute, NULL);
+	return gCurAnimData[idx];
+}
+
+static inline bool anim_axis_has_translation(int i) {
+	return gCurAnimType == ANIM_TYPE_TRANSLATION || ((gCurAnimType == ANIM_TYPE_VERTICAL_TRANSLATION) == (i == 1));
+}
+
+// how many values the next animated part takes
+static u32 anim_part_value_count() {
+	switch(gCurAnimType) {
+		case ANIM_TYPE_TRANSLATION: return 6;
+		case ANIM_TYPE_VERTICAL_TRANSLATION: return 4;
+		case ANIM_TYPE_LATERAL_TRANSLATION: return 5;
+		default: return 3;
+	}
+}
+
+static void decode_anim_part(s16* values) {
+	u32 frame = gCurrAnimFrame;
+	if(gCurAnimType < ANIM_TYPE_NO_TRANSLATION) {
+		for(int i = 0; i < 3; i++) {
+			if(anim_axis_has_translation(i)) {
+				*values++ = decode_anim_translation(frame);
+			} else {
+				gCurrAnimAttribute += 2;
+			}
+		}
+	} else if(gCurAnimType == ANIM_TYPE_NO_TRANSLATION) {
+		// the translation is still there, Mario moves by it instead
+		gCurrAnimAttribute += 6;
+	}
+	for(int i = 0; i < 3; i++) {
+		*values++ = decode_anim_rotation(frame);
+	}
+}
+
+static struct PoseCacheEntry* find_cached_pose(const struct Animation* anim, s16 frame) {
+	struct PoseCacheEntry* oldest = &pose_cache[0];
+	pose_cache_clock++;
+	for(int i = 0; i < POSE_CACHE_SIZE; i++) {
+		struct PoseCacheEntry* entry = &pose_cache[i];
+		if(entry->anim == anim && entry->frame == frame) {
+			entry->last_used = pose_cache_clock;
+			gCurrAnimAttribute = entry->attribute_end;
+			gPoseCacheHits++;
+			return entry;
+		}
+		if(entry->last_used < oldest->last_used) {
+			oldest = entry;
+		}
+	}
+	gPoseCacheMisses++;
+	oldest->anim = anim;
+	oldest->frame = frame;
+	oldest->num_values = 0;
+	oldest->attribute_end = gCurrAnimAttribute;
+	oldest->last_used = pose_cache_clock;
+	return oldest;
+}
+
+// the values of the next animated part, from the pose cache if another object already decoded them this frame
+static const s16* next_anim_part() {
+	static s16 decoded[6];
+	if(pose_anim) {
+		cur_pose = find_cached_pose(pose_anim, gCurrAnimFrame);
+		cur_pose_pos = 0;
+		pose_anim = NULL;
+	}
+	if(cur_pose) {
+		u32 count = anim_part_value_count();
+		s16* values = &cur_pose->values[cur_pose_pos];
+		if(cur_pose_pos + count <= cur_pose->num_values) {
+			cur_pose_pos += count;
+			return values;
+		}
+		if(cur_pose_pos + count <= ARRAY_COUNT(cur_pose->values)) {
+			// gCurrAnimAttribute is at attribute_end, past the last recorded part
+			decode_anim_part(values);
+			cur_pose_pos += count;
+			cur_pose->num_values = cur_pose_pos;
+			cur_pose->attribute_end = gCurrAnimAttribute;
+			return values;
+		}
+		// too many parts to record, the rest are decoded every time
+		cur_pose = NULL;
+	}
+	decode_anim_part(decoded);
+	return decoded;
+}
+
+void geo_forget_animation_poses(const struct Animation* anim) {
+	for(int i = 0; i < POSE_CACHE_SIZE; i++) {
+		if(pose_cache[i].anim == anim) {
+			pose_cache[i].anim = NULL;
+			pose_cache[i].last_used = 0;
+		}
+	}
+}
+
+void geo_clear_pose_cache(void) {
+	for(int i = 0; i < POSE_CACHE_SIZE; i++) {
+		pose_cache[i].anim = NULL;
+		pose_cache[i].last_used = 0;
+	}
+	pose_cache_clock = 0;
+}
+
 static void geo_process_animated_part(struct GraphNodeAnimatedPart* node) {
 	ShortMatrix bak = gfx_modelview_get();
 	if(gCurAnimType) {
-		u32 frame = gCurrAnimFrame;
+		const s16* values = next_anim_part();
 		if(gCurAnimType < ANIM_TYPE_NO_TRANSLATION) {
 			s16 translation[3];
 			for(int i = 0; i < 3; i++) {
 				translation[i] = node->translation[i];
-				if(gCurAnimType == ANIM_TYPE_TRANSLATION || ((gCurAnimType == ANIM_TYPE_VERTICAL_TRANSLATION) == (i == 1))) {
-					s32 value;
-					if(is_anim_compressed) {
-						if(gCurrAnimAttribute[0] == 0) {
-							value = (s16) gCurrAnimAttribute[1];
-							gCurrAnimAttribute += 2;
-						} else {
-							u32 next_idx;
-							u32 idx = retrieve_animation_index(frame / POS_STEP, &gCurrAnimAttribute, &next_idx);
-							value = gCurAnimData[idx];
-							assert(value > -2147400);
-							s32 mid_frame = frame % POS_STEP;
-							if(mid_frame != 0 && next_idx != idx) {
-								s32 next_value = gCurAnimData[next_idx];
-								assert(next_value > -2147400);
-								s32 diff = next_value - value;
-								if(ABS(diff) <= 0x7FFF) {
-									value = value + diff * mid_frame / POS_STEP;
-								}
-								assert(value > -2147400);
-							}
-						}
-					} else {
-						u32 idx = retrieve_animation_index(frame, &gCurrAnimAttribute, NULL);
-						value = gCurAnimData[idx];
-						assert(value > -2147400);
-					}
-					translation[i] += value * gCurAnimTranslationMultiplierq / ONE;
-				} else if(!is_anim_compressed) {
-					gCurrAnimAttribute += 2;
+				if(anim_axis_has_translation(i)) {
+					translation[i] += *values++ * gCurAnimTranslationMultiplierq / ONE;
 				}
 			}
 			gfx_modelview_translatei(translation);
@@ -498,33 +617,7 @@ static void geo_process_animated_part(struct GraphNodeAnimatedPart* node) {
 		}
 		gCurAnimType = ANIM_TYPE_ROTATION;
 		// all non-null animation types have rotation, so no need to check
-		Vec3s rotation;
-		for(int i = 0; i < 3; i++) {
-			s32 value;
-			if(is_anim_compressed) {
-				if(gCurrAnimAttribute[0] == 0) {
-					value = (s16) gCurrAnimAttribute[1];
-					gCurrAnimAttribute += 2;
-				} else {
-					u32 next_idx;
-					u32 idx = retrieve_animation_index(frame / ROT_STEP, &gCurrAnimAttribute, &next_idx);
-					value = (s16) ((u16) ((const u8*) gCurAnimData)[idx] << 8);
-					s32 mid_frame = frame % ROT_STEP;
-					if(mid_frame != 0 && next_idx != idx) {
-						s32 next_value = (s16) ((u16) ((const u8*) gCurAnimData)[next_idx] << 8);
-						s32 diff = next_value - value;
-						if(ABS(diff) <= 0x7FFF) {
-							value = value + diff * mid_frame / ROT_STEP;
-						}
-					}
-				}
-			} else {
-				u32 idx = retrieve_animation_index(frame, &gCurrAnimAttribute, NULL);
-				value = gCurAnimData[idx];
-			}
-			rotation[i] = value;
-		}
-		gfx_modelview_rotate_xyz(rotation);
+		gfx_modelview_rotate_xyz(values);
 		matrix_changed = true;
 	}
 	if(node->displayList) {
@@ -634,3 +727,40 @@ static void geo_process_master_list(struct GraphNodeMasterList* node) {
 		gCurGraphNodeMasterList = NULL;
 	}
 }
+
+#ifdef TARGET_PC
+static s32 bench_pose_sink = 0;
+
+static void bench_walk_animated_parts(struct GraphNode* first_node) {
+	struct GraphNode* node = first_node;
+	do {
+		if(node->flags & GRAPH_RENDER_ACTIVE) {
+			if(node->type == GRAPH_NODE_TYPE_ANIMATED_PART && gCurAnimType) {
+				bench_pose_sink += next_anim_part()[0];
+				gCurAnimType = ANIM_TYPE_ROTATION;
+			}
+			if(node->children) {
+				bench_walk_animated_parts(node->children);
+			}
+		}
+	} while(node->next && (node = node->next) != first_node);
+}
+
+// decodes the current frame of the object's animation for every animated part it has, without drawing anything
+s32 bench_decode_pose(struct Object* obj, s32 cached) {
+	struct AnimInfo* anim_info = &obj->header.gfx.animInfo;
+	if(!anim_info->curAnim || !obj->header.gfx.sharedChild) {
+		return FALSE;
+	}
+	u16 anim_timer = anim_info->animTimer;
+	geo_set_animation_globals(anim_info, FALSE);
+	anim_info->animTimer = anim_timer;
+	if(!cached) {
+		pose_anim = NULL;
+	}
+	bench_walk_animated_parts(obj->header.gfx.sharedChild);
+	gCurAnimType = ANIM_TYPE_NONE;
+	cur_pose = NULL;
+	return TRUE;
+}
+#endif
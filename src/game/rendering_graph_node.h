@@ -29,6 +29,17 @@ void update_matrix();
 // translation types the type is set to this
 #define ANIM_TYPE_ROTATION              5
 
+// how many animated objects found their pose already decoded by another object playing the same frame
+extern u32 gPoseCacheHits;
+extern u32 gPoseCacheMisses;
+
 void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor);
+// animation data at this address changed, for buffers animations are loaded into
+void geo_forget_animation_poses(const struct Animation *anim);
+void geo_clear_pose_cache(void);
+
+#ifdef TARGET_PC
+s32 bench_decode_pose(struct Object *obj, s32 cached);
+#endif
 
 #endif // RENDERING_GRAPH_NODE_H
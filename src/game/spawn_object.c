@@ -10,6 +10,7 @@
 #include "object_fields.h"
 #include "object_helpers.h"
 #include "object_list_processor.h"
+#include "platform_displacement.h"
 #include "spawn_object.h"
 #include "types.h"
 #include <port/gfx/gfx.h>
@@ -193,6 +194,7 @@ void unload_object(struct Object *obj) {
 
     obj->header.gfx.throwMatrixq = NULL;
     stop_sounds_from_source(obj->header.gfx.cameraToObject);
+    forget_platform_displacement(obj);
     geo_remove_child(&obj->header.gfx.node);
     geo_add_child(&gObjParentGraphNode, &obj->header.gfx.node);
 
@@ -330,6 +332,7 @@ struct Object *create_object(const BehaviorScript *bhvScript) {
     obj = allocate_object(objList);
 
     obj->curBhvCommand = bhvScript;
+    obj->curBhvOp = NULL;
     obj->behavior = behavior;
 
     if (objListIndex == OBJ_LIST_UNIMPORTANT) {
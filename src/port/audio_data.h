@@ -1,12 +1,42 @@
 #pragma once
 #include <types.h>
 
+typedef union {
+	struct {
+		u16 spu_freq; // 0x1000 * (frequency in Hz) / 44100
+		u16 spu_addr; // address in SPU memory divided by 8
+	};
+	u32 as_u32;
+} SampleDef;
+
+// the sound player's channel and layer scripts, converted by tools/sound_player_to_c.py
+// a sound's script starts with its channel's ops, the layers it starts are further along the same array
+// var is one byte, or two when the first has the top bit set, like in the m64 format
+enum SfxOp {
+	// 0x00-0x7F: a layer's note, the semitone with the transpositions applied, then velocity, gate and var delay
+	// the note is released once the remaining delay is under gate / 256 of it, 0 holds it until the next one
+	SFX_OP_WAIT = 0x80, // var delay
+	SFX_OP_BANK, // channel: bank
+	SFX_OP_INSTR, // instrument, the layer's one replaces the channel's
+	SFX_OP_ENVELOPE, // channel: adsr1, adsr2 as little endian u16, the release bits of adsr2 aren't used
+	SFX_OP_RELEASE, // channel: release shift for the SPU envelope
+	SFX_OP_PAN, // pan, 0-127 with 64 in the middle
+	SFX_OP_LAYER, // channel: layer index, u16 offset of its ops in the sound's script
+	SFX_OP_FREE_LAYER, // channel: layer index
+	SFX_OP_PORTAMENTO, // layer: mode, semitone, time, as in the m64 layer_portamento
+	SFX_OP_PORTAMENTO_OFF, // layer
+	SFX_OP_LEGATO, // layer: 1 slides the held note to the next ones instead of starting them again, 0 stops
+	SFX_OP_JUMP, // layer: u16 offset in the sound's script, only ever backwards so it's a loop
+	SFX_OP_END = 0xFF,
+};
+
 typedef struct {
-	u8 bank_id;
-	u8 sample_id;
-	u8 note;
-	u8 gate;
-	s8 velocity;
+	const u8* script; // NULL for the sounds that don't play anything
 } SfxDef;
 
-extern SfxDef* sfx_defs_per_channel[];
+#define SFX_MAX_LAYERS 4
+
+extern const SfxDef* sfx_defs_per_channel[];
+extern const u16 sfx_count_per_channel[];
+// per bank, per instrument: the SPU envelope the instrument's notes use, adsr1 | adsr2 << 16
+extern const u32* sfx_instrument_adsr[];
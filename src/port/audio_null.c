@@ -1,11 +1,47 @@
 #ifndef TARGET_PSX
 
 #include <types.h>
+#include <macros.h>
+#include <port/sfx_player.h>
 
-void audio_backend_init() {}
-void play_sound(s32 soundBits, f32 *pos) {}
+// the sound effects still go through the player so its cost can be measured, but nothing comes out
+
+static u32 sounding_voices = 0;
+
+void audio_backend_init() {
+	sfx_player_init();
+}
+void audio_backend_load_level(UNUSED s16 level) {}
+void play_sound(s32 soundBits, f32 *pos) {
+	sfx_player_play(soundBits, pos);
+}
+void stop_sound(u32 soundBits, f32 *pos) {
+	sfx_player_stop(soundBits, pos);
+}
+void stop_sounds_from_source(f32 *pos) {
+	sfx_player_stop_from_source(pos);
+}
+void stop_sounds_in_continuous_banks() {
+	sfx_player_stop_banks(SFX_CONTINUOUS_BANKS);
+}
 bool cd_playing_audio = false;
 void play_music(u8 player, u16 seqArgs, u16 fadeTimer) {}
-void audio_backend_tick() {}
+void audio_backend_tick() {
+	sfx_player_tick();
+}
+
+SampleDef sfx_backend_find_sample(u32 bank, u32 instrument) {
+	return (SampleDef) {.spu_freq = 0x1000, .spu_addr = 4096 / 8};
+}
+void sfx_backend_set_voice(u32 voice, u16 spu_addr, u16 adsr1, u16 adsr2) {}
+void sfx_backend_set_pitch(u32 voice, u16 freq) {}
+void sfx_backend_set_volume(u32 voice, u16 vol_l, u16 vol_r) {}
+// the released voices go quiet right away, and the held ones never run out of sample
+u32 sfx_backend_silent_voices() {
+	return ~sounding_voices;
+}
+void sfx_backend_flush(u32 key_on, u32 key_off) {
+	sounding_voices = (sounding_voices | key_on) & ~key_off;
+}
 
 #endif
@@ -0,0 +1,88 @@
+#include <port/cd.h>
+#include <game/profiler.h>
+#include <assert.h>
+
+// queue of asynchronous reads, the actual reading is done by the platform backend one request at a time
+
+#define CD_QUEUE_LEN 16
+
+typedef struct {
+	void* out;
+	u32 pos;
+	u32 size;
+	CdReadCallback callback;
+	void* arg;
+	bool blocking;
+} CdQueuedRead;
+
+static CdQueuedRead queue[CD_QUEUE_LEN];
+static CdRequest next_request = 0; // handle that the next submitted read will get
+static CdRequest cur_request = 0; // every request before this one is finished
+static bool backend_reading = false;
+
+void cd_update() {
+	while(cur_request != next_request) {
+		CdQueuedRead* read = &queue[cur_request % CD_QUEUE_LEN];
+		if(!backend_reading) {
+			backend_reading = true;
+			cd_backend_begin_read(read->out, read->pos, read->size, read->blocking);
+		}
+		if(!cd_backend_read_done()) {
+			return;
+		}
+		backend_reading = false;
+		// the request is finished before running the callback, so that it can queue more reads
+		CdQueuedRead finished = *read;
+		cur_request++;
+		if(finished.callback) {
+			finished.callback(finished.out, finished.size, finished.arg);
+		}
+	}
+}
+
+static CdRequest submit(void* out, u32 pos, u32 size, CdReadCallback callback, void* arg, bool blocking) {
+	while(next_request - cur_request >= CD_QUEUE_LEN) {
+		cd_update();
+	}
+	queue[next_request % CD_QUEUE_LEN] = (CdQueuedRead) {
+		.out = out,
+		.pos = pos,
+		.size = size,
+		.callback = callback,
+		.arg = arg,
+		.blocking = blocking
+	};
+	CdRequest request = next_request++;
+	PROFILER_COUNT(PROFILER_COUNTER_CD_BYTES, size);
+	cd_update();
+	return request;
+}
+
+CdRequest cd_read_submit(void* out, u32 pos, u32 size, CdReadCallback callback, void* arg) {
+	return submit(out, pos, size, callback, arg, false);
+}
+
+bool cd_read_poll(CdRequest request) {
+	assert((s32) (next_request - request) > 0);
+	cd_update();
+	return (s32) (cur_request - request) > 0;
+}
+
+void cd_read_wait(CdRequest request) {
+	while(!cd_read_poll(request)) {}
+}
+
+void cd_read_wait_all() {
+	while(cur_request != next_request) {
+		cd_update();
+	}
+}
+
+bool cd_busy() {
+	return cur_request != next_request;
+}
+
+void cd_read(void* out, u32 pos, u32 size) {
+	PROFILER_SCOPE(PROFILER_ZONE_CD_READ, size);
+	cd_read_wait(submit(out, pos, size, NULL, NULL, true));
+}
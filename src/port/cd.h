@@ -3,4 +3,23 @@
 
 #define SECTOR_SIZE 2048
 
+// blocking read, waits for every queued read too
 void cd_read(void* out, u32 pos, u32 size);
+
+// asynchronous reads, completed in the order they were submitted while the game keeps running
+// callbacks are always run from cd_update/cd_read_poll/cd_read_wait, never from an interrupt
+// the sample bank uploads stream through this (see spu_mem_upload), the level and segment loads still go through cd_read
+typedef u32 CdRequest;
+typedef void (*CdReadCallback)(void* out, u32 size, void* arg);
+
+CdRequest cd_read_submit(void* out, u32 pos, u32 size, CdReadCallback callback, void* arg);
+bool cd_read_poll(CdRequest request);
+void cd_read_wait(CdRequest request);
+void cd_read_wait_all();
+bool cd_busy();
+void cd_update(); // starts queued reads and runs callbacks, called every frame
+
+// implemented per platform, only one read is ever in progress
+// blocking is set when the game is going to wait for the read, so a loading screen can be shown
+void cd_backend_begin_read(void* out, u32 pos, u32 size, bool blocking);
+bool cd_backend_read_done();
@@ -4,6 +4,8 @@
 #include <game/game_init.h>
 #include <game/camera.h>
 #include <game/print.h>
+#include <game/profiler.h>
+#include <port/cd.h>
 
 extern struct TextLabel* sTextLabels[52];
 extern s16 sTextLabelsCount;
@@ -31,8 +33,11 @@ void gfx_end_frame(bool vsync_30fps) {
 
 	gfx_modelview_identity();
 	showing_msg = NULL;
+	cd_update();
 	if(vsync_30fps) {
+		PROFILER_BEGIN(PROFILER_ZONE_AUDIO_TICK, 0);
 		audio_backend_tick();
+		PROFILER_END(PROFILER_ZONE_AUDIO_TICK);
 		gNumVblanks += 2;
 	}
 }
@@ -1,21 +1,11 @@
 #pragma once
 #include <PR/gbi.h>
 #include <types.h>
+#include "gfx_dl.h"
 
 #define XRES 320
 #define YRES 240
 
-typedef union __attribute__((aligned(4))) {
-	struct {
-		u8 r;
-		u8 g;
-		u8 b;
-		u8 _pad;
-	};
-	u8 elems[4];
-	u32 as_u32;
-} Color;
-
 // render distance in world space, anything farther will be clipped
 #define MAX_Z 8000 // for performance, should be equal to Z_BUCKETS multiplied by a power of two
 #define MAX_TESSELLATION_Z 1000
@@ -64,83 +54,36 @@ void gfx_modelview_pop();
 void gfx_modelview_mul(const ShortMatrix* mtx);
 ShortVec gfx_modelview_apply_without_translation(const ShortVec* v);
 ShortVec gfx_modelview_apply(const ShortVec* v);
+bool gfx_modelview_sphere_is_culled(const ShortVec* sphere, s32 multiplier);
 #define DECAL_Z_BIAS 2 // in ordering table indices, not world coordinates, so 2 is probably ideal
 
 // textures
 void gfx_load_texture(void* tex_ptr);
+void gfx_load_level_textures(s16 level);
+
+typedef struct {
+	u32 hits;
+	u32 misses;
+	u32 evictions;
+	u32 bytes_uploaded;
+} TexCacheStats;
+
+#ifdef TARGET_PSX
+extern TexCacheStats tex_cache_stats;
+extern TexCacheStats tex_cache_last_frame_stats;
+#endif
 
 // rsp compiler
 void gfx_reset_rsp_jit();
 bool gfx_compile_rsp(Gfx* cmd, bool nested);
 
-#define ALPHA_TRANSLUCENT 32
-#define ALPHA_OPAQUE 192
-
 // display list execution
 extern u32 debug_processed_poly_count;
-
-#ifdef TARGET_PC
-typedef u64 dl_t;
-#define DL_PACK_OP(op) ((dl_t) (op) << 56)
-#define DL_UNPACK_OP(cmd) ((dl_t) (cmd) >> 56)
-#define DL_PACK_PTR(ptr) ((dl_t) (ptr) & 0xFFFFFFFFFFFFFF)
-#define DL_UNPACK_PTR(cmd) ((void*) ((s64) ((cmd) << 8) >> 8))
-#else
-typedef u32 dl_t;
-#define DL_PACK_OP(op) ((dl_t) (op) << 24)
-#define DL_UNPACK_OP(cmd) ((dl_t) (cmd) >> 24)
-#define DL_PACK_PTR(ptr) ((dl_t) (ptr) & 0xFFFFFF)
-#define DL_UNPACK_PTR(cmd) ((void*) ((cmd) & 0xFFFFFF))
-#endif
+extern u32 debug_saved_vtx_transform_count; // vertex references served by the executor's per batch cache
 
 void gfx_reset_dl_exec();
 void gfx_run_compiled_dl(dl_t* dl);
 
-#define PRIM_FLAG_TEXTURED        0b00000001
-#define PRIM_FLAG_LIGHTED         0b00000010
-#define PRIM_FLAG_DECAL           0b00000100
-#define PRIM_FLAG_FORCE_BLEND     0b00001000
-#define PRIM_FLAG_ENV_COLOR       0b00010000
-//#define PRIM_FLAG_ENV_ALPHA ...
-#define PRIM_FLAG_TESSELLATE  0b01000000
-//#define PRIM_FLAG_TESSELLATE_HIGH 0b10000000
-
-enum {
-	_DL_CMD_ENUM_START = (u8) G_NOOP + 1,
-	DL_CMD_JUMP = _DL_CMD_ENUM_START,
-	DL_CMD_CALL,
-	DL_CMD_END,
-	DL_CMD_TEX,
-	DL_CMD_VTX,
-	DL_CMD_TRI,
-	DL_CMD_QUAD,
-	DL_CMD_ENV_COLOR_ALPHA_0,
-	DL_CMD_ENV_COLOR_ALPHA_HALF,
-	DL_CMD_ENV_COLOR_ALPHA_RESERVED,
-	DL_CMD_ENV_COLOR_ALPHA_FULL,
-	DL_CMD_LIGHT_AMBIENT,
-	DL_CMD_LIGHT_DIRECTIONAL0,
-	DL_CMD_LIGHT_DIRECTIONAL1,
-	DL_CMD_MTX_SET,
-	DL_CMD_MULTIPLIER,
-	DL_CMD_SET_BACKGROUND,
-	DL_CMD_SET_ORTHO,
-	DL_CMD_SPRITE,
-	DL_CMD_CIRCLE_SHADOW,
-	// the commands below are less common and are split off so that the loop can fit in icache
-	_DL_CMD_ENUM_FIRST_EXTRA,
-	DL_CMD_MTX_MUL = _DL_CMD_ENUM_FIRST_EXTRA,
-	DL_CMD_MTX_PUSH,
-	DL_CMD_MTX_POP,
-	DL_CMD_MTX_N64_SET,
-	DL_CMD_MTX_N64_MUL,
-	DL_CMD_SQUARE_SHADOW,
-	_DL_CMD_ENUM_POST_END,
-	_DL_CMD_ENUM_END = _DL_CMD_ENUM_POST_END - 1,
-	_DL_CMD_ENUM_COUNT = _DL_CMD_ENUM_POST_END - _DL_CMD_ENUM_START
-};
-STATIC_ASSERT(_DL_CMD_ENUM_END < (u8) G_TEXRECT, "too many commands");
-
 // global display list
 void gfx_init_global_dl();
 void gfx_flush_global_dl();
@@ -167,3 +110,15 @@ void gfx_emit_mtx_pop();
 void gfx_emit_set_background(bool is_background);
 void gfx_emit_set_ortho(bool is_ortho);
 void gfx_emit_shadow(bool is_square, s16 radius, u8 opacity);
+
+// camera facing quads drawn with the current texture and modelview, for envfx's snow and bubbles
+// the positions are split in x, y and z arrays that the executor feeds to the gte three at a time
+typedef struct {
+	u16 count;
+	s16 half_size; // of each quad, in modelview units
+	s16 lift; // moves each quad up on screen by this many modelview units
+	s16 pos[]; // count x coordinates, then the y ones, then the z ones
+} ParticleBatch;
+
+// the batch is allocated with the frame's display list and read when it's executed, fill it before the flush
+ParticleBatch* gfx_emit_particles(u32 count, s16 half_size, s16 lift);
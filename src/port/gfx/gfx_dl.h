@@ -0,0 +1,145 @@
+#pragma once
+#include <PR/gbi.h>
+#include <stdbool.h>
+
+// the compiled display list format and what the rsp compiler reads to produce it
+// this is also built for the host by tools/precompile_dl.c, so it can only depend on gbi.h
+
+typedef union __attribute__((aligned(4))) {
+	struct {
+		u8 r;
+		u8 g;
+		u8 b;
+		u8 _pad;
+	};
+	u8 elems[4];
+	u32 as_u32;
+} Color;
+
+#define ALPHA_TRANSLUCENT 32
+#define ALPHA_OPAQUE 192
+
+#ifdef TARGET_PC
+typedef u64 dl_t;
+#define DL_PACK_OP(op) ((dl_t) (op) << 56)
+#define DL_UNPACK_OP(cmd) ((dl_t) (cmd) >> 56)
+#define DL_PACK_PTR(ptr) ((dl_t) (ptr) & 0xFFFFFFFFFFFFFF)
+#define DL_UNPACK_PTR(cmd) ((void*) ((s64) ((cmd) << 8) >> 8))
+#else
+typedef u32 dl_t;
+#define DL_PACK_OP(op) ((dl_t) (op) << 24)
+#define DL_UNPACK_OP(cmd) ((dl_t) (cmd) >> 24)
+#define DL_PACK_PTR(ptr) ((dl_t) (ptr) & 0xFFFFFF)
+#define DL_UNPACK_PTR(cmd) ((void*) ((cmd) & 0xFFFFFF))
+#endif
+
+#define PRIM_FLAG_TEXTURED        0b00000001
+#define PRIM_FLAG_LIGHTED         0b00000010
+#define PRIM_FLAG_DECAL           0b00000100
+#define PRIM_FLAG_FORCE_BLEND     0b00001000
+#define PRIM_FLAG_ENV_COLOR       0b00010000
+//#define PRIM_FLAG_ENV_ALPHA ...
+#define PRIM_FLAG_TESSELLATE  0b01000000
+//#define PRIM_FLAG_TESSELLATE_HIGH 0b10000000
+
+enum {
+	_DL_CMD_ENUM_START = (u8) G_NOOP + 1,
+	DL_CMD_JUMP = _DL_CMD_ENUM_START,
+	DL_CMD_CALL,
+	DL_CMD_END,
+	DL_CMD_TEX,
+	DL_CMD_VTX,
+	DL_CMD_TRI,
+	DL_CMD_QUAD,
+	DL_CMD_ENV_COLOR_ALPHA_0,
+	DL_CMD_ENV_COLOR_ALPHA_HALF,
+	DL_CMD_ENV_COLOR_ALPHA_RESERVED,
+	DL_CMD_ENV_COLOR_ALPHA_FULL,
+	DL_CMD_LIGHT_AMBIENT,
+	DL_CMD_LIGHT_DIRECTIONAL0,
+	DL_CMD_LIGHT_DIRECTIONAL1,
+	DL_CMD_MTX_SET,
+	DL_CMD_MULTIPLIER,
+	DL_CMD_SET_BACKGROUND,
+	DL_CMD_SET_ORTHO,
+	DL_CMD_SPRITE,
+	DL_CMD_CIRCLE_SHADOW,
+	// the commands below are less common and are split off so that the loop can fit in icache
+	_DL_CMD_ENUM_FIRST_EXTRA,
+	DL_CMD_MTX_MUL = _DL_CMD_ENUM_FIRST_EXTRA,
+	DL_CMD_MTX_PUSH,
+	DL_CMD_MTX_POP,
+	DL_CMD_MTX_N64_SET,
+	DL_CMD_MTX_N64_MUL,
+	DL_CMD_SQUARE_SHADOW,
+	DL_CMD_CULL,
+	DL_CMD_PARTICLES,
+	_DL_CMD_ENUM_POST_END,
+	_DL_CMD_ENUM_END = _DL_CMD_ENUM_POST_END - 1,
+	_DL_CMD_ENUM_COUNT = _DL_CMD_ENUM_POST_END - _DL_CMD_ENUM_START
+};
+_Static_assert(_DL_CMD_ENUM_END < (u8) G_TEXRECT, "too many commands");
+
+// header of the display lists compiled at build time by tools/precompile_dl.c, never seen by the executor
+#define DL_CMD_PRECOMPILED _DL_CMD_ENUM_POST_END
+_Static_assert(DL_CMD_PRECOMPILED < (u8) G_TEXRECT, "the precompiled header must not collide with the gbi opcodes");
+
+typedef struct {
+	u16 width;
+	u16 height;
+	bool rotated;
+	bool has_translucency;
+	u8 offx;
+	u8 offy;
+#ifdef TARGET_PC
+	[[gnu::packed]] u64 sdl_tex_ptr;
+#else
+	u16 page_attr;
+	u16 clut_attr;
+	u32 window_cmd;
+#endif
+	u16 pixel_data_sector;
+	u16 pixel_data_sector_count;
+	u32 cache_slot; // index into tex_slots once loaded on psx, ATLAS_CACHE_SLOT if prebaked into the level's atlas
+} TexHeader;
+
+_Static_assert(sizeof(TexHeader) == 24, "TexHeader must match the layout output by convertImage.py and pack_textures.py");
+
+typedef struct __attribute__((aligned(4))) {
+	union {
+		struct {
+			s16 x;
+			s16 y;
+		};
+		s32 xy;
+	};
+	union {
+		u32 zuv;
+		struct {
+			s16 z;
+			union {
+				struct {
+					u8 u;
+					u8 v;
+				};
+				u16 uv;
+				u8 uv_arr[2];
+			};
+		};
+	};
+	Color color; // also used for normals
+} GfxVtx;
+
+_Static_assert(sizeof(GfxVtx) + 4 <= sizeof(Vtx), "GfxVtx must be at least 4 bytes smaller than Vtx");
+
+typedef union {
+	struct {
+		u32 tag;
+		GfxVtx psx[];
+	};
+	struct {
+		Vtx n64[0]; // zero length rather than flexible, older host compilers refuse a struct with only a flexible member
+	};
+} VtxList;
+
+#define COMPILED_TAG 0x777A1210 // MARIO :)
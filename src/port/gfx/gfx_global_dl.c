@@ -2,10 +2,12 @@
 #include "port/gfx/gfx.h"
 #include <port/psx/scratchpad_call.h>
 #include <game/game_init.h>
+#include <game/profiler.h>
 #include <assert.h>
 
 #if defined(TARGET_PSX) && !defined(NO_KERNEL_RAM)
-#define GLOBAL_DL_BUFFER_START ((void*) 16)
+// skips the exception vector at 0x80 (see irq_psx.s)
+#define GLOBAL_DL_BUFFER_START ((void*) 256)
 #define GLOBAL_DL_BUFFER_END ((void*) (65536 - TESSELLATION_QUEUE_SIZE_BYTES))
 #else
 #ifdef TARGET_PSX
@@ -19,6 +21,51 @@ static dl_t global_dl_buf[16384];
 scratchpad static dl_t* global_dl;
 static dl_t* global_dl_right;
 
+#ifdef TARGET_PSX
+// the compiled lists whose textures were already made resident since the last flush, a list that doesn't fit is just walked again
+typedef struct {
+	const dl_t* dl;
+	u32 flush_count;
+} TouchedDl;
+
+#define TOUCHED_DL_CACHE_SIZE 64
+static TouchedDl touched_dls[TOUCHED_DL_CACHE_SIZE];
+static u32 flush_count = 1;
+
+// the executor runs with its stack in the scratchpad and can't load textures, so every texture a called list
+// switches to is loaded here and marked as used this frame, which keeps alloc_slot from evicting it before the flush
+static void load_compiled_dl_textures(const dl_t* dl) {
+	TouchedDl* touched = &touched_dls[(uintptr_t) dl / sizeof(dl_t) % TOUCHED_DL_CACHE_SIZE];
+	if(touched->dl == dl && touched->flush_count == flush_count) {
+		return;
+	}
+	touched->dl = dl;
+	touched->flush_count = flush_count;
+	while(true) {
+		dl_t cmd = *(dl++);
+		switch(DL_UNPACK_OP(cmd)) {
+			case DL_CMD_END: {
+				return;
+			}
+			case DL_CMD_JUMP: {
+				dl = DL_UNPACK_PTR(cmd);
+				break;
+			}
+			case DL_CMD_CALL: {
+				load_compiled_dl_textures(DL_UNPACK_PTR(cmd));
+				break;
+			}
+			case DL_CMD_TEX: {
+				if(DL_UNPACK_PTR(cmd)) {
+					gfx_load_texture(DL_UNPACK_PTR(cmd));
+				}
+				break;
+			}
+		}
+	}
+}
+#endif
+
 void gfx_init_global_dl() {
 	global_dl = GLOBAL_DL_BUFFER_START;
 	global_dl_right = GLOBAL_DL_BUFFER_END;
@@ -28,7 +75,13 @@ void gfx_flush_global_dl() {
 	if(global_dl != GLOBAL_DL_BUFFER_START) {
 		*(global_dl++) = DL_PACK_OP(DL_CMD_END);
 		gfx_init_global_dl();
+#ifdef TARGET_PSX
+		flush_count++; // the lists in the global dl get overwritten
+#endif
+		// timed out here, gfx_run_compiled_dl runs with its stack in the scratchpad
+		PROFILER_BEGIN(PROFILER_ZONE_RUN_DL, 0);
 		scratchpad_call(gfx_run_compiled_dl, global_dl);
+		PROFILER_END(PROFILER_ZONE_RUN_DL);
 	}
 }
 
@@ -45,6 +98,9 @@ void* alloc_display_list(u32 size) { // get rid of this one when the converted d
 
 void gfx_emit_call(void* target) {
 	if(gfx_compile_rsp(target, false)) {
+#ifdef TARGET_PSX
+		load_compiled_dl_textures(target);
+#endif
 		*(global_dl++) = DL_PACK_OP(DL_CMD_CALL) | DL_PACK_PTR(target);
 	}
 	assert((uintptr_t) global_dl_right > (uintptr_t) global_dl);
@@ -193,3 +249,13 @@ void gfx_emit_set_ortho(bool is_ortho) {
 void gfx_emit_shadow(bool is_square, s16 radius, u8 opacity) {
 	*(global_dl++) = (is_square? DL_PACK_OP(DL_CMD_SQUARE_SHADOW): DL_PACK_OP(DL_CMD_CIRCLE_SHADOW)) | (u32) opacity << 16 | (u32) (u16) radius;
 }
+
+ParticleBatch* gfx_emit_particles(u32 count, s16 half_size, s16 lift) {
+	ParticleBatch* batch = gfx_alloc_in_global_dl(sizeof(ParticleBatch) + count * 3 * sizeof(s16));
+	batch->count = count;
+	batch->half_size = half_size;
+	batch->lift = lift;
+	*(global_dl++) = DL_PACK_OP(DL_CMD_PARTICLES) | DL_PACK_PTR(batch);
+	assert((uintptr_t) global_dl_right > (uintptr_t) global_dl);
+	return batch;
+}
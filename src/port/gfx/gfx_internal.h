@@ -1,25 +1,26 @@
 #pragma once
 #include "gfx.h"
 
+#ifdef TARGET_PSX
+#define ATLAS_CACHE_SLOT 0xFFFF // must match pack_textures.py
+
 typedef struct {
-	u16 width;
-	u16 height;
-	bool rotated;
-	bool has_translucency;
-	u8 offx;
-	u8 offy;
-#ifdef TARGET_PC
-	[[gnu::packed]] u64 sdl_tex_ptr;
-#else
-	u16 page_attr;
-	u16 clut_attr;
-	u32 window_cmd;
-#endif
-	u16 pixel_data_sector;
-	u16 pixel_data_sector_count;
-} TexHeader;
+	TexHeader* owner; // only compared against, it may point to a header that's been unloaded since
+	u32 last_used_frame;
+	u16 next_free;
+} TexSlot;
+
+extern TexSlot tex_slots[];
+extern u32 tex_cache_frame;
 
-STATIC_ASSERT(sizeof(TexHeader) == 20, "TexHeader must match the layout output by convertImage.py and pack_textures.py");
+void gfx_reset_texture_cache();
+void gfx_texture_cache_end_frame();
+
+// the textures are all loaded while the global dl is built (see gfx_emit_tex and gfx_emit_call), the executor only checks
+static inline bool gfx_texture_is_resident(const TexHeader* tex) {
+	return tex->cache_slot == ATLAS_CACHE_SLOT || tex_slots[tex->cache_slot].owner == tex;
+}
+#endif
 
 #define Z_BUCKETS 2000 // for performance, should be equal to MAX_Z divided by a power of two
 #define FOREGROUND_BUCKETS 32
@@ -48,47 +49,8 @@ Packet gfx_packet_begin();
 void gfx_packet_append(Packet* packet, u32 cmd);
 void gfx_packet_end(Packet packet, u32 ot_z);
 
-typedef ALIGNED4 struct {
-	union {
-		struct {
-			s16 x;
-			s16 y;
-		};
-		s32 xy;
-	};
-	union {
-		u32 zuv;
-		struct {
-			s16 z;
-			union {
-				struct {
-					u8 u;
-					u8 v;
-				};
-				u16 uv;
-				u8 uv_arr[2];
-			};
-		};
-	};
-	Color color; // also used for normals
-} GfxVtx;
-
-STATIC_ASSERT(sizeof(GfxVtx) + 4 <= sizeof(Vtx), "GfxVtx must be at least 4 bytes smaller than Vtx");
-
-typedef union {
-	struct {
-		u32 tag;
-		GfxVtx psx[];
-	};
-	struct {
-		Vtx n64[];
-	};
-} VtxList;
-
 void ensure_vertices_converted(VtxList* vtx_list, u32 count);
 
-#define COMPILED_TAG 0x777A1210 // MARIO :)
-
 void gfx_begin_queueing_for_tessellation(const GfxVtx* v0, const GfxVtx* v1, const GfxVtx* v2, const GfxVtx* v3, u8 flags);
 void gfx_finish_queueing_for_tessellation(u32 rgb0, u32 rgb1, u32 rgb2, u32 rgb3);
 
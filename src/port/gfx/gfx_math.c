@@ -170,3 +170,22 @@ void gfx_modelview_scale_byq(q32 scale) {
 	};
 	gfx_modelview_mul(&scratch_mtx);
 }
+
+// sphere is {x, y, z, radius} in model space, as referenced by DL_CMD_CULL
+bool gfx_modelview_sphere_is_culled(const ShortVec* sphere, s32 multiplier) {
+	ShortVec center = gfx_modelview_apply(sphere);
+	ShortVec radius_vec = gfx_modelview_apply_without_translation(&(ShortVec) {.vx = sphere->_pad});
+	// the manhattan length is never smaller than the actual radius, so this stays conservative with scaling
+	s32 radius = (radius_vec.vx < 0? -radius_vec.vx: radius_vec.vx)
+		+ (radius_vec.vy < 0? -radius_vec.vy: radius_vec.vy)
+		+ (radius_vec.vz < 0? -radius_vec.vz: radius_vec.vz);
+	s32 z = center.vz;
+	if(z + radius <= 0 || z - radius >= MAX_Z) {
+		return true;
+	}
+	// signed distances to the side planes, scaled by at most multiplier + half the resolution
+	s32 x = center.vx < 0? -center.vx: center.vx;
+	s32 y = center.vy < 0? -center.vy: center.vy;
+	return x * multiplier - z * (XRES / 2) > radius * (multiplier + XRES / 2)
+		|| y * multiplier - z * (YRES / 2) > radius * (multiplier + YRES / 2);
+}
@@ -0,0 +1,374 @@
+// the rsp display list compiler, shared by gfx_rsp_jit.c at runtime and tools/precompile_dl.c at build time
+// the includer reads the source list and writes the output through these, defined before including this file:
+//   RspCmd, rsp_w0(cmd), rsp_w1(cmd), rsp_next_cmd(cmd): the source commands
+//   RspOutput, rsp_emit(out, word), rsp_emit_ptr(out, op, segmented, ptr), rsp_output_is_empty(out): the compiled list
+//   rsp_resolve(segmented, size): the pointer to a segmented range, NULL if it can't be resolved
+//   rsp_in_own_segment(segmented): whether the pointer is in the segment of the list being compiled
+//   rsp_load_texture(tex): called for each texture the list uses
+//   rsp_compile_nested(segmented, ptr): compiles a called list, returns one of the RSP_COMPILE_* values
+//   RSP_REQUIRE(cond): what to do when something can't be compiled, the runtime asserts and the tool gives up on the list
+//   compile_as_ortho
+
+#include <stddef.h>
+
+enum {
+	RSP_COMPILE_EMPTY,
+	RSP_COMPILE_USEFUL,
+	RSP_COMPILE_FAILED, // only returned by the build time compiler
+};
+
+static int texture_scale_x, texture_scale_y;
+static bool use_env_color = false;
+static bool use_env_alpha = false;
+static bool use_color = false;
+static bool use_texture = false;
+static u32 geometry_mode = 0;
+static u32 other_mode_l = 0;
+static u32 num_lights = 2; // includes ambient light
+static TexHeader* compilation_tex_header = NULL;
+static VtxList* compilation_vertices = NULL;
+static bool compilation_clamp = false;
+
+void gfx_reset_rsp_jit() {
+	texture_scale_x = 1 << 21;
+	texture_scale_y = 1 << 21;
+	use_env_color = false;
+	use_env_alpha = false;
+	use_color = false;
+	use_texture = false;
+	geometry_mode = G_LIGHTING;
+	other_mode_l = 0;
+	num_lights = 2;
+	compilation_tex_header = NULL;
+	compilation_vertices = NULL;
+	compilation_clamp = false;
+}
+
+static int clamp(int x, int a, int b) {
+	return x < a? a: (x > b? b: x);
+}
+
+void ensure_vertices_converted(VtxList* list, u32 count) {
+	TexHeader* tex = compilation_tex_header;
+	if(list->tag != COMPILED_TAG) {
+		for(u32 i = 0; i < count; i++) {
+			Vtx* n64 = &list->n64[i];
+			s16 x = n64->v.ob[0];
+			s16 y = n64->v.ob[1];
+			s16 z = n64->v.ob[2];
+			s32 u = (s32) n64->v.tc[(tex && tex->rotated)? 1: 0] * (texture_scale_x >> 8) >> (21 - 8);
+			s32 v = (s32) n64->v.tc[(tex && tex->rotated)? 0: 1] * (texture_scale_y >> 8) >> (21 - 8);
+			if(tex) {
+				if(compilation_clamp) {
+					u = clamp(u, 0, tex->width);
+					v = clamp(v, 0, tex->height);
+				} else {
+					if(tex->width <= 32) {
+						u = clamp(u + 128, 0, 255);
+					} else if(tex->width <= 64) {
+						u = clamp(u + 64, 0, 255);
+					}
+					if(tex->height <= 32) {
+						v = clamp(v + 128, 0, 255);
+					} else if(tex->height <= 64) {
+						v = clamp(v + 64, 0, 255);
+					}
+				}
+			}
+			Color color = (Color) {.r = n64->v.cn[0], .g = n64->v.cn[1], .b = n64->v.cn[2], ._pad = 0};
+
+			GfxVtx* psx = &list->psx[i];
+			psx->x = x;
+			psx->y = y;
+			psx->z = z;
+			psx->u = u;
+			psx->v = v;
+			psx->color = color;
+		}
+		list->tag = COMPILED_TAG;
+	}
+}
+
+static int min3(int x, int y, int z) {
+	if(y < x) {
+		x = y;
+	}
+	return z < x? z: x;
+}
+
+static int max3(int x, int y, int z) {
+	if(y > x) {
+		x = y;
+	}
+	return z > x? z: x;
+}
+
+static int rsp_compile_commands(RspCmd cmd, RspOutput* out) {
+	while(true) {
+		uintptr_t w0 = rsp_w0(cmd);
+		uintptr_t w1 = rsp_w1(cmd); // a real pointer on pc
+		u8 opcode = w0 >> 24;
+		// those G_* constants HAVE to be cast to u8, because they are defined in a weird way. don't remove the casts
+		switch(opcode) {
+			case (u8) G_VTX: {
+				u8 count = (w0 & 0xFFFF) / sizeof(Vtx);
+				VtxList* vtx_list = rsp_resolve(w1, count * sizeof(Vtx));
+				RSP_REQUIRE(vtx_list && rsp_in_own_segment(w1));
+				RSP_REQUIRE((w0 >> 16 & 0xF) == 0);
+				RSP_REQUIRE(count <= 16);
+				ensure_vertices_converted(vtx_list, count);
+				compilation_vertices = vtx_list;
+				rsp_emit_ptr(out, DL_CMD_VTX, w1 + offsetof(VtxList, psx), vtx_list->psx);
+				break;
+			}
+			case (u8) G_TRI1: {
+				u32 i0 = (w1 >> 16 & 0xFF) / 10;
+				u32 i1 = (w1 >> 8 & 0xFF) / 10;
+				u32 i2 = (w1 & 0xFF) / 10;
+				goto process_poly_cmd;
+			case (u8) G_PORT_QUAD:
+				i0 = w1 >> 24 & 0xF;
+				i1 = w1 >> 16 & 0xF;
+				i2 = w1 >> 8 & 0xF;
+				u32 i3 = w1 & 0xF;
+				GfxVtx* v3 = &compilation_vertices->psx[i3];
+				goto process_poly_cmd;
+			case (u8) G_PORT_TRI2:
+				i0 = w0 >> 16 & 0xF;
+				i1 = w0 >> 8 & 0xF;
+				i2 = w0 & 0xF;
+			process_poly_cmd:
+				RSP_REQUIRE(compilation_vertices);
+				GfxVtx* v0 = &compilation_vertices->psx[i0];
+				GfxVtx* v1 = &compilation_vertices->psx[i1];
+				GfxVtx* v2 = &compilation_vertices->psx[i2];
+				u32 flags = 0;
+				if(use_texture && compilation_tex_header) flags |= PRIM_FLAG_TEXTURED;
+				if(use_env_color) flags |= PRIM_FLAG_ENV_COLOR;
+#ifdef PRIM_FLAG_ENV_ALPHA
+				if(use_env_alpha) flags |= PRIM_FLAG_ENV_ALPHA;
+#endif
+				if(!compile_as_ortho) {
+					if(geometry_mode & G_LIGHTING) {
+						flags |= PRIM_FLAG_LIGHTED;
+					}
+					if((other_mode_l & ZMODE_DEC) == ZMODE_DEC) {
+						flags |= PRIM_FLAG_DECAL;
+					} else if(use_texture && compilation_tex_header) {
+						s32 min_x = min3(v0->x, v1->x, v2->x);
+						s32 min_y = min3(v0->y, v1->y, v2->y);
+						s32 min_z = min3(v0->z, v1->z, v2->z);
+						s32 max_x = max3(v0->x, v1->x, v2->x);
+						s32 max_y = max3(v0->y, v1->y, v2->y);
+						s32 max_z = max3(v0->z, v1->z, v2->z);
+						if(opcode == (u8) G_PORT_QUAD) {
+							if(v3->x < min_x) {
+								min_x = v3->x;
+							} else if(v3->x > max_x) {
+								max_x = v3->x;
+							}
+							if(v3->y < min_y) {
+								min_y = v3->y;
+							} else if(v3->y > max_y) {
+								max_y = v3->y;
+							}
+							if(v3->z < min_z) {
+								min_z = v3->z;
+							} else if(v3->z > max_z) {
+								max_z = v3->z;
+							}
+						}
+						u32 width = max_x - min_x;
+						u32 height = max_y - min_y;
+						u32 depth = max_z - min_z;
+						// same as sqrtu(size_sq) > 256, without depending on the runtime's sqrt table
+						u32 size_sq = width * width + height * height + depth * depth;
+						if(size_sq >= 257 * 257) {
+							flags |= PRIM_FLAG_TESSELLATE;//_LOW;
+							//if(size_sq >= 1025 * 1025) {
+							//	flags |= PRIM_FLAG_TESSELLATE_HIGH;
+							//}
+						}
+					}
+				}
+				if(opcode == (u8) G_PORT_QUAD) {
+					rsp_emit(out, DL_PACK_OP(DL_CMD_QUAD) | i0 << 20 | i1 << 16 | i2 << 12 | i3 << 8 | flags);
+				} else if(opcode == (u8) G_PORT_TRI2) {
+					u32 t1i0 = w1 >> 24 & 0xFF;
+					u32 t1i1 = w1 >> 16 & 0xFF;
+					u32 t1i2 = w1 >> 8 & 0xFF;
+					rsp_emit(out, DL_PACK_OP(DL_CMD_TRI) | i0 << 20 | i1 << 16 | i2 << 12 | flags);
+					rsp_emit(out, DL_PACK_OP(DL_CMD_TRI) | t1i0 << 20 | t1i1 << 16 | t1i2 << 12 | flags);
+				} else {
+					rsp_emit(out, DL_PACK_OP(DL_CMD_TRI) | i0 << 20 | i1 << 16 | i2 << 12 | flags);
+				}
+				break;
+			}
+			case (u8) G_MTX: {
+				u8 params = (w0 >> 16) & 0xFF;
+				if(params & G_MTX_PROJECTION) {
+					// we don't need a projection matrix! yep playstation is a rebel like that
+				} else {
+					// mess with modelview matrix
+					s32* addr = rsp_resolve(w1, sizeof(Mtx));
+					RSP_REQUIRE(addr);
+					if(params & G_MTX_PUSH) {
+						rsp_emit(out, DL_PACK_OP(DL_CMD_MTX_PUSH));
+					}
+					if(params & G_MTX_LOAD) {
+						rsp_emit_ptr(out, DL_CMD_MTX_N64_SET, w1, addr);
+					} else {
+						rsp_emit_ptr(out, DL_CMD_MTX_N64_MUL, w1, addr);
+					}
+				}
+				break;
+			}
+			case (u8) G_POPMTX: {
+				rsp_emit(out, DL_PACK_OP(DL_CMD_MTX_POP));
+				break;
+			}
+			case (u8) G_MOVEWORD: {
+				u8 index = (w0 >> 16) & 0xFF;
+				switch(index) {
+					case G_MW_NUMLIGHT: {
+						num_lights = (u32) (w1 - 0x80000000) / 32;
+						break;
+					}
+				}
+				break;
+			}
+			case (u8) G_MOVEMEM: {
+				u8 index = (w0 >> 16) & 0xFF;
+				switch(index) {
+					case G_MV_L0: case G_MV_L1: case G_MV_L2: {
+						const Light_t* n64light = rsp_resolve(w1, sizeof(Light_t));
+						RSP_REQUIRE(n64light);
+						switch(num_lights - 1 - (index - G_MV_L0) / 2) {
+							case 0: {
+								rsp_emit(out, DL_PACK_OP(DL_CMD_LIGHT_AMBIENT) | (u32) n64light->col[2] << 16 | (u32) n64light->col[1] << 8 | (u32) n64light->col[0]);
+								break;
+							}
+							case 1: {
+								rsp_emit_ptr(out, DL_CMD_LIGHT_DIRECTIONAL0, w1, n64light);
+								break;
+							}
+							case 2: {
+								rsp_emit_ptr(out, DL_CMD_LIGHT_DIRECTIONAL1, w1, n64light);
+								break;
+							}
+						}
+						break;
+					}
+				}
+				break;
+			}
+			case (u8) G_TEXTURE: {
+				texture_scale_x = w1 >> 16 & 0xFFFF;
+				texture_scale_y = w1 & 0xFFFF;
+				break;
+			}
+			case (u8) G_SETGEOMETRYMODE: {
+				geometry_mode |= w1;
+				break;
+			}
+			case (u8) G_CLEARGEOMETRYMODE: {
+				geometry_mode &= ~w1;
+				break;
+			}
+			case (u8) G_SETOTHERMODE_L: {
+				const u8 bits = (w0 & 0xFF) + 1;
+				const u8 shift = 32 - (w0 >> 8 & 0xFF) - bits;
+				const u32 mask = ((1 << bits) - 1) << shift;
+				other_mode_l = (other_mode_l & ~mask) | (w1 & mask);
+				break;
+			}
+			case (u8) G_SETENVCOLOR: {
+				u32 rgb = w1 >> 8;
+				u8 alpha = w1;
+				if(alpha >= ALPHA_OPAQUE) {
+					rsp_emit(out, DL_PACK_OP(DL_CMD_ENV_COLOR_ALPHA_FULL) | rgb);
+				} else if(alpha >= ALPHA_TRANSLUCENT) {
+					rsp_emit(out, DL_PACK_OP(DL_CMD_ENV_COLOR_ALPHA_HALF) | rgb);
+				} else {
+					rsp_emit(out, DL_PACK_OP(DL_CMD_ENV_COLOR_ALPHA_0) | rgb);
+				}
+				break;
+			}
+			case (u8) G_TEXRECT: {
+				u32 x0 = (w1 >> 12 & 0xFFF) / 4;
+				u32 y0 = (w1 >> 0 & 0xFFF) / 4;
+				rsp_emit(out, DL_PACK_OP(DL_CMD_SPRITE) | (y0 & 0xFFF) << 12 | (x0 & 0xFFF));
+				break;
+			}
+			case (u8) G_SETCOMBINE: {
+				u8 a_color_src = w0 >> 20 & 0x0F;
+				u8 b_color_src = w1 >> 28 & 0x0F;
+				u8 c_color_src = w0 >> 15 & 0x1F;
+				u8 d_color_src = w1 >> 15 & 0x07;
+				u8 c_alpha_src = w0 >> 9 & 0x07;
+				u8 d_alpha_src = w1 >> 9 & 0x07;
+				use_env_color = c_color_src == G_CCMUX_ENVIRONMENT || d_color_src == G_CCMUX_ENVIRONMENT;
+				use_env_alpha = c_alpha_src == G_CCMUX_ENVIRONMENT || d_alpha_src == G_CCMUX_ENVIRONMENT;
+				//assert(use_env_color == use_env_alpha);
+				use_color = !use_env_color && (a_color_src == G_CCMUX_SHADE || b_color_src == G_CCMUX_SHADE || c_color_src == G_CCMUX_SHADE || d_color_src == G_CCMUX_SHADE);
+				use_texture = a_color_src == G_CCMUX_TEXEL0 || b_color_src == G_CCMUX_TEXEL0 || c_color_src == G_CCMUX_TEXEL0 || d_color_src == G_CCMUX_TEXEL0;
+				if(b_color_src == d_color_src) {
+					other_mode_l |= ZMODE_DEC;
+					// according to the DSi port this hides the overlay on the mario head since we can't do the blending it expects
+					// but can we? can't test that yet, so this is for later
+					if(a_color_src == G_CCMUX_PRIMITIVE) {
+						use_texture = false;
+						use_env_color = true;
+						use_env_alpha = true;
+					}
+				} else {
+					other_mode_l &= ~ZMODE_DEC;
+				}
+				break;
+			}
+			case (u8) G_SETTILE: {
+				compilation_clamp = w1 & (G_TX_CLAMP << 18);
+				break;
+			}
+			case (u8) G_SETTIMG: {
+				compilation_tex_header = rsp_resolve(w1, sizeof(TexHeader));
+				RSP_REQUIRE(compilation_tex_header);
+				rsp_load_texture(compilation_tex_header);
+				rsp_emit_ptr(out, DL_CMD_TEX, w1, compilation_tex_header);
+				break;
+			}
+			case (u8) G_PORT_CULL: {
+				void* sphere = rsp_resolve(w1, 8); // a ShortVec
+				RSP_REQUIRE(sphere && rsp_in_own_segment(w1));
+				rsp_emit_ptr(out, DL_CMD_CULL, w1, sphere);
+				break;
+			}
+			case (u8) G_DL: {
+				void* target = rsp_resolve(w1, 8);
+				RSP_REQUIRE(target);
+				int target_result = rsp_compile_nested(w1, target);
+				RSP_REQUIRE(target_result != RSP_COMPILE_FAILED);
+				if(w0 & (1 << 16)) { // jump/tail call
+					if(target_result == RSP_COMPILE_USEFUL) {
+						rsp_emit_ptr(out, DL_CMD_JUMP, w1, target);
+						return RSP_COMPILE_USEFUL;
+					} else {
+						goto end;
+					}
+				} else { // call and continue
+					if(target_result == RSP_COMPILE_USEFUL) {
+						rsp_emit_ptr(out, DL_CMD_CALL, w1, target);
+					}
+				}
+				break;
+			}
+			case (u8) G_ENDDL: {
+			end:
+				bool was_useful = !rsp_output_is_empty(out);
+				rsp_emit(out, DL_PACK_OP(DL_CMD_END));
+				return was_useful? RSP_COMPILE_USEFUL: RSP_COMPILE_EMPTY;
+			}
+		}
+		cmd = rsp_next_cmd(cmd);
+	}
+}
@@ -0,0 +1,302 @@
+#include <port/pc/bench_pc.h>
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <macros.h>
+#include <object_constants.h>
+#include <sm64.h>
+#include <sounds.h>
+#include <audio/external.h>
+#include <engine/behavior_script.h>
+#include <game/area.h>
+#include <game/game_init.h>
+#include <game/level_update.h>
+#include <game/memory.h>
+#include <game/object_collision.h>
+#include <game/object_list_processor.h>
+#include <game/profiler.h>
+#include <game/rendering_graph_node.h>
+#include <port/gfx/gfx.h>
+#include <port/sfx_player.h>
+
+bool bench_headless = false;
+static struct DemoInput* demo = NULL; // starts with the level id, inputs follow
+static u32 max_frames = 0; // 0 runs until the demo ends
+static const char* out_path = "bench.csv";
+static FILE* out_file = NULL;
+static FILE* collision_file = NULL;
+static bool demo_started = false;
+static u32 frame = 0;
+static u32 behavior_iterations = 0; // 0 doesn't time the behavior interpreter
+static u32 object_iterations = 0; // 0 doesn't time reading the objects' hot fields
+static u32 pose_iterations = 0; // 0 doesn't time decoding the animated objects' poses
+static u32 sfx_frames = 0; // 0 doesn't time the sound effect player
+static u64 last_frame_ns = 0;
+
+extern bool close_requested;
+extern struct AllocOnlyPool* sLevelPool;
+extern void* main_pool_start_addr;
+extern void* main_pool_end_addr;
+extern s16 gCurrentFrameIndex1;
+extern struct ProfilerFrameData gProfilerFrameData[2];
+
+static void load_demo(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if(!f) {
+		fprintf(stderr, "bench: can't open %s\n", path);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	// an extra zeroed input ends the demo even if the file doesn't
+	demo = calloc(size / sizeof(struct DemoInput) + 1, sizeof(struct DemoInput));
+	if(size < (long) sizeof(struct DemoInput) * 2 || fread(demo, 1, size, f) != (size_t) size) {
+		fprintf(stderr, "bench: %s isn't a demo\n", path);
+		exit(1);
+	}
+	fclose(f);
+}
+
+void bench_init(int argc, char** argv) {
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--headless")) {
+			bench_headless = true;
+		} else if(!strcmp(argv[i], "--demo") && i + 1 < argc) {
+			load_demo(argv[++i]);
+		} else if(!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			max_frames = strtoul(argv[++i], NULL, 0);
+		} else if(!strcmp(argv[i], "--out") && i + 1 < argc) {
+			out_path = argv[++i];
+		} else if(!strcmp(argv[i], "--record-collision") && i + 1 < argc) {
+			collision_file = fopen(argv[++i], "w");
+			if(!collision_file) {
+				fprintf(stderr, "bench: can't write %s\n", argv[i]);
+				exit(1);
+			}
+			fprintf(collision_file, "kind,level,area,x,y,z,cell_x,cell_z,radius,flags,object\n");
+		} else if(!strcmp(argv[i], "--bench-behaviors") && i + 1 < argc) {
+			behavior_iterations = strtoul(argv[++i], NULL, 0);
+		} else if(!strcmp(argv[i], "--bench-objects") && i + 1 < argc) {
+			object_iterations = strtoul(argv[++i], NULL, 0);
+		} else if(!strcmp(argv[i], "--bench-poses") && i + 1 < argc) {
+			pose_iterations = strtoul(argv[++i], NULL, 0);
+		} else if(!strcmp(argv[i], "--bench-sfx") && i + 1 < argc) {
+			sfx_frames = strtoul(argv[++i], NULL, 0);
+		} else {
+			fprintf(stderr, "usage: %s [--headless] [--demo <demo.bin>] [--frames <n>] [--out <stats.csv>] [--record-collision <queries.csv>] [--bench-behaviors <n>] [--bench-objects <n>] [--bench-poses <n>] [--bench-sfx <n>]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if(bench_headless) {
+		// no window, no vsync, the frames run as fast as they can
+		SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+	}
+	if(demo || max_frames) {
+		out_file = fopen(out_path, "w");
+		if(!out_file) {
+			fprintf(stderr, "bench: can't write %s\n", out_path);
+			exit(1);
+		}
+		fprintf(out_file, "frame,level,area,frame_us,script_us,graph_us,render_us,polys,objects,main_pool_used,level_pool_used\n");
+	}
+}
+
+bool bench_has_demo() {
+	return demo != NULL;
+}
+
+// called from level_script_bench_entry, mirrors how the title screen starts a demo
+s32 lvl_start_bench_demo(UNUSED s16 arg, UNUSED s32 unused) {
+	gCurrDemoInput = demo + 1;
+	gCurrSaveFileNum = 1;
+	gCurrActNum = 1;
+	demo_started = true;
+	return (s8) demo->timer;
+}
+
+static u32 count_active_objects() {
+	u32 count = 0;
+	for(s32 i = 0; i < OBJECT_POOL_CAPACITY; i++) {
+		if(gObjectPool[i].activeFlags & ACTIVE_FLAG_ACTIVE) {
+			count++;
+		}
+	}
+	return count;
+}
+
+// times the interpreter alone stepping the objects that are in loops that only call functions,
+// running their decoded ops or, in a BHV_UNDECODED build, their commands
+static void bench_behaviors() {
+	u64 ns = 0;
+	u32 objects = 0;
+	for(s32 i = 0; i < OBJECT_POOL_CAPACITY; i++) {
+		struct Object* obj = &gObjectPool[i];
+		if(!(obj->activeFlags & ACTIVE_FLAG_ACTIVE) || !bench_behavior_steppable(obj)) {
+			continue;
+		}
+		u64 start = SDL_GetTicksNS();
+		for(u32 j = 0; j < behavior_iterations; j++) {
+			bench_step_behavior(obj);
+		}
+		ns += SDL_GetTicksNS() - start;
+		objects++;
+	}
+	u64 ticks = (u64) objects * behavior_iterations;
+#ifdef BHV_UNDECODED
+	const char* interpreter = "commands";
+#else
+	const char* interpreter = "decoded";
+#endif
+	printf("behaviors (%s): %u objects, %.1f ns per tick\n", interpreter, objects, ticks? (double) ns / ticks: 0.0);
+}
+
+// times finding the pairs of objects whose hitboxes get checked, building the collision grid and going through
+// every check detect_object_collisions makes, reading the objects the way it did before gObjectHot against
+// copying their hot fields over first like every frame does and reading those
+static void bench_objects() {
+	volatile s32 sink = 0;
+	u64 start = SDL_GetTicksNS();
+	for(u32 j = 0; j < object_iterations; j++) {
+		sink = bench_object_broad_phase(TRUE);
+	}
+	u64 direct_ns = SDL_GetTicksNS() - start;
+
+	start = SDL_GetTicksNS();
+	for(u32 j = 0; j < object_iterations; j++) {
+		sink = bench_object_broad_phase(FALSE);
+	}
+	u64 hot_ns = SDL_GetTicksNS() - start;
+
+	u32 pairs = sink;
+	printf("objects: %u objects, %u pairs, %.1f us per frame from the objects, %.1f us per frame copying and reading the hot fields\n",
+		count_active_objects(), pairs, object_iterations? direct_ns / 1000.0 / object_iterations: 0.0,
+		object_iterations? hot_ns / 1000.0 / object_iterations: 0.0);
+}
+
+// times decoding the current pose of every animated object joint by joint, against getting it from the pose cache,
+// along with how often the drawn objects found their pose in the cache during the run
+static void bench_poses() {
+	u32 hits = gPoseCacheHits;
+	u32 misses = gPoseCacheMisses;
+	u64 ns[2] = {0, 0};
+	u32 objects = 0;
+	for(s32 i = 0; i < OBJECT_POOL_CAPACITY; i++) {
+		struct Object* obj = &gObjectPool[i];
+		if(!(obj->activeFlags & ACTIVE_FLAG_ACTIVE) || !bench_decode_pose(obj, TRUE)) {
+			continue;
+		}
+		for(s32 cached = 0; cached < 2; cached++) {
+			u64 start = SDL_GetTicksNS();
+			for(u32 j = 0; j < pose_iterations; j++) {
+				bench_decode_pose(obj, cached);
+			}
+			ns[cached] += SDL_GetTicksNS() - start;
+		}
+		objects++;
+	}
+	u64 poses = (u64) objects * pose_iterations;
+	printf("poses: %u objects, %.1f ns per pose decoding every part, %.1f ns per pose from the cache, %u hits and %u misses while drawing\n",
+		objects, poses? (double) ns[0] / poses: 0.0, poses? (double) ns[1] / poses: 0.0, hits, misses);
+}
+
+// times the sound effect player for n frames with every bank starting a new sound each frame, going through all of them,
+// which keeps the voices as busy as they can get
+static void bench_sfx() {
+	u32 played = gSfxNotesPlayed;
+	u32 stolen = gSfxVoicesStolen;
+	u32 dropped = gSfxNotesDropped;
+	u64 total_ns = 0;
+	u64 worst_ns = 0;
+	sfx_player_stop_all();
+	for(u32 j = 0; j < sfx_frames; j++) {
+		u64 start = SDL_GetTicksNS();
+		for(u32 bank = 0; bank < SOUND_BANK_COUNT; bank++) {
+			u32 id = j % sfx_count_per_channel[bank];
+			sfx_player_play(SOUND_ARG_LOAD(bank, id, 0xFF, SOUND_DISCRETE), gGlobalSoundSource);
+		}
+		sfx_player_tick();
+		u64 ns = SDL_GetTicksNS() - start;
+		total_ns += ns;
+		if(ns > worst_ns) {
+			worst_ns = ns;
+		}
+	}
+	sfx_player_stop_all();
+	printf("sfx: %.1f ns per frame, %u ns at worst, %u notes played, %u voices stolen, %u notes dropped\n",
+		sfx_frames? (double) total_ns / sfx_frames: 0.0, (u32) worst_ns,
+		gSfxNotesPlayed - played, gSfxVoicesStolen - stolen, gSfxNotesDropped - dropped);
+}
+
+void bench_record_collision_query(char kind, s32 cellX, s32 cellZ, q32 xq, q32 yq, q32 zq, q32 radiusq) {
+	if(!collision_file) {
+		return;
+	}
+	// what else decides which surfaces count, same bits as in bench_collision.py
+	u32 flags = 0;
+	if(gCheckingSurfaceCollisionsForCamera) {
+		flags |= 1;
+	}
+	if(gCurrentObject && (gCurrentObject->activeFlags & ACTIVE_FLAG_MOVE_THROUGH_GRATE)) {
+		flags |= 2;
+	}
+	if(gCurrentObject && gCurrentObject == gMarioObject && (gMarioState->flags & MARIO_VANISH_CAP)) {
+		flags |= 4;
+	}
+	// which object asks, for the floor cache
+	s32 object = gCurrentObject && gCurrentObject >= gObjectPool && gCurrentObject < gObjectPool + OBJECT_POOL_CAPACITY? gCurrentObject - gObjectPool: -1;
+	fprintf(collision_file, "%c,%d,%d,%d,%d,%d,%d,%d,%d,%u,%d\n", kind, gCurrLevelNum, gCurrAreaIndex, xq, yq, zq, cellX, cellZ, radiusq, flags, object);
+}
+
+void bench_end_frame() {
+	u64 now = SDL_GetTicksNS();
+	u64 frame_ns = last_frame_ns? now - last_frame_ns: 0;
+	last_frame_ns = now;
+	u32 polys = debug_processed_poly_count;
+	debug_processed_poly_count = 0;
+	if(!out_file) {
+		return;
+	}
+
+	// the profiler has just moved on from the frame that ended
+	struct ProfilerFrameData* profiler = &gProfilerFrameData[gCurrentFrameIndex1 ^ 1];
+	// same as the debug text, the unused part of the level pool counts as free
+	u32 level_pool_used = 0;
+	u32 avail = main_pool_available();
+	if(sLevelPool) {
+		level_pool_used = (uintptr_t) sLevelPool->free_ptr - (uintptr_t) (sLevelPool + 1);
+		avail += sLevelPool->size - level_pool_used;
+	}
+	u32 main_pool_used = (main_pool_end_addr - main_pool_start_addr) - avail;
+	fprintf(out_file, "%u,%d,%d,%u,%u,%u,%u,%u,%u,%u,%u\n",
+		frame, gCurrLevelNum, gCurrAreaIndex, (u32) (frame_ns / 1000),
+		(u32) (profiler->gameTimes[LEVEL_SCRIPT_EXECUTE] - profiler->gameTimes[THREAD5_START]),
+		(u32) (profiler->gameTimes[BEFORE_DISPLAY_LISTS] - profiler->gameTimes[LEVEL_SCRIPT_EXECUTE]),
+		(u32) (profiler->gameTimes[AFTER_DISPLAY_LISTS] - profiler->gameTimes[BEFORE_DISPLAY_LISTS]),
+		polys, count_active_objects(), main_pool_used, level_pool_used);
+	frame++;
+
+	bool demo_over = demo_started && (gCurrDemoInput == NULL || gCurrDemoInput->timer == 0);
+	if((max_frames && frame >= max_frames) || (!max_frames && demo_over)) {
+		if(behavior_iterations) {
+			bench_behaviors();
+		}
+		if(object_iterations) {
+			bench_objects();
+		}
+		if(pose_iterations) {
+			bench_poses();
+		}
+		if(sfx_frames) {
+			bench_sfx();
+		}
+		fclose(out_file);
+		out_file = NULL;
+		if(collision_file) {
+			fclose(collision_file);
+			collision_file = NULL;
+		}
+		close_requested = true;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <types.h>
+
+// headless benchmark runs: sm64 --headless --demo <demo.bin> [--frames <n>] [--out <stats.csv>]
+// the demo is in the format of assets/demos/*.bin (the level id, then the inputs for run_demo_inputs)
+// --record-collision <queries.csv> also writes down the static collision queries for tools/bench_collision.py
+// --bench-behaviors <n> steps the objects' behavior scripts n times each at the end and prints how long the interpreter took
+// --bench-objects <n> finds the pairs of objects to check for collisions n times at the end, from the objects and from gObjectHot
+// --bench-poses <n> decodes the animated objects' current poses n times each at the end, with and without the pose cache
+// --bench-sfx <n> runs the sound effect player for n frames at the end with every bank starting a sound each frame
+
+extern bool bench_headless;
+extern const LevelScript level_script_bench_entry[]; // in levels/entry.c
+
+void bench_init(int argc, char** argv);
+bool bench_has_demo();
+s32 lvl_start_bench_demo(s16 arg, s32 unused);
+void bench_end_frame();
+// kind is 'f', 'c' or 'w', the position is the one the static surfaces are checked at
+void bench_record_collision_query(char kind, s32 cellX, s32 cellZ, q32 xq, q32 yq, q32 zq, q32 radiusq);
@@ -6,7 +6,7 @@
 
 static u8* ext_files_buffer = NULL;
 
-void cd_read(void* out, u32 pos, u32 size) {
+void cd_backend_begin_read(void* out, u32 pos, u32 size, UNUSED bool blocking) {
 	if(!ext_files_buffer) {
 		FILE* h = fopen("build/us_pc/ext_files.dat", "rb");
 		assert(h);
@@ -19,3 +19,7 @@ void cd_read(void* out, u32 pos, u32 size) {
 	}
 	memcpy(out, ext_files_buffer + pos, size);
 }
+
+bool cd_backend_read_done() {
+	return true;
+}
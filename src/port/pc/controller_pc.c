@@ -3,6 +3,7 @@
 #include <SDL3/SDL.h>
 #include <game/main.h>
 #include <port/gfx/gfx.h>
+#include <game/profiler.h>
 
 void controller_backend_read(OSContPad* pad, u32 port) {
 	pad->button = 0;
@@ -51,6 +52,7 @@ void controller_backend_read(OSContPad* pad, u32 port) {
 	if(keys[SDL_SCANCODE_BACKSPACE]) {
 		if(!already_backspacing) {
 			debug_processed_poly_count = 0;
+			debug_saved_vtx_transform_count = 0;
 			gShowDebugText = !gShowDebugText;
 			gShowProfiler = !gShowProfiler;
 			already_backspacing = true;
@@ -58,4 +60,14 @@ void controller_backend_read(OSContPad* pad, u32 port) {
 	} else {
 		already_backspacing = false;
 	}
+
+	static bool already_exporting = false;
+	if(keys[SDL_SCANCODE_F9]) {
+		if(!already_exporting) {
+			profiler_export_trace();
+			already_exporting = true;
+		}
+	} else {
+		already_exporting = false;
+	}
 }
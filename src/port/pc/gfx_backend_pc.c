@@ -5,6 +5,7 @@
 #include <SDL3/SDL_timer.h>
 #include <port/cd.h>
 #include <port/gfx/gfx_internal.h>
+#include <port/pc/bench_pc.h>
 #include <game/memory.h>
 #include <stdlib.h>
 
@@ -16,7 +17,7 @@ void gfx_backend_init() {
 	renderer = SDL_CreateRenderer(window, NULL);
 	SDL_ShowWindow(window);
 	SDL_SetRenderLogicalPresentation(renderer, 320, 240, SDL_LOGICAL_PRESENTATION_LETTERBOX);
-	SDL_SetRenderVSync(renderer, 1);
+	SDL_SetRenderVSync(renderer, bench_headless? 0: 1);
 }
 
 void gfx_init_buffers() {}
@@ -65,6 +66,10 @@ void gfx_load_texture(void* tex_ptr) {
 	tex_header->sdl_tex_ptr = (uintptr_t) texture;
 }
 
+void gfx_load_level_textures(UNUSED s16 level) {
+	// level textures are only prebaked for psx vram
+}
+
 bool close_requested = false;
 
 u64 last_frame_time = 0;
@@ -80,7 +85,7 @@ void gfx_swap_buffers(bool vsync_30fps) {
 	flush_pc_ot();
 	if(vsync_30fps) {
 		u64 t = SDL_GetTicksNS();
-		if(last_frame_time == 0 || is_holding_tab()) {
+		if(last_frame_time == 0 || is_holding_tab() || bench_headless) {
 			last_frame_time = t;
 		} else {
 			u64 next_frame_time = last_frame_time + 1000000000ull / 30;
@@ -5,11 +5,13 @@
 #include <SDL3/SDL.h>
 #include <assert.h>
 #include <engine/math_util.h>
+#include <game/profiler.h>
 
 void gfx_begin_queueing_for_tessellation(const GfxVtx* v0, const GfxVtx* v1, const GfxVtx* v2, const GfxVtx* v3, u8 flags) {}
 void gfx_finish_queueing_for_tessellation(u32 rgb0, u32 rgb1, u32 rgb2, u32 rgb3) {}
 
 u32 debug_processed_poly_count = 0;
+u32 debug_saved_vtx_transform_count = 0;
 void* tex_ptr = NULL;
 static Color env_color;
 
@@ -25,10 +27,16 @@ static Color ambient_color;
 static ShortVec light_directions[2];
 static Color light_colors[2];
 
+// modelview space positions of the current DL_CMD_VTX batch, each one computed on first use,
+// reference for the screen space cache of the psx executor
+static ShortVec transformed[16];
+static u16 transformed_mask;
+
 void gfx_reset_dl_exec() {
 	tex_ptr = NULL;
 	multiplier = 1;
 	is_ortho = false;
+	transformed_mask = 0;
 	is_2d_background = true;
 	foreground_z = FOREGROUND_BUCKETS;
 	env_color.as_u32 = 0xFFFFFF;
@@ -100,8 +108,22 @@ static SDL_FColor light_from_normal(s8* normal) {
 	};
 }
 
+static ShortVec apply_modelview_cached(const GfxVtx* v) {
+	uintptr_t idx = ((uintptr_t) v - (uintptr_t) vertices) / sizeof(GfxVtx);
+	if(idx >= ARRAY_COUNT(transformed)) { // not part of the batch, like shadow vertices
+		return gfx_modelview_apply((ShortVec*) &v->x);
+	}
+	if(transformed_mask & 1 << idx) {
+		debug_saved_vtx_transform_count++;
+	} else {
+		transformed[idx] = gfx_modelview_apply((ShortVec*) &v->x);
+		transformed_mask |= 1 << idx;
+	}
+	return transformed[idx];
+}
+
 static SDL_Vertex transform_vertex(const GfxVtx* v, s32* min_z, s32* max_z, u32 flags) {
-	ShortVec p = gfx_modelview_apply((ShortVec*) &v->x);
+	ShortVec p = apply_modelview_cached(v);
 	//p.vz = -p.vz;
 	if(p.vz < *min_z) {
 		*min_z = p.vz;
@@ -231,6 +253,45 @@ static void draw_shadow(s32 radius, u8 opacity) {
 	assert(packet_buf_count < ARRAY_COUNT(packet_buf) - 1);
 }
 
+static void draw_particles(const ParticleBatch* batch) {
+	if(!tex_ptr || is_ortho) {
+		return;
+	}
+	TexHeader* tex = tex_ptr;
+	u32 count = batch->count;
+	const s16* xs = batch->pos;
+	const s16* ys = xs + count;
+	const s16* zs = ys + count;
+	// same corners as gfx_emit_screen_quad, zigzagged
+	const SDL_FPoint uvs[4] = {{0, 0}, {tex->rotated, !tex->rotated}, {!tex->rotated, tex->rotated}, {1, 1}};
+	for(u32 i = 0; i < count; i++) {
+		ShortVec p = gfx_modelview_apply(&(ShortVec) {.vx = xs[i], .vy = ys[i], .vz = zs[i]});
+		if(p.vz <= 0 || p.vz >= MAX_Z) {
+			continue;
+		}
+		float half = (float) batch->half_size * multiplier / p.vz;
+		float x = (float) p.vx * multiplier / p.vz + XRES / 2;
+		float y = (float) (p.vy - batch->lift) * multiplier / p.vz + YRES / 2;
+		SdlPacket* packet = &packet_buf[packet_buf_count];
+		for(u32 j = 0; j < 4; j++) {
+			packet->vertices[j] = (SDL_Vertex) {
+				.position.x = x + (j < 2? -half: half),
+				.position.y = y + (j & 1? half: -half),
+				.tex_coord = uvs[j],
+				.color = {1, 1, 1, 1}
+			};
+		}
+		u32 otz = p.vz / (MAX_Z / Z_BUCKETS);
+		packet->next = ot[otz];
+		ot[otz] = packet;
+		packet->is_quad = true;
+		packet->flags = PRIM_FLAG_TEXTURED;
+		packet->sdl_tex = (void*) tex->sdl_tex_ptr;
+		packet_buf_count++;
+		assert(packet_buf_count < ARRAY_COUNT(packet_buf) - 1);
+	}
+}
+
 void gfx_run_compiled_dl(dl_t* dl) {
 	dl_t* call_stack[16];
 	u32 call_stack_idx = 0;
@@ -242,14 +303,24 @@ void gfx_run_compiled_dl(dl_t* dl) {
 				dl_t* target = DL_UNPACK_PTR(cmd);
 				if(op == DL_CMD_CALL) {
 					call_stack[call_stack_idx++] = dl;
+					PROFILER_BEGIN(PROFILER_ZONE_DL_CALL, target);
+					PROFILER_COUNT(PROFILER_COUNTER_DL_CALLS, 1);
 				}
 				dl = target;
 				break;
 			}
+			case DL_CMD_CULL: {
+				if(is_ortho || !gfx_modelview_sphere_is_culled(DL_UNPACK_PTR(cmd), multiplier)) {
+					break;
+				}
+				// the whole list is out of view, so return from it right away
+				[[fallthrough]];
+			}
 			case DL_CMD_END: {
 				if(call_stack_idx == 0) {
 					return;
 				}
+				PROFILER_END(PROFILER_ZONE_DL_CALL);
 				dl = call_stack[--call_stack_idx];
 				break;
 			}
@@ -259,6 +330,7 @@ void gfx_run_compiled_dl(dl_t* dl) {
 			}
 			case DL_CMD_VTX: {
 				vertices = DL_UNPACK_PTR(cmd);
+				transformed_mask = 0;
 				break;
 			}
 			case DL_CMD_TRI: case DL_CMD_QUAD: {
@@ -272,6 +344,7 @@ void gfx_run_compiled_dl(dl_t* dl) {
 					op == DL_CMD_QUAD? &vertices[cmd >> 8 & 0xF]: NULL,
 					cmd & 0xFF
 				);
+				debug_processed_poly_count++;
 				break;
 			}
 			case DL_CMD_ENV_COLOR_ALPHA_FULL: {
@@ -322,6 +395,7 @@ void gfx_run_compiled_dl(dl_t* dl) {
 				} else {
 					gfx_modelview_set(addr);
 				}
+				transformed_mask = 0;
 				break;
 			}
 			case DL_CMD_MTX_PUSH: {
@@ -331,6 +405,7 @@ void gfx_run_compiled_dl(dl_t* dl) {
 			case DL_CMD_MTX_POP: {
 				gfx_flush_tessellation_queue_if_necessary();
 				gfx_modelview_pop();
+				transformed_mask = 0;
 				break;
 			}
 			case DL_CMD_MTX_N64_SET: case DL_CMD_MTX_N64_MUL: {
@@ -350,6 +425,7 @@ void gfx_run_compiled_dl(dl_t* dl) {
 				} else {
 					gfx_modelview_set(&arg_mtx);
 				}
+				transformed_mask = 0;
 				break;
 			}
 			case DL_CMD_MULTIPLIER: {
@@ -372,6 +448,10 @@ void gfx_run_compiled_dl(dl_t* dl) {
 				draw_shadow((s16) (cmd & 0xFFFF), (u8) (cmd >> 16 & 0xFF));
 				break;
 			}
+			case DL_CMD_PARTICLES: {
+				draw_particles(DL_UNPACK_PTR(cmd));
+				break;
+			}
 			default: abortf("invalid compiled display list opcode %d\n", op);
 		}
 	}
@@ -2,6 +2,7 @@
 #include <lib/src/libultra_internal.h>
 #include <macros.h>
 #include <stdbool.h>
+#include <game/profiler.h>
 
 //#define SAVES
 
@@ -13,6 +14,10 @@ OSTime osGetTime(void) {
 	return SDL_GetTicksNS() / 1000;
 }
 
+u32 profiler_ticks(void) {
+	return osGetTime();
+}
+
 u32 osGetCount(void) {
 	static u32 counter = 0;
 	return counter++;
@@ -17,6 +17,10 @@
 
 #include "compat.h"
 
+#ifdef TARGET_PC
+#include "pc/bench_pc.h"
+#endif
+
 #define CONFIG_FILE "sm64config.txt"
 
 OSMesg gMainReceivedMesg;
@@ -50,8 +54,14 @@ ALIGNED8 static u8 main_pool[DOUBLE_SIZE_ON_64_BIT(0x0C0000)]; // the original s
 #endif
 
 [[gnu::noinline]] int main(UNUSED int argc, UNUSED char *argv[]) {
+#ifdef TARGET_PC
+	bench_init(argc, argv);
+#endif
 	main_pool_init(main_pool, (u8*) main_pool + sizeof(main_pool));
+	// paintings, snow and the like build their display lists in here
+	main_pool_set_arena(MEMORY_ARENA_DISPLAY_LISTS);
 	gEffectsMemoryPool = mem_pool_init(DOUBLE_SIZE_ON_64_BIT(0x4000), MEMORY_POOL_LEFT);
+	main_pool_set_arena(MEMORY_ARENA_OTHER);
 
 #ifdef USE_CONFIG
     configfile_load(CONFIG_FILE);
@@ -63,6 +73,9 @@ ALIGNED8 static u8 main_pool[DOUBLE_SIZE_ON_64_BIT(0x0C0000)]; // the original s
     thread5_game_loop(NULL);
     while(!close_requested) {
 		game_loop_one_iteration();
+#ifdef TARGET_PC
+		bench_end_frame();
+#endif
     }
     return 0;
 }
@@ -4,17 +4,22 @@
 #include <port/cd.h>
 #include <port/gfx/gfx.h>
 #include <port/audio_data.h>
+#include <port/sfx_player.h>
 #include <game/memory.h>
 #include <types.h>
 #include <ps1/registers.h>
 #include <ps1/gpu.h>
 #include <port/psx/cd_psx.h>
+#include <port/psx/spu_mem_psx.h>
 #include <audio/external.h>
 #include <sounds.h>
+#include <level_table.h>
+#include <assert.h>
 
 #ifdef BENCH
 
 void audio_backend_init() {}
+void audio_backend_load_level(UNUSED s16 level) {}
 void audio_backend_tick() {}
 void play_sound(UNUSED s32, UNUSED f32*) {}
 void play_music(UNUSED u8 player, UNUSED u16 seqArgs, UNUSED u16 fadeTimer) {}
@@ -27,15 +32,28 @@ extern u8 _audio_sample_segment[];
 extern u8 _audio_sample_segment_end[];
 #define SPU_START_ADDR 4096
 
-typedef union {
-	struct {
-		u16 spu_freq; // 0x1000 * (frequency in Hz) / 44100
-		u16 spu_addr; // address in SPU memory divided by 8
-	};
-	u32 as_u32;
-} SampleDef;
+// the soundtable from psx_sample_pack.py
+typedef struct {
+	u32 offset; // in the sample segment, at the start of a sector
+	u32 size;
+} SampleBankInfo;
+
+typedef struct {
+	u16 instrument_bank_count;
+	u16 sample_bank_count;
+	SampleBankInfo sample_banks[];
+	// followed by the offsets in words of the instrument banks, each one being the index of its sample bank
+	// followed by a SampleDef per instrument with the address relative to the sample bank
+} SoundTable;
+
+#define MAX_SAMPLE_BANKS 16
 
-static u16* table;
+static SoundTable* table;
+static u16* instrument_bank_offsets;
+// a sample bank is in SPU RAM as long as a loaded instrument bank uses it
+static u8 sample_bank_refs[MAX_SAMPLE_BANKS];
+static u32 sample_bank_addrs[MAX_SAMPLE_BANKS]; // 0 while it isn't loaded
+static u32 loaded_instrument_banks = 0;
 
 #if !defined(SERIAL) && !defined(BENCH)
 static u8 track_mapping[] = {
@@ -78,11 +96,59 @@ static u8 track_mapping[] = {
 
 typedef struct {
 	ALIGNED4 MinSecFrame start_msf;
-	ALIGNED4 MinSecFrame end_msf;
+	ALIGNED4 MinSecFrame end_msf; // unused, the tracks end with a marker sector that cd_psx.c loops them on
 } BgmInfo;
 static BgmInfo bgm_info[256];
 #endif
 
+static void acquire_sample_bank(u32 idx) {
+	if(sample_bank_refs[idx]++ == 0) {
+		const SampleBankInfo* info = &table->sample_banks[idx];
+		assert(_audio_sample_segment + info->offset + info->size <= _audio_sample_segment_end);
+		u32 addr = spu_mem_alloc(info->size);
+		if(!addr) {
+			abortf("sample bank %u needs %u bytes of SPU RAM, %u are free\n", idx, info->size, spu_mem_available());
+		}
+		spu_mem_upload(addr, _audio_sample_segment + info->offset, info->size);
+		sample_bank_addrs[idx] = addr;
+	}
+}
+
+static void release_sample_bank(u32 idx) {
+	assert(sample_bank_refs[idx] > 0);
+	if(--sample_bank_refs[idx] == 0) {
+		// the voices may still be playing from it, and the next bank can go in its place
+		sfx_player_stop_all();
+		spu_mem_free(sample_bank_addrs[idx]);
+		sample_bank_addrs[idx] = 0;
+	}
+}
+
+static u32 instrument_bank_sample_bank(u32 bank) {
+	return *((u32*) table + instrument_bank_offsets[bank]);
+}
+
+// the banks that stay loaded aren't touched, the ones going away are released first to make room
+static void set_instrument_banks(u32 banks) {
+	for(u32 bank = 0; bank < table->instrument_bank_count; bank++) {
+		if((loaded_instrument_banks & ~banks) & (1 << bank)) {
+			release_sample_bank(instrument_bank_sample_bank(bank));
+		}
+	}
+	for(u32 bank = 0; bank < table->instrument_bank_count; bank++) {
+		if((banks & ~loaded_instrument_banks) & (1 << bank)) {
+			acquire_sample_bank(instrument_bank_sample_bank(bank));
+		}
+	}
+	loaded_instrument_banks = banks;
+}
+
+// every level can play all of the sound player's sounds, so for now they all want every packed bank
+// a level with instruments of its own would add their banks here
+static u32 level_instrument_banks(UNUSED s16 level) {
+	return (1 << table->instrument_bank_count) - 1;
+}
+
 void audio_backend_init() {
 	SPU_CTRL = SPU_CTRL_ENABLE | SPU_CTRL_UNMUTE;
 	for(int i = 0; i < 24; i++) {
@@ -107,13 +173,15 @@ void audio_backend_init() {
 	SPU_REVERB_VOL_L = 0;
 	SPU_REVERB_VOL_R = 0;
 
-	u8* buf = main_pool_alloc(_audio_sample_segment_end - _audio_sample_segment, MEMORY_POOL_RIGHT);
-	dma_read(buf, _audio_sample_segment, _audio_sample_segment_end);
-	sendSPUData(buf, SPU_START_ADDR, (u32) (_audio_sample_segment_end - _audio_sample_segment + 255) / 256 * 256);
-	main_pool_free(buf);
-
+	enum MemoryArena prev_arena = main_pool_set_arena(MEMORY_ARENA_AUDIO);
 	table = main_pool_alloc(_audio_table_segment_end - _audio_table_segment, MEMORY_POOL_RIGHT);
 	dma_read((u8*) table, _audio_table_segment, _audio_table_segment_end);
+	main_pool_set_arena(prev_arena);
+	assert(table->sample_bank_count <= MAX_SAMPLE_BANKS);
+	instrument_bank_offsets = (u16*) &table->sample_banks[table->sample_bank_count];
+	spu_mem_init(SPU_START_ADDR, SPU_RAM_SIZE);
+	sfx_player_init();
+	set_instrument_banks(level_instrument_banks(LEVEL_NONE));
 
 #if defined(SERIAL) || defined(BENCH)
 	SPU_CDDA_VOL_L = 0;
@@ -129,92 +197,79 @@ void audio_backend_init() {
 	u32 bgm_pack_lba = psx_cd_find_file_lba("BGMPACK.XA;1");
 	for(int i = 0; i < 40; i++) {
 		bgm_info[i].start_msf = lba_to_msf(bgm_pack_lba + bgm_info[i].start_msf.as_u32);
-		bgm_info[i].end_msf = lba_to_msf(bgm_pack_lba + bgm_info[i].end_msf.as_u32);
 	}
 #endif
 }
 
-#ifndef BENCH
-static bool is_voice_playing(u32 voice) {
-	if(voice < 16) {
-		return (SPU_FLAG_STATUS1 & (1 << voice)) == 0;
-	} else {
-		return (SPU_FLAG_STATUS2 & (1 << voice >> 16)) == 0;
+void audio_backend_load_level(s16 level) {
+	set_instrument_banks(level_instrument_banks(level));
+}
+
+SampleDef sfx_backend_find_sample(u32 bank, u32 instrument) {
+	u32* instrument_bank = (u32*) table + instrument_bank_offsets[bank];
+	u32 addr = sample_bank_addrs[instrument_bank[0]];
+	SampleDef sample = {.as_u32 = instrument_bank[1 + instrument]};
+	if(sample.as_u32 == 0 || addr == 0) {
+		return (SampleDef) {.as_u32 = 0};
 	}
+	sample.spu_addr += addr / 8;
+	return sample;
 }
 
-static SampleDef find_instrument(u32 sound_bank_id, u32 instrument_id) {
-	return (SampleDef) {.as_u32 = *((u32*) table + table[sound_bank_id] + instrument_id)};
+void sfx_backend_set_voice(u32 voice, u16 spu_addr, u16 adsr1, u16 adsr2) {
+	SPU_CH_ADDR(voice) = spu_addr;
+	SPU_CH_ADSR1(voice) = adsr1;
+	SPU_CH_ADSR2(voice) = adsr2;
 }
-#endif
 
-//static SoundDef find_sound(u32 channel_id, u32 sound_id) {
-//	u32 sound_bank_id = sound_defs[channel_id][sound_id * 2];
-//	u32 instrument_id = sound_defs[channel_id][sound_id * 2 + 1];
-//	SampleDef sample = (SampleDef) {.as_u32 = *((u32*) table + table[sound_bank_id] + instrument_id)};
-//	Sound
-//}
-
-// from src/audio/data.c, but stored as u16:
-// Frequencies for notes using the standard twelve-tone equal temperament scale.
-// For indices 0..116, gNoteFrequencies[k] = 2^((k-39)/12).
-// For indices 117..128, gNoteFrequencies[k] = 0.5 * 2^((k-39)/12).
-// The 39 in the formula refers to piano key 40 (middle C, at 256 Hz) being
-// the reference frequency, which is assigned value 1.
-#define UNIT 512
-static u16 note_freq_scales[128] = {
-	0.105112f * UNIT, 0.111362f * UNIT, 0.117984f * UNIT, 0.125f * UNIT, 0.132433f * UNIT, 0.140308f * UNIT, 0.148651f * UNIT, 0.15749f * UNIT, 0.166855f * UNIT, 0.176777f * UNIT, 0.187288f * UNIT, 0.198425f * UNIT,
-	0.210224f * UNIT, 0.222725f * UNIT, 0.235969f * UNIT, 0.25f * UNIT, 0.264866f * UNIT, 0.280616f * UNIT, 0.297302f * UNIT, 0.31498f * UNIT, 0.33371f * UNIT, 0.353553f * UNIT, 0.374577f * UNIT, 0.39685f * UNIT,
-	0.420448f * UNIT, 0.445449f * UNIT, 0.471937f * UNIT, 0.5f * UNIT, 0.529732f * UNIT, 0.561231f * UNIT, 0.594604f * UNIT, 0.629961f * UNIT, 0.66742f * UNIT, 0.707107f * UNIT, 0.749154f * UNIT, 0.793701f * UNIT,
-	0.840897f * UNIT, 0.890899f * UNIT, 0.943875f * UNIT, 1.0f * UNIT, 1.059463f * UNIT, 1.122462f * UNIT, 1.189207f * UNIT, 1.259921f * UNIT, 1.33484f * UNIT, 1.414214f * UNIT, 1.498307f * UNIT, 1.587401f * UNIT,
-	1.681793f * UNIT, 1.781798f * UNIT, 1.887749f * UNIT, 2.0f * UNIT, 2.118926f * UNIT, 2.244924f * UNIT, 2.378414f * UNIT, 2.519842f * UNIT, 2.66968f * UNIT, 2.828428f * UNIT, 2.996615f * UNIT, 3.174803f * UNIT,
-	3.363586f * UNIT, 3.563596f * UNIT, 3.775498f * UNIT, 4.0f * UNIT, 4.237853f * UNIT, 4.489849f * UNIT, 4.756829f * UNIT, 5.039685f * UNIT, 5.33936f * UNIT, 5.656855f * UNIT, 5.993229f * UNIT, 6.349606f * UNIT,
-	6.727173f * UNIT, 7.127192f * UNIT, 7.550996f * UNIT, 8.0f * UNIT, 8.475705f * UNIT, 8.979697f * UNIT, 9.513658f * UNIT, 10.07937f * UNIT, 10.67872f * UNIT, 11.31371f * UNIT, 11.986459f * UNIT, 12.699211f * UNIT,
-	13.454346f * UNIT, 14.254383f * UNIT, 15.101993f * UNIT, 16.0f * UNIT, 16.95141f * UNIT, 17.959394f * UNIT, 19.027315f * UNIT, 20.15874f * UNIT, 21.35744f * UNIT, 22.62742f * UNIT, 23.972918f * UNIT, 25.398422f * UNIT,
-	26.908691f * UNIT, 28.508766f * UNIT, 30.203985f * UNIT, 32.0f * UNIT, 33.90282f * UNIT, 35.91879f * UNIT, 38.05463f * UNIT, 40.31748f * UNIT, 42.71488f * UNIT, 45.25484f * UNIT, 47.945835f * UNIT, 50.796844f * UNIT,
-	53.817383f * UNIT, 57.017532f * UNIT, 60.40797f * UNIT, 64.0f * UNIT, 67.80564f * UNIT, 71.83758f * UNIT, 76.10926f * UNIT, 80.63496f * UNIT, 85.42976f * UNIT, 45.25484f * UNIT, 47.945835f * UNIT, 50.796844f * UNIT,
-    53.817383f * UNIT, 57.017532f * UNIT, 60.40797f * UNIT, 64.0f * UNIT, 67.80564f * UNIT, 71.83758f * UNIT, 76.10926f * UNIT, 80.63496f * UNIT
-};
+void sfx_backend_set_pitch(u32 voice, u16 freq) {
+	SPU_CH_FREQ(voice) = freq;
+}
 
-static u8 queued_offs[24] = {};
-
-static void play_note(u32 voice, SampleDef sample, u32 note, u32 gate, s8 velocity) {
-	SPU_CH_FREQ(voice) = (u32) sample.spu_freq * note_freq_scales[note] / UNIT;
-	SPU_CH_ADDR(voice) = sample.spu_addr;
-	s16 vol = 0x4000 / 127 * velocity;
-	SPU_CH_VOL_L(voice) = vol;
-	SPU_CH_VOL_R(voice) = vol;
-	if(voice < 16) {
-		SPU_FLAG_ON1 = 1 << voice;
-	} else {
-		SPU_FLAG_ON2 = 1 << voice >> 16;
-	}
-	if(gate != 0) {
-		queued_offs[voice] = gate * 30 / 240;
-	} else {
-		queued_offs[voice] = 240;
-	}
+void sfx_backend_set_volume(u32 voice, u16 vol_l, u16 vol_r) {
+	SPU_CH_VOL_L(voice) = vol_l;
+	SPU_CH_VOL_R(voice) = vol_r;
 }
 
-void play_sound(s32 soundBits, UNUSED f32* pos) {
-	u32 channel_id = ((u32) soundBits & SOUNDARGS_MASK_BANK) >> SOUNDARGS_SHIFT_BANK;
-	u32 sfx_id = ((u32) soundBits & SOUNDARGS_MASK_SOUNDID) >> SOUNDARGS_SHIFT_SOUNDID;
-	u32 voice = channel_id + 2;
-	SfxDef sfx_def = sfx_defs_per_channel[channel_id][sfx_id];
-	SampleDef instrument = find_instrument(sfx_def.bank_id, sfx_def.sample_id);
-	if(soundBits & SOUND_DISCRETE) {
-		play_note(voice, instrument, sfx_def.note, sfx_def.gate, sfx_def.velocity);
-	} else {
-		if(!is_voice_playing(voice) || SPU_CH_ADDR(voice) != instrument.spu_addr) {
-			play_note(voice, instrument, sfx_def.note, sfx_def.gate, sfx_def.velocity);
+u32 sfx_backend_silent_voices() {
+	u32 silent = 0;
+	for(u32 voice = 0; voice < SFX_VOICE_COUNT; voice++) {
+		if(SPU_CH_ADSR_VOL(voice) == 0) {
+			silent |= 1 << voice;
 		}
 	}
+	return silent;
+}
+
+void sfx_backend_flush(u32 key_on, u32 key_off) {
+	if(key_on & 0xFFFF) {
+		SPU_FLAG_ON1 = key_on;
+	}
+	if(key_on >> 16) {
+		SPU_FLAG_ON2 = key_on >> 16;
+	}
+	if(key_off & 0xFFFF) {
+		SPU_FLAG_OFF1 = key_off;
+	}
+	if(key_off >> 16) {
+		SPU_FLAG_OFF2 = key_off >> 16;
+	}
+}
+
+void play_sound(s32 soundBits, f32* pos) {
+	sfx_player_play(soundBits, pos);
+}
+void stop_sound(u32 soundBits, f32* pos) {
+	sfx_player_stop(soundBits, pos);
+}
+void stop_sounds_from_source(f32* pos) {
+	sfx_player_stop_from_source(pos);
+}
+void stop_sounds_in_continuous_banks() {
+	sfx_player_stop_banks(SFX_CONTINUOUS_BANKS);
 }
 
 bool cd_playing_audio = false;
-#if !defined(SERIAL) && !defined(BENCH)
-static u8 cur_song_idx;
-#endif
 
 void play_music(UNUSED u8 player, UNUSED u16 seqArgs, UNUSED u16 fadeTimer) {
 #if !defined(SERIAL) && !defined(BENCH)
@@ -222,51 +277,21 @@ void play_music(UNUSED u8 player, UNUSED u16 seqArgs, UNUSED u16 fadeTimer) {
 		u8 track = track_mapping[seqArgs & 0xFF];
 		if(track == 0) {
 			if(cd_playing_audio) {
-				psx_cd_run_cmd(CDROM_STOP, NULL, 0);
-				cd_playing_audio = false;
+				cd_read_wait_all();
+				psx_cd_xa_stop();
 			}
 		} else {
-			cur_song_idx = track - 2;
-			psx_cd_run_cmd(CDROM_SETMODE, (const u8[]) {MODE_XA_ADPCM | MODE_XA_SECTOR_FILTER | MODE_2X_SPEED}, 1);
-			psx_cd_run_cmd(CDROM_SETFILTER, (const u8[]) {cur_song_idx, 0}, 2);
-			psx_cd_run_cmd(CDROM_SETLOC, (u8*) &bgm_info[cur_song_idx].start_msf, 3);
-			psx_cd_run_cmd(CDROM_READS, NULL, 0);
-			cd_playing_audio = true;
+			u8 song_idx = track - 2;
+			cd_read_wait_all(); // the drive can't be used while reading
+			psx_cd_xa_play(song_idx, bgm_info[song_idx].start_msf);
 		}
 	}
 #endif
 }
 
+// the music loops by itself from the cd interrupt, see psx_cd_xa_play
 void audio_backend_tick() {
-	for(int voice = 0; voice < 24; voice++) {
-		if(queued_offs[voice] != 0) {
-			queued_offs[voice]--;
-			if(queued_offs[voice] == 0) {
-				if(voice < 16) {
-					SPU_FLAG_OFF1 = 1 << voice;
-				} else {
-					SPU_FLAG_OFF2 = 1 << voice >> 16;
-				}
-			}
-		}
-	}
-#if !defined(SERIAL) && !defined(BENCH)
-	if(cd_playing_audio) {
-		MinSecFrame playing_msf;
-		do {
-			psx_cd_run_cmd(CDROM_NOP, NULL, 0);
-		} while(CDROM_RESULT & CDROM_STAT_SEEK);
-		psx_cd_run_cmd(CDROM_GETLOCL, NULL, 0);
-		playing_msf.min = CDROM_RESULT;
-		playing_msf.sec = CDROM_RESULT;
-		playing_msf.frame = CDROM_RESULT;
-		MinSecFrame song_end_msf = bgm_info[cur_song_idx].end_msf;
-		if(((u32) playing_msf.min << 16 | (u32) playing_msf.sec << 8 | playing_msf.frame) > ((u32) song_end_msf.min << 16 | (u32) song_end_msf.sec << 8 | song_end_msf.frame)) {
-			psx_cd_run_cmd(CDROM_SETLOC, (u8*) &bgm_info[cur_song_idx].start_msf, 3);
-			psx_cd_run_cmd(CDROM_READS, NULL, 0);
-		}
-	}
-#endif
+	sfx_player_tick();
 }
 
 #endif
@@ -16,9 +16,25 @@
 static bool dma_inited = false;
 static u32 dat_lba;
 
+// state of the interrupt driven reads, see cd_backend_begin_read
+typedef enum {
+	READ_IDLE,
+	READ_STARTING, // waiting for the ReadN acknowledge
+	READ_WAITING_SECTOR,
+	READ_TRANSFERRING, // waiting for the sector DMA
+	READ_PAUSING, // waiting for the Pause acknowledge
+	READ_WAITING_PAUSE, // waiting for the Pause to complete
+	READ_FINISHED,
+	READ_FAILED,
+} ReadState;
+
+static volatile ReadState read_state = READ_IDLE;
+
 #define SECTOR_SIZE 2048
 extern u32 gGlobalTimer;
 
+static void xa_check_masked_sector();
+
 void psx_cd_await_interrupt(u8 expected) {
 	CDROM_ADDRESS = 1; // interrupt flags are only accessible at index 1
 	while(true) { // acknowledge whichever interrupts we get, but only stop on the expected one
@@ -38,6 +54,9 @@ void psx_cd_await_interrupt(u8 expected) {
 				break;
 			} else {
 				//assert(got != 5);
+				if(got == 1) {
+					xa_check_masked_sector();
+				}
 				CDROM_HINTSTS = 7; // acknowledge
 			}
 		}
@@ -75,17 +94,181 @@ MinSecFrame lba_to_msf(u32 lba) {
 	};
 }
 
-void psx_cd_do_read(u8* buf, u32 logical_block, u32 sector_count, u8* excess_buf) {
-	MinSecFrame bak_msf;
-	if(cd_playing_audio) {
-		do {
-			psx_cd_run_cmd(CDROM_NOP, NULL, 0);
-		} while(CDROM_RESULT & CDROM_STAT_SEEK);
+// state of the xa music, looped from the interrupt handler when the drive reaches the marker sector
+// that interleave_xa.py puts after the track, so the game never has to ask the drive where it is
+typedef enum {
+	XA_STOPPED,
+	XA_PLAYING,
+	XA_SUSPENDED, // a data read is using the drive, xa_resume_msf is where to pick up from
+	XA_LOOP_SETLOC, // waiting for the Setloc acknowledge
+	XA_LOOP_READS, // waiting for the ReadS acknowledge
+} XaState;
+
+static volatile XaState xa_state = XA_STOPPED;
+static u8 xa_track;
+static MinSecFrame xa_start_msf;
+static volatile MinSecFrame xa_seek_msf; // the last location the drive was sent to
+static MinSecFrame xa_resume_msf;
+static bool xa_marker_latched; // the marker came in while the interrupt was masked, see xa_check_masked_sector
+
+#define XA_END_MARKER_MAGIC 0x454D4742 // "BGME"
+
+// sends a command without waiting for its acknowledge, for the interrupt handler
+static void send_cmd_async(u8 cmd, const u8* args, int arg_count) {
+	CDROM_ADDRESS = 1;
+	while(CDROM_HSTS & CDROM_HSTS_BUSYSTS) {
+		asm volatile("");
+	}
+	CDROM_HCLRCTL = CDROM_HCLRCTL_CLRPRM;
+	CDROM_ADDRESS = 0;
+	for(int i = 0; i < arg_count; i++) {
+		CDROM_PARAMETER = args[i];
+	}
+	CDROM_COMMAND = cmd;
+}
+
+// the sector data has to be requested already, only the marker's first bytes are needed and the rest is left in the buffer
+static bool xa_read_is_marker() {
+	while(!(CDROM_HSTS & CDROM_HSTS_DRQSTS)) {
+		asm volatile("");
+	}
+	u32 magic = 0, track = 0;
+	for(int i = 0; i < 4; i++) {
+		magic |= (u32) CDROM_RDDATA << (i * 8);
+	}
+	for(int i = 0; i < 4; i++) {
+		track |= (u32) CDROM_RDDATA << (i * 8);
+	}
+	CDROM_ADDRESS = 0;
+	CDROM_HCHPCTL = 0;
+	return magic == XA_END_MARKER_MAGIC && track == xa_track;
+}
+
+// called by psx_cd_await_interrupt for the sectors it skips, xa_suspend runs commands with the interrupt masked
+// while the music is still playing, and if the marker went by then the track would never loop
+static void xa_check_masked_sector() {
+	if(xa_state != XA_PLAYING) {
+		return;
+	}
+	CDROM_ADDRESS = 0;
+	CDROM_HCHPCTL = 0;
+	CDROM_HCHPCTL = CDROM_HCHPCTL_BFRD;
+	if(xa_read_is_marker()) {
+		xa_marker_latched = true;
+	}
+	CDROM_ADDRESS = 1;
+}
+
+static void xa_start(MinSecFrame msf) {
+	xa_seek_msf = msf;
+	psx_cd_run_cmd(CDROM_SETMODE, (const u8[]) {MODE_XA_ADPCM | MODE_XA_SECTOR_FILTER | MODE_2X_SPEED}, 1);
+	psx_cd_run_cmd(CDROM_SETLOC, (u8*) &msf, 3);
+	psx_cd_run_cmd(CDROM_READS, NULL, 0);
+	xa_state = XA_PLAYING;
+	xa_marker_latched = false;
+	IRQ_STAT = ~(1 << IRQ_CDROM);
+	IRQ_MASK |= 1 << IRQ_CDROM;
+}
+
+// masks the cd interrupt so that the drive can be used synchronously, once the handler isn't in the middle of looping
+static void xa_mask_irq() {
+	while(true) {
+		IRQ_MASK &= ~(1 << IRQ_CDROM);
+		if(xa_state != XA_LOOP_SETLOC && xa_state != XA_LOOP_READS) {
+			return;
+		}
+		IRQ_MASK |= 1 << IRQ_CDROM;
+		while(xa_state == XA_LOOP_SETLOC || xa_state == XA_LOOP_READS) {
+			asm volatile("");
+		}
+	}
+}
+
+void psx_cd_xa_play(u8 track, MinSecFrame start_msf) {
+	psx_irq_install();
+	xa_mask_irq();
+	xa_track = track;
+	xa_start_msf = start_msf;
+	psx_cd_run_cmd(CDROM_SETFILTER, (const u8[]) {track, 0}, 2);
+	xa_start(start_msf);
+	cd_playing_audio = true;
+}
+
+void psx_cd_xa_stop() {
+	xa_mask_irq();
+	if(xa_state != XA_STOPPED) {
+		psx_cd_run_cmd(CDROM_STOP, NULL, 0);
+		xa_state = XA_STOPPED;
+	}
+	cd_playing_audio = false;
+}
+
+// stops the music for a data read and remembers where it was, returns whether xa_resume has to be called after
+static bool xa_suspend() {
+	xa_mask_irq();
+	if(xa_state != XA_PLAYING) {
+		return false;
+	}
+	// while it's still seeking it hasn't played anything past the location it was sent to
+	psx_cd_run_cmd(CDROM_NOP, NULL, 0);
+	if(CDROM_RESULT & CDROM_STAT_SEEK) {
+		xa_resume_msf = xa_seek_msf;
+	} else {
 		psx_cd_run_cmd(CDROM_GETLOCL, NULL, 0);
-		bak_msf.min = CDROM_RESULT;
-		bak_msf.sec = CDROM_RESULT;
-		bak_msf.frame = CDROM_RESULT;
+		xa_resume_msf.min = CDROM_RESULT;
+		xa_resume_msf.sec = CDROM_RESULT;
+		xa_resume_msf.frame = CDROM_RESULT;
+	}
+	// past the marker, so it has to loop now
+	if(xa_marker_latched) {
+		xa_resume_msf = xa_start_msf;
 	}
+	xa_state = XA_SUSPENDED;
+	return true;
+}
+
+// seeks back with Setloc and ReadS, the drive can't just be unpaused since the data read moved it
+static void xa_resume() {
+	xa_start(xa_resume_msf);
+}
+
+// called from psx_cd_handle_irq when there's no data read, got is the interrupt that was just acknowledged
+static void xa_handle_irq(u8 got) {
+	switch(got) {
+		case IRQ_DATA_READY: {
+			if(xa_state != XA_PLAYING) {
+				break;
+			}
+			if(xa_read_is_marker()) {
+				xa_seek_msf = xa_start_msf;
+				send_cmd_async(CDROM_SETLOC, (u8*) &xa_start_msf, 3);
+				xa_state = XA_LOOP_SETLOC;
+			}
+			break;
+		}
+		case IRQ_CMD_ACKNOWLEDGE: {
+			if(xa_state == XA_LOOP_SETLOC) {
+				send_cmd_async(CDROM_READS, NULL, 0);
+				xa_state = XA_LOOP_READS;
+			} else if(xa_state == XA_LOOP_READS) {
+				xa_state = XA_PLAYING;
+			}
+			break;
+		}
+		case IRQ_ERROR: {
+			// try the loop again, the track is already over anyway
+			if(xa_state == XA_LOOP_SETLOC || xa_state == XA_LOOP_READS) {
+				send_cmd_async(CDROM_SETLOC, (u8*) &xa_start_msf, 3);
+				xa_state = XA_LOOP_SETLOC;
+			}
+			break;
+		}
+	}
+}
+
+void psx_cd_do_read(u8* buf, u32 logical_block, u32 sector_count, u8* excess_buf) {
+	assert(read_state == READ_IDLE);
+	bool xa_suspended = xa_suspend();
 
 	psx_cd_run_cmd(CDROM_SETMODE, (const u8[]) {MODE_2X_SPEED}, 1);
 	MinSecFrame msf = lba_to_msf(logical_block);
@@ -120,10 +303,8 @@ void psx_cd_do_read(u8* buf, u32 logical_block, u32 sector_count, u8* excess_buf
 	psx_cd_run_cmd(CDROM_PAUSE, NULL, 0);
 	psx_cd_await_interrupt(2);
 
-	if(cd_playing_audio) {
-		psx_cd_run_cmd(CDROM_SETMODE, (const u8[]) {MODE_XA_ADPCM | MODE_XA_SECTOR_FILTER | MODE_2X_SPEED}, 1);
-		psx_cd_run_cmd(CDROM_SETLOC, (u8*) &bak_msf, 3);
-		psx_cd_run_cmd(CDROM_READS, NULL, 0);
+	if(xa_suspended) {
+		xa_resume();
 	}
 }
 
@@ -162,11 +343,15 @@ static u8 ext_files_dat[] = {
 #embed <ext_files.dat>
 };
 
-void cd_read(void* out, u32 pos, u32 size) {
+void cd_backend_begin_read(void* out, u32 pos, u32 size, UNUSED bool blocking) {
 	assert(pos + size <= sizeof(ext_files_dat));
 	memcpy(out, ext_files_dat + pos, size);
 }
 
+bool cd_backend_read_done() {
+	return true;
+}
+
 #elifdef SERIAL
 
 static void sio_send_byte(u8 byte) {
@@ -271,7 +456,7 @@ static u32 read_attempt(void* out, u32 pos, u32 size) {
 	return hash.value;
 }
 
-void cd_read(void* out, u32 pos, u32 size) {
+void cd_backend_begin_read(void* out, u32 pos, u32 size, UNUSED bool blocking) {
 	while(true) {
 		u32 expected_hash = read_attempt(out, pos, size);
 		u32 hash = 0xdabadee;
@@ -288,50 +473,207 @@ void cd_read(void* out, u32 pos, u32 size) {
 	}
 }
 
+bool cd_backend_read_done() {
+	return true;
+}
+
 #else
 
-void cd_read(void* out, u32 pos, u32 size) {
-	if(dma_inited) {
+static u8* volatile read_dst; // where the next sector goes
+static u8* read_end;
+static u8* volatile read_excess; // the last sector when it isn't complete, NULL once it's been read
+static volatile u32 read_lba; // lba of the next sector, to resume after errors
+static u8* read_tail;
+static u32 read_tail_size;
+static bool xa_interrupted = false;
+static ALIGNED4 u8 excess_sector[SECTOR_SIZE];
+
+#define READ_IRQS (1 << IRQ_CDROM | 1 << IRQ_DMA)
+
+static void cd_init() {
+	BIU_COM_DELAY = 0x1325;
+	BIU_DEV5_CTRL = 0x00020943; // enable cdrom bus
+	DMA_DPCR |= DMA_DPCR_ENABLE << (DMA_CDROM * 4); // enable CD DMA
+	DMA_DICR = DMA_DICR_IRQ_ENABLE | DMA_DICR_CH_ENABLE(DMA_CDROM) | DMA_DICR_CH_STAT(DMA_CDROM); // raise IRQ_DMA when a sector is transferred
+	CDROM_ADDRESS = 1;
+	CDROM_HINTMSK_W = 7; // enable all response interrupts
+	CDROM_HCLRCTL = 7; // clear any pending responses just in case
+	// clear request state
+	CDROM_ADDRESS = 0;
+	CDROM_HCHPCTL = 0;
+	// reset cd audio playback in both channels
+	CDROM_ADDRESS = 2;
+	CDROM_ATV0 = 128;
+	CDROM_ATV1 = 0;
+	CDROM_ADDRESS = 3;
+	CDROM_ATV2 = 128;
+	CDROM_ATV3 = 0;
+	CDROM_ADPCTL = CDROM_ADPCTL_CHNGATV;
+	// initialize
+	psx_cd_run_cmd(CDROM_NOP, NULL, 0);
+	psx_cd_run_cmd(CDROM_NOP, NULL, 0);
+	psx_cd_run_cmd(CDROM_INIT, NULL, 0);
+	psx_cd_run_cmd(CDROM_DEMUTE, NULL, 0);
+
+	dat_lba = psx_cd_find_file_lba("EXT.DAT;1");
+	assert(dat_lba);
+	psx_irq_install();
+	dma_inited = true;
+}
+
+static void ack_dma_irq() {
+	DMA_DICR = (DMA_DICR & (DMA_DICR_CH_MODE_BITMASK | DMA_DICR_CH_ENABLE_BITMASK | DMA_DICR_IRQ_ENABLE)) | DMA_DICR_CH_STAT(DMA_CDROM);
+}
+
+// the commands before ReadN are still sent synchronously since they get acknowledged almost immediately,
+// the slow part (seeking and waiting for every sector) is handled by psx_cd_handle_irq
+static void start_reading() {
+	psx_cd_run_cmd(CDROM_SETMODE, (const u8[]) {MODE_2X_SPEED}, 1);
+	MinSecFrame msf = lba_to_msf(read_lba);
+	psx_cd_run_cmd(CDROM_SETLOC, (u8*) &msf, 3);
+	read_state = READ_STARTING;
+	ack_dma_irq();
+	IRQ_STAT = ~READ_IRQS;
+	IRQ_MASK |= READ_IRQS;
+	CDROM_ADDRESS = 1;
+	while(CDROM_HSTS & CDROM_HSTS_BUSYSTS) {
+		asm volatile("");
+	}
+	CDROM_HCLRCTL = CDROM_HCLRCTL_CLRPRM;
+	CDROM_ADDRESS = 0;
+	CDROM_COMMAND = CDROM_READN;
+}
+
+void cd_backend_begin_read(void* out, u32 pos, u32 size, bool blocking) {
+	if(!dma_inited) {
+		cd_init();
+	} else if(blocking) {
 		gfx_show_message_screen("loading", "", "");
-	} else {
-		BIU_COM_DELAY = 0x1325;
-		BIU_DEV5_CTRL = 0x00020943; // enable cdrom bus
-		DMA_DPCR |= DMA_DPCR_ENABLE << (DMA_CDROM * 4); // enable CD DMA
-		CDROM_ADDRESS = 1;
-		CDROM_HINTMSK_W = 7; // enable all response interrupts
-		CDROM_HCLRCTL = 7; // clear any pending responses just in case
-		// clear request state
-		CDROM_ADDRESS = 0;
-		CDROM_HCHPCTL = 0;
-		// reset cd audio playback in both channels
-		CDROM_ADDRESS = 2;
-		CDROM_ATV0 = 128;
-		CDROM_ATV1 = 0;
-		CDROM_ADDRESS = 3;
-		CDROM_ATV2 = 128;
-		CDROM_ATV3 = 0;
-		CDROM_ADPCTL = CDROM_ADPCTL_CHNGATV;
-		// initialize
-		psx_cd_run_cmd(CDROM_NOP, NULL, 0);
-		psx_cd_run_cmd(CDROM_NOP, NULL, 0);
-		psx_cd_run_cmd(CDROM_INIT, NULL, 0);
-		psx_cd_run_cmd(CDROM_DEMUTE, NULL, 0);
-
-		dat_lba = psx_cd_find_file_lba("EXT.DAT;1");
-		assert(dat_lba);
-		dma_inited = true;
 	}
+	assert(read_state == READ_IDLE);
 	// the segment starts are already aligned to sectors by makextfiles.c
-	u32 sector = dat_lba + pos / SECTOR_SIZE;
 	u32 sector_count = size / SECTOR_SIZE;
-	u32 size_aligned_down = sector_count * SECTOR_SIZE;
-	if(size > size_aligned_down) {
-		ALIGNED4 u8 excess[SECTOR_SIZE];
-		psx_cd_do_read(out, sector, sector_count, excess);
-		memcpy(out + size_aligned_down, excess, size - size_aligned_down);
-	} else {
-		psx_cd_do_read(out, sector, sector_count, NULL);
+	read_dst = out;
+	read_end = out + sector_count * SECTOR_SIZE;
+	read_tail = read_end;
+	read_tail_size = size - sector_count * SECTOR_SIZE;
+	read_excess = read_tail_size? excess_sector: NULL;
+	read_lba = dat_lba + pos / SECTOR_SIZE;
+	if(size == 0) {
+		read_state = READ_FINISHED;
+		return;
+	}
+	xa_interrupted = xa_suspend();
+	start_reading();
+}
+
+bool cd_backend_read_done() {
+	switch(read_state) {
+		case READ_FINISHED: {
+			read_state = READ_IDLE;
+			if(read_tail_size) {
+				memcpy(read_tail, excess_sector, read_tail_size);
+			}
+			if(xa_interrupted) {
+				xa_interrupted = false;
+				xa_resume();
+			}
+			return true;
+		}
+		case READ_FAILED: {
+			// the interrupts are masked at this point, so just stop the drive and resume from the sector that failed
+			printf("cd read error at lba %u, retrying\n", read_lba);
+			read_state = READ_IDLE;
+			psx_cd_run_cmd(CDROM_PAUSE, NULL, 0);
+			psx_cd_await_interrupt(2);
+			start_reading();
+			return false;
+		}
+		default: {
+			return false;
+		}
+	}
+}
+
+// called from the interrupt handler in irq_psx.c
+void psx_cd_handle_irq() {
+	u8 prev_index = CDROM_HSTS & CDROM_HSTS_RA_BITMASK; // the interrupted code may be in the middle of using another bank
+	if(IRQ_STAT & (1 << IRQ_CDROM)) {
+		CDROM_ADDRESS = 1;
+		u8 got = CDROM_HINTSTS & 7;
+		if(got == IRQ_DATA_READY && (read_state == READ_WAITING_SECTOR || (read_state == READ_IDLE && xa_state == XA_PLAYING))) {
+			// request the sector data, same as in psx_cd_await_interrupt
+			CDROM_ADDRESS = 0;
+			CDROM_HCHPCTL = 0;
+			CDROM_HCHPCTL = CDROM_HCHPCTL_BFRD;
+			CDROM_ADDRESS = 1;
+		}
+		CDROM_HINTSTS = 7; // acknowledge
+		CDROM_HCLRCTL = CDROM_HCLRCTL_CLRPRM;
+		IRQ_STAT = ~(1 << IRQ_CDROM);
+		if(read_state == READ_IDLE) {
+			xa_handle_irq(got);
+		} else {
+			switch(got) {
+				case IRQ_CMD_ACKNOWLEDGE: {
+					if(read_state == READ_STARTING) {
+						read_state = READ_WAITING_SECTOR;
+					} else if(read_state == READ_PAUSING) {
+						read_state = READ_WAITING_PAUSE;
+					}
+					break;
+				}
+				case IRQ_DATA_READY: {
+					if(read_state == READ_WAITING_SECTOR) {
+						while(!(CDROM_HSTS & CDROM_HSTS_DRQSTS)) {
+							asm volatile("");
+						}
+						DMA_MADR(DMA_CDROM) = (u32) (read_dst < read_end? read_dst: read_excess);
+						DMA_BCR(DMA_CDROM) = SECTOR_SIZE / 4; // the DMA size is in 4-byte words
+						DMA_CHCR(DMA_CDROM) = DMA_CHCR_ENABLE | DMA_CHCR_TRIGGER | DMA_CHCR_MODE_BURST;
+						read_state = READ_TRANSFERRING;
+					}
+					break;
+				}
+				case IRQ_BLOCKING_CMD_DONE: {
+					if(read_state == READ_WAITING_PAUSE) {
+						IRQ_MASK &= ~READ_IRQS;
+						read_state = READ_FINISHED;
+					}
+					break;
+				}
+				case IRQ_ERROR: {
+					if(read_state != READ_IDLE && read_state != READ_FINISHED) {
+						IRQ_MASK &= ~READ_IRQS;
+						read_state = READ_FAILED;
+					}
+					break;
+				}
+			}
+		}
+	}
+	if(IRQ_STAT & (1 << IRQ_DMA)) {
+		ack_dma_irq();
+		IRQ_STAT = ~(1 << IRQ_DMA);
+		if(read_state == READ_TRANSFERRING) {
+			if(read_dst < read_end) {
+				read_dst += SECTOR_SIZE;
+			} else {
+				read_excess = NULL;
+			}
+			read_lba++;
+			if(read_dst < read_end || read_excess) {
+				read_state = READ_WAITING_SECTOR;
+			} else {
+				CDROM_ADDRESS = 1;
+				CDROM_HCLRCTL = CDROM_HCLRCTL_CLRPRM;
+				CDROM_ADDRESS = 0;
+				CDROM_COMMAND = CDROM_PAUSE;
+				read_state = READ_PAUSING;
+			}
+		}
 	}
+	CDROM_ADDRESS = prev_index;
 }
 
 #endif
@@ -73,6 +73,9 @@ void psx_cd_await_interrupt(u8 expected);
 void psx_cd_run_cmd(u8 cmd, const u8* args, int arg_count);
 void psx_cd_do_read(u8* buf, u32 logical_block, u32 sector_count, u8* excess_buf);
 u32 psx_cd_find_file_lba(const char* name);
+void psx_cd_handle_irq();
+
+void psx_irq_install();
 
 typedef union {
 	struct {
@@ -81,6 +84,11 @@ typedef union {
 	u32 as_u32;
 } MinSecFrame;
 
+// xa music from the interleaved pack, track is its file number, the reads pause it and pick it up where it was
+// it loops by itself off the marker sector interleave_xa.py puts after each track
+void psx_cd_xa_play(u8 track, MinSecFrame start_msf);
+void psx_cd_xa_stop();
+
 #define TO_BCD(i) (((i) / 10 * 16) | ((i) % 10))
 
 MinSecFrame lba_to_msf(u32 lba);
@@ -6,6 +6,7 @@
 #include <game/rumble_init.h>
 #include <game/main.h>
 #include <port/gfx/gfx.h>
+#include <game/profiler.h>
 
 /*
  * ps1-bare-metal - (C) 2023 spicyjpeg
@@ -305,11 +306,15 @@ void controller_backend_read(OSContPad* pad, u32 port) {
 	//}
 	pad->errnum = 0;
 
-	static u8 last_buttons = 0;
+	static u16 last_buttons = 0;
 	if((buttons & PSX_BTN_R2) && !(last_buttons & PSX_BTN_R2)) {
 		debug_processed_poly_count = 0;
+		debug_saved_vtx_transform_count = 0;
 		gShowDebugText = !gShowDebugText;
 		gShowProfiler = !gShowProfiler;
 	}
+	if((buttons & PSX_BTN_L2) && !(last_buttons & PSX_BTN_L2)) {
+		profiler_export_trace();
+	}
 	last_buttons = buttons;
 }
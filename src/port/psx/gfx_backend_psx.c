@@ -34,6 +34,7 @@ void gfx_backend_init() {
 		| (1 << 0 & BIU_CTRL_WRITE_DELAY_BITMASK);
 	SPU_CTRL = SPU_CTRL_ENABLE | SPU_CTRL_UNMUTE; // enable SPU
 	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE); // allow DMA to the display
+	gfx_reset_texture_cache();
 }
 
 void gfx_fade_to_color(Color color, u8 alpha) {
@@ -5,6 +5,8 @@
 #include <ps1/gte.h>
 #include <engine/math_util.h>
 #include <game/game_init.h>
+#include <game/profiler.h>
+#include <assert.h>
 
 // check the .map file and ensure the section is smaller than 0x1000 so it actually fits in icache!!!
 #define DL_EXEC_ICACHE_FUNC [[gnu::section(".dl_exec")]] [[gnu::noinline]]
@@ -17,12 +19,32 @@ scratchpad static bool is_ortho;
 static bool is_2d_background;
 static u8 foreground_z;
 
+// screen space results of the vertices of the current DL_CMD_VTX batch, each one computed on first use,
+// so vertices shared between polygons are only projected and lit once
+typedef struct {
+	u32 sxy;
+	u32 sz;
+	u32 rgb;
+} ProjectedVtx;
+
+u32 debug_saved_vtx_transform_count;
+scratchpad static ProjectedVtx projected[16];
+scratchpad static u16 projected_mask;
+scratchpad static u16 projected_error_mask;
+scratchpad static u16 lit_mask;
+
+static inline void invalidate_projected_vertices() {
+	projected_mask = 0;
+	lit_mask = 0;
+}
+
 void gfx_reset_dl_exec() {
 	tex_ptr = NULL;
 	is_2d_background = true;
 	foreground_z = FOREGROUND_BUCKETS;
 	env_color.as_u32 = 0xFFFFFFFF;
 	is_ortho = false;
+	invalidate_projected_vertices();
 	gfx_modelview_identity();
 	gte_setControlReg(GTE_RBK, 0);
 	gte_setControlReg(GTE_GBK, 0);
@@ -58,8 +80,11 @@ typedef struct {
 	GfxVtx v2;
 	GfxVtx v3;
 	bool is_quad;
+	u32 batch_indices; // packed like the DL_CMD_TRI/QUAD operands, NOT_BATCHED when the vertices were generated
 } SubPoly;
 
+#define NOT_BATCHED 0xFFFFFFFF
+
 #define POLY_QUEUE_MAX 3
 
 typedef struct {
@@ -67,6 +92,51 @@ typedef struct {
 	SubPoly sub_polys[POLY_QUEUE_MAX];
 } PolyQueue;
 
+// kept out of the icache loop, misses are the uncommon case on dense meshes
+[[gnu::noinline]] static void project_batch_vertices(u32 missing) {
+	projected_mask |= missing;
+	projected_error_mask &= ~missing;
+	u8 group[3];
+	u32 group_len = 0;
+	for(u32 i = 0; missing; i++, missing >>= 1) {
+		if(!(missing & 1)) {
+			continue;
+		}
+		group[group_len++] = i;
+		debug_saved_vtx_transform_count--;
+		if(group_len == 3) {
+			// three at once with rtpt whenever possible, it's much faster than three rtps
+			gte_loadDataRegM(GTE_VXY0, (const u32*) &vertices[group[0]].xy);
+			gte_loadDataRegM(GTE_VZ0, &vertices[group[0]].zuv);
+			gte_loadDataRegM(GTE_VXY1, (const u32*) &vertices[group[1]].xy);
+			gte_loadDataRegM(GTE_VZ1, &vertices[group[1]].zuv);
+			gte_loadDataRegM(GTE_VXY2, (const u32*) &vertices[group[2]].xy);
+			gte_loadDataRegM(GTE_VZ2, &vertices[group[2]].zuv);
+			gte_commandAfterLoad(GTE_CMD_RTPT | GTE_SF);
+			projected[group[0]].sxy = gte_getDataReg(GTE_SXY0);
+			projected[group[1]].sxy = gte_getDataReg(GTE_SXY1);
+			projected[group[2]].sxy = gte_getDataReg(GTE_SXY2);
+			projected[group[0]].sz = gte_getDataReg(GTE_SZ1);
+			projected[group[1]].sz = gte_getDataReg(GTE_SZ2);
+			projected[group[2]].sz = gte_getDataReg(GTE_SZ3);
+			if(gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS) {
+				projected_error_mask |= 1 << group[0] | 1 << group[1] | 1 << group[2];
+			}
+			group_len = 0;
+		}
+	}
+	for(u32 j = 0; j < group_len; j++) {
+		gte_loadDataRegM(GTE_VXY0, (const u32*) &vertices[group[j]].xy);
+		gte_loadDataRegM(GTE_VZ0, &vertices[group[j]].zuv);
+		gte_commandAfterLoad(GTE_CMD_RTPS | GTE_SF);
+		projected[group[j]].sxy = gte_getDataReg(GTE_SXY2);
+		projected[group[j]].sz = gte_getDataReg(GTE_SZ3);
+		if(gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS) {
+			projected_error_mask |= 1 << group[j];
+		}
+	}
+}
+
 static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 	return (GfxVtx) {
 		.x = ((s32) v0->x + v1->x) / 2, .y = ((s32) v0->y + v1->y) / 2, .z = ((s32) v0->z + v1->z) / 2,
@@ -81,13 +151,18 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 	GfxVtx* v1 = &poly->v1;
 	GfxVtx* v2 = &poly->v2;
 	GfxVtx* v3 = poly->is_quad? &poly->v3: NULL;
-
-	gte_loadDataRegM(GTE_VXY0, (const u32*) &v0->xy);
-	gte_loadDataRegM(GTE_VZ0, &v0->zuv);
-	gte_loadDataRegM(GTE_VXY1, (const u32*) &v1->xy);
-	gte_loadDataRegM(GTE_VZ1, &v1->zuv);
-	gte_loadDataRegM(GTE_VXY2, (const u32*) &v2->xy);
-	gte_loadDataRegM(GTE_VZ2, &v2->zuv);
+	u32 batch = poly->batch_indices;
+	u32 i0 = batch >> 20 & 0xF, i1 = batch >> 16 & 0xF, i2 = batch >> 12 & 0xF, i3 = batch >> 8 & 0xF;
+	u32 batch_mask = batch == NOT_BATCHED || is_ortho? 0: 1 << i0 | 1 << i1 | 1 << i2 | (v3? 1 << i3: 0);
+
+	if(!batch_mask) {
+		gte_loadDataRegM(GTE_VXY0, (const u32*) &v0->xy);
+		gte_loadDataRegM(GTE_VZ0, &v0->zuv);
+		gte_loadDataRegM(GTE_VXY1, (const u32*) &v1->xy);
+		gte_loadDataRegM(GTE_VZ1, &v1->zuv);
+		gte_loadDataRegM(GTE_VXY2, (const u32*) &v2->xy);
+		gte_loadDataRegM(GTE_VZ2, &v2->zuv);
+	}
 
 #ifdef PRIM_FLAG_ENV_ALPHA
 	if((flags & PRIM_FLAG_ENV_ALPHA) && env_alpha._pad < ALPHA_OPAQUE) {
@@ -130,18 +205,37 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 			sxy3 = (gte_getDataReg(GTE_IR1) & 0xFFFF) | gte_getDataReg(GTE_IR2) << 16;
 		}
 	} else {
-		// RTPT transforms and projects all 3 vertices in a mere 23 cycles. based GTE :)
-		gte_commandNoNop(GTE_CMD_RTPT | GTE_SF);
+		if(batch_mask) {
+			if((projected_mask & batch_mask) != batch_mask) {
+				project_batch_vertices(batch_mask & ~projected_mask);
+			}
+			debug_saved_vtx_transform_count += v3? 4: 3;
 
-		debug_processed_poly_count++;
-		is_2d_background = false;
+			// put the cached results where rtpt would have, so the rest doesn't care where they come from
+			gte_setDataReg(GTE_SXY0, projected[i0].sxy);
+			gte_setDataReg(GTE_SXY1, projected[i1].sxy);
+			gte_setDataReg(GTE_SXY2, projected[i2].sxy);
+			gte_setDataReg(GTE_SZ1, projected[i0].sz);
+			gte_setDataReg(GTE_SZ2, projected[i1].sz);
+			gte_setDataReg(GTE_SZ3, projected[i2].sz);
+			gte_errored = projected_error_mask & batch_mask;
 
-		//// if there was any error in rtpt, cull it
-		//if(gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS) return;
-		gte_errored = gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS;
+			// prepare to reject backfaces
+			gte_commandAfterLoad(GTE_CMD_NCLIP);
+		} else {
+			// RTPT transforms and projects all 3 vertices in a mere 23 cycles. based GTE :)
+			gte_commandNoNop(GTE_CMD_RTPT | GTE_SF);
+
+			//// if there was any error in rtpt, cull it
+			//if(gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS) return;
+			gte_errored = gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS;
 
-		// prepare to reject backfaces
-		gte_commandNoNop(GTE_CMD_NCLIP);
+			// prepare to reject backfaces
+			gte_commandNoNop(GTE_CMD_NCLIP);
+		}
+
+		debug_processed_poly_count++;
+		is_2d_background = false;
 
 		// sort z in the meantime
 		z = gte_getDataReg(GTE_SZ1);
@@ -172,17 +266,24 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 		sxy2 = gte_getDataReg(GTE_SXY2);
 
 		if(v3) {
-			// if this is a quad, quickly transform the extra vertex with rtps
-			gte_loadDataRegM(GTE_VXY0, (const u32*) &v3->xy);
-			gte_loadDataRegM(GTE_VZ0, &v3->zuv);
-			gte_commandAfterLoad(GTE_CMD_RTPS | GTE_SF);
+			if(batch_mask) {
+				// writing sxyp pushes the fifo like rtps does
+				gte_setDataReg(GTE_SXYP, projected[i3].sxy);
+				gte_setDataReg(GTE_SZ3, projected[i3].sz);
+				gte_commandAfterLoad(GTE_CMD_NCLIP);
+			} else {
+				// if this is a quad, quickly transform the extra vertex with rtps
+				gte_loadDataRegM(GTE_VXY0, (const u32*) &v3->xy);
+				gte_loadDataRegM(GTE_VZ0, &v3->zuv);
+				gte_commandAfterLoad(GTE_CMD_RTPS | GTE_SF);
 
-			//// if there was any error in rtps, cull it
-			//if(gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS) return;
-			gte_errored = gte_errored || (gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS);
+				//// if there was any error in rtps, cull it
+				//if(gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS) return;
+				gte_errored = gte_errored || (gte_getControlReg(GTE_FLAG) & IMPORTANT_GTE_ERRORS);
 
-			// prepare to reject backfaces
-			gte_commandNoNop(GTE_CMD_NCLIP);
+				// prepare to reject backfaces
+				gte_commandNoNop(GTE_CMD_NCLIP);
+			}
 
 			// get the result
 			sxy3 = gte_getDataReg(GTE_SXY2);
@@ -206,7 +307,13 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 	}
 
 	u32 rgb0, rgb1, rgb2, rgb3;
-	if(flags & PRIM_FLAG_LIGHTED) {
+	bool lit_from_cache = (flags & PRIM_FLAG_LIGHTED) && batch_mask && (lit_mask & batch_mask) == batch_mask;
+	if(lit_from_cache) {
+		rgb0 = projected[i0].rgb;
+		rgb1 = projected[i1].rgb;
+		rgb2 = projected[i2].rgb;
+		if(v3) rgb3 = projected[i3].rgb;
+	} else if(flags & PRIM_FLAG_LIGHTED) {
 		gte_setV0((s16) (s8) v0->color.r * (ONE / 128), (s16) (s8) v0->color.g * (ONE / 128), (s16) (s8) v0->color.b * (ONE / 128));
 		gte_setV1((s16) (s8) v1->color.r * (ONE / 128), (s16) (s8) v1->color.g * (ONE / 128), (s16) (s8) v1->color.b * (ONE / 128));
 		gte_setV2((s16) (s8) v2->color.r * (ONE / 128), (s16) (s8) v2->color.g * (ONE / 128), (s16) (s8) v2->color.b * (ONE / 128));
@@ -228,6 +335,7 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 	// these things will hopefully be done while nct is cooking
 	if(false && (gte_errored || ((flags & PRIM_FLAG_TESSELLATE) && min_z <= MAX_TESSELLATION_Z))) {
 #if 1
+		poly->batch_indices = NOT_BATCHED;
 		if(v3) {
 			if(queue->count <= (u32) POLY_QUEUE_MAX - 4) {
 				SubPoly* additions = &queue->sub_polys[queue->count + 1];
@@ -239,6 +347,7 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 				additions[0].v2 = *v2;
 				additions[0].v3 = between(v2, v3);
 				additions[0].is_quad = true;
+				additions[0].batch_indices = NOT_BATCHED;
 
 				// bottom left
 				additions[1].v0 = between(v0, v1);
@@ -246,6 +355,7 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 				additions[1].v2 = additions[0].v1;
 				additions[1].v3 = between(v1, v3);
 				additions[1].is_quad = true;
+				additions[1].batch_indices = NOT_BATCHED;
 
 				// bottom right
 				additions[2].v0 = additions[0].v1;
@@ -253,6 +363,7 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 				additions[2].v2 = additions[0].v3;
 				additions[2].v3 = *v3;
 				additions[2].is_quad = true;
+				additions[2].batch_indices = NOT_BATCHED;
 
 				// top left
 				*v1 = additions[1].v0;
@@ -269,12 +380,14 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 				additions[0].v1 = between(v1, v2);
 				additions[0].v2 = *v2;
 				additions[0].is_quad = false;
+				additions[0].batch_indices = NOT_BATCHED;
 
 				// bottom left
 				additions[1].v0 = between(v0, v1);
 				additions[1].v1 = *v1;
 				additions[1].v2 = additions[0].v1;
 				additions[1].is_quad = false;
+				additions[1].batch_indices = NOT_BATCHED;
 
 				// top left
 				*v1 = additions[1].v0;
@@ -309,7 +422,7 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 	}
 	u32 ot_z = z / (MAX_Z / Z_BUCKETS) + FOREGROUND_BUCKETS;
 
-	if(flags & PRIM_FLAG_LIGHTED) {
+	if((flags & PRIM_FLAG_LIGHTED) && !lit_from_cache) {
 		rgb0 = gte_getDataReg(GTE_RGB0);
 		rgb1 = gte_getDataReg(GTE_RGB1);
 		rgb2 = gte_getDataReg(GTE_RGB2);
@@ -318,6 +431,13 @@ static GfxVtx between(const GfxVtx* v0, const GfxVtx* v1) {
 			gte_commandNoNop(GTE_CMD_NCS | GTE_SF | GTE_LM);
 			rgb3 = gte_getDataReg(GTE_RGB2);
 		}
+		if(batch_mask) {
+			projected[i0].rgb = rgb0;
+			projected[i1].rgb = rgb1;
+			projected[i2].rgb = rgb2;
+			if(v3) projected[i3].rgb = rgb3;
+			lit_mask |= batch_mask;
+		}
 	}
 
 	Packet packet = gfx_packet_begin();
@@ -498,12 +618,82 @@ static const s16 shadow_vertex1[2] = {
 	gfx_packet_end(packet, z);
 }
 
+// quads bigger than this are too close to the camera to be worth drawing
+#define MAX_PARTICLE_HALF_SIZE 128
+
+static void draw_particle(u32 sxy, s32 z, s32 half_size, s32 lift, const u32* uvs) {
+	if((u32) (z - 1) >= (u32) (MAX_Z - 1)) {
+		return;
+	}
+	s32 half = half_size / z;
+	if(half == 0 || half > MAX_PARTICLE_HALF_SIZE) {
+		return;
+	}
+	s32 x = (s16) sxy;
+	s32 y = ((s32) sxy >> 16) - lift / z;
+	if(x + half <= 0 || x - half >= XRES || y + half <= 0 || y - half >= YRES) {
+		return;
+	}
+	TexHeader* tex = tex_ptr;
+	Packet packet = gfx_packet_begin();
+	gfx_packet_append(&packet, tex->window_cmd);
+	gfx_packet_append(&packet, gp0_quad(true, false));
+	gfx_packet_append(&packet, gp0_xy(x - half, y - half));
+	gfx_packet_append(&packet, uvs[0] | (u32) tex->clut_attr << 16);
+	gfx_packet_append(&packet, gp0_xy(x - half, y + half));
+	gfx_packet_append(&packet, uvs[1] | (u32) tex->page_attr << 16);
+	gfx_packet_append(&packet, gp0_xy(x + half, y - half));
+	gfx_packet_append(&packet, uvs[2]);
+	gfx_packet_append(&packet, gp0_xy(x + half, y + half));
+	gfx_packet_append(&packet, uvs[3]);
+	gfx_packet_end(packet, z / (MAX_Z / Z_BUCKETS) + FOREGROUND_BUCKETS);
+}
+
+// no need to look at the gte flags, a particle off screen or behind the camera only fails its own checks
+[[gnu::flatten]] static void draw_particles(const ParticleBatch* batch) {
+	TexHeader* tex = tex_ptr;
+	if(!tex || is_ortho) {
+		return;
+	}
+	u32 count = batch->count;
+	const s16* xs = batch->pos;
+	const s16* ys = xs + count;
+	const s16* zs = ys + count;
+	s32 h = gte_getControlReg(GTE_H);
+	s32 half_size = batch->half_size * h;
+	s32 lift = batch->lift * h;
+
+	// same corners as gfx_emit_screen_quad, zigzagged
+	u32 right = tex->width - 1, bottom = (tex->height - 1) << 8;
+	u32 uvs[4] = {0, tex->rotated? right: bottom, tex->rotated? bottom: right, right | bottom};
+
+	for(u32 i = 0; i < count; i += 3) {
+		// a last group of one or two projects its first particle again to fill the gte
+		u32 i1 = i + 1 < count? i + 1: i;
+		u32 i2 = i + 2 < count? i + 2: i;
+		gte_setV0(xs[i], ys[i], zs[i]);
+		gte_setV1(xs[i1], ys[i1], zs[i1]);
+		gte_setV2(xs[i2], ys[i2], zs[i2]);
+		gte_commandAfterLoad(GTE_CMD_RTPT | GTE_SF);
+		u32 sxy0 = gte_getDataReg(GTE_SXY0);
+		u32 sxy1 = gte_getDataReg(GTE_SXY1);
+		u32 sxy2 = gte_getDataReg(GTE_SXY2);
+		s32 z0 = gte_getDataReg(GTE_SZ1);
+		s32 z1 = gte_getDataReg(GTE_SZ2);
+		s32 z2 = gte_getDataReg(GTE_SZ3);
+		draw_particle(sxy0, z0, half_size, lift, uvs);
+		if(i1 != i) draw_particle(sxy1, z1, half_size, lift, uvs);
+		if(i2 != i) draw_particle(sxy2, z2, half_size, lift, uvs);
+	}
+}
+
 [[gnu::noinline]] static void handle_extra_cmd(u8 op, u32 cmd) {
 	[[gnu::assume(op >= _DL_CMD_ENUM_FIRST_EXTRA && op <= _DL_CMD_ENUM_END)]];
 	switch(op) {
 		case DL_CMD_MTX_MUL: {
 			const ShortMatrix* mtx = (const ShortMatrix*) cmd;
 			gfx_modelview_mul(mtx);
+			invalidate_projected_vertices();
 			break;
 		}
 		case DL_CMD_MTX_N64_SET:
@@ -523,6 +713,7 @@ static const s16 shadow_vertex1[2] = {
 			} else {
 				gfx_modelview_set(&arg_mtx);
 			}
+			invalidate_projected_vertices();
 			break;
 		}
 		case DL_CMD_MTX_PUSH: {
@@ -531,12 +722,17 @@ static const s16 shadow_vertex1[2] = {
 		}
 		case DL_CMD_MTX_POP: {
 			gfx_modelview_pop();
+			invalidate_projected_vertices();
 			break;
 		}
 		case DL_CMD_SQUARE_SHADOW: {
 			draw_square_shadow((s16) (cmd & 0xFFFF), (u8) (cmd >> 16 & 0xFF));
 			break;
 		}
+		case DL_CMD_PARTICLES: {
+			draw_particles((const ParticleBatch*) cmd);
+			break;
+		}
 	}
 }
 
@@ -556,21 +752,33 @@ DL_EXEC_ICACHE_FUNC void gfx_run_compiled_dl(dl_t* dl) {
 			case DL_CMD_CALL: {
 				call_stack[call_stack_idx++] = dl;
 				dl = (dl_t*) cmd;
+				PROFILER_BEGIN(PROFILER_ZONE_DL_CALL, dl);
+				PROFILER_COUNT(PROFILER_COUNTER_DL_CALLS, 1);
 				break;
 			}
+			case DL_CMD_CULL: {
+				if(is_ortho || !gfx_modelview_sphere_is_culled((const ShortVec*) cmd, gte_getControlReg(GTE_H))) {
+					break;
+				}
+				// the whole list is out of view, so return from it right away
+				[[fallthrough]];
+			}
 			case DL_CMD_END: {
 				if(call_stack_idx == 0) {
 					return;
 				}
+				PROFILER_END(PROFILER_ZONE_DL_CALL);
 				dl = call_stack[--call_stack_idx];
 				break;
 			}
 			case DL_CMD_TEX: {
 				tex_ptr = (void*) cmd;
+				assert(!tex_ptr || gfx_texture_is_resident(tex_ptr));
 				break;
 			}
 			case DL_CMD_VTX: {
 				vertices = (void*) cmd;
+				invalidate_projected_vertices();
 				break;
 			}
 			case DL_CMD_TRI: case DL_CMD_QUAD: {
@@ -585,6 +793,7 @@ DL_EXEC_ICACHE_FUNC void gfx_run_compiled_dl(dl_t* dl) {
 				} else {
 					poly_queue.sub_polys[0].is_quad = false;
 				}
+				poly_queue.sub_polys[0].batch_indices = cmd;
 				do {
 					draw_poly(&poly_queue, cmd & 0xFF);
 				} while(poly_queue.count);
@@ -601,20 +810,24 @@ DL_EXEC_ICACHE_FUNC void gfx_run_compiled_dl(dl_t* dl) {
 				gte_setControlReg(GTE_RBK, (cmd & 0xFF) * (ONE / 256));
 				gte_setControlReg(GTE_GBK, (cmd >> 8 & 0xFF) * (ONE / 256));
 				gte_setControlReg(GTE_BBK, (cmd >> 16 /*& 0xFF*/) * (ONE / 256));
+				lit_mask = 0;
 				break;
 			}
 			case DL_CMD_LIGHT_DIRECTIONAL0:
 			case DL_CMD_LIGHT_DIRECTIONAL1: {
 				set_light_from_cmd(cmd, op - DL_CMD_LIGHT_DIRECTIONAL0);
+				lit_mask = 0;
 				break;
 			}
 			case DL_CMD_MTX_SET: {
 				const ShortMatrix* mtx = (const ShortMatrix*) cmd;
 				gfx_modelview_set(mtx);
+				invalidate_projected_vertices();
 				break;
 			}
 			case DL_CMD_MULTIPLIER: {
 				gte_setControlReg(GTE_H, cmd /*& 0xFFFFFF*/);
+				invalidate_projected_vertices();
 				break;
 			}
 			case DL_CMD_SET_BACKGROUND: {
@@ -623,6 +836,7 @@ DL_EXEC_ICACHE_FUNC void gfx_run_compiled_dl(dl_t* dl) {
 			}
 			case DL_CMD_SET_ORTHO: {
 				is_ortho = cmd; //& 1;
+				invalidate_projected_vertices();
 				break;
 			}
 			case DL_CMD_SPRITE: {
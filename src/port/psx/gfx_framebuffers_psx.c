@@ -61,6 +61,7 @@ void gfx_swap_buffers(bool vsync_30fps) {
 	ot = fb[selected_fb].ot;
 	next_packet = fb[selected_fb].packet_pool;
 	clearOrderingTable(ot, OT_LEN);
+	gfx_texture_cache_end_frame();
 }
 
 void gfx_discard_frame() {
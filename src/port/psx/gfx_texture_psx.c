@@ -7,6 +7,9 @@
 #include <assert.h>
 #include <stdio.h>
 #include <game/memory.h>
+#include <port/cd.h>
+#include <level_table.h>
+#include <game/profiler.h>
 
 // VRAM is composed of two rows of 16 64x256 pages, 32 pages total
 // the first 10 pages (640 pixels) are taken up by the dual 320x240 framebuffers
@@ -15,58 +18,115 @@
 
 // these values can be configured but must stay in this order
 #define FIRST_PAGE_128x32 16
-#define FIRST_PAGE_64x64 18
-#define FIRST_PAGE_64x32 19
-#define FIRST_PAGE_32x32 23
-#define FIRST_PAGE_16x16 26
-#define FIRST_PAGE_8x16 28
+#define FIRST_PAGE_64x64 17
+#define FIRST_PAGE_64x32 18
+#define FIRST_PAGE_32x32 21
+#define FIRST_PAGE_16x16 24
+#define FIRST_PAGE_8x16 25
+#define FIRST_PAGE_ATLAS 26
 #define FIRST_PAGE_CLUTS 29
 #define PAGES_END 32
 
+// the atlas pages hold the current level's own textures, prebaked by pack_textures.py (which must match this layout)
+// their palettes take the last rows of the palette pages
+#define ATLAS_X (FIRST_PAGE_ATLAS % 16 * 64)
+#define ATLAS_Y (FIRST_PAGE_ATLAS / 16 * 256)
+#define ATLAS_WIDTH ((FIRST_PAGE_CLUTS - FIRST_PAGE_ATLAS) * 64)
+#define ATLAS_CLUT_ROWS 32
+
 #define BPP 4
-#define COUNT_IN_PAGE(w, h) (16 / BPP * 64 / (w) * (256 / (h)))
 
 #define LOW_CLUTS_PER_ROW ((PAGES_END - FIRST_PAGE_CLUTS) * 64 / (1 << BPP))
-#define LOW_CLUT_SLOTS (LOW_CLUTS_PER_ROW * 256)
+#define LOW_CLUT_SLOTS (LOW_CLUTS_PER_ROW * (256 - ATLAS_CLUT_ROWS))
 #define CLUT_PAGES_X (FIRST_PAGE_CLUTS % 16 * 64)
 #define CLUT_PAGES_Y (FIRST_PAGE_CLUTS / 16 * 256)
+#define ATLAS_CLUT_X CLUT_PAGES_X
+#define ATLAS_CLUT_Y (CLUT_PAGES_Y + 256 - ATLAS_CLUT_ROWS)
 #define HIGH_CLUTS_PER_ROW (XRES * 2 / (1 << BPP))
 #define HIGH_CLUT_SLOTS (HIGH_CLUTS_PER_ROW * 16)
 #define CLUT_SLOTS (LOW_CLUT_SLOTS + HIGH_CLUT_SLOTS)
 
-#define PAGES_128x32 (FIRST_PAGE_64x64 - FIRST_PAGE_128x32)
-#define PAGE_SLOTS_128x32 COUNT_IN_PAGE(128 / BPP, 32)
-#define SLOTS_128x32 (PAGE_SLOTS_128x32 * PAGES_128x32)
-#define FIRST_CLUT_128x32 0
+// width and height in texels
+#define CLASS_SLOTS(w, h, pages) (256 / (w) * (pages) * (256 / (h)))
 
-#define PAGES_64x64 (FIRST_PAGE_64x32 - FIRST_PAGE_64x64)
-#define PAGE_SLOTS_64x64 COUNT_IN_PAGE(64 / BPP, 64)
-#define SLOTS_64x64 (PAGE_SLOTS_64x64 * PAGES_64x64)
-#define FIRST_CLUT_64x64 (FIRST_CLUT_128x32 + SLOTS_128x32)
+#define SLOTS_8x16 CLASS_SLOTS(8, 16, FIRST_PAGE_ATLAS - FIRST_PAGE_8x16)
+#define SLOTS_16x16 CLASS_SLOTS(16, 16, FIRST_PAGE_8x16 - FIRST_PAGE_16x16)
+#define SLOTS_32x32 CLASS_SLOTS(32, 32, FIRST_PAGE_16x16 - FIRST_PAGE_32x32)
+#define SLOTS_64x32 CLASS_SLOTS(64, 32, FIRST_PAGE_32x32 - FIRST_PAGE_64x32)
+#define SLOTS_64x64 CLASS_SLOTS(64, 64, FIRST_PAGE_64x32 - FIRST_PAGE_64x64)
+#define SLOTS_128x32 CLASS_SLOTS(128, 32, FIRST_PAGE_64x64 - FIRST_PAGE_128x32)
 
-#define PAGES_64x32 (FIRST_PAGE_32x32 - FIRST_PAGE_64x32)
-#define PAGE_SLOTS_64x32 COUNT_IN_PAGE(64 / BPP, 32)
-#define SLOTS_64x32 (PAGE_SLOTS_64x32 * PAGES_64x32)
-#define FIRST_CLUT_64x32 (FIRST_CLUT_64x64 + SLOTS_64x64)
+#define TEX_SLOTS (SLOTS_128x32 + SLOTS_64x64 + SLOTS_64x32 + SLOTS_32x32 + SLOTS_16x16 + SLOTS_8x16)
 
-#define PAGES_32x32 (FIRST_PAGE_16x16 - FIRST_PAGE_32x32)
-#define PAGE_SLOTS_32x32 COUNT_IN_PAGE(32 / BPP, 32)
-#define SLOTS_32x32 (PAGE_SLOTS_32x32 * PAGES_32x32)
-#define FIRST_CLUT_32x32 (FIRST_CLUT_64x32 + SLOTS_64x32)
+STATIC_ASSERT(CLUT_SLOTS >= TEX_SLOTS, "not enough clut slots for the amount of texture slots");
+STATIC_ASSERT(TEX_SLOTS < ATLAS_CACHE_SLOT, "too many texture slots for the atlas marker");
 
-#define PAGES_16x16 (FIRST_PAGE_8x16 - FIRST_PAGE_16x16)
-#define PAGE_SLOTS_16x16 COUNT_IN_PAGE(16 / BPP, 16)
-#define SLOTS_16x16 (PAGE_SLOTS_16x16 * PAGES_16x16)
-#define FIRST_CLUT_16x16 (FIRST_CLUT_32x32 + SLOTS_32x32)
+typedef struct {
+	u8 width;
+	u8 height;
+	u8 first_page;
+	u8 pages;
+	u16 first_slot;
+	u16 slot_count;
+} TexSlotClass;
 
-#define PAGES_8x16 (FIRST_PAGE_CLUTS - FIRST_PAGE_8x16)
-#define PAGE_SLOTS_8x16 COUNT_IN_PAGE(8 / BPP, 16)
-#define SLOTS_8x16 (PAGE_SLOTS_8x16 * PAGES_8x16 / 64)
-#define FIRST_CLUT_8x16 (FIRST_CLUT_16x16 + SLOTS_16x16)
+// checked in this order, each class fills its pages left to right, then top to bottom
+static const TexSlotClass slot_classes[] = {
+	{8, 16, FIRST_PAGE_8x16, FIRST_PAGE_ATLAS - FIRST_PAGE_8x16, 1, SLOTS_8x16},
+	{16, 16, FIRST_PAGE_16x16, FIRST_PAGE_8x16 - FIRST_PAGE_16x16, 1 + SLOTS_8x16, SLOTS_16x16},
+	{32, 32, FIRST_PAGE_32x32, FIRST_PAGE_16x16 - FIRST_PAGE_32x32, 1 + SLOTS_8x16 + SLOTS_16x16, SLOTS_32x32},
+	{64, 32, FIRST_PAGE_64x32, FIRST_PAGE_32x32 - FIRST_PAGE_64x32, 1 + SLOTS_8x16 + SLOTS_16x16 + SLOTS_32x32, SLOTS_64x32},
+	{64, 64, FIRST_PAGE_64x64, FIRST_PAGE_64x32 - FIRST_PAGE_64x64, 1 + SLOTS_8x16 + SLOTS_16x16 + SLOTS_32x32 + SLOTS_64x32, SLOTS_64x64},
+	{128, 32, FIRST_PAGE_128x32, FIRST_PAGE_64x64 - FIRST_PAGE_128x32, 1 + SLOTS_8x16 + SLOTS_16x16 + SLOTS_32x32 + SLOTS_64x32 + SLOTS_64x64, SLOTS_128x32},
+};
 
-#define TEX_SLOTS (SLOTS_128x32 + SLOTS_64x64 + SLOTS_64x32 + SLOTS_32x32 + SLOTS_16x16 + SLOTS_8x16)
+// slot 0 is never handed out, so headers that were never loaded (cache_slot 0) never match its owner
+TexSlot tex_slots[TEX_SLOTS + 1];
+static u16 free_slots[ARRAY_COUNT(slot_classes)];
+// starts at 2 so that the eviction check below can't underflow
+u32 tex_cache_frame = 2;
+TexCacheStats tex_cache_stats;
+TexCacheStats tex_cache_last_frame_stats;
 
-STATIC_ASSERT(CLUT_SLOTS >= TEX_SLOTS, "not enough clut slots for the amount of texture slots");
+void gfx_reset_texture_cache() {
+	for(s32 i = 0; i < ARRAY_COUNT(slot_classes); i++) {
+		const TexSlotClass* class = &slot_classes[i];
+		for(u32 j = 0; j < class->slot_count; j++) {
+			TexSlot* slot = &tex_slots[class->first_slot + j];
+			slot->owner = NULL;
+			slot->next_free = j + 1 < class->slot_count? class->first_slot + j + 1: 0;
+		}
+		free_slots[i] = class->first_slot;
+	}
+}
+
+void gfx_texture_cache_end_frame() {
+	tex_cache_last_frame_stats = tex_cache_stats;
+	tex_cache_stats = (TexCacheStats) {};
+	tex_cache_frame++;
+}
+
+static u32 alloc_slot(u32 class_idx) {
+	u32 slot_idx = free_slots[class_idx];
+	if(slot_idx) {
+		free_slots[class_idx] = tex_slots[slot_idx].next_free;
+		return slot_idx;
+	}
+	// evict the least recently used texture, but not one from this frame or the one the gpu may still be drawing
+	const TexSlotClass* class = &slot_classes[class_idx];
+	u32 oldest_frame = tex_cache_frame - 1;
+	for(u32 i = class->first_slot; i < class->first_slot + class->slot_count; i++) {
+		if(tex_slots[i].last_used_frame < oldest_frame) {
+			oldest_frame = tex_slots[i].last_used_frame;
+			slot_idx = i;
+		}
+	}
+	if(!slot_idx) {
+		abortf("out of %ux%u texture slots\n", class->width, class->height);
+	}
+	tex_cache_stats.evictions++;
+	return slot_idx;
+}
 
 static void upload_texture(u32 vram_x, u32 vram_y, u32 clut_idx, void* tex_data, u8 vram_width, u8 height, const void* pixel_data) {
 	TexHeader* tex = tex_data;
@@ -90,12 +150,55 @@ static void upload_texture(u32 vram_x, u32 vram_y, u32 clut_idx, void* tex_data,
 extern u8 _texture_data_segment[];
 UNUSED extern u8 _texture_data_segment_end[];
 
+typedef struct {
+	s16 level;
+	u16 sector;
+	u16 sector_count;
+	u16 height;
+	u16 clut_rows;
+} TexAtlas;
+
+static const TexAtlas tex_atlases[] = {
+#include "tex_atlases.inc.c"
+};
+
+// the pixels and the palettes are stored as two vram rectangles back to back, so it all goes in with one read
+// a new level also starts with an empty texture cache, since the headers of the previous one may be gone
+void gfx_load_level_textures(s16 level) {
+	gfx_reset_texture_cache();
+	for(s32 i = 0; i < ARRAY_COUNT(tex_atlases); i++) {
+		const TexAtlas* atlas = &tex_atlases[i];
+		if(atlas->level == level) {
+			u32 size = atlas->sector_count * SECTOR_SIZE;
+			enum MemoryArena prev_arena = main_pool_set_arena(MEMORY_ARENA_DISPLAY_LISTS);
+			u8* buf = main_pool_alloc(size, MEMORY_POOL_RIGHT);
+			main_pool_set_arena(prev_arena);
+			assert(buf);
+			const void* dma_begin_addr = _texture_data_segment + atlas->sector * SECTOR_SIZE;
+			dma_read(buf, dma_begin_addr, dma_begin_addr + size);
+			sendVRAMData(buf, ATLAS_X, ATLAS_Y, ATLAS_WIDTH, atlas->height);
+			sendVRAMData(buf + atlas->height * ATLAS_WIDTH * 2, ATLAS_CLUT_X, ATLAS_CLUT_Y, LOW_CLUTS_PER_ROW * 16, atlas->clut_rows);
+			waitForDMADone();
+			main_pool_free(buf);
+			return;
+		}
+	}
+}
+
 [[gnu::noinline]] void gfx_load_texture(void* tex_ptr) {
 	TexHeader* tex_header = tex_ptr;
 	assert(tex_header);
-	if(((u32) tex_header->window_cmd >> 24) == ((u32) GP0_CMD_TEXWINDOW >> 24)) {
+	u32 slot_idx = tex_header->cache_slot;
+	if(slot_idx == ATLAS_CACHE_SLOT) {
 		return;
 	}
+	if(tex_slots[slot_idx].owner == tex_header) {
+		tex_slots[slot_idx].last_used_frame = tex_cache_frame;
+		tex_cache_stats.hits++;
+		return;
+	}
+	tex_cache_stats.misses++;
+	PROFILER_SCOPE(PROFILER_ZONE_LOAD_TEXTURE, tex_header);
 	const void* dma_begin_addr = _texture_data_segment + tex_header->pixel_data_sector * 2048;
 	ALIGNED4 u8 pixel_data[tex_header->pixel_data_sector_count * 2048];
 	bool prev_can_show_screen_message = can_show_screen_message;
@@ -104,65 +207,23 @@ UNUSED extern u8 _texture_data_segment_end[];
 	can_show_screen_message = prev_can_show_screen_message;
 	u16 width = tex_header->width;
 	u16 height = tex_header->height;
-	u32 aligned_width, aligned_height;
-	u32 vram_x, vram_y, slot_idx;
-	if(width <= 8 && height <= 16) {
-		static u32 cur_slot_8x16 = 0;
-		assert(cur_slot_8x16 < SLOTS_8x16);
-		u32 slots_in_row = 64 / (16 / (16 / BPP)) * PAGES_8x16;
-		vram_x = FIRST_PAGE_8x16 % 16 * 64 + cur_slot_8x16 % slots_in_row * (8 / (16 / BPP));
-		vram_y = FIRST_PAGE_8x16 / 16 * 256 + cur_slot_8x16 / slots_in_row * 16;
-		slot_idx = FIRST_CLUT_8x16 + cur_slot_8x16++;
-		aligned_width = 8;
-		aligned_height = 16;
-	} else if(width <= 16 && height <= 16) {
-		static u32 cur_slot_16x16 = 0;
-		assert(cur_slot_16x16 < SLOTS_16x16);
-		u32 slots_in_row = 64 / (16 / (16 / BPP)) * PAGES_16x16;
-		vram_x = FIRST_PAGE_16x16 % 16 * 64 + cur_slot_16x16 % slots_in_row * (16 / (16 / BPP));
-		vram_y = FIRST_PAGE_16x16 / 16 * 256 + cur_slot_16x16 / slots_in_row * 16;
-		slot_idx = FIRST_CLUT_16x16 + cur_slot_16x16++;
-		aligned_width = 16;
-		aligned_height = 16;
-	} else if(width <= 32 && height <= 32) {
-		static u32 cur_slot_32x32 = 0;
-		assert(cur_slot_32x32 < SLOTS_32x32);
-		u32 slots_in_row = 64 / (32 / (16 / BPP)) * PAGES_32x32;
-		vram_x = FIRST_PAGE_32x32 % 16 * 64 + cur_slot_32x32 % slots_in_row * (32 / (16 / BPP));
-		vram_y = FIRST_PAGE_32x32 / 16 * 256 + cur_slot_32x32 / slots_in_row * 32;
-		slot_idx = FIRST_CLUT_32x32 + cur_slot_32x32++;
-		aligned_width = 32;
-		aligned_height = 32;
-	} else if(width <= 64 && height <= 32) {
-		static u32 cur_slot_64x32 = 0;
-		assert(cur_slot_64x32 < SLOTS_64x32);
-		u32 slots_in_row = 64 / (64 / (16 / BPP)) * PAGES_64x32;
-		vram_x = FIRST_PAGE_64x32 % 16 * 64 + cur_slot_64x32 % slots_in_row * (64 / (16 / BPP));
-		vram_y = FIRST_PAGE_64x32 / 16 * 256 + cur_slot_64x32 / slots_in_row * 32;
-		slot_idx = FIRST_CLUT_64x32 + cur_slot_64x32++;
-		aligned_width = 64;
-		aligned_height = 32;
-	} else if(width <= 64 && height <= 64) {
-		static u32 cur_slot_64x64 = 0;
-		assert(cur_slot_64x64 < SLOTS_64x64);
-		u32 slots_in_row = 64 / (64 / (16 / BPP)) * PAGES_64x64;
-		vram_x = FIRST_PAGE_64x64 % 16 * 64 + cur_slot_64x64 % slots_in_row * (64 / (16 / BPP));
-		vram_y = FIRST_PAGE_64x64 / 16 * 256 + cur_slot_64x64 / slots_in_row * 64;
-		slot_idx = FIRST_CLUT_64x64 + cur_slot_64x64++;
-		aligned_width = 64;
-		aligned_height = 64;
-	} else if(width <= 128 && height <= 32) {
-		static u32 cur_slot_128x32 = 0;
-		assert(cur_slot_128x32 < SLOTS_128x32);
-		u32 slots_in_row = 64 / (128 / (16 / BPP)) * PAGES_128x32;
-		vram_x = FIRST_PAGE_128x32 % 16 * 64 + cur_slot_128x32 % slots_in_row * (128 / (16 / BPP));
-		vram_y = FIRST_PAGE_128x32 / 16 * 256 + cur_slot_128x32 / slots_in_row * 32;
-		slot_idx = FIRST_CLUT_128x32 + cur_slot_128x32++;
-		aligned_width = 128;
-		aligned_height = 32;
-	} else {
-		abortf("unhandled texture size %ux%u\n", width, height);
+	u32 class_idx = 0;
+	while(width > slot_classes[class_idx].width || height > slot_classes[class_idx].height) {
+		if(++class_idx == ARRAY_COUNT(slot_classes)) {
+			abortf("unhandled texture size %ux%u\n", width, height);
+		}
 	}
-	upload_texture(vram_x, vram_y, slot_idx, tex_header, width / (16 / BPP), aligned_height, pixel_data);
-	tex_header->window_cmd = gp0_texwindow(tex_header->offx / 8, tex_header->offy / 8, ~(aligned_width / 8 - 1), ~(aligned_height / 8 - 1));
+	const TexSlotClass* class = &slot_classes[class_idx];
+	slot_idx = alloc_slot(class_idx);
+	u32 idx_in_class = slot_idx - class->first_slot;
+	u32 slots_in_row = 256 / class->width * class->pages;
+	u32 vram_x = class->first_page % 16 * 64 + idx_in_class % slots_in_row * (class->width / (16 / BPP));
+	u32 vram_y = class->first_page / 16 * 256 + idx_in_class / slots_in_row * class->height;
+	upload_texture(vram_x, vram_y, slot_idx - 1, tex_header, width / (16 / BPP), class->height, pixel_data);
+	tex_header->window_cmd = gp0_texwindow(tex_header->offx / 8, tex_header->offy / 8, ~(class->width / 8 - 1), ~(class->height / 8 - 1));
+	tex_header->cache_slot = slot_idx;
+	tex_slots[slot_idx].owner = tex_header;
+	tex_slots[slot_idx].last_used_frame = tex_cache_frame;
+	tex_cache_stats.bytes_uploaded += (16 + width / (16 / BPP) * class->height) * 2;
+	PROFILER_COUNT(PROFILER_COUNTER_TEXTURE_BYTES, (16 + width / (16 / BPP) * class->height) * 2);
 }
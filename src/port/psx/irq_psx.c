@@ -0,0 +1,40 @@
+#include <types.h>
+#include <string.h>
+#include <assert.h>
+#include <ps1/registers.h>
+#include <ps1/cop0.h>
+#include <port/psx/cd_psx.h>
+
+// minimal interrupt support: only the cd reads and the xa music looping run off interrupts, everything else keeps polling IRQ_STAT
+// interrupts are enabled in the cpu once the handler is installed, but IRQ_MASK stays 0 unless a cd read is in progress or music is playing
+
+extern const u32 psx_irq_vector[], psx_irq_vector_end[];
+void psx_flush_icache();
+
+static bool irq_installed = false;
+
+void psx_irq_install() {
+	if(irq_installed) {
+		return;
+	}
+	IRQ_MASK = 0;
+	memcpy((void*) 0x80000080, psx_irq_vector, (uintptr_t) psx_irq_vector_end - (uintptr_t) psx_irq_vector);
+	psx_flush_icache();
+	cop0_setReg(COP0_SR, cop0_getReg(COP0_SR) | COP0_SR_Im2 | COP0_SR_IEc);
+	irq_installed = true;
+}
+
+// called from psx_irq_entry in irq_psx.s with interrupts disabled, returns the address to resume at
+u32 psx_irq_handler(u32 cause, u32 epc) {
+	if((cause & COP0_CAUSE_EXC_BITMASK) != COP0_CAUSE_EXC_INT) {
+		abortf("unhandled exception %u at %08x\n", (cause & COP0_CAUSE_EXC_BITMASK) >> 2, epc);
+	}
+#if !defined(SERIAL) && !defined(BENCH)
+	psx_cd_handle_irq();
+#endif
+	// a gte command that got interrupted has already been executed, so it must not be run again
+	if(!(cause & COP0_CAUSE_BD) && (*(const u32*) epc >> 24 & 0xFE) == 0x4A) {
+		epc += 4;
+	}
+	return epc;
+}
@@ -0,0 +1,119 @@
+// exception handling, only used for the interrupts of the cd reads (see irq_psx.c)
+
+.set noreorder
+.set noat
+
+// copied to the exception vector at 0x80000080 by psx_irq_install
+.global psx_irq_vector
+.global psx_irq_vector_end
+.balign 4
+psx_irq_vector:
+	lui $k0, %hi(psx_irq_entry)
+	addiu $k0, $k0, %lo(psx_irq_entry)
+	jr $k0
+	nop
+psx_irq_vector_end:
+
+.set IRQ_FRAME_SIZE, 96
+
+// saves the registers that C code may clobber, then calls psx_irq_handler(cause, epc) on a separate stack
+// (the interrupted code may be running with its stack in the scratchpad, which has very little room left)
+.balign 4
+psx_irq_entry:
+	move $k1, $sp
+	lui $sp, %hi(psx_irq_stack_top - IRQ_FRAME_SIZE)
+	addiu $sp, $sp, %lo(psx_irq_stack_top - IRQ_FRAME_SIZE)
+	sw $k1, 16($sp)
+	sw $at, 20($sp)
+	sw $v0, 24($sp)
+	sw $v1, 28($sp)
+	sw $a0, 32($sp)
+	sw $a1, 36($sp)
+	sw $a2, 40($sp)
+	sw $a3, 44($sp)
+	sw $t0, 48($sp)
+	sw $t1, 52($sp)
+	sw $t2, 56($sp)
+	sw $t3, 60($sp)
+	sw $t4, 64($sp)
+	sw $t5, 68($sp)
+	sw $t6, 72($sp)
+	sw $t7, 76($sp)
+	sw $t8, 80($sp)
+	sw $t9, 84($sp)
+	sw $ra, 88($sp)
+	mfhi $t0
+	mflo $t1
+	sw $t0, 0($sp)
+	sw $t1, 4($sp)
+	mfc0 $a0, $13 // cause
+	mfc0 $a1, $14 // epc
+	jal psx_irq_handler
+	nop
+	move $k0, $v0 // address to return to
+	lw $t0, 0($sp)
+	lw $t1, 4($sp)
+	mthi $t0
+	mtlo $t1
+	lw $at, 20($sp)
+	lw $v0, 24($sp)
+	lw $v1, 28($sp)
+	lw $a0, 32($sp)
+	lw $a1, 36($sp)
+	lw $a2, 40($sp)
+	lw $a3, 44($sp)
+	lw $t0, 48($sp)
+	lw $t1, 52($sp)
+	lw $t2, 56($sp)
+	lw $t3, 60($sp)
+	lw $t4, 64($sp)
+	lw $t5, 68($sp)
+	lw $t6, 72($sp)
+	lw $t7, 76($sp)
+	lw $t8, 80($sp)
+	lw $t9, 84($sp)
+	lw $ra, 88($sp)
+	lw $sp, 16($sp)
+	jr $k0
+	rfe
+
+// invalidates the whole instruction cache, needed after writing the exception vector
+// this has to run uncached, so it jumps to the kseg1 mirror of itself
+.global psx_flush_icache
+.balign 4
+psx_flush_icache:
+	lui $t0, %hi(.Lflush_uncached)
+	addiu $t0, $t0, %lo(.Lflush_uncached)
+	lui $t1, 0xA000
+	or $t0, $t0, $t1
+	jr $t0
+	nop
+.Lflush_uncached:
+	mfc0 $t2, $12 // status register
+	lui $t3, 0xFFFE
+	lw $t4, 0x130($t3) // cache control
+	li $t5, 0x804 // i-cache tag test mode
+	sw $t5, 0x130($t3)
+	lui $t5, 1 // isolate the cache, with interrupts disabled
+	mtc0 $t5, $12
+	nop
+	nop
+	li $t6, 0
+	li $t7, 0x1000
+.Lflush_loop:
+	sw $zero, 0($t6) // clears the tag of the cache line for that address
+	addiu $t6, $t6, 16
+	bne $t6, $t7, .Lflush_loop
+	nop
+	mtc0 $t2, $12
+	nop
+	nop
+	sw $t4, 0x130($t3)
+	jr $ra
+	nop
+
+.section .bss
+.balign 8
+psx_irq_stack:
+	.space 1024
+psx_irq_stack_top:
@@ -0,0 +1,99 @@
+#include <port/psx/spu_mem_psx.h>
+#include <port/cd.h>
+#include <game/memory.h>
+#include <ps1/gpu.h>
+#include <assert.h>
+
+#define SPU_MEM_MAX_BLOCKS 32
+// the uploads go through two buffers this big instead of the whole bank at once
+#define SPU_UPLOAD_CHUNK (4 * SECTOR_SIZE)
+
+typedef struct {
+	u32 addr;
+	u32 size;
+} SpuBlock;
+
+// the allocated blocks sorted by address, the gaps between them are free
+static SpuBlock blocks[SPU_MEM_MAX_BLOCKS];
+static u32 block_count = 0;
+static u32 mem_start;
+static u32 mem_end;
+
+void spu_mem_init(u32 start, u32 end) {
+	assert(start % 64 == 0 && end <= SPU_RAM_SIZE);
+	mem_start = start;
+	mem_end = end;
+	block_count = 0;
+}
+
+// first fit, the banks are few and mostly stay for the whole game so there's little to fragment
+u32 spu_mem_alloc(u32 size) {
+	assert(size % 64 == 0);
+	assertm(block_count < SPU_MEM_MAX_BLOCKS, "too many SPU RAM blocks");
+	u32 gap_start = mem_start;
+	u32 i = 0;
+	for(; i <= block_count; i++) {
+		u32 gap_end = i < block_count? blocks[i].addr: mem_end;
+		if(gap_end - gap_start >= size) {
+			break;
+		}
+		if(i == block_count) {
+			return 0;
+		}
+		gap_start = blocks[i].addr + blocks[i].size;
+	}
+	for(u32 j = block_count; j > i; j--) {
+		blocks[j] = blocks[j - 1];
+	}
+	blocks[i] = (SpuBlock) {.addr = gap_start, .size = size};
+	block_count++;
+	return gap_start;
+}
+
+void spu_mem_free(u32 addr) {
+	for(u32 i = 0; i < block_count; i++) {
+		if(blocks[i].addr == addr) {
+			block_count--;
+			for(; i < block_count; i++) {
+				blocks[i] = blocks[i + 1];
+			}
+			return;
+		}
+	}
+	abortf("freeing SPU RAM at %x that isn't allocated\n", addr);
+}
+
+u32 spu_mem_available() {
+	u32 used = 0;
+	for(u32 i = 0; i < block_count; i++) {
+		used += blocks[i].size;
+	}
+	return mem_end - mem_start - used;
+}
+
+// two buffers, so that the next chunk streams in from the cd while the previous one is going to the spu
+void spu_mem_upload(u32 addr, const u8* src, u32 size) {
+	assert(addr % 64 == 0 && size % 64 == 0);
+	if(size == 0) {
+		return;
+	}
+	enum MemoryArena prev_arena = main_pool_set_arena(MEMORY_ARENA_AUDIO);
+	u8* bufs = main_pool_alloc(2 * SPU_UPLOAD_CHUNK, MEMORY_POOL_RIGHT);
+	main_pool_set_arena(prev_arena);
+	assert(bufs);
+	u32 chunk = size < SPU_UPLOAD_CHUNK? size: SPU_UPLOAD_CHUNK;
+	CdRequest read = dma_read_submit(bufs, src, src + chunk);
+	for(u32 done = 0; done < size; done += SPU_UPLOAD_CHUNK) {
+		u8* buf = bufs + done / SPU_UPLOAD_CHUNK % 2 * SPU_UPLOAD_CHUNK;
+		chunk = size - done < SPU_UPLOAD_CHUNK? size - done: SPU_UPLOAD_CHUNK;
+		cd_read_wait(read);
+		u32 next = done + SPU_UPLOAD_CHUNK;
+		if(next < size) {
+			// sendSPUData waits for its dma, so the other buffer is free by now
+			u32 next_chunk = size - next < SPU_UPLOAD_CHUNK? size - next: SPU_UPLOAD_CHUNK;
+			read = dma_read_submit(bufs + next / SPU_UPLOAD_CHUNK % 2 * SPU_UPLOAD_CHUNK, src + next, src + next + next_chunk);
+		}
+		sendSPUData(buf, addr + done, chunk);
+	}
+	main_pool_free(bufs);
+}
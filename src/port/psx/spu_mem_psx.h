@@ -0,0 +1,13 @@
+#pragma once
+#include <types.h>
+
+// SPU RAM allocation for the sample banks, addresses and sizes are in bytes and multiples of 64 (the SPU DMA block)
+
+#define SPU_RAM_SIZE 0x80000
+
+void spu_mem_init(u32 start, u32 end);
+u32 spu_mem_alloc(u32 size); // 0 when there's no gap big enough left
+void spu_mem_free(u32 addr);
+u32 spu_mem_available();
+// reads from the cd straight into SPU RAM a few sectors at a time, src must be at the start of a sector
+void spu_mem_upload(u32 addr, const u8* src, u32 size);
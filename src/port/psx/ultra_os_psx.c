@@ -3,6 +3,7 @@
 #include <lib/src/libultra_internal.h>
 #include <macros.h>
 #include <stdbool.h>
+#include <game/profiler.h>
 
 
 uintptr_t osVirtualToPhysical(void *addr) {
@@ -26,21 +27,26 @@ struct Counter {
 
 u64 osClockRate = 1000000;
 
-OSTime osGetTime(void) {
-	if(!inited) {
-		COUNTERS[1].mode = 0x0100;
-		inited = true;
-		return 0;
-	}
-	u16 time_read = COUNTERS[1].value;
+// the value can be caught mid update, so read it until it settles
+static u16 read_counter(s32 index) {
+	u16 time_read = COUNTERS[index].value;
 	while(true) {
-		u16 reread = COUNTERS[1].value;
+		u16 reread = COUNTERS[index].value;
 		if(time_read == reread) {
-			break;
+			return time_read;
 		} else {
 			time_read = reread;
 		}
 	}
+}
+
+OSTime osGetTime(void) {
+	if(!inited) {
+		COUNTERS[1].mode = 0x0100;
+		inited = true;
+		return 0;
+	}
+	u16 time_read = read_counter(1);
 	u32 offset = time_read - last_time_read;
 	if(time_read < last_time_read) {
 		offset += 0x10000;
@@ -50,6 +56,36 @@ OSTime osGetTime(void) {
     return last_time_us;
 }
 
+// root counter 2 counts at sysclk/8 for the profiler, which is too fine for it to be kept in us like osGetTime
+// it wraps every 15 ms, less than a frame, so the hblanks counted since the last read tell how many times it did
+static u32 profiler_time = 0;
+static u16 profiler_last_read = 0;
+static u16 profiler_last_hblank_read = 0;
+static bool profiler_inited = false;
+
+u32 profiler_ticks(void) {
+	if(!profiler_inited) {
+		osGetTime(); // counter 1 counts hblanks from then on
+		COUNTERS[2].mode = 0x0200;
+		profiler_last_hblank_read = read_counter(1);
+		profiler_last_read = read_counter(2);
+		profiler_inited = true;
+		return 0;
+	}
+	u16 hblank_read = read_counter(1);
+	u16 time_read = read_counter(2);
+	u32 offset = (u16) (time_read - profiler_last_read);
+	// a scanline is 269 ticks on ntsc and 271 on pal, which is close enough as long as it's read every few seconds
+	u32 hblank_offset = (u16) (hblank_read - profiler_last_hblank_read) * 270;
+	while(offset + 0x8000 < hblank_offset) {
+		offset += 0x10000;
+	}
+	profiler_last_hblank_read = hblank_read;
+	profiler_last_read = time_read;
+	profiler_time += offset;
+	return profiler_time;
+}
+
 u32 osGetCount(void) {
     static u32 counter = 0;
     return counter++;
@@ -0,0 +1,523 @@
+#include <port/sfx_player.h>
+#include <sounds.h>
+#include <math.h>
+
+// the channels and layers run the same way as in src/audio/seqplayer.c: an op waits by setting the delay,
+// which counts down once per tatum, and a layer's note is released once its delay gets down to its gate
+
+// how far away sounds can still be heard, like the N64's default acoustic reach
+#define SFX_ACOUSTIC_REACH 20000.0f
+#define SFX_MAX_DISTANCE 22000.0f
+// sounds that aren't discrete stop when the game hasn't played them for this many frames, like on the N64,
+// and so do the looping ones in the continuous banks, the rest loop until they're stopped
+#define SFX_FRESH_FRAMES 2
+#define SFX_NO_INSTRUMENT 0xFF
+#define SFX_NO_RELEASE 0xFF
+
+// from src/audio/data.c, but stored as u16:
+// Frequencies for notes using the standard twelve-tone equal temperament scale.
+// For indices 0..116, gNoteFrequencies[k] = 2^((k-39)/12).
+// For indices 117..128, gNoteFrequencies[k] = 0.5 * 2^((k-39)/12).
+// The 39 in the formula refers to piano key 40 (middle C, at 256 Hz) being
+// the reference frequency, which is assigned value 1.
+#define UNIT 512
+static const u16 note_freq_scales[128] = {
+	0.105112f * UNIT, 0.111362f * UNIT, 0.117984f * UNIT, 0.125f * UNIT, 0.132433f * UNIT, 0.140308f * UNIT, 0.148651f * UNIT, 0.15749f * UNIT, 0.166855f * UNIT, 0.176777f * UNIT, 0.187288f * UNIT, 0.198425f * UNIT,
+	0.210224f * UNIT, 0.222725f * UNIT, 0.235969f * UNIT, 0.25f * UNIT, 0.264866f * UNIT, 0.280616f * UNIT, 0.297302f * UNIT, 0.31498f * UNIT, 0.33371f * UNIT, 0.353553f * UNIT, 0.374577f * UNIT, 0.39685f * UNIT,
+	0.420448f * UNIT, 0.445449f * UNIT, 0.471937f * UNIT, 0.5f * UNIT, 0.529732f * UNIT, 0.561231f * UNIT, 0.594604f * UNIT, 0.629961f * UNIT, 0.66742f * UNIT, 0.707107f * UNIT, 0.749154f * UNIT, 0.793701f * UNIT,
+	0.840897f * UNIT, 0.890899f * UNIT, 0.943875f * UNIT, 1.0f * UNIT, 1.059463f * UNIT, 1.122462f * UNIT, 1.189207f * UNIT, 1.259921f * UNIT, 1.33484f * UNIT, 1.414214f * UNIT, 1.498307f * UNIT, 1.587401f * UNIT,
+	1.681793f * UNIT, 1.781798f * UNIT, 1.887749f * UNIT, 2.0f * UNIT, 2.118926f * UNIT, 2.244924f * UNIT, 2.378414f * UNIT, 2.519842f * UNIT, 2.66968f * UNIT, 2.828428f * UNIT, 2.996615f * UNIT, 3.174803f * UNIT,
+	3.363586f * UNIT, 3.563596f * UNIT, 3.775498f * UNIT, 4.0f * UNIT, 4.237853f * UNIT, 4.489849f * UNIT, 4.756829f * UNIT, 5.039685f * UNIT, 5.33936f * UNIT, 5.656855f * UNIT, 5.993229f * UNIT, 6.349606f * UNIT,
+	6.727173f * UNIT, 7.127192f * UNIT, 7.550996f * UNIT, 8.0f * UNIT, 8.475705f * UNIT, 8.979697f * UNIT, 9.513658f * UNIT, 10.07937f * UNIT, 10.67872f * UNIT, 11.31371f * UNIT, 11.986459f * UNIT, 12.699211f * UNIT,
+	13.454346f * UNIT, 14.254383f * UNIT, 15.101993f * UNIT, 16.0f * UNIT, 16.95141f * UNIT, 17.959394f * UNIT, 19.027315f * UNIT, 20.15874f * UNIT, 21.35744f * UNIT, 22.62742f * UNIT, 23.972918f * UNIT, 25.398422f * UNIT,
+	26.908691f * UNIT, 28.508766f * UNIT, 30.203985f * UNIT, 32.0f * UNIT, 33.90282f * UNIT, 35.91879f * UNIT, 38.05463f * UNIT, 40.31748f * UNIT, 42.71488f * UNIT, 45.25484f * UNIT, 47.945835f * UNIT, 50.796844f * UNIT,
+	53.817383f * UNIT, 57.017532f * UNIT, 60.40797f * UNIT, 64.0f * UNIT, 67.80564f * UNIT, 71.83758f * UNIT, 76.10926f * UNIT, 80.63496f * UNIT, 85.42976f * UNIT, 45.25484f * UNIT, 47.945835f * UNIT, 50.796844f * UNIT,
+	53.817383f * UNIT, 57.017532f * UNIT, 60.40797f * UNIT, 64.0f * UNIT, 67.80564f * UNIT, 71.83758f * UNIT, 76.10926f * UNIT, 80.63496f * UNIT
+};
+
+typedef struct {
+	const u8* pc; // NULL once the layer has ended
+	u16 delay; // tatums until the next op
+	u16 release_delay; // the note is released once the delay is down to this
+	s8 voice; // -1 when no note is held, or it was stolen
+	u8 instrument; // SFX_NO_INSTRUMENT plays the channel's
+	u8 pan; // 0xFF uses the channel's
+	u8 velocity;
+	bool legato;
+	u8 portamento_mode;
+	u8 portamento_note;
+	u8 portamento_time;
+	s32 freq; // << 8, slides towards target_freq during portamentos
+	s32 target_freq;
+	s32 freq_step;
+} SfxLayer;
+
+typedef struct {
+	const u8* script; // NULL when the channel is idle
+	const u8* pc; // NULL once the channel's own ops have ended, its layers can still be playing
+	u16 delay;
+	u8 bank;
+	u8 instrument;
+	u8 pan;
+	u8 priority;
+	u8 sound_id;
+	f32* source; // the pos the sound was played from, to stop it by
+	u8 release; // SFX_NO_RELEASE uses the instrument's
+	u8 freshness;
+	bool discrete;
+	bool looped;
+	bool has_envelope;
+	u16 adsr1;
+	u16 adsr2;
+	u16 intensity; // 0-256, from the distance to the camera
+	u8 position_pan;
+	SfxLayer layers[SFX_MAX_LAYERS];
+} SfxChannel;
+
+typedef struct {
+	SfxLayer* layer; // NULL when no note holds the voice, it can still be fading out
+	u8 priority;
+	u32 age;
+} SfxVoice;
+
+u32 gSfxNotesPlayed = 0;
+u32 gSfxVoicesStolen = 0;
+u32 gSfxNotesDropped = 0;
+
+static SfxChannel channels[SOUND_BANK_COUNT];
+static SfxVoice voices[SFX_VOICE_COUNT];
+static u32 voice_counter = 0;
+static u32 silent_voices = 0;
+static u32 key_on = 0;
+static u32 key_off = 0;
+static u32 deferred_key_off = 0; // notes that were released in the frame they started in
+static u32 tatum_acc = 0;
+
+static u16 read_var(const u8** pc) {
+	u16 value = *(*pc)++;
+	if(value & 0x80) {
+		value = (value & 0x7F) << 8 | *(*pc)++;
+	}
+	return value;
+}
+
+static u16 read_u16(const u8** pc) {
+	u16 value = (*pc)[0] | (*pc)[1] << 8;
+	*pc += 2;
+	return value;
+}
+
+// a voice that has gone quiet, then the released voice that has been fading out the longest,
+// then the least important note that isn't more important than this one, the oldest first
+static s32 allocate_voice(u8 priority) {
+	s32 released = -1;
+	s32 stealable = -1;
+	for(s32 i = 0; i < SFX_VOICE_COUNT; i++) {
+		SfxVoice* voice = &voices[i];
+		if(!voice->layer) {
+			if(silent_voices & (1 << i)) {
+				return i;
+			}
+			if(released < 0 || voice->age < voices[released].age) {
+				released = i;
+			}
+		} else if(voice->priority <= priority
+			&& (stealable < 0 || voice->priority < voices[stealable].priority
+				|| (voice->priority == voices[stealable].priority && voice->age < voices[stealable].age))) {
+			stealable = i;
+		}
+	}
+	if(released >= 0) {
+		return released;
+	}
+	if(stealable >= 0) {
+		voices[stealable].layer->voice = -1;
+		voices[stealable].layer = NULL;
+		gSfxVoicesStolen++;
+		return stealable;
+	}
+	gSfxNotesDropped++;
+	return -1;
+}
+
+static void release_note(SfxLayer* layer) {
+	if(layer->voice < 0) {
+		return;
+	}
+	u32 bit = 1 << layer->voice;
+	if(key_on & bit) {
+		deferred_key_off |= bit;
+	} else {
+		key_off |= bit;
+	}
+	voices[layer->voice].layer = NULL;
+	layer->voice = -1;
+}
+
+static u16 note_freq(SampleDef sample, u32 note) {
+	u32 freq = (u32) sample.spu_freq * note_freq_scales[note] / UNIT;
+	return freq > 0x3FFF? 0x3FFF: freq;
+}
+
+static void update_volume(SfxChannel* channel, SfxLayer* layer) {
+	// the N64 scales the notes by the square of their velocity
+	u32 vol = (u32) layer->velocity * layer->velocity * channel->intensity >> 8;
+	s32 pan = (layer->pan != 0xFF? layer->pan: channel->pan) + channel->position_pan - 64;
+	pan = pan < 0? 0: pan > 127? 127: pan;
+	u32 vol_l = vol * (pan < 64? 64: 127 - pan) >> 6;
+	u32 vol_r = vol * (pan > 64? 64: pan) >> 6;
+	sfx_backend_set_volume(layer->voice, vol_l, vol_r);
+}
+
+static void play_note(SfxChannel* channel, SfxLayer* layer, u32 note, u16 delay) {
+	u8 instrument = layer->instrument != SFX_NO_INSTRUMENT? layer->instrument: channel->instrument;
+	SampleDef sample = sfx_backend_find_sample(channel->bank, instrument);
+	if(sample.as_u32 == 0) {
+		release_note(layer);
+		return;
+	}
+
+	layer->freq = note_freq(sample, note) << 8;
+	layer->freq_step = 0;
+	if(layer->portamento_mode) {
+		// slides from the portamento's note to this one, or the other way around, see seq_channel_layer_process_script
+		s32 other = note_freq(sample, layer->portamento_note) << 8;
+		u32 mode = layer->portamento_mode & 0x7F;
+		u32 tatums = layer->portamento_mode & 0x80? (u32) delay * layer->portamento_time >> 8: layer->portamento_time * SFX_TATUMS_PER_SECOND / 240;
+		if(mode == 1 || mode == 3 || mode == 5) {
+			layer->target_freq = layer->freq;
+			layer->freq = other;
+		} else {
+			layer->target_freq = other;
+		}
+		layer->freq_step = (layer->target_freq - layer->freq) / (s32) (tatums? tatums: 1);
+		if(layer->freq_step == 0) {
+			layer->freq = layer->target_freq;
+		}
+		if(mode == 1 || mode == 2) {
+			layer->portamento_mode = 0;
+		} else if(mode == 5) {
+			layer->portamento_note = note;
+		}
+	}
+
+	bool start = !layer->legato || layer->voice < 0;
+	if(layer->voice < 0) {
+		s32 voice = allocate_voice(channel->priority);
+		if(voice < 0) {
+			return;
+		}
+		layer->voice = voice;
+		voices[voice].layer = layer;
+		voices[voice].priority = channel->priority;
+	}
+	if(start) {
+		u32 adsr = sfx_instrument_adsr[channel->bank][instrument];
+		u16 adsr1 = adsr;
+		u16 adsr2 = adsr >> 16;
+		if(channel->has_envelope) {
+			adsr1 = channel->adsr1;
+			adsr2 = (channel->adsr2 & ~0x3F) | (adsr2 & 0x3F);
+		}
+		if(channel->release != SFX_NO_RELEASE) {
+			adsr2 = (adsr2 & ~0x3F) | channel->release;
+		}
+		sfx_backend_set_voice(layer->voice, sample.spu_addr, adsr1, adsr2);
+		u32 bit = 1 << layer->voice;
+		key_on |= bit;
+		key_off &= ~bit;
+		deferred_key_off &= ~bit;
+		voices[layer->voice].age = voice_counter++;
+		gSfxNotesPlayed++;
+	}
+	sfx_backend_set_pitch(layer->voice, layer->freq >> 8);
+	update_volume(channel, layer);
+}
+
+static void start_layer(SfxLayer* layer, const u8* pc) {
+	release_note(layer);
+	*layer = (SfxLayer) {
+		.pc = pc,
+		.voice = -1,
+		.instrument = SFX_NO_INSTRUMENT,
+		.pan = 0xFF,
+	};
+}
+
+static void layer_tatum(SfxChannel* channel, SfxLayer* layer) {
+	if(layer->freq_step && layer->voice >= 0) {
+		layer->freq += layer->freq_step;
+		if((layer->freq_step > 0 && layer->freq >= layer->target_freq) || (layer->freq_step < 0 && layer->freq <= layer->target_freq)) {
+			layer->freq = layer->target_freq;
+			layer->freq_step = 0;
+		}
+		sfx_backend_set_pitch(layer->voice, layer->freq >> 8);
+	}
+	if(layer->delay > 0) {
+		layer->delay--;
+		if(layer->delay > 0) {
+			if(layer->delay <= layer->release_delay && !layer->legato) {
+				release_note(layer);
+			}
+			return;
+		}
+	}
+	for(u32 ops = 0; ops < SFX_MAX_OPS_PER_TATUM && layer->delay == 0 && layer->pc; ops++) {
+		u8 op = *layer->pc++;
+		if(op < SFX_OP_WAIT) {
+			layer->velocity = *layer->pc++;
+			u8 gate = *layer->pc++;
+			layer->delay = read_var(&layer->pc);
+			layer->release_delay = gate * layer->delay >> 8;
+			if(!layer->legato) {
+				release_note(layer);
+			}
+			play_note(channel, layer, op, layer->delay);
+			continue;
+		}
+		switch(op) {
+			case SFX_OP_WAIT:
+				release_note(layer);
+				layer->delay = read_var(&layer->pc);
+				break;
+			case SFX_OP_INSTR:
+				layer->instrument = *layer->pc++;
+				break;
+			case SFX_OP_PAN:
+				layer->pan = *layer->pc++;
+				break;
+			case SFX_OP_PORTAMENTO:
+				layer->portamento_mode = layer->pc[0];
+				layer->portamento_note = layer->pc[1];
+				layer->portamento_time = layer->pc[2];
+				layer->pc += 3;
+				break;
+			case SFX_OP_PORTAMENTO_OFF:
+				layer->portamento_mode = 0;
+				break;
+			case SFX_OP_LEGATO:
+				layer->legato = *layer->pc++;
+				break;
+			case SFX_OP_JUMP:
+				layer->pc = channel->script + read_u16(&layer->pc);
+				channel->looped = true;
+				break;
+			default: // SFX_OP_END
+				release_note(layer);
+				layer->pc = NULL;
+				break;
+		}
+	}
+}
+
+static void channel_tatum(SfxChannel* channel) {
+	if(channel->delay > 0) {
+		channel->delay--;
+	}
+	for(u32 ops = 0; ops < SFX_MAX_OPS_PER_TATUM && channel->delay == 0 && channel->pc; ops++) {
+		u8 op = *channel->pc++;
+		switch(op) {
+			case SFX_OP_WAIT:
+				channel->delay = read_var(&channel->pc);
+				break;
+			case SFX_OP_BANK:
+				channel->bank = *channel->pc++;
+				break;
+			case SFX_OP_INSTR:
+				channel->instrument = *channel->pc++;
+				break;
+			case SFX_OP_ENVELOPE:
+				channel->adsr1 = read_u16(&channel->pc);
+				channel->adsr2 = read_u16(&channel->pc);
+				channel->has_envelope = true;
+				break;
+			case SFX_OP_RELEASE:
+				channel->release = *channel->pc++;
+				break;
+			case SFX_OP_PAN:
+				channel->pan = *channel->pc++;
+				break;
+			case SFX_OP_LAYER: {
+				u8 idx = *channel->pc++;
+				start_layer(&channel->layers[idx], channel->script + read_u16(&channel->pc));
+				break;
+			}
+			case SFX_OP_FREE_LAYER:
+				start_layer(&channel->layers[*channel->pc++], NULL);
+				break;
+			default: // SFX_OP_END
+				channel->pc = NULL;
+				break;
+		}
+	}
+
+	bool playing = channel->pc != NULL;
+	for(u32 i = 0; i < SFX_MAX_LAYERS; i++) {
+		if(channel->layers[i].pc) {
+			layer_tatum(channel, &channel->layers[i]);
+			playing |= channel->layers[i].pc != NULL;
+		}
+	}
+	if(!playing) {
+		channel->script = NULL;
+	}
+}
+
+static void stop_channel(SfxChannel* channel) {
+	for(u32 i = 0; i < SFX_MAX_LAYERS; i++) {
+		start_layer(&channel->layers[i], NULL);
+	}
+	channel->script = NULL;
+	channel->pc = NULL;
+}
+
+static f32 get_sound_pan(f32 x, f32 z) {
+	// same as in src/audio/external.c
+	f32 absX = x < 0? -x: x;
+	f32 absZ = z < 0? -z: z;
+	absX = absX > SFX_MAX_DISTANCE? SFX_MAX_DISTANCE: absX;
+	absZ = absZ > SFX_MAX_DISTANCE? SFX_MAX_DISTANCE: absZ;
+	if(x == 0.0f && z == 0.0f) {
+		return 0.5f;
+	} else if(x >= 0.0f && absX >= absZ) {
+		return 1.0f - (2 * SFX_MAX_DISTANCE - absX) / (3.0f * (2 * SFX_MAX_DISTANCE - absZ));
+	} else if(x < 0 && absX > absZ) {
+		return (2 * SFX_MAX_DISTANCE - absX) / (3.0f * (2 * SFX_MAX_DISTANCE - absZ));
+	} else {
+		return 0.5f + x / (6.0f * absZ);
+	}
+}
+
+static void set_position(SfxChannel* channel, u32 bank, s32 soundBits, f32* pos) {
+	u16 intensity = 256;
+	u8 position_pan = 64;
+	if(pos) {
+		f32 distance = sqrtf(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+		if(!(soundBits & SOUND_NO_VOLUME_LOSS)) {
+			// the same falloff as the N64's with the default reach and a volume range of 1
+			f32 reach = SFX_ACOUSTIC_REACH / (bank < 3? 2: 3);
+			intensity = distance >= reach? 0: (u16) (256.0f - distance / reach * 256.0f);
+		}
+		f32 pan = get_sound_pan(pos[0], pos[2]);
+		position_pan = pan <= 0.0f? 0: pan >= 1.0f? 127: (u8) (pan * 127.0f);
+	}
+	if(intensity != channel->intensity || position_pan != channel->position_pan) {
+		channel->intensity = intensity;
+		channel->position_pan = position_pan;
+		for(u32 i = 0; i < SFX_MAX_LAYERS; i++) {
+			if(channel->layers[i].voice >= 0) {
+				update_volume(channel, &channel->layers[i]);
+			}
+		}
+	}
+}
+
+void sfx_player_init() {
+	for(u32 i = 0; i < SOUND_BANK_COUNT; i++) {
+		stop_channel(&channels[i]);
+	}
+	for(u32 i = 0; i < SFX_VOICE_COUNT; i++) {
+		voices[i].layer = NULL;
+	}
+	key_on = key_off = deferred_key_off = 0;
+	silent_voices = ~0u;
+}
+
+void sfx_player_play(s32 soundBits, f32* pos) {
+	u32 bank = ((u32) soundBits & SOUNDARGS_MASK_BANK) >> SOUNDARGS_SHIFT_BANK;
+	u32 id = ((u32) soundBits & SOUNDARGS_MASK_SOUNDID) >> SOUNDARGS_SHIFT_SOUNDID;
+	u8 priority = ((u32) soundBits & SOUNDARGS_MASK_PRIORITY) >> SOUNDARGS_SHIFT_PRIORITY;
+	if(bank >= SOUND_BANK_COUNT || id >= sfx_count_per_channel[bank] || !sfx_defs_per_channel[bank][id].script) {
+		return;
+	}
+	const u8* script = sfx_defs_per_channel[bank][id].script;
+	SfxChannel* channel = &channels[bank];
+	if(channel->script == script && !(soundBits & SOUND_DISCRETE)) {
+		channel->freshness = SFX_FRESH_FRAMES;
+		channel->source = pos;
+		set_position(channel, bank, soundBits, pos);
+		return;
+	}
+	// like the N64, each bank plays one sound at a time and the most important one wins
+	if(channel->script && priority < channel->priority) {
+		return;
+	}
+	stop_channel(channel);
+	channel->script = script;
+	channel->pc = script;
+	channel->delay = 0;
+	channel->bank = 0;
+	channel->instrument = 0;
+	channel->pan = 64;
+	channel->priority = priority;
+	channel->sound_id = id;
+	channel->source = pos;
+	channel->release = SFX_NO_RELEASE;
+	channel->freshness = SFX_FRESH_FRAMES;
+	channel->discrete = (soundBits & SOUND_DISCRETE) != 0;
+	channel->looped = false;
+	channel->has_envelope = false;
+	channel->intensity = 0xFFFF; // makes set_position set it
+	set_position(channel, bank, soundBits, pos);
+}
+
+void sfx_player_stop(s32 soundBits, f32* pos) {
+	u32 bank = ((u32) soundBits & SOUNDARGS_MASK_BANK) >> SOUNDARGS_SHIFT_BANK;
+	u32 id = ((u32) soundBits & SOUNDARGS_MASK_SOUNDID) >> SOUNDARGS_SHIFT_SOUNDID;
+	// like the N64, only the sound played from that same pos
+	if(bank < SOUND_BANK_COUNT && channels[bank].script && channels[bank].sound_id == id && channels[bank].source == pos) {
+		stop_channel(&channels[bank]);
+	}
+}
+
+void sfx_player_stop_from_source(f32* pos) {
+	for(u32 i = 0; i < SOUND_BANK_COUNT; i++) {
+		if(channels[i].script && channels[i].source == pos) {
+			stop_channel(&channels[i]);
+		}
+	}
+}
+
+void sfx_player_stop_banks(u32 bank_mask) {
+	for(u32 i = 0; i < SOUND_BANK_COUNT; i++) {
+		if(bank_mask & (1 << i)) {
+			stop_channel(&channels[i]);
+		}
+	}
+}
+
+void sfx_player_stop_all() {
+	sfx_player_stop_banks(SOUND_BANKS_ALL);
+}
+
+void sfx_player_tick() {
+	silent_voices = sfx_backend_silent_voices();
+	key_off |= deferred_key_off;
+	deferred_key_off = 0;
+
+	for(u32 i = 0; i < SOUND_BANK_COUNT; i++) {
+		SfxChannel* channel = &channels[i];
+		if(channel->script && (!channel->discrete || (channel->looped && (SFX_CONTINUOUS_BANKS & (1 << i))))) {
+			if(channel->freshness == 0) {
+				stop_channel(channel);
+			} else {
+				channel->freshness--;
+			}
+		}
+	}
+
+	// 3.2 tatums per frame at 30 fps
+	tatum_acc += SFX_TATUMS_PER_SECOND;
+	while(tatum_acc >= 30) {
+		tatum_acc -= 30;
+		for(u32 i = 0; i < SOUND_BANK_COUNT; i++) {
+			if(channels[i].script) {
+				channel_tatum(&channels[i]);
+			}
+		}
+	}
+
+	sfx_backend_flush(key_on, key_off);
+	key_on = 0;
+	key_off = 0;
+}
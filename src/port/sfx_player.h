@@ -0,0 +1,36 @@
+#pragma once
+#include <types.h>
+#include <port/audio_data.h>
+#include <sounds.h>
+
+// plays the sound player's sounds (converted by tools/sound_player_to_c.py) on the hardware voices
+// one channel per sound bank, like the N64 sound player, their layers' notes share the voices by priority
+
+#define SFX_VOICE_COUNT 24
+// the sound player runs at tempo 120, 48 tatums per beat
+#define SFX_TATUMS_PER_SECOND 96
+// a channel or layer runs at most this many ops per tatum, so a frame never costs more than
+// SOUND_BANK_COUNT * (1 + SFX_MAX_LAYERS) * SFX_MAX_OPS_PER_TATUM * 4 tatums of them whatever the sounds do
+#define SFX_MAX_OPS_PER_TATUM 16
+// the banks that are mostly continuous sounds, like stop_sounds_in_continuous_banks's on the N64
+#define SFX_CONTINUOUS_BANKS ((1 << SOUND_BANK_MOVING) | (1 << SOUND_BANK_ENV) | (1 << SOUND_BANK_AIR))
+
+void sfx_player_init();
+void sfx_player_play(s32 soundBits, f32* pos);
+void sfx_player_stop(s32 soundBits, f32* pos); // the sound if it's still playing from pos
+void sfx_player_stop_from_source(f32* pos);
+void sfx_player_stop_banks(u32 bank_mask);
+void sfx_player_stop_all();
+void sfx_player_tick(); // once per 30 fps frame
+
+extern u32 gSfxNotesPlayed;
+extern u32 gSfxVoicesStolen; // notes cut off to play more important ones
+extern u32 gSfxNotesDropped; // notes that found every voice busy with more important ones
+
+// the audio backend's side, the voice settings take effect with the next sfx_backend_flush
+SampleDef sfx_backend_find_sample(u32 bank, u32 instrument); // 0 when there's no sample
+void sfx_backend_set_voice(u32 voice, u16 spu_addr, u16 adsr1, u16 adsr2);
+void sfx_backend_set_pitch(u32 voice, u16 freq);
+void sfx_backend_set_volume(u32 voice, u16 vol_l, u16 vol_r);
+u32 sfx_backend_silent_voices(); // mask of the voices whose envelope has run out
+void sfx_backend_flush(u32 key_on, u32 key_off); // masks of the voices to start and release
@@ -0,0 +1,472 @@
+import sys
+import re
+import struct
+
+# usage: bake_collision.py <areas/N/collision.inc.c> <out collision.baked.inc.c> [--max-split N] [--bytes-per-candidate N] [-DDEFINITION=VALUE...]
+# runs what load_area_terrain does for the area terrains (the ones used with TERRAIN() in the level's script.c) at build time:
+# the surfaces are read, given their normals and sorted into the static partition cells the same way surface_load.c does it,
+# and written out as a struct BakedTerrain holding the surfaces and the sorted surface index lists of every cell,
+# which the queries in surface_collision.c walk directly
+# cells with long lists get split into up to 4x4 subcells, each with the part of the cell's lists that can be hit from inside it,
+# which is worth it when it saves enough candidates per query for the memory it takes (see choose_split)
+# every surface also gets the range of query heights that can hit it, so most of them get skipped without being read,
+# and every floor the height up to which the floor cache can return it without walking the list
+# the terrain array itself is cut down to a TERRAIN_LOAD_BAKED header followed by the special objects and environment regions
+# every other array in the file is copied over untouched
+# the logic below HAS to be kept in sync with read_surface_data, add_surface and add_surface_to_cell in surface_load.c,
+# and with the tests in surface_collision.c
+
+# must match surface_collision.h and surface_load.h
+LEVEL_BOUNDARY_MAX = 0x2000
+CELL_SIZE = 0x400
+NUM_CELLS = 2 * LEVEL_BOUNDARY_MAX // CELL_SIZE
+FRACT_BITS = 12
+COMPRESSED_NORMAL_ONE = 120
+NO_SURFACE = 0xFFFF
+CELL_SIZE_SHIFT = 10
+MAX_WALL_RADIUS = 200
+FLOOR_BUFFER = 78
+
+FORCE_TYPES = {"SURFACE_0004", "SURFACE_FLOWING_WATER", "SURFACE_DEEP_MOVING_QUICKSAND", "SURFACE_SHALLOW_MOVING_QUICKSAND",
+	"SURFACE_MOVING_QUICKSAND", "SURFACE_HORIZONTAL_WIND", "SURFACE_INSTANT_MOVING_QUICKSAND"}
+NO_CAM_TYPES = {"SURFACE_NO_CAM_COLLISION", "SURFACE_NO_CAM_COLLISION_77", "SURFACE_NO_CAM_COL_VERY_SLIPPERY", "SURFACE_SWITCH"}
+
+# must match BAKED_CELL_MAX_SPLIT in surface_load.h
+max_split = 2
+# how many bytes splitting a cell can take for each candidate it saves the average query there
+bytes_per_candidate = 32
+definitions: set[str] = set()
+in_path = ""
+
+with open("include/surface_terrains.h", "r") as header:
+	surface_type_values = dict((name, int(value, 0)) for name, value in re.findall(r"^#define (SURFACE_\w+)\s+(0x[0-9A-Fa-f]+|\d+)\b", header.read(), re.MULTILINE))
+type_names = {}
+for name, value in surface_type_values.items():
+	type_names.setdefault(value, name)
+
+def f32(x: float) -> float:
+	return struct.unpack("<f", struct.pack("<f", x))[0]
+
+def sqrtf(x: float) -> float:
+	# the approximation from float_math.c
+	bits = struct.unpack("<I", struct.pack("<f", x))[0]
+	return struct.unpack("<f", struct.pack("<I", (bits >> 1) + ((1 << 29) - (1 << 22) - 0x4B0D2)))[0]
+
+def s16(x: int) -> int:
+	return (x + 0x8000 & 0xFFFF) - 0x8000
+
+def s32(x: int) -> int:
+	return (x + 0x80000000 & 0xFFFFFFFF) - 0x80000000
+
+def ftoq(x: float) -> int:
+	# truncates towards zero like the one in float_math.c
+	q = int(x * (1 << FRACT_BITS))
+	return q if -0x80000000 < q < 0x80000000 else -0x80000000
+
+def c_div(a: int, b: int) -> int:
+	return abs(a) // abs(b) * (1 if (a < 0) == (b < 0) else -1)
+
+def strip_conditionals(text: str) -> str:
+	# only the #ifdef/#ifndef/#else/#endif that the collision files use
+	out = []
+	stack: list[bool] = []
+	for line in text.splitlines(keepends = True):
+		directive = line.strip()
+		if directive.startswith("#ifdef") or directive.startswith("#ifndef"):
+			name = directive.split()[1]
+			stack.append((name in definitions) == directive.startswith("#ifdef"))
+		elif directive.startswith("#else"):
+			stack[-1] = not stack[-1]
+		elif directive.startswith("#endif"):
+			stack.pop()
+		elif directive.startswith("#if") or directive.startswith("#elif"):
+			raise RuntimeError(f"unhandled condition in {in_path}: {directive}")
+		elif all(stack):
+			out.append(line)
+	assert not stack, f"unmatched conditional directive in {in_path}"
+	return "".join(out)
+
+def strip_comments(text: str) -> str:
+	return re.sub(r"//[^\n]*|/\*.*?\*/", "", text, flags = re.DOTALL)
+
+def level_dir(path: str) -> str:
+	match = re.search(r"(levels/\w+)/areas/\d+/", path)
+	assert match, f"{path} isn't an area collision file"
+	return match.group(1)
+
+def read_array_names(path: str, macro: str) -> list[str]:
+	try:
+		with open(path, "r") as script_file:
+			script = strip_comments(script_file.read())
+	except FileNotFoundError:
+		return []
+	return re.findall(macro + r"\(\s*(\w+)\s*\)", script)
+
+def read_rooms(path: str, names: list[str]) -> list[int] | None:
+	try:
+		with open(path, "r") as rooms_file:
+			text = strip_comments(strip_conditionals(rooms_file.read()))
+	except FileNotFoundError:
+		return None
+	for name, body in re.findall(r"const u8 (\w+)\[\] = \{(.*?)\};", text, re.DOTALL):
+		if name in names:
+			return [int(value, 0) for value in body.replace("\n", " ").split(",") if value.strip()]
+	return None
+
+class Surface:
+	__slots__ = "type", "force", "flags", "room", "lower_y", "upper_y", "vertices", "normal", "origin_offset", "list_idx"
+
+def read_surface(vertices: list[tuple[int, int, int]], indices: list[int]) -> Surface | None:
+	# see read_surface_data, the float math is done in single precision with round to nearest. the console's
+	# soft float doesn't always round the same way, so a normal can be off by one unit from the runtime's
+	(x1, y1, z1), (x2, y2, z2), (x3, y3, z3) = (vertices[i] for i in indices)
+	nx = f32(s32((y2 - y1) * (z3 - z2) - (z2 - z1) * (y3 - y2)))
+	ny = f32(s32((z2 - z1) * (x3 - x2) - (x2 - x1) * (z3 - z2)))
+	nz = f32(s32((x2 - x1) * (y3 - y2) - (y2 - y1) * (x3 - x2)))
+	mag = sqrtf(f32(f32(f32(nx * nx) + f32(ny * ny)) + f32(nz * nz)))
+	if mag == 0:
+		return None
+	mag = f32(1 / mag)
+	nx = f32(nx * mag)
+	ny = f32(ny * mag)
+	nz = f32(nz * mag)
+	surface = Surface()
+	surface.vertices = [(x1, y1, z1), (x2, y2, z2), (x3, y3, z3)]
+	surface.normal = tuple(c_div(ftoq(n) * COMPRESSED_NORMAL_ONE, 1 << FRACT_BITS) for n in (nx, ny, nz))
+	surface.origin_offset = ftoq(-f32(f32(f32(nx * x1) + f32(ny * y1)) + f32(nz * z1)))
+	surface.lower_y = min(y1, y2, y3) - 5
+	surface.upper_y = max(y1, y2, y3) + 5
+	return surface
+
+def lower_cell_index(coord: int) -> int:
+	coord = max(s16(coord + LEVEL_BOUNDARY_MAX), 0)
+	index = coord // CELL_SIZE
+	if coord % CELL_SIZE < 50:
+		index -= 1
+	return max(index, 0)
+
+def upper_cell_index(coord: int) -> int:
+	coord = max(s16(coord + LEVEL_BOUNDARY_MAX), 0)
+	index = coord // CELL_SIZE
+	if coord % CELL_SIZE > CELL_SIZE - 50:
+		index += 1
+	return min(index, NUM_CELLS - 1)
+
+def partition(surfaces: list[Surface]) -> list[list[list[list[int]]]]:
+	# see add_surface and add_surface_to_cell, each cell keeps [floors, ceilings, walls] as lists of surface indices
+	cells = [[[[], [], []] for _ in range(NUM_CELLS)] for _ in range(NUM_CELLS)]
+	for surface_idx, surface in enumerate(surfaces):
+		normal_y = surface.normal[1]
+		if normal_y > int(0.01 * COMPRESSED_NORMAL_ONE):
+			list_idx, sort_dir = 0, 1
+		elif normal_y < int(-0.01 * COMPRESSED_NORMAL_ONE):
+			list_idx, sort_dir = 1, -1
+		else:
+			list_idx, sort_dir = 2, 0
+			if abs(surface.normal[0]) > int(0.707 * COMPRESSED_NORMAL_ONE) and "SURFACE_FLAG_X_PROJECTION" not in surface.flags:
+				surface.flags.append("SURFACE_FLAG_X_PROJECTION")
+		surface.list_idx = list_idx
+		priority = s16(surface.vertices[0][1] * sort_dir)
+		xs = [v[0] for v in surface.vertices]
+		zs = [v[2] for v in surface.vertices]
+		for cell_z in range(lower_cell_index(min(zs)), upper_cell_index(max(zs)) + 1):
+			for cell_x in range(lower_cell_index(min(xs)), upper_cell_index(max(xs)) + 1):
+				cell_list = cells[cell_z][cell_x][list_idx]
+				# goes after everything with a priority at least as high
+				pos = len(cell_list)
+				for i, other_idx in enumerate(cell_list):
+					if priority > s16(surfaces[other_idx].vertices[0][1] * sort_dir):
+						pos = i
+						break
+				cell_list.insert(pos, surface_idx)
+	return cells
+
+def y_range(surface: Surface) -> tuple[int, int]:
+	# the query heights that can hit the surface, see the baked list walkers in surface_collision.c
+	if surface.list_idx == 2:
+		return surface.lower_y, surface.upper_y
+	# the height floor/ceil_height_at computes is linear over the triangle, so its extremes are at the vertices
+	# (the division by ny keeps the order), if it can overflow anywhere no range is given
+	nxq, nyq, nzq = (c_div(n << FRACT_BITS, COMPRESSED_NORMAL_ONE) for n in surface.normal)
+	heights = [c_div(-(x * nxq + nzq * z + surface.origin_offset) << FRACT_BITS, nyq) for x, _, z in surface.vertices]
+	buffer = FLOOR_BUFFER << FRACT_BITS
+	if surface.list_idx == 0:
+		lowest = min(heights) - buffer
+		return (max(lowest >> FRACT_BITS, -0x8000) if -0x80000000 <= lowest and max(heights) < 0x80000000 else -0x8000), 0x7FFF
+	highest = max(heights) + buffer
+	return -0x8000, (min(highest >> FRACT_BITS, 0x7FFF) if highest < 0x80000000 and min(heights) >= -0x80000000 else 0x7FFF)
+
+def interiors_overlap(a: Surface, b: Surface) -> bool:
+	# whether the xz projections of two triangles overlap by more than their edges, flat ones count as overlapping anything
+	pa = [(x, z) for x, _, z in a.vertices]
+	pb = [(x, z) for x, _, z in b.vertices]
+	for poly in (pa, pb):
+		(x1, z1), (x2, z2), (x3, z3) = poly
+		if (x2 - x1) * (z3 - z1) - (z2 - z1) * (x3 - x1) == 0:
+			return True
+	# separating axis test, the projections can touch but not overlap on one of the edge normals
+	for poly in (pa, pb):
+		for i in range(3):
+			(x1, z1), (x2, z2) = poly[i], poly[(i + 1) % 3]
+			proj_a = [(z2 - z1) * x + (x1 - x2) * z for x, z in pa]
+			proj_b = [(z2 - z1) * x + (x1 - x2) * z for x, z in pb]
+			if max(proj_a) <= min(proj_b) or max(proj_b) <= min(proj_a):
+				return False
+	return True
+
+def floor_cache_limits(surfaces: list[Surface], coarse: list[list[list[list[int]]]], y_ranges: list[tuple[int, int]]) -> list[int]:
+	# for the floor cache in surface_collision.c: a query strictly inside a floor can only hit the floors before it in the lists
+	# that overlap it, so the walk finds the floor again as long as the query is below where all of those start being hit
+	# the order of the lists is the same in every cell (by priority, then load order), so this holds in all of them
+	limits = [0x7FFF] * len(surfaces)
+	checked = set()
+	for row in coarse:
+		for cell in row:
+			floors = cell[0]
+			for k, floor_idx in enumerate(floors):
+				for other_idx in floors[:k]:
+					if (other_idx, floor_idx) in checked or y_ranges[other_idx][0] >= limits[floor_idx]:
+						continue
+					checked.add((other_idx, floor_idx))
+					if interiors_overlap(surfaces[other_idx], surfaces[floor_idx]):
+						limits[floor_idx] = y_ranges[other_idx][0]
+	return limits
+
+def wall_projection_margin(surface: Surface) -> int | None:
+	# how far out of the triangle (on the axis it's projected along) push_from_wall can still let a point through,
+	# because of the truncations in its edge tests. a point that's d units out is at least area * d / span away
+	# from one of the edges, while the error grows by d / 16, see the error bound below. None for slivers
+	w_axis = 2 if "SURFACE_FLAG_X_PROJECTION" in surface.flags else 0
+	ws = [v[w_axis] for v in surface.vertices]
+	ys = [v[1] for v in surface.vertices]
+	(w1, y1), (w2, y2), (w3, y3) = zip(ws, ys)
+	area = abs((w2 - w1) * (y3 - y1) - (w3 - w1) * (y2 - y1)) / 2
+	span_w = max(ws) - min(ws)
+	span_y = max(ys) - min(ys)
+	if span_w == 0:
+		return 0 if area > 0 else None
+	growth = 16 * area / span_w - 1 / 16
+	if growth <= 0:
+		return None
+	# each qmul of the /16 truncated factors is off by at most (|a| + |b|) / 16 + 1
+	error = (2 * span_y + 2 * span_w + 5) / 16 + 2.1
+	return int(error / growth) + 2
+
+def can_hit(surface: Surface, x0: int, x1: int, z0: int, z1: int) -> bool:
+	# whether a query whose truncated position is in x0..x1, z0..z1 can hit the surface
+	xs = [v[0] for v in surface.vertices]
+	zs = [v[2] for v in surface.vertices]
+	if surface.list_idx != 2:
+		# the edge tests are exact, the point has to be in the triangle
+		return min(xs) <= x1 and max(xs) >= x0 and min(zs) <= z1 and max(zs) >= z0
+	# the wall tests work on the untruncated position, anywhere up to the next unit
+	lo_x, hi_x, lo_z, hi_z = x0, x1 + 1, z0, z1 + 1
+	margin = wall_projection_margin(surface)
+	if margin is not None:
+		if "SURFACE_FLAG_X_PROJECTION" in surface.flags:
+			lo_z, hi_z = max(lo_z, min(zs) - margin), min(hi_z, max(zs) + margin)
+		else:
+			lo_x, hi_x = max(lo_x, min(xs) - margin), min(hi_x, max(xs) + margin)
+		if lo_x > hi_x or lo_z > hi_z:
+			return False
+	# the offset from the plane is computed from truncated coordinates and products, which puts it off by less than 6
+	lowest = highest = surface.origin_offset / (1 << FRACT_BITS)
+	for n, lo, hi in zip(surface.normal, (lo_x, surface.lower_y, lo_z), (hi_x, surface.upper_y, hi_z)):
+		lowest += min(n * lo, n * hi) / COMPRESSED_NORMAL_ONE
+		highest += max(n * lo, n * hi) / COMPRESSED_NORMAL_ONE
+	return lowest <= MAX_WALL_RADIUS + 7 and highest >= -MAX_WALL_RADIUS - 7
+
+def split_cell(surfaces: list[Surface], cell: list[list[int]], cell_x: int, cell_z: int, split: int) -> list[list[list[int]]]:
+	# the lists of the subcells, row by row, in the order of the cell's lists
+	size = CELL_SIZE >> split
+	corner_x = cell_x * CELL_SIZE - LEVEL_BOUNDARY_MAX
+	corner_z = cell_z * CELL_SIZE - LEVEL_BOUNDARY_MAX
+	subcells = []
+	for sub_z in range(1 << split):
+		for sub_x in range(1 << split):
+			x0 = corner_x + sub_x * size
+			z0 = corner_z + sub_z * size
+			subcells.append([[i for i in cell_list if can_hit(surfaces[i], x0, x0 + size - 1, z0, z0 + size - 1)] for cell_list in cell])
+	return subcells
+
+def choose_split(surfaces: list[Surface], cell: list[list[int]], cell_x: int, cell_z: int) -> tuple[int, list[list[list[int]]]]:
+	# the split with the fewest candidates per query on average, counting the memory it takes against it
+	best = None
+	for split in range(max_split + 1):
+		subcells = split_cell(surfaces, cell, cell_x, cell_z, split)
+		candidates = sum(len(cell_list) for lists in subcells for cell_list in lists) / len(subcells)
+		size = sum(2 * (len(cell_list) + 1) for lists in subcells for cell_list in lists if cell_list) + 2 * 3 * len(subcells)
+		cost = candidates + size / bytes_per_candidate
+		if best is None or cost < best[0]:
+			best = (cost, split, subcells)
+	return best[1], best[2]
+
+class Grid:
+	__slots__ = "indices", "lists", "cells", "coarse", "y_ranges"
+
+def build_grid(surfaces: list[Surface]) -> Grid:
+	# all the lists go back to back, each one terminated by NO_SURFACE, identical lists are only stored once
+	grid = Grid()
+	grid.indices = [NO_SURFACE]
+	grid.lists = []
+	grid.cells = []
+	list_starts = {(): 0}
+	def add_list(cell_list: list[int]) -> int:
+		key = tuple(cell_list)
+		if key not in list_starts:
+			list_starts[key] = len(grid.indices)
+			grid.indices += cell_list + [NO_SURFACE]
+		return list_starts[key]
+	grid.coarse = partition(surfaces)
+	grid.y_ranges = [y_range(surface) for surface in surfaces]
+	# floors only use the lower end of their range, the upper one is free for their floor cache limit
+	for i, limit in enumerate(floor_cache_limits(surfaces, grid.coarse, grid.y_ranges)):
+		if surfaces[i].list_idx == 0:
+			grid.y_ranges[i] = (grid.y_ranges[i][0], limit)
+	for cell_z, row in enumerate(grid.coarse):
+		for cell_x, cell in enumerate(row):
+			split, subcells = choose_split(surfaces, cell, cell_x, cell_z) if any(cell) else (0, [cell])
+			grid.cells.append((len(grid.lists), add_list(cell[2]), split))
+			for lists in subcells:
+				grid.lists += [add_list(cell_list) for cell_list in lists]
+	assert len(grid.indices) < NO_SURFACE and len(grid.lists) < NO_SURFACE, "too many surface lists"
+	return grid
+
+def read_terrain(name: str, body: str, rooms: list[int] | None) -> tuple[list[Surface], list[str], int]:
+	# returns the surfaces, the calls to keep after the TERRAIN_LOAD_BAKED header and how many triangles there were
+	calls = re.findall(r"(\w+)\(([^()]*)\)", body)
+	kept_calls: list[str] = []
+	vertices: list[tuple[int, int, int]] = []
+	surfaces: list[Surface] = []
+	surface_count = 0
+	i = 0
+	while i < len(calls):
+		macro, args = calls[i]
+		args = [arg.strip() for arg in args.split(",") if arg.strip()]
+		i += 1
+		match macro:
+			case "COL_INIT" | "COL_TRI_STOP":
+				pass
+			case "COL_VERTEX_INIT":
+				count = int(args[0], 0)
+				vertices = [tuple(int(arg, 0) for arg in calls[i + j][1].split(",")) for j in range(count)]
+				assert all(calls[i + j][0] == "COL_VERTEX" for j in range(count))
+				i += count
+			case "COL_TRI_INIT":
+				surface_type = surface_type_values[args[0]] if args[0] in surface_type_values else int(args[0], 0)
+				type_name = type_names.get(surface_type, str(surface_type))
+				has_force = type_name in FORCE_TYPES
+				for j in range(int(args[1], 0)):
+					tri_macro, tri_args = calls[i + j]
+					assert tri_macro == ("COL_TRI_SPECIAL" if has_force else "COL_TRI"), f"unexpected {tri_macro} in {name}"
+					tri_args = [int(arg, 0) for arg in tri_args.split(",")]
+					room = rooms[surface_count] if rooms is not None else 0
+					surface_count += 1
+					surface = read_surface(vertices, tri_args[:3])
+					if surface is not None:
+						surface.type = type_name
+						surface.force = tri_args[3] if has_force else 0
+						surface.flags = ["SURFACE_FLAG_NO_CAM_COLLISION"] if type_name in NO_CAM_TYPES else []
+						surface.room = room if room < 128 else room - 256
+						surfaces.append(surface)
+				i += int(args[1], 0)
+			case "COL_SPECIAL_INIT" | "COL_WATER_BOX_INIT" | "COL_END" | "SPECIAL_OBJECT" | "SPECIAL_OBJECT_WITH_YAW" | "SPECIAL_OBJECT_WITH_YAW_AND_PARAM" | "COL_WATER_BOX":
+				kept_calls.append(f"{macro}({', '.join(args)})")
+			case _:
+				raise RuntimeError(f"unhandled {macro} in {name}")
+	return surfaces, kept_calls, surface_count
+
+def bake_terrain(name: str, body: str, rooms: list[int] | None) -> str:
+	surfaces, kept_calls, surface_count = read_terrain(name, body, rooms)
+	grid = build_grid(surfaces)
+
+	split_cells = sum(1 for cell in grid.cells if cell[2])
+	out = [f"// {surface_count} triangles baked into {len(surfaces)} surfaces, {split_cells} cells split\n"]
+	out.append(f"static struct Surface {name}_surfaces[] = {{\n")
+	for s in surfaces:
+		v1, v2, v3 = s.vertices
+		out.append(f"\t{{.type = {s.type}, .force = {s.force}, .flags = {' | '.join(s.flags) or 0}, .room = {s.room}, .lowerY = {s.lower_y}, .upperY = {s.upper_y}, "
+			f".vertex1 = {{{v1[0]}, {v1[1]}, {v1[2]}}}, .vertex2 = {{{v2[0]}, {v2[1]}, {v2[2]}}}, .vertex3 = {{{v3[0]}, {v3[1]}, {v3[2]}}}, "
+			f".compressed_normal = {{{s.normal[0]}, {s.normal[1]}, {s.normal[2]}}}, .originOffsetq = {s.origin_offset}}},\n")
+	out.append("};\n")
+	out.append(f"static const struct SurfaceYRange {name}_y_ranges[] = {{\n")
+	for i in range(0, len(surfaces), 8):
+		out.append(f"\t{' '.join(f'{{{lo}, {hi}}},' for lo, hi in grid.y_ranges[i:i + 8])}\n")
+	out.append("};\n")
+	for array, values in ((f"{name}_indices", grid.indices), (f"{name}_lists", grid.lists)):
+		out.append(f"static const u16 {array}[] = {{\n")
+		for i in range(0, len(values), 16):
+			out.append(f"\t{', '.join(str(value) for value in values[i:i + 16])},\n")
+		out.append("};\n")
+	out.append(f"static const struct BakedTerrain {name}_baked = {{\n")
+	out.append(f"\t.surfaces = {name}_surfaces,\n")
+	out.append(f"\t.yRanges = {name}_y_ranges,\n")
+	out.append(f"\t.indices = {name}_indices,\n")
+	out.append(f"\t.lists = {name}_lists,\n")
+	out.append("\t.cells = {\n")
+	for cell_z in range(NUM_CELLS):
+		out.append("\t\t{\n")
+		for lists, walls, split in grid.cells[cell_z * NUM_CELLS:(cell_z + 1) * NUM_CELLS]:
+			out.append(f"\t\t\t{{{lists}, {walls}, {split}}},\n")
+		out.append("\t\t},\n")
+	out.append("\t},\n")
+	out.append("};\n")
+	out.append(f"const struct BakedCollision {name} = {{TERRAIN_LOAD_BAKED, &{name}_baked, {{\n")
+	for call in kept_calls:
+		out.append(f"\t{call},\n")
+	out.append("}};\n")
+	return "".join(out)
+
+def terrain_arrays(path: str) -> list[tuple[re.Match, list[int] | None]]:
+	# the arrays of the file that are used as area terrain, with the rooms of their surfaces
+	with open(path, "r") as in_file:
+		text = in_file.read()
+	terrain_names = read_array_names(f"{level_dir(path)}/script.c", "TERRAIN")
+	rooms = read_rooms(path.replace("collision.inc.c", "room.inc.c"), read_array_names(f"{level_dir(path)}/script.c", "ROOMS"))
+	matches = re.finditer(r"^const Collision (\w+)\[\] = \{\n(.*?)^\};\n", text, re.DOTALL | re.MULTILINE)
+	return [(match, rooms) for match in matches if match.group(1) in terrain_names]
+
+def read_area_surfaces(path: str, defines: set[str]) -> dict[str, list[Surface]]:
+	# for other tools, the surfaces of every terrain in an area collision file
+	global definitions, in_path
+	definitions, in_path = defines, path
+	areas = {}
+	for match, rooms in terrain_arrays(path):
+		surfaces = read_terrain(match.group(1), strip_comments(strip_conditionals(match.group(2))), rooms)[0]
+		areas[match.group(1)] = surfaces
+	return areas
+
+def main():
+	global in_path, definitions, max_split, bytes_per_candidate
+	args = sys.argv[1:]
+	if len(args) < 2:
+		print(f"usage: {sys.argv[0]} <collision.inc.c> <out collision.baked.inc.c> [--max-split N] [--bytes-per-candidate N] [-DDEFINITION=VALUE...]")
+		exit()
+	in_path, out_path = args[0], args[1]
+	options = args[2:]
+	while options:
+		option = options.pop(0)
+		if option == "--max-split":
+			max_split = int(options.pop(0))
+			assert 0 <= max_split <= 2, "cells can't be split more than BAKED_CELL_MAX_SPLIT"
+		elif option == "--bytes-per-candidate":
+			bytes_per_candidate = int(options.pop(0))
+		elif option.startswith("-D"):
+			definitions.add(option[2:].split("=")[0])
+
+	with open(in_path, "r") as in_file:
+		in_text = in_file.read()
+
+	out_text = f"// generated by tools/bake_collision.py from {in_path}\n#include <engine/surface_load.h>\n\n"
+	pos = 0
+	for match, rooms in terrain_arrays(in_path):
+		out_text += in_text[pos:match.start()]
+		out_text += bake_terrain(match.group(1), strip_comments(strip_conditionals(match.group(2))), rooms)
+		pos = match.end()
+	out_text += in_text[pos:]
+
+	with open(out_path, "w") as out_file:
+		out_file.write(out_text)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+
+# replays static collision queries against the area terrains, once through the plain 16x16 cell lists and once through the
+# baked grid bake_collision.py writes, and compares how many surfaces each has to look at and that they find the same thing
+# the queries come from the pc build's --record-collision csv, or are made up around the surfaces with --random
+# run from the repo root, the query tests below HAVE to be kept in sync with surface_collision.c
+
+import argparse
+import collections
+import csv
+import random
+import re
+import sys
+import time
+
+import bake_collision as bc
+
+FLOORS, CEILS, WALLS = 0, 1, 2
+KINDS = {"f": FLOORS, "c": CEILS, "w": WALLS}
+# the flags field of the recorded queries
+FLAG_CAMERA = 1
+FLAG_THROUGH_GRATE = 2
+FLAG_VANISH_CAP = 4
+
+SURFACE_CAMERA_BOUNDARY = bc.surface_type_values["SURFACE_CAMERA_BOUNDARY"]
+SURFACE_VANISH_CAP_WALLS = bc.surface_type_values["SURFACE_VANISH_CAP_WALLS"]
+
+def s32(x: int) -> int:
+	return bc.s32(x)
+
+def qmul(a: int, b: int) -> int:
+	return s32(a * b >> bc.FRACT_BITS)
+
+def type_value(surface: bc.Surface) -> int:
+	if surface.type in bc.surface_type_values:
+		return bc.surface_type_values[surface.type]
+	return int(surface.type, 0)
+
+def skipped_for_camera(surface: bc.Surface, flags: int) -> bool:
+	if flags & FLAG_CAMERA:
+		return "SURFACE_FLAG_NO_CAM_COLLISION" in surface.flags
+	return type_value(surface) == SURFACE_CAMERA_BOUNDARY
+
+def floor_or_ceil_height_at(surface: bc.Surface, kind: int, x: int, y: int, z: int, flags: int, min_cross: int = 0) -> int | None:
+	# floor_height_at and ceil_height_at
+	sign = 1 if kind == FLOORS else -1
+	(x1, _, z1), (x2, _, z2), (x3, _, z3) = surface.vertices
+	for (ax, az), (bx, bz) in (((x1, z1), (x2, z2)), ((x2, z2), (x3, z3)), ((x3, z3), (x1, z1))):
+		if sign * ((az - z) * (bx - ax) - (ax - x) * (bz - az)) < min_cross:
+			return None
+	if skipped_for_camera(surface, flags):
+		return None
+	nxq, nyq, nzq = (bc.c_div(n << bc.FRACT_BITS, bc.COMPRESSED_NORMAL_ONE) for n in surface.normal)
+	if nyq == 0:
+		return None
+	height = s32(bc.c_div(s32(-(x * nxq + nzq * z + surface.origin_offset)) << bc.FRACT_BITS, nyq))
+	if sign * (y - (s32(height - sign * (bc.FLOOR_BUFFER << bc.FRACT_BITS)) >> bc.FRACT_BITS)) < 0:
+		return None
+	return height
+
+def wall_push(surface: bc.Surface, xq: int, yq: int, zq: int, radius: int, flags: int) -> tuple[int, int] | None:
+	# push_from_wall, returns how much it pushes
+	nx, ny, nz = surface.normal
+	offset = s32(sum(bc.c_div(bc.c_div(c, 1 << bc.FRACT_BITS) * n, bc.COMPRESSED_NORMAL_ONE) for c, n in ((xq, nx), (yq, ny), (zq, nz))) * (1 << bc.FRACT_BITS) + surface.origin_offset)
+	if offset < -radius or offset > radius:
+		return None
+	if "SURFACE_FLAG_X_PROJECTION" in surface.flags:
+		ws = [-(v[2] << bc.FRACT_BITS) for v in surface.vertices]
+		pw = -zq
+		sign = 1 if nx > 0 else -1
+	else:
+		ws = [v[0] << bc.FRACT_BITS for v in surface.vertices]
+		pw = xq
+		sign = 1 if nz > 0 else -1
+	ys = [v[1] << bc.FRACT_BITS for v in surface.vertices]
+	for i in range(3):
+		j = (i + 1) % 3
+		edge = qmul(bc.c_div(ys[i] - yq, 16), bc.c_div(ws[j] - ws[i], 16)) - qmul(bc.c_div(ws[i] - pw, 16), bc.c_div(ys[j] - ys[i], 16))
+		if sign * edge > 0:
+			return None
+	if skipped_for_camera(surface, flags):
+		return None
+	if not flags & FLAG_CAMERA and type_value(surface) == SURFACE_VANISH_CAP_WALLS and flags & (FLAG_THROUGH_GRATE | FLAG_VANISH_CAP):
+		return None
+	return bc.c_div(nx * (radius - offset), bc.COMPRESSED_NORMAL_ONE), bc.c_div(nz * (radius - offset), bc.COMPRESSED_NORMAL_ONE)
+
+class Terrain:
+	def __init__(self, surfaces: list[bc.Surface]):
+		self.surfaces = surfaces
+		self.grid = bc.build_grid(surfaces)
+		self.y_ranges = self.grid.y_ranges
+		# find_floor_from_baked_list_cached, by object
+		self.floor_cache: dict[int, int] = {}
+
+	def baked_list(self, x: int, z: int, kind: int) -> list[int]:
+		# baked_surface_list
+		x += bc.LEVEL_BOUNDARY_MAX
+		z += bc.LEVEL_BOUNDARY_MAX
+		lists, _, split = self.grid.cells[(z >> bc.CELL_SIZE_SHIFT) * bc.NUM_CELLS + (x >> bc.CELL_SIZE_SHIFT)]
+		shift = bc.CELL_SIZE_SHIFT - split
+		sub = ((z & bc.CELL_SIZE - 1) >> shift << split) + ((x & bc.CELL_SIZE - 1) >> shift)
+		return self.read_list(self.grid.lists[lists + sub * 3 + kind])
+
+	def read_list(self, start: int) -> list[int]:
+		return self.grid.indices[start:self.grid.indices.index(bc.NO_SURFACE, start)]
+
+class Stats:
+	def __init__(self):
+		self.queries = 0
+		self.walked = [0, 0]
+		self.read = [0, 0]
+		self.mismatches = 0
+		self.floor_queries = 0
+		self.floor_cache_hits = 0
+
+def replay(terrain: Terrain, kind: int, cell_x: int, cell_z: int, xq: int, yq: int, zq: int, radius: int, flags: int, obj: int, stats: Stats) -> None:
+	stats.queries += 1
+	results = []
+	for baked in (False, True):
+		if kind == WALLS:
+			radius = min(radius, 200 << bc.FRACT_BITS)
+			if not baked:
+				candidates = terrain.grid.coarse[cell_z][cell_x][WALLS]
+			else:
+				x, z = xq >> bc.FRACT_BITS, zq >> bc.FRACT_BITS
+				if (x + bc.LEVEL_BOUNDARY_MAX) >> bc.CELL_SIZE_SHIFT == cell_x and (z + bc.LEVEL_BOUNDARY_MAX) >> bc.CELL_SIZE_SHIFT == cell_z:
+					candidates = terrain.baked_list(x, z, WALLS)
+				else:
+					candidates = terrain.read_list(terrain.grid.cells[cell_z * bc.NUM_CELLS + cell_x][1])
+			push_x, push_z, walls = xq, zq, []
+			for i in candidates:
+				stats.walked[baked] += 1
+				# the plain lists have to read the surface for its heights
+				stats.read[baked] += not baked
+				lo, hi = terrain.y_ranges[i] if baked else (terrain.surfaces[i].lower_y, terrain.surfaces[i].upper_y)
+				if yq < lo << bc.FRACT_BITS or yq > hi << bc.FRACT_BITS:
+					continue
+				stats.read[baked] += baked
+				if (push := wall_push(terrain.surfaces[i], xq, yq, zq, radius, flags)) is not None:
+					push_x, push_z = s32(push_x + push[0]), s32(push_z + push[1])
+					walls.append(i)
+			results.append((push_x, push_z, walls))
+		else:
+			x, y, z = xq >> bc.FRACT_BITS, yq >> bc.FRACT_BITS, zq >> bc.FRACT_BITS
+			candidates = terrain.baked_list(x, z, kind) if baked else terrain.grid.coarse[cell_z][cell_x][kind]
+			found = None
+			for i in candidates:
+				stats.walked[baked] += 1
+				if baked and (y < terrain.y_ranges[i][0] if kind == FLOORS else y > terrain.y_ranges[i][1]):
+					continue
+				stats.read[baked] += 1
+				if (height := floor_or_ceil_height_at(terrain.surfaces[i], kind, x, y, z, flags)) is not None:
+					found = (i, height)
+					break
+			results.append(found)
+	if results[0] != results[1]:
+		stats.mismatches += 1
+		if stats.mismatches <= 10:
+			print(f"mismatch: {'fcw'[kind]} at {xq / 4096:.2f} {yq / 4096:.2f} {zq / 4096:.2f} in cell {cell_x} {cell_z}: {results[0]} vs {results[1]}", file = sys.stderr)
+	if kind == FLOORS:
+		# the cached floor has to be the one the walk finds whenever it's used
+		stats.floor_queries += 1
+		x, y, z = xq >> bc.FRACT_BITS, yq >> bc.FRACT_BITS, zq >> bc.FRACT_BITS
+		cached = terrain.floor_cache.get(obj)
+		if cached is not None and y < terrain.y_ranges[cached][1] and (height := floor_or_ceil_height_at(terrain.surfaces[cached], FLOORS, x, y, z, flags, 1)) is not None:
+			stats.floor_cache_hits += 1
+			if (cached, height) != results[1]:
+				stats.mismatches += 1
+				if stats.mismatches <= 10:
+					print(f"mismatch: floor cache at {xq / 4096:.2f} {yq / 4096:.2f} {zq / 4096:.2f} returns {cached} instead of {results[1]}", file = sys.stderr)
+		elif results[1] is not None:
+			terrain.floor_cache[obj] = results[1][0]
+
+def random_queries(terrain: Terrain, count: int, rng: random.Random):
+	# points around random surfaces, some of them with walls of objects having pushed them out of their cell,
+	# and floor queries of objects that move a little between them
+	for obj in range(count):
+		surface = rng.choice(terrain.surfaces)
+		vx, vy, vz = rng.choice(surface.vertices)
+		kind = rng.choice((FLOORS, CEILS, WALLS))
+		xq = (vx + rng.randint(-300, 300) << bc.FRACT_BITS) + rng.randrange(1 << bc.FRACT_BITS)
+		zq = (vz + rng.randint(-300, 300) << bc.FRACT_BITS) + rng.randrange(1 << bc.FRACT_BITS)
+		yq = (vy + rng.randint(-200, 200) << bc.FRACT_BITS) + rng.randrange(1 << bc.FRACT_BITS)
+		ox, oz = xq, zq
+		if kind == WALLS and rng.random() < 0.2:
+			ox += rng.randint(-400, 400) << bc.FRACT_BITS
+			oz += rng.randint(-400, 400) << bc.FRACT_BITS
+		if not all(-bc.LEVEL_BOUNDARY_MAX < c >> bc.FRACT_BITS < bc.LEVEL_BOUNDARY_MAX for c in (xq, zq, ox, oz)):
+			continue
+		cell_x = ((ox >> bc.FRACT_BITS) + bc.LEVEL_BOUNDARY_MAX) >> bc.CELL_SIZE_SHIFT
+		cell_z = ((oz >> bc.FRACT_BITS) + bc.LEVEL_BOUNDARY_MAX) >> bc.CELL_SIZE_SHIFT
+		flags = rng.choice((0, 0, 0, FLAG_CAMERA, FLAG_VANISH_CAP))
+		yield kind, cell_x, cell_z, xq, yq, zq, rng.randint(0, 250) << bc.FRACT_BITS, flags, obj
+		if kind == FLOORS:
+			for _ in range(rng.randint(0, 4)):
+				xq += rng.randint(-40 << bc.FRACT_BITS, 40 << bc.FRACT_BITS)
+				zq += rng.randint(-40 << bc.FRACT_BITS, 40 << bc.FRACT_BITS)
+				yq += rng.randint(-60 << bc.FRACT_BITS, 60 << bc.FRACT_BITS)
+				if not all(-bc.LEVEL_BOUNDARY_MAX < c >> bc.FRACT_BITS < bc.LEVEL_BOUNDARY_MAX for c in (xq, zq)):
+					break
+				cell_x = ((xq >> bc.FRACT_BITS) + bc.LEVEL_BOUNDARY_MAX) >> bc.CELL_SIZE_SHIFT
+				cell_z = ((zq >> bc.FRACT_BITS) + bc.LEVEL_BOUNDARY_MAX) >> bc.CELL_SIZE_SHIFT
+				yield kind, cell_x, cell_z, xq, yq, zq, 0, flags, obj
+
+def level_folders() -> dict[int, str]:
+	# level numbers in the order of level_defines.h, starting from 1 like enum LevelNum
+	with open("levels/level_defines.h", "r") as level_defines:
+		levels = re.findall(r"^(STUB_LEVEL|DEFINE_LEVEL(?:_REMOVED)?)\(\s*\"[^\"]*\",\s*\w+,\s*\w+,\s*(\w+)", level_defines.read(), re.MULTILINE)
+	return dict((i + 1, folder) for i, (macro, folder) in enumerate(levels) if macro != "STUB_LEVEL")
+
+def area_terrain_names(folder: str) -> dict[int, str]:
+	with open(f"levels/{folder}/script.c", "r") as script_file:
+		script = bc.strip_comments(script_file.read())
+	names = {}
+	for area, body in re.findall(r"AREA\(\s*(\d+),(.*?)END_AREA\(\)", script, re.DOTALL):
+		if terrain := re.search(r"TERRAIN\(\s*(\w+)\s*\)", body):
+			names[int(area)] = terrain.group(1)
+	return names
+
+terrain_cache: dict[tuple[str, int], Terrain | None] = {}
+
+def load_terrain(folder: str, area: int, defines: set[str]) -> Terrain | None:
+	key = (folder, area)
+	if key not in terrain_cache:
+		terrain_cache[key] = None
+		name = area_terrain_names(folder).get(area)
+		try:
+			areas = bc.read_area_surfaces(f"levels/{folder}/areas/{area}/collision.inc.c", defines)
+		except FileNotFoundError:
+			areas = {}
+		if name in areas:
+			terrain_cache[key] = Terrain(areas[name])
+	return terrain_cache[key]
+
+def main():
+	parser = argparse.ArgumentParser(description = "compares static collision queries between the 16x16 cell lists and the baked grid")
+	parser.add_argument("queries", nargs = "?", help = "csv written by the pc build with --record-collision")
+	parser.add_argument("-r", "--random", type = int, default = 0, help = "instead, make up this many queries in every area")
+	parser.add_argument("-l", "--level", action = "append", default = [], help = "only these level folders (with --random)")
+	parser.add_argument("-D", dest = "defines", action = "append", default = ["VERSION_US"], help = "definitions for the collision files")
+	args = parser.parse_args()
+	defines = set(d.split("=")[0] for d in args.defines)
+
+	stats: dict[str, Stats] = collections.defaultdict(Stats)
+	start = time.time()
+	if args.random:
+		rng = random.Random(0)
+		folders = args.level or sorted(set(level_folders().values()))
+		for folder in folders:
+			for area in area_terrain_names(folder):
+				if (terrain := load_terrain(folder, area, defines)) is not None:
+					for query in random_queries(terrain, args.random, rng):
+						replay(terrain, *query, stats[f"{folder} {area}"])
+	elif args.queries:
+		folders = level_folders()
+		with open(args.queries, "r") as f:
+			for row in csv.DictReader(f):
+				folder = folders.get(int(row["level"]))
+				if folder is None or (terrain := load_terrain(folder, int(row["area"]), defines)) is None:
+					continue
+				replay(terrain, KINDS[row["kind"]], int(row["cell_x"]), int(row["cell_z"]), int(row["x"]), int(row["y"]), int(row["z"]),
+					int(row["radius"]), int(row["flags"]), int(row["object"]), stats[f"{folder} {row['area']}"])
+	else:
+		parser.error("give a recorded csv or --random")
+
+	total = Stats()
+	for name, s in sorted(stats.items()):
+		print(f"{name:>20}: {s.queries:7} queries, surfaces walked {s.walked[0] / s.queries:6.2f} -> {s.walked[1] / s.queries:6.2f}, "
+			f"read {s.read[0] / s.queries:6.2f} -> {s.read[1] / s.queries:6.2f}, floor cache hits {s.floor_cache_hits / max(s.floor_queries, 1):4.0%}, {s.mismatches} mismatches")
+		total.queries += s.queries
+		total.mismatches += s.mismatches
+		total.floor_queries += s.floor_queries
+		total.floor_cache_hits += s.floor_cache_hits
+		for i in range(2):
+			total.walked[i] += s.walked[i]
+			total.read[i] += s.read[i]
+	if total.queries:
+		print(f"{'total':>20}: {total.queries:7} queries, surfaces walked {total.walked[0] / total.queries:6.2f} -> {total.walked[1] / total.queries:6.2f}, "
+			f"read {total.read[0] / total.queries:6.2f} -> {total.read[1] / total.queries:6.2f}, floor cache hits {total.floor_cache_hits / max(total.floor_queries, 1):4.0%}, "
+			f"{total.mismatches} mismatches ({time.time() - start:.1f} s)")
+	if total.mismatches:
+		sys.exit(1)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+# runs the pc build headlessly through a set of demos, and summarizes the per frame stats it writes
+# with --baseline, exits with an error if a demo got slower than in a previous summary.json
+# with --bench-behaviors, also prints the behavior interpreter's time per tick at the end of each demo,
+# and with --behaviors-baseline, the time of a BHV_UNDECODED build at the end of the same demo next to it
+
+import argparse
+import csv
+import json
+import pathlib
+import re
+import subprocess
+import sys
+
+def percentile(values, p):
+	values = sorted(values)
+	return values[min(len(values) - 1, int(len(values) * p))]
+
+def summarize(rows):
+	frame_us = [int(row["frame_us"]) for row in rows[1:]] # the first frame has no previous one to time against
+	return {
+		"frames": len(rows),
+		"mean_frame_us": sum(frame_us) // max(len(frame_us), 1),
+		"p95_frame_us": percentile(frame_us, 0.95) if frame_us else 0,
+		"max_frame_us": max(frame_us, default = 0),
+		"mean_script_us": sum(int(row["script_us"]) for row in rows) // len(rows),
+		"mean_graph_us": sum(int(row["graph_us"]) for row in rows) // len(rows),
+		"mean_render_us": sum(int(row["render_us"]) for row in rows) // len(rows),
+		"max_polys": max(int(row["polys"]) for row in rows),
+		"max_objects": max(int(row["objects"]) for row in rows),
+		"max_main_pool_used": max(int(row["main_pool_used"]) for row in rows),
+	}
+
+def run_demo(exe, demo, out_csv, args):
+	cmd = [str(exe), "--headless", "--demo", str(demo), "--out", str(out_csv)]
+	if args.frames:
+		cmd += ["--frames", str(args.frames)]
+	if args.bench_behaviors:
+		cmd += ["--bench-behaviors", str(args.bench_behaviors)]
+	return subprocess.run(cmd, check = True, stdout = subprocess.PIPE, text = True).stdout
+
+# the ns per tick printed by --bench-behaviors
+def behavior_tick_ns(output):
+	match = re.search(r"^behaviors \((\w+)\): \d+ objects, ([\d.]+) ns per tick$", output, re.M)
+	return (match.group(1), float(match.group(2))) if match else None
+
+def main():
+	parser = argparse.ArgumentParser(description = "headless benchmark suite for the sm64-psx pc build")
+	parser.add_argument("exe", type = pathlib.Path)
+	parser.add_argument("out_dir", type = pathlib.Path)
+	parser.add_argument("demos", type = pathlib.Path, nargs = "+", help = "demo files, in the format of assets/demos/*.bin")
+	parser.add_argument("-f", "--frames", type = int, default = 0, help = "frames to run each demo for (default: until it ends)")
+	parser.add_argument("-b", "--baseline", type = pathlib.Path, default = None, help = "summary.json of a previous run to compare against")
+	parser.add_argument("-t", "--threshold", type = float, default = 0.1, help = "allowed slowdown relative to the baseline")
+	parser.add_argument("--bench-behaviors", type = int, default = 0, help = "times the behavior interpreter this many ticks per object at the end of each demo")
+	parser.add_argument("--behaviors-baseline", type = pathlib.Path, default = None, help = "a BHV_UNDECODED build to time the interpreter of on the same demos")
+	args = parser.parse_args()
+
+	args.out_dir.mkdir(parents = True, exist_ok = True)
+	summary = {}
+	for demo in args.demos:
+		out_csv = args.out_dir / (demo.stem + ".csv")
+		output = run_demo(args.exe, demo, out_csv, args)
+		with open(out_csv, "r") as f:
+			rows = list(csv.DictReader(f))
+		if not rows:
+			print(f"{demo.stem}: no frames recorded", file = sys.stderr)
+			sys.exit(1)
+		summary[demo.stem] = summarize(rows)
+		s = summary[demo.stem]
+		print(f"{demo.stem:>8}: {s['frames']:5} frames, mean {s['mean_frame_us']:6} us, p95 {s['p95_frame_us']:6} us, max {s['max_frame_us']:6} us, "
+			f"polys {s['max_polys']:5}, objects {s['max_objects']:3}, pool {s['max_main_pool_used']:7}")
+		if args.bench_behaviors:
+			ticks = [behavior_tick_ns(output)]
+			if args.behaviors_baseline:
+				# the demo plays out the same, so both stop on the same objects in the same state
+				ticks.append(behavior_tick_ns(run_demo(args.behaviors_baseline, demo, args.out_dir / (demo.stem + "_baseline.csv"), args)))
+			print(f"{demo.stem:>8}: behaviors " + ", ".join(f"{tick[0]} {tick[1]:.1f} ns per tick" if tick else "not timed" for tick in ticks))
+	with open(args.out_dir / "summary.json", "w") as f:
+		json.dump(summary, f, indent = "\t")
+
+	if args.baseline:
+		with open(args.baseline, "r") as f:
+			baseline = json.load(f)
+		regressed = False
+		for name, s in summary.items():
+			if name not in baseline:
+				continue
+			for key in ["mean_frame_us", "p95_frame_us"]:
+				if s[key] > baseline[name][key] * (1 + args.threshold):
+					print(f"{name}: {key} regressed from {baseline[name][key]} to {s[key]}", file = sys.stderr)
+					regressed = True
+			if s["max_main_pool_used"] > baseline[name]["max_main_pool_used"]:
+				print(f"{name}: max_main_pool_used grew from {baseline[name]['max_main_pool_used']} to {s['max_main_pool_used']}", file = sys.stderr)
+				regressed = True
+		if regressed:
+			sys.exit(1)
+
+if __name__ == "__main__":
+	main()
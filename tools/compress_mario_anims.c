@@ -3,8 +3,8 @@
 #include <string.h>
 #include <stdio.h>
 
-// no compression is actually done right now... but it COULD be done maybe...
-// note that it would have to be reducing the animation data itself, NOT just data compression, because i tried that and it sucked
+// the animation data itself is reduced to keyframes by mario_anims_converter.py, this only lays out the segment
+// (data compression on top of that was tried and it sucked)
 
 //#define IMPLEMENT_COMPRESS_LZSS
 //#define IMPLEMENT_COMPRESS_ANIM
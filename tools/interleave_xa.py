@@ -12,6 +12,19 @@ out_info_bytes = bytearray()
 padding_sector = bytes(0 for _ in range(XA_SECTOR_SIZE))
 out_pack_bytes = bytearray()
 
+# a data sector after each track's audio, in the track's file and channel so it gets through the drive's filter
+# the game gets an interrupt when the drive reaches it and loops the track from there (see cd_psx.c)
+END_MARKER_MAGIC = b"BGME"
+SUBMODE_EOR = 1 << 0
+SUBMODE_DATA = 1 << 3
+SUBMODE_EOF = 1 << 7
+
+def end_marker_sector(file: int, channel: int, index: int) -> bytes:
+	submode = SUBMODE_DATA | SUBMODE_EOR | SUBMODE_EOF
+	subheader = bytes((file, channel, submode, 0)) * 2
+	data = END_MARKER_MAGIC + struct.pack("<I", index)
+	return subheader + data + bytes(XA_SECTOR_SIZE - len(subheader) - len(data))
+
 class Input:
 	__slots__ = "data", "off", "start_lba_off", "end_lba_off"
 	data: bytes
@@ -19,12 +32,12 @@ class Input:
 	start_lba_off: int
 	end_lba_off: int
 
-	def __init__(self, data: bytes):
-		self.data = data
+	def __init__(self, data: bytes, index: int):
+		assert len(data) > 0 and len(data) % XA_SECTOR_SIZE == 0
+		self.data = data + end_marker_sector(data[0], data[1], index)
 		self.off = 0
 		self.start_lba_off = -1
 		self.end_lba_off = -1
-		assert len(data) > 0 and len(data) % XA_SECTOR_SIZE == 0
 
 	def next_sector(self) -> bytes:
 		next_off = self.off + XA_SECTOR_SIZE
@@ -39,7 +52,7 @@ all_inputs: list[Input] = []
 
 for path in sys.argv[3:]:
 	with open(path, "rb") as input:
-		all_inputs.append(Input(input.read()))
+		all_inputs.append(Input(input.read(), len(all_inputs)))
 
 remaining_inputs = all_inputs.copy()
 
@@ -5,8 +5,6 @@ import traceback
 import sys
 
 compress = True
-POS_STEP = 2
-ROT_STEP = 2
 
 num_headers = 0
 items = []
@@ -96,18 +94,80 @@ def parse_file(filename, lines):
             name = lines[lineindex][len("s16 "):-6]
             lineindex = parse_array(filename, lines, lineindex, name, is_indices)
 
-# this is rarely needed, but why not
-def reduce_count(values_arr: list[str], start: int, count: int, step: int) -> int:
-    last_idx = start + count - 1
-    last_value = values_arr[last_idx]
-    old_count = count
-    for i in range(start + count // step * step, start, -step):
-        if i < last_idx and values_arr[i] == last_value:
-            count -= 1
-    return count
+# compressed channels keep only the frames where the motion changes and the decoder interpolates linearly between
+# them. keyframes are picked greedily: each one is placed as far from the previous one as it can be while every frame
+# in between stays within these bounds of the original, so a channel that moves linearly only keeps its ends and one
+# that doesn't move at all is stored as a constant.
+# a keyed channel is a u8 gap to the next keyframe for every keyframe but the last, then the keyframe values: the top
+# byte of rotations, and s16 translations or a s16 base and u8 offsets from it when they fit.
+# the layout must match retrieve_compressed_animation_value in src/engine/graph_node.c
+CHANNEL_COUNT_MASK = 0x7FFF
+CHANNEL_BYTE_DELTAS = 0x8000
+MAX_KEYFRAME_GAP = 0xFF
+POS_MAX_ERROR = 4 # in units
+ROT_MAX_ERROR = 0x200 # in angle units, includes the up to 0x80 lost to keeping only the top byte
+
+def to_s16(v: int) -> int:
+    return (v + 0x8000 & 0xFFFF) - 0x8000
+
+# the values array is s8, so bytes are written as such
+def to_s8(v: int) -> int:
+    return (v + 0x80 & 0xFF) - 0x80
+
+def c_div(a: int, b: int) -> int:
+    return abs(a) // b * (1 if a >= 0 else -1)
+
+def quantize(v: int, is_rot: bool) -> int:
+    if is_rot:
+        return to_s16((v + 0x80 & 0xFFFF) >> 8 << 8)
+    return v
+
+# mirrors the decoder between two keyframes
+def interpolate(a: int, b: int, offset: int, gap: int, is_rot: bool) -> int:
+    diff = to_s16(b - a) if is_rot else b - a
+    value = a + c_div(diff * offset, gap)
+    return to_s16(value) if is_rot else value
+
+def frame_error(decoded: int, original: int, is_rot: bool) -> int:
+    if is_rot:
+        return abs(to_s16(decoded - original))
+    return abs(decoded - original)
+
+def segment_fits(frames: list[int], i: int, j: int, is_rot: bool) -> bool:
+    max_error = ROT_MAX_ERROR if is_rot else POS_MAX_ERROR
+    a = quantize(frames[i], is_rot)
+    b = quantize(frames[j], is_rot)
+    for k in range(i, j + 1):
+        if frame_error(interpolate(a, b, k - i, j - i, is_rot), frames[k], is_rot) > max_error:
+            return False
+    return True
+
+def pick_keyframes(frames: list[int], is_rot: bool) -> list[int]:
+    keys = [0]
+    while keys[-1] < len(frames) - 1:
+        i = keys[-1]
+        j = i + 1
+        while j + 1 < len(frames) and j + 1 - i <= MAX_KEYFRAME_GAP and segment_fits(frames, i, j + 1, is_rot):
+            j += 1
+        keys.append(j)
+    return keys
+
+def constant_value(frames: list[int], is_rot: bool):
+    if is_rot:
+        first = frames[0]
+        if all(frame_error(v, first, True) <= ROT_MAX_ERROR for v in frames):
+            return first
+    else:
+        low = min(frames)
+        high = max(frames)
+        if high - low <= POS_MAX_ERROR * 2:
+            return (low + high) // 2
+    return None
+
+channel_stats = {"constant": 0, "keyed": 0, "byte_deltas": 0, "frames": 0, "keyframes": 0}
 
 already_compressed = {}
-def compress_pair(values_name: str, indices_name: str, flags: int):
+def compress_pair(values_name: str, indices_name: str):
     if values_name in already_compressed or indices_name in already_compressed:
         return
     assert values_name not in already_compressed and indices_name not in already_compressed
@@ -115,57 +175,47 @@ def compress_pair(values_name: str, indices_name: str, flags: int):
     already_compressed[indices_name] = True
     values_arr = arrays_by_name[values_name]
     indices_arr = arrays_by_name[indices_name]
-    if (flags & ANIM_FLAG_HOR_TRANS) != 0:
-        has_xzpos = False
-        has_ypos = True
-    elif (flags & ANIM_FLAG_VERT_TRANS) != 0:
-        has_xzpos = True
-        has_ypos = False
-    elif (flags & ANIM_FLAG_NO_TRANS) != 0:
-        has_xzpos = False
-        has_ypos = False
-    else:
-        has_xzpos = True
-        has_ypos = True
     new_values = []
     new_indices = []
-    attr_idx = 0
-    for i in range(0, len(indices_arr), 2):
-        count_str = indices_arr[i]
-        start_str = indices_arr[i + 1]
-        count = int(count_str, 0)
-        start = int(start_str, 0)
+    for attr_idx in range(len(indices_arr) // 2):
+        count = int(indices_arr[attr_idx * 2], 0)
+        start = int(indices_arr[attr_idx * 2 + 1], 0)
         assert count != 0
-        if count == 1:
+        is_rot = attr_idx >= 3
+        frames = [to_s16(int(v, 0)) for v in values_arr[start:start + count]]
+        channel_stats["frames"] += len(frames)
+        constant = constant_value(frames, is_rot)
+        if constant is not None:
+            channel_stats["constant"] += 1
             new_indices.append("0")
-            new_indices.append(values_arr[start])
-        elif (has_xzpos or has_ypos) and attr_idx < 3:
-            # do not compress translation attributes, just take the opportunity to remove the indices for unused ones because why not
-            count = reduce_count(values_arr, start, count, POS_STEP)
-            if (has_xzpos and has_ypos) or has_ypos == (attr_idx == 1):
-                new_indices.append(str((count + POS_STEP - 1) // POS_STEP))
-                if len(new_values) % 2 != 0: # ensure the value array is aligned to 2
-                    new_values.append("0")
-                new_indices.append(str(len(new_values) // 2))
-                for j in range(start, start + count, POS_STEP):
-                    v = int(values_arr[j], 0)
-                    new_values.append(str(v & 0xFF))
-                    new_values.append(str(v >> 8 & 0xFF))
-                if count % POS_STEP != 0:
-                    v = int(values_arr[start + count - 1], 0)
-                    new_values.append(str(v & 0xFF))
-                    new_values.append(str(v >> 8 & 0xFF))
+            new_indices.append(str(constant & 0xFFFF))
+            continue
+        keys = pick_keyframes(frames, is_rot)
+        assert len(keys) <= CHANNEL_COUNT_MASK
+        channel_stats["keyed"] += 1
+        channel_stats["keyframes"] += len(keys)
+        samples = [quantize(frames[k], is_rot) for k in keys]
+        header = len(keys)
+        offset = len(new_values)
+        for k in range(len(keys) - 1):
+            new_values.append(str(to_s8(keys[k + 1] - keys[k])))
+        if is_rot:
+            for v in samples:
+                new_values.append(str(to_s8(v >> 8)))
+        elif max(samples) - min(samples) <= 0xFF:
+            channel_stats["byte_deltas"] += 1
+            header |= CHANNEL_BYTE_DELTAS
+            base = min(samples)
+            new_values.append(str(to_s8(base)))
+            new_values.append(str(to_s8(base >> 8)))
+            for v in samples:
+                new_values.append(str(to_s8(v - base)))
         else:
-            count = reduce_count(values_arr, start, count, ROT_STEP)
-            new_indices.append(str((count + ROT_STEP - 1) // ROT_STEP))
-            new_indices.append(str(len(new_values)))
-            last_val = -1
-            last_val_count = 0
-            for j in range(start, start + count, ROT_STEP):
-                new_values.append(str(int(values_arr[j], 0) >> 8))
-            if count % ROT_STEP != 0:
-                new_values.append(str(int(values_arr[start + count - 1], 0) >> 8))
-        attr_idx += 1
+            for v in samples:
+                new_values.append(str(to_s8(v)))
+                new_values.append(str(to_s8(v >> 8)))
+        new_indices.append(str(header))
+        new_indices.append(str(offset))
     arrays_by_name[values_name] = new_values
     arrays_by_name[indices_name] = new_indices
 
@@ -205,7 +255,7 @@ try:
             offset_to_end = "offsetof(struct MarioAnimsObj, " + values + ") + sizeof(gMarioAnims." + values + ")"
             structobj.append("{" + offset_to_struct + ", " + offset_to_end + " - " + offset_to_struct + "},")
             if compress:
-                compress_pair(values, indices, v1)
+                compress_pair(values, indices)
     structobj.append("},")
 
     for item in items:
@@ -235,6 +285,11 @@ try:
             structdef.append(f"{type} {name}[{len(arr)}];")
             structobj.append("{" + ",".join(arr) + "},")
 
+    if compress:
+        print("mario animations: " + str(channel_stats["frames"]) + " frames reduced to " + str(channel_stats["keyframes"]) + " keyframes in "
+            + str(channel_stats["keyed"]) + " channels (" + str(channel_stats["byte_deltas"]) + " with byte offsets), "
+            + str(channel_stats["constant"]) + " constant channels", file=sys.stderr)
+
     print("#include \"game/memory.h\"")
     print("#include <stddef.h>")
     print("")
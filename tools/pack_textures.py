@@ -1,27 +1,142 @@
 import sys
+import re
+
+# usage: pack_textures.py <out pixel archive> <fulldata list> [<level_defines.h> <out atlas table>]
+# when the last two are given, each level's own textures are packed into a vram image that gets loaded with the level,
+# and their headers are written with their final vram attributes, so they're never loaded individually
+
+# must match the atlas layout in gfx_texture_psx.c
+ATLAS_VRAM_X = 640
+ATLAS_VRAM_Y = 256
+ATLAS_WIDTH = 3 * 256 # in texels
+ATLAS_HEIGHT = 256
+ATLAS_CLUT_VRAM_X = 832
+ATLAS_CLUT_ROWS = 32
+ATLAS_CLUT_VRAM_Y = 512 - ATLAS_CLUT_ROWS
+ATLAS_CLUTS_PER_ROW = 12
+# same order as gfx_load_texture
+SIZE_CLASSES = [(8, 16), (16, 16), (32, 32), (64, 32), (64, 64), (128, 32)]
+CELL_W = 8
+CELL_H = 16
+# marks headers as prebaked, must match gfx_internal.h
+ATLAS_CACHE_SLOT = 0xFFFF
+
+def size_class(width, height):
+	for w, h in SIZE_CLASSES:
+		if width <= w and height <= h:
+			return w, h
+	return None
+
+def pack_atlas(textures):
+	# textures: list of (index, width, height), returns {index: (x, y)} for the ones that fit
+	cols = ATLAS_WIDTH // CELL_W
+	used = [[False] * cols for _ in range(ATLAS_HEIGHT // CELL_H)]
+	placed = {}
+	order = sorted(textures, key = lambda t: (-t[1] * t[2], -t[2], t[0]))
+	for idx, w, h in order[:ATLAS_CLUT_ROWS * ATLAS_CLUTS_PER_ROW]:
+		cw = w // CELL_W
+		ch = h // CELL_H
+		# positions must be aligned to the texture size for the texture window to work, rows first to keep the image short
+		for y in range(0, len(used) - ch + 1, ch):
+			for x in range(0, cols - cw + 1, cw):
+				if not any(used[y + j][x + i] for j in range(ch) for i in range(cw)):
+					for j in range(ch):
+						for i in range(cw):
+							used[y + j][x + i] = True
+					placed[idx] = (x * CELL_W, y * CELL_H)
+					break
+			else:
+				continue
+			break
+	return placed
+
+def baked_attrs(x, y, w, h, clut_idx):
+	vram_x = ATLAS_VRAM_X + x // 4
+	vram_y = ATLAS_VRAM_Y + y
+	offx = vram_x % 64 * 4
+	offy = vram_y % 256
+	page_attr = (vram_x // 64 & 15) | (vram_y // 256 & 1) << 4
+	clut_x = ATLAS_CLUT_VRAM_X + clut_idx % ATLAS_CLUTS_PER_ROW * 16
+	clut_y = ATLAS_CLUT_VRAM_Y + clut_idx // ATLAS_CLUTS_PER_ROW
+	clut_attr = (clut_x // 16 & 0x3F) | (clut_y & 0x3FF) << 6
+	window_cmd = 0xE2000000 | (~(w // 8 - 1) & 0x1F) | (~(h // 8 - 1) & 0x1F) << 5 | (offx // 8 & 0x1F) << 10 | (offy // 8 & 0x1F) << 15
+	return bytes([offx, offy]) + page_attr.to_bytes(2, "little") + clut_attr.to_bytes(2, "little") + window_cmd.to_bytes(4, "little")
 
 with open(sys.argv[2], "r") as list_file:
 	in_file_list = list_file.read().splitlines()
 
-queued_headers = []
-out_pixel_archive_bytes = bytearray()
-cur_pos = 0
+contents_list = []
 for in_path in in_file_list:
 	assert in_path.endswith(".fulldata")
 	with open(in_path, "rb") as in_file:
-		contents = in_file.read()
-		pixel_data = contents[16:]
-		unaligned_len = len(pixel_data)
-		aligned_len = (unaligned_len + 2047) // 2048 * 2048
-		queued_headers.append((
-			in_path.removesuffix(".fulldata") + ".texheader",
-			contents[:16]
-				+ (cur_pos // 2048).to_bytes(2, "little")
-				+ (aligned_len // 2048).to_bytes(2, "little")
-		))
-		out_pixel_archive_bytes += pixel_data
-		out_pixel_archive_bytes += bytes(0 for _ in range(aligned_len - unaligned_len))
-		cur_pos += aligned_len
+		contents_list.append(in_file.read())
+
+baked = {}
+atlases = []
+if len(sys.argv) > 4:
+	with open(sys.argv[3], "r") as level_defines:
+		level_enums = dict((folder, enum) for enum, folder in re.findall(r"^DEFINE_LEVEL(?:_REMOVED)?\(\s*\"[^\"]*\",\s*(\w+),\s*\w+,\s*(\w+),", level_defines.read(), re.MULTILINE))
+	levels = {}
+	for i, in_path in enumerate(in_file_list):
+		match = re.search(r"/levels/(\w+)/[^/]+\.fulldata$", in_path)
+		if match and match.group(1) in level_enums:
+			contents = contents_list[i]
+			size = size_class(int.from_bytes(contents[0:2], "little"), int.from_bytes(contents[2:4], "little"))
+			if size:
+				levels.setdefault(match.group(1), []).append((i, *size))
+	for folder, textures in levels.items():
+		placed = pack_atlas(textures)
+		if not placed:
+			continue
+		height = max(y + h for i, w, h in textures if i in placed for x, y in [placed[i]])
+		pixels = bytearray(ATLAS_WIDTH // 2 * height)
+		cluts = bytearray()
+		for clut_idx, i in enumerate(sorted(placed)):
+			x, y = placed[i]
+			contents = contents_list[i]
+			w = int.from_bytes(contents[0:2], "little")
+			h = int.from_bytes(contents[2:4], "little")
+			aligned_w, aligned_h = size_class(w, h)
+			cluts += contents[16:48]
+			for row in range(h):
+				src = 48 + row * (w // 2)
+				dst = (y + row) * (ATLAS_WIDTH // 2) + x // 2
+				pixels[dst:dst + w // 2] = contents[src:src + w // 2]
+			baked[i] = baked_attrs(x, y, aligned_w, aligned_h, clut_idx)
+		clut_rows = (len(placed) + ATLAS_CLUTS_PER_ROW - 1) // ATLAS_CLUTS_PER_ROW
+		cluts += bytes(clut_rows * ATLAS_CLUTS_PER_ROW * 32 - len(cluts))
+		atlases.append((level_enums[folder], height, clut_rows, pixels + cluts))
+
+queued_headers = []
+out_pixel_archive_bytes = bytearray()
+cur_pos = 0
+for i, in_path in enumerate(in_file_list):
+	contents = contents_list[i]
+	header_path = in_path.removesuffix(".fulldata") + ".texheader"
+	if i in baked:
+		queued_headers.append((header_path, contents[:6] + baked[i] + bytes(4) + ATLAS_CACHE_SLOT.to_bytes(4, "little")))
+		continue
+	pixel_data = contents[16:]
+	unaligned_len = len(pixel_data)
+	aligned_len = (unaligned_len + 2047) // 2048 * 2048
+	queued_headers.append((
+		header_path,
+		contents[:16]
+			+ (cur_pos // 2048).to_bytes(2, "little")
+			+ (aligned_len // 2048).to_bytes(2, "little")
+			+ bytes(4) # cache slot
+	))
+	out_pixel_archive_bytes += pixel_data
+	out_pixel_archive_bytes += bytes(0 for _ in range(aligned_len - unaligned_len))
+	cur_pos += aligned_len
+
+atlas_table = ""
+for level, height, clut_rows, data in atlases:
+	aligned_len = (len(data) + 2047) // 2048 * 2048
+	atlas_table += f"{{{level}, {cur_pos // 2048}, {aligned_len // 2048}, {height}, {clut_rows}}},\n"
+	out_pixel_archive_bytes += data
+	out_pixel_archive_bytes += bytes(aligned_len - len(data))
+	cur_pos += aligned_len
 
 with open(sys.argv[1], "wb") as out_pixel_archive:
 	out_pixel_archive.write(out_pixel_archive_bytes)
@@ -29,3 +144,7 @@ with open(sys.argv[1], "wb") as out_pixel_archive:
 for path, contents in queued_headers:
 	with open(path, "wb") as out_header:
 		out_header.write(contents)
+
+if len(sys.argv) > 4:
+	with open(sys.argv[4], "w") as out_atlas_table:
+		out_atlas_table.write(atlas_table)
@@ -0,0 +1,360 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <port/gfx/gfx_dl.h>
+
+// runs the rsp display list compiler (src/port/gfx/gfx_rsp_jit.c) at build time on a linked segment elf,
+// so that static display lists don't have to be compiled at runtime the first time they are drawn
+// each list that could be compiled is rewritten in place as:
+//   [DL_CMD_PRECOMPILED | trailer index] [compiled stream...] [relocation count] [relocations...]
+// pointers in the compiled stream hold segment offsets, and each relocation is (stream word index << 8) | segment number
+// the runtime moves the stream down one word and turns the offsets into real pointers the first time the list is used
+// anything that can't be compiled the exact same way as the runtime compiler would (pointers into segments that aren't
+// given on the command line, lists that don't fit in their own storage...) is left alone for the runtime compiler
+// this only works for the psx, where dl_t is 32 bits and Gfx is 8 bytes, so the compiled list fits where the source was
+// the compiler itself is src/port/gfx/gfx_rsp_compile.inc.c, the same one gfx_rsp_jit.c uses, and the format comes from gfx_dl.h
+
+#define ELFCLASS32 1
+#define ELFDATA2LSB 1
+#define SHT_SYMTAB 2
+#define STT_OBJECT 1
+#define ELF_ST_TYPE(x) (((unsigned int) x) & 0xf)
+
+typedef struct {
+	unsigned char e_ident[16];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint32_t e_entry;
+	uint32_t e_phoff;
+	uint32_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+} Elf32_Ehdr;
+
+typedef struct {
+	uint32_t sh_name;
+	uint32_t sh_type;
+	uint32_t sh_flags;
+	uint32_t sh_addr;
+	uint32_t sh_offset;
+	uint32_t sh_size;
+	uint32_t sh_link;
+	uint32_t sh_info;
+	uint32_t sh_addralign;
+	uint32_t sh_entsize;
+} Elf32_Shdr;
+
+typedef struct {
+	uint32_t st_name;
+	uint32_t st_value;
+	uint32_t st_size;
+	unsigned char st_info;
+	unsigned char st_other;
+	uint16_t st_shndx;
+} Elf32_Sym;
+
+#define SEGMENT_COUNT 32
+
+typedef struct {
+	uint8_t* data;
+	uint32_t size;
+} Segment;
+
+enum {
+	LIST_PENDING,
+	LIST_COMPILING,
+	LIST_COMPILED,
+	LIST_SKIPPED,
+};
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+	uint8_t state;
+	bool useful;
+	bool referenced;
+} DisplayList;
+
+static Segment segments[SEGMENT_COUNT];
+static uint32_t target_segment;
+static DisplayList* lists;
+static uint32_t list_count;
+
+// the elfs and the host are both little endian
+static uint32_t read_u32(const uint8_t* p) {
+	uint32_t x;
+	memcpy(&x, p, 4);
+	return x;
+}
+
+static void write_u32(uint8_t* p, uint32_t x) {
+	memcpy(p, &x, 4);
+}
+
+// returns NULL if the segmented range isn't in a segment that was loaded
+static void* resolve(uint32_t segmented, uint32_t size) {
+	Segment* seg = &segments[(segmented >> 24) % SEGMENT_COUNT];
+	uint32_t offset = segmented & 0xFFFFFF;
+	if((segmented >> 24) >= SEGMENT_COUNT || !seg->data || offset + size > seg->size) {
+		return NULL;
+	}
+	return seg->data + offset;
+}
+
+static DisplayList* find_list(uint32_t segmented) {
+	if((segmented >> 24) != target_segment) {
+		return NULL;
+	}
+	for(uint32_t i = 0; i < list_count; i++) {
+		if(lists[i].offset == (segmented & 0xFFFFFF)) {
+			return &lists[i];
+		}
+	}
+	return NULL;
+}
+
+typedef const uint8_t* RspCmd;
+#define rsp_w0(cmd) read_u32(cmd)
+#define rsp_w1(cmd) read_u32((cmd) + 4)
+#define rsp_next_cmd(cmd) ((cmd) + 8)
+
+typedef struct {
+	uint32_t* words;
+	uint32_t count;
+	uint32_t* relocs;
+	uint32_t reloc_count;
+} RspOutput;
+
+static void rsp_emit(RspOutput* out, uint32_t word) {
+	out->words[out->count++] = word;
+}
+
+// the pointer is left as a segment offset and relocated by the runtime
+static void emit_segmented(RspOutput* out, uint8_t op, uint32_t segmented) {
+	out->relocs[out->reloc_count++] = out->count << 8 | segmented >> 24;
+	rsp_emit(out, DL_PACK_OP(op) | (segmented & 0xFFFFFF));
+}
+
+#define rsp_emit_ptr(out, op, segmented, ptr) emit_segmented(out, op, segmented)
+#define rsp_output_is_empty(out) ((out)->count == 0)
+
+#define rsp_resolve(segmented, size) resolve(segmented, size)
+// vertices are converted in place and cull spheres are used as is, so they can't be in a segment that isn't patched
+#define rsp_in_own_segment(segmented) ((segmented) >> 24 == target_segment)
+// textures get loaded when the runtime relocates the list
+#define rsp_load_texture(tex) ((void) (tex))
+static int compile_nested(uint32_t segmented);
+#define rsp_compile_nested(segmented, ptr) compile_nested(segmented)
+#define RSP_REQUIRE(cond) do { if(!(cond)) return RSP_COMPILE_FAILED; } while(0)
+
+static const bool compile_as_ortho = false; // precompiled lists are never compiled as ortho
+
+#include <port/gfx/gfx_rsp_compile.inc.c>
+
+// same as gfx_compile_rsp, except that it returns false if the list can't be precompiled
+// the result of the runtime compiler's return value goes in list->useful
+static bool compile_list(DisplayList* list, bool nested) {
+	if(list->state == LIST_COMPILED) {
+		return true;
+	}
+	if(list->state != LIST_PENDING) {
+		return false;
+	}
+	if(!nested) {
+		gfx_reset_rsp_jit();
+	}
+	list->state = LIST_COMPILING;
+	uint32_t max_words = list->size / 4;
+	RspOutput out = {
+		.words = malloc(max_words * sizeof(uint32_t)),
+		.relocs = malloc(max_words * sizeof(uint32_t)),
+	};
+	int result = rsp_compile_commands(segments[target_segment].data + list->offset, &out);
+	list->useful = result == RSP_COMPILE_USEFUL;
+	// header, stream, relocation count and relocations all have to fit where the source list was
+	bool ok = result != RSP_COMPILE_FAILED && 1 + out.count + 1 + out.reloc_count <= max_words;
+	if(ok) {
+		uint8_t* dst = segments[target_segment].data + list->offset;
+		uint32_t trailer_index = 1 + out.count;
+		write_u32(dst, DL_PACK_OP(DL_CMD_PRECOMPILED) | trailer_index);
+		for(uint32_t i = 0; i < out.count; i++) {
+			write_u32(dst + (1 + i) * 4, out.words[i]);
+		}
+		write_u32(dst + trailer_index * 4, out.reloc_count);
+		for(uint32_t i = 0; i < out.reloc_count; i++) {
+			write_u32(dst + (trailer_index + 1 + i) * 4, out.relocs[i]);
+		}
+		list->state = LIST_COMPILED;
+	} else {
+		list->state = LIST_SKIPPED;
+	}
+	free(out.words);
+	free(out.relocs);
+	return ok;
+}
+
+// called lists are compiled as separate lists of the table, so that each gets its own header and relocations
+static int compile_nested(uint32_t segmented) {
+	DisplayList* target = find_list(segmented);
+	if(!target || !compile_list(target, true)) {
+		return RSP_COMPILE_FAILED;
+	}
+	return target->useful? RSP_COMPILE_USEFUL: RSP_COMPILE_EMPTY;
+}
+
+// checks that a symbol looks like a Gfx array: only F3D_OLD opcodes, terminated by gsSPEndDisplayList()
+static bool is_display_list(const uint8_t* data, uint32_t size) {
+	if(size < 8 || size % 8 != 0) {
+		return false;
+	}
+	if(read_u32(data + size - 8) != (uint32_t) (u8) G_ENDDL << 24 || read_u32(data + size - 4) != 0) {
+		return false;
+	}
+	for(uint32_t i = 0; i < size; i += 8) {
+		uint8_t opcode = data[i + 3];
+		if(!(opcode <= (u8) G_PORT_TRI2 || (opcode >= (u8) G_RDPHALF_CONT && opcode <= (u8) G_NOOP) || opcode >= (u8) G_TEXRECT)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint8_t* read_file(const char* path, size_t* size) {
+	FILE* f = fopen(path, "rb");
+	if(!f) {
+		fprintf(stderr, "could not open '%s'\n", path);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t* data = malloc(*size);
+	if(fread(data, 1, *size, f) != *size) {
+		fprintf(stderr, "could not read '%s'\n", path);
+		exit(1);
+	}
+	fclose(f);
+	return data;
+}
+
+static const Elf32_Shdr* get_section(const uint8_t* file, uint32_t index) {
+	const Elf32_Ehdr* ehdr = (const Elf32_Ehdr*) file;
+	return (const Elf32_Shdr*) (file + ehdr->e_shoff + index * ehdr->e_shentsize);
+}
+
+// returns the index of the .data section and loads it as a segment
+static uint32_t load_segment(uint8_t* file, const char* path) {
+	const Elf32_Ehdr* ehdr = (const Elf32_Ehdr*) file;
+	if(memcmp(ehdr->e_ident, "\x7f" "ELF", 4) != 0 || ehdr->e_ident[4] != ELFCLASS32 || ehdr->e_ident[5] != ELFDATA2LSB) {
+		fprintf(stderr, "'%s' is not a little endian 32-bit ELF\n", path);
+		exit(1);
+	}
+	const Elf32_Shdr* strtab = get_section(file, ehdr->e_shstrndx);
+	for(uint32_t i = 0; i < ehdr->e_shnum; i++) {
+		const Elf32_Shdr* shdr = get_section(file, i);
+		if(strcmp((const char*) file + strtab->sh_offset + shdr->sh_name, ".data") == 0) {
+			uint32_t segment = shdr->sh_addr >> 24;
+			if(segment >= SEGMENT_COUNT || (shdr->sh_addr & 0xFFFFFF) != 0) {
+				fprintf(stderr, "'%s' is not linked at the start of a segment (0x%08X)\n", path, shdr->sh_addr);
+				exit(1);
+			}
+			segments[segment] = (Segment) {
+				.data = file + shdr->sh_offset,
+				.size = shdr->sh_size,
+			};
+			return i;
+		}
+	}
+	fprintf(stderr, "'%s' has no .data section\n", path);
+	exit(1);
+}
+
+int main(int argc, const char** argv) {
+	if(argc < 2) {
+		fprintf(stderr, "usage: precompile_dl <segment elf to patch> [elfs of other segments it references...]\n");
+		return 1;
+	}
+	for(int i = 2; i < argc; i++) {
+		size_t size;
+		load_segment(read_file(argv[i], &size), argv[i]);
+	}
+	size_t file_size;
+	uint8_t* file = read_file(argv[1], &file_size);
+	uint32_t data_index = load_segment(file, argv[1]);
+	const Elf32_Shdr* data_shdr = get_section(file, data_index);
+	target_segment = data_shdr->sh_addr >> 24;
+	Segment* seg = &segments[target_segment];
+
+	// collect every object that looks like a display list
+	const Elf32_Ehdr* ehdr = (const Elf32_Ehdr*) file;
+	for(uint32_t i = 0; i < ehdr->e_shnum; i++) {
+		const Elf32_Shdr* symtab = get_section(file, i);
+		if(symtab->sh_type != SHT_SYMTAB) {
+			continue;
+		}
+		const Elf32_Sym* syms = (const Elf32_Sym*) (file + symtab->sh_offset);
+		uint32_t sym_count = symtab->sh_size / sizeof(Elf32_Sym);
+		lists = realloc(lists, (list_count + sym_count) * sizeof(DisplayList));
+		for(uint32_t j = 0; j < sym_count; j++) {
+			const Elf32_Sym* sym = &syms[j];
+			uint32_t offset = sym->st_value - data_shdr->sh_addr;
+			if(ELF_ST_TYPE(sym->st_info) != STT_OBJECT || sym->st_shndx != data_index || offset + sym->st_size > seg->size) {
+				continue;
+			}
+			if(is_display_list(seg->data + offset, sym->st_size) && !find_list(sym->st_value)) {
+				lists[list_count++] = (DisplayList) {.offset = offset, .size = sym->st_size, .state = LIST_PENDING};
+			}
+		}
+	}
+
+	// only compile the lists that aren't called from other lists, the others get compiled as part of their parents
+	// so that they inherit the same state as they would have at runtime
+	for(uint32_t i = 0; i < list_count; i++) {
+		const uint8_t* data = seg->data + lists[i].offset;
+		for(uint32_t j = 0; j < lists[i].size; j += 8) {
+			if(data[j + 3] == (u8) G_DL) {
+				DisplayList* target = find_list(read_u32(data + j + 4));
+				if(target) {
+					target->referenced = true;
+				}
+			}
+		}
+	}
+	uint8_t* snapshot = malloc(seg->size);
+	DisplayList* list_snapshot = malloc(list_count * sizeof(DisplayList));
+	uint32_t compiled_roots = 0, root_count = 0;
+	for(uint32_t i = 0; i < list_count; i++) {
+		if(lists[i].referenced) {
+			continue;
+		}
+		root_count++;
+		// a list that can't be fully precompiled is restored along with everything it touched (vertices, children...)
+		memcpy(snapshot, seg->data, seg->size);
+		memcpy(list_snapshot, lists, list_count * sizeof(DisplayList));
+		if(compile_list(&lists[i], false)) {
+			compiled_roots++;
+		} else {
+			memcpy(seg->data, snapshot, seg->size);
+			memcpy(lists, list_snapshot, list_count * sizeof(DisplayList));
+			lists[i].state = LIST_SKIPPED;
+		}
+	}
+
+	FILE* out = fopen(argv[1], "wb");
+	if(!out) {
+		fprintf(stderr, "could not open '%s' for writing\n", argv[1]);
+		return 1;
+	}
+	fwrite(file, 1, file_size, out);
+	fclose(out);
+	printf("precompiled %u/%u display lists in %s\n", compiled_roots, root_count, argv[1]);
+	return 0;
+}
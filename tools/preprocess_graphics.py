@@ -120,16 +120,24 @@ class DisplayList:
 		self.name = name
 		self.cmds = []
 
+	# chunks split off by flush_triangle_queue, which DL_CMD_CULL can skip at runtime
+	def is_cullable(self) -> bool:
+		return len(self.cmds) > 0 and self.cmds[0].name == "gsSPPortCullSphere"
+
 	def try_inline(self):
 		i = 0
 		while i < len(self.cmds):
 			cmd = self.cmds[i]
 			if cmd.name == "gsSPDisplayList" and (target := display_lists.get(cmd.between_parentheses)):
-				if INLINE_AGGRESSIVELY or target.use_count <= 1:
+				# inlining a chunk would make its cull command return from the whole parent
+				if not target.is_cullable() and (INLINE_AGGRESSIVELY or target.use_count <= 1):
 					self.cmds = [*self.cmds[:i], *target.cmds, *self.cmds[i + 1:]]
 			i += 1
 
 	def affect_vtx_selection(self, prev: str | None) -> str | None:
+		if self.is_cullable():
+			# whether the chunk ran or got culled isn't known until runtime
+			return None
 		known = prev
 		i = 0
 		while i < len(self.cmds):
@@ -303,62 +311,212 @@ def normalize_triangle_queue_uvs():
 					n64_vtx_list_lengths[vtx_list_name] = 3
 					triangle_queue[tri_idx] = vtx_list_name, 0, 1, 2
 
-# consider one triangle to write, potentially merging it with a second one into a quadrangle
-def flush_single_triangle(t0_idx: int):
-	assert cur_display_list is not None
-	t0 = triangle_queue[t0_idx]
-	if t0 is not None:
-		for t1_idx, t1 in enumerate(triangle_queue):
-			if t0_idx != t1_idx and t1 is not None:
-				t0vtx, t0i0, t0i1, t0i2 = t0
-				t1vtx, t1i0, t1i1, t1i2 = t1
-				if t0vtx is None or t0vtx != t1vtx:
-					continue
-				for _t0_rotation in range(3):
-					for _t1_rotation in range(3):
-						if t1i0 == t0i2 and t1i1 == t0i1:
-							triangle_queue[t0_idx] = None
-							triangle_queue[t1_idx] = None
-							if t0vtx:
-								cur_display_list.cmds.append(Cmd(f"gsSPVertex({t0vtx}, {n64_vtx_list_lengths[t0vtx]}, 0),"))
-							cur_display_list.cmds.append(Cmd(f"gsSPPortQuadrangle({t0i0}, {t0i1}, {t0i2}, {t1i2}),"))
-							return
-						t1i0, t1i1, t1i2 = t1i2, t1i0, t1i1
-					t0i0, t0i1, t0i2 = t0i2, t0i0, t0i1
+Triangle = tuple[str | None, int, int, int]
+Primitive = tuple[str | None, tuple[int, ...]] # 3 indices for a triangle, 4 for a quadrangle drawn as (0, 1, 2) + (1, 2, 3)
+
+# quadrangles are only backface culled when both halves face away, so only merge pairs folded by less than 60 degrees
+QUAD_MIN_NORMAL_DOT = 0.5
+# the texture mapping of both halves has to match (in 1/32 texels), so the quadrangle can be tessellated as one
+QUAD_UV_TOLERANCE = 64
+
+triangles_written = 0
+primitives_written = 0
+quads_written = 0
+
+def triangle_normal(vertices: list[N64Vtx], i0: int, i1: int, i2: int) -> tuple[float, float, float] | None:
+	v0, v1, v2 = vertices[i0], vertices[i1], vertices[i2]
+	ax, ay, az = v1.x - v0.x, v1.y - v0.y, v1.z - v0.z
+	bx, by, bz = v2.x - v0.x, v2.y - v0.y, v2.z - v0.z
+	nx, ny, nz = ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx
+	length = sqrt(nx * nx + ny * ny + nz * nz)
+	return (nx / length, ny / length, nz / length) if length > 0 else None
+
+# how good of a quadrangle (a, b, c, d) would be, None if it shouldn't be merged at all
+def quad_score(vtx_list_name: str, a: int, b: int, c: int, d: int) -> float | None:
+	vtx_list = static_n64_vtx_lists.get(vtx_list_name)
+	if vtx_list is None:
+		return 0.0 # not known here, merge like before
+	vertices = vtx_list.vertices
+	n0 = triangle_normal(vertices, a, b, c)
+	n1 = triangle_normal(vertices, c, b, d)
+	if n0 is None or n1 is None:
+		return 0.0
+	dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2]
+	if dot < QUAD_MIN_NORMAL_DOT:
+		return None
+	# extend the texture mapping of (a, b, c) to d, in the plane seen along the normal's dominant axis
+	va, vb, vc, vd = vertices[a], vertices[b], vertices[c], vertices[d]
+	drop = max(range(3), key = lambda axis: abs(n0[axis]))
+	def planar(v: N64Vtx) -> tuple[int, int]:
+		return ((v.y, v.z), (v.x, v.z), (v.x, v.y))[drop]
+	(ax, ay), (bx, by), (cx, cy), (dx, dy) = planar(va), planar(vb), planar(vc), planar(vd)
+	det = (bx - ax) * (cy - ay) - (cx - ax) * (by - ay)
+	if det == 0:
+		return None
+	s = ((dx - ax) * (cy - ay) - (cx - ax) * (dy - ay)) / det
+	t = ((bx - ax) * (dy - ay) - (dx - ax) * (by - ay)) / det
+	if abs(va.u + s * (vb.u - va.u) + t * (vc.u - va.u) - vd.u) > QUAD_UV_TOLERANCE \
+		or abs(va.v + s * (vb.v - va.v) + t * (vc.v - va.v) - vd.v) > QUAD_UV_TOLERANCE:
+		return None
+	return dot
+
+# pairs up triangles sharing an edge, best candidates first, and keeps the rest as triangles
+def merge_quads(tris: list[Triangle]) -> list[Primitive]:
+	edges: dict[tuple[str, int, int], list[tuple[int, int]]] = {}
+	for t_idx, (vtx, i0, i1, i2) in enumerate(tris):
+		if vtx is not None:
+			for x, p, q in ((i0, i1, i2), (i1, i2, i0), (i2, i0, i1)):
+				edges.setdefault((vtx, p, q), []).append((t_idx, x))
+	candidates: list[tuple[float, int, int, Primitive]] = []
+	for t1_idx, (vtx, i0, i1, i2) in enumerate(tris):
+		if vtx is not None:
+			for c0, c1, c2 in ((i0, i1, i2), (i1, i2, i0), (i2, i0, i1)):
+				# the other triangle has the same edge in the opposite direction
+				for t0_idx, x in edges.get((vtx, c1, c0), []):
+					if t0_idx < t1_idx and (score := quad_score(vtx, x, c1, c0, c2)) is not None:
+						candidates.append((score, t0_idx, t1_idx, (vtx, (x, c1, c0, c2))))
+	candidates.sort(key = lambda candidate: (-candidate[0], candidate[1], candidate[2]))
+	merged: dict[int, Primitive | None] = {}
+	for _, t0_idx, t1_idx, quad in candidates:
+		if t0_idx not in merged and t1_idx not in merged:
+			merged[t0_idx] = quad
+			merged[t1_idx] = None
+	prims: list[Primitive] = []
+	for t_idx, (vtx, i0, i1, i2) in enumerate(tris):
+		if t_idx not in merged:
+			prims.append((vtx, (i0, i1, i2)))
+		elif (quad := merged[t_idx]) is not None:
+			prims.append(quad)
+	return prims
+
+# groups primitives by vertex list to load each one once, then orders every group so
+# consecutive primitives share as many vertices as possible
+def reorder_primitives(prims: list[Primitive]) -> list[Primitive]:
+	groups: dict[str | None, list[Primitive]] = {None: []} # the ones using vertices loaded before stay first
+	for prim in prims:
+		groups.setdefault(prim[0], []).append(prim)
+	ordered: list[Primitive] = []
+	for group in groups.values():
+		remaining = group
+		while remaining:
+			if ordered and ordered[-1][0] == remaining[0][0]:
+				last = set(ordered[-1][1])
+				best = max(range(len(remaining)), key = lambda i: (len(last.intersection(remaining[i][1])), -i))
+			else:
+				best = 0
+			ordered.append(remaining.pop(best))
+	return ordered
+
+# level geometry is split into chunks, each one called as a sub display list that starts
+# with a bounding sphere test, so the executor can skip it when it's out of view
+CHUNK_SIZE = 2048 # chunks are bisected along their longest axis until they are smaller than this
+CHUNK_MIN_TRIANGLES = 16
+chunk_bounds: dict[str, tuple[int, int, int, int]] = {}
+
+def triangle_centroid(tri: Triangle) -> tuple[int, int, int]:
+	assert tri[0] is not None
+	vertices = static_n64_vtx_lists[tri[0]].vertices
+	v0, v1, v2 = vertices[tri[1]], vertices[tri[2]], vertices[tri[3]]
+	return (v0.x + v1.x + v2.x) // 3, (v0.y + v1.y + v2.y) // 3, (v0.z + v1.z + v2.z) // 3
+
+def bisect_triangles(tris: list[Triangle], out: list[list[Triangle]]):
+	if len(tris) >= CHUNK_MIN_TRIANGLES * 2:
+		centroids = [triangle_centroid(tri) for tri in tris]
+		extents = [max(c[axis] for c in centroids) - min(c[axis] for c in centroids) for axis in range(3)]
+		axis = extents.index(max(extents))
+		if extents[axis] >= CHUNK_SIZE:
+			# each half keeps the original order, so triangles that could be merged into quads stay next to each other
+			order = sorted(range(len(tris)), key = lambda i: centroids[i][axis])
+			half = len(tris) // 2
+			bisect_triangles([tris[i] for i in sorted(order[:half])], out)
+			bisect_triangles([tris[i] for i in sorted(order[half:])], out)
+			return
+	out.append(tris)
+
+def split_triangle_queue() -> list[list[Triangle]] | None:
+	tris: list[Triangle] = []
+	for tri in triangle_queue:
+		if tri is not None:
+			if tri[0] is None or tri[0] not in static_n64_vtx_lists:
+				return None
+			tris.append(tri)
+	chunks: list[list[Triangle]] = []
+	bisect_triangles(tris, chunks)
+	return chunks if len(chunks) > 1 else None
+
+def get_bounding_sphere(tris: list[Triangle]) -> tuple[int, int, int, int]:
+	points = [static_n64_vtx_lists[tri[0]].vertices[i] for tri in tris if tri[0] is not None for i in tri[1:]]
+	cx = (min(v.x for v in points) + max(v.x for v in points)) // 2
+	cy = (min(v.y for v in points) + max(v.y for v in points)) // 2
+	cz = (min(v.z for v in points) + max(v.z for v in points)) // 2
+	r = max(int(sqrt((v.x - cx) ** 2 + (v.y - cy) ** 2 + (v.z - cz) ** 2)) + 1 for v in points)
+	return cx, cy, cz, min(r, 0x7FFF)
 
 def flush_triangle_queue():
+	global cur_display_list
 	if len(triangle_queue) == 0:
 		return
+	assert cur_display_list is not None
+	if should_tessellate and (chunks := split_triangle_queue()):
+		parent = cur_display_list
+		for tris in chunks:
+			name = f"{parent.name}_chunk{len(chunk_bounds)}"
+			chunk_bounds[name] = get_bounding_sphere(tris)
+			cur_display_list = DisplayList(f"static const Gfx {name}[] = {{", name)
+			cur_display_list.cmds.append(Cmd(f"gsSPPortCullSphere(&{name}_bounds),"))
+			triangle_queue[:] = tris
+			write_triangle_queue()
+			cur_display_list.cmds.append(Cmd("gsSPEndDisplayList(),"))
+			cur_display_list.use_count = 1
+			display_lists[name] = cur_display_list
+			display_lists_ordered.append(name)
+			parent.cmds.append(Cmd(f"gsSPDisplayList({name}),"))
+		cur_display_list = parent
+	else:
+		write_triangle_queue()
+
+def write_triangle_queue():
+	global triangles_written, primitives_written, quads_written
 	#if should_tessellate:
 	#	tessellate_triangle_queue()
 	#normalize_triangle_queue_uvs()
 	assert cur_display_list is not None
-	for t0_idx in range(len(triangle_queue)):
-		flush_single_triangle(t0_idx)
-	last = None
-	for t in triangle_queue:
-		if t is not None:
-			if last is None:
-				last = t
-			else:
-				if last[0] == t[0]:
-					if t[0]:
-						cur_display_list.cmds.append(Cmd(f"gsSPVertex({t[0]}, {n64_vtx_list_lengths[t[0]]}, 0),"))
-					cur_display_list.cmds.append(Cmd(f"gsSP2Triangles({last[1]}, {last[2]}, {last[3]}, 0, {t[1]}, {t[2]}, {t[3]}, 0),"))
-				else:
-					if last[0]:
-						cur_display_list.cmds.append(Cmd(f"gsSPVertex({last[0]}, {n64_vtx_list_lengths[last[0]]}, 0),"))
-					cur_display_list.cmds.append(Cmd(f"gsSP1Triangle({last[1]}, {last[2]}, {last[3]}, 0),"))
-					if t[0]:
-						cur_display_list.cmds.append(Cmd(f"gsSPVertex({t[0]}, {n64_vtx_list_lengths[t[0]]}, 0),"))
-					cur_display_list.cmds.append(Cmd(f"gsSP1Triangle({t[1]}, {t[2]}, {t[3]}, 0),"))
+	tris = [t for t in triangle_queue if t is not None]
+	prims = reorder_primitives(merge_quads(tris))
+	triangles_written += len(tris)
+	primitives_written += len(prims)
+	last: Primitive | None = None
+	for prim in prims:
+		vtx, indices = prim
+		if len(indices) == 4:
+			if last is not None:
+				write_single_triangle(last)
 				last = None
+			quads_written += 1
+			if vtx:
+				cur_display_list.cmds.append(Cmd(f"gsSPVertex({vtx}, {n64_vtx_list_lengths[vtx]}, 0),"))
+			cur_display_list.cmds.append(Cmd(f"gsSPPortQuadrangle({indices[0]}, {indices[1]}, {indices[2]}, {indices[3]}),"))
+		elif last is None:
+			last = prim
+		elif last[0] == vtx:
+			if vtx:
+				cur_display_list.cmds.append(Cmd(f"gsSPVertex({vtx}, {n64_vtx_list_lengths[vtx]}, 0),"))
+			cur_display_list.cmds.append(Cmd(f"gsSP2Triangles({last[1][0]}, {last[1][1]}, {last[1][2]}, 0, {indices[0]}, {indices[1]}, {indices[2]}, 0),"))
+			last = None
+		else:
+			write_single_triangle(last)
+			last = prim
 	if last is not None:
-		if last[0]:
-			cur_display_list.cmds.append(Cmd(f"gsSPVertex({last[0]}, {n64_vtx_list_lengths[last[0]]}, 0),"))
-		cur_display_list.cmds.append(Cmd(f"gsSP1Triangle({last[1]}, {last[2]}, {last[3]}, 0),"))
+		write_single_triangle(last)
 	triangle_queue.clear()
 
+def write_single_triangle(prim: Primitive):
+	assert cur_display_list is not None
+	vtx, indices = prim
+	if vtx:
+		cur_display_list.cmds.append(Cmd(f"gsSPVertex({vtx}, {n64_vtx_list_lengths[vtx]}, 0),"))
+	cur_display_list.cmds.append(Cmd(f"gsSP1Triangle({indices[0]}, {indices[1]}, {indices[2]}, 0),"))
+
 model_c_path = sys.argv[1]
 with open(model_c_path, "r") as in_file:
 	in_lines = in_file.readlines()
@@ -441,6 +599,9 @@ for line_idx, line in enumerate(in_lines):
 	if len(line) == 0 or line.startswith("//"):
 		continue
 	if line.startswith("#") and state != ParseState.MultilineComment:
+		# area collision is partitioned at build time by bake_collision.py, the baked file is found through the build dir
+		if re.match(r'#include "levels/\w+/areas/\d+/collision\.inc\.c"$', line):
+			line = line.replace("collision.inc.c", "collision.baked.inc.c")
 		out_lines.append(line + "\n")
 		continue
 	match state:
@@ -590,6 +751,9 @@ for name in static_n64_vtx_lists:
 		out_lines.append(f"{{{{{{{vtx.x}, {vtx.y}, {vtx.z}}}, 0, {{{vtx.u}, {vtx.v}}}, {{{vtx.r}, {vtx.g}, {vtx.b}, {vtx.a}}}}}}},\n")
 	out_lines.append("};\n")
 
+for name, (x, y, z, r) in chunk_bounds.items():
+	out_lines.append(f"static const ShortVec {name}_bounds = {{.elems = {{{x}, {y}, {z}, {r}}}}};\n")
+
 for name in display_lists_ordered:
 	dl = display_lists[name]
 	if INLINE:
@@ -599,6 +763,9 @@ for name in display_lists_ordered:
 		out_lines.append(cmd.line + "\n")
 	out_lines.append("};\n")
 
+if triangles_written:
+	out_lines.insert(1, f"// {triangles_written} triangles written as {primitives_written} primitives, {quads_written} of them quadrangles, {triangles_written - primitives_written} saved\n")
+
 with open(out_path, "w") as out_file:
 	out_lines.insert(0, "#include <port/gfx/gfx_internal.h>") # needed for GfxVtx
 	out_file.writelines(out_lines)
@@ -20,29 +20,48 @@ bank_files = os.listdir(bank_dir)
 bank_files.sort()
 bank_files = bank_files[0:11]
 
-out_sample_data = bytearray()
+SECTOR_SIZE = 2048
+SPU_DMA_BLOCK = 64 # the SPU DMA moves 16 words at a time
+
+# the samples are grouped by the N64 sample bank they come from, the game puts each group in SPU RAM as a whole
+# and only while an instrument bank that uses it is loaded (see audio_psx.c)
+class SampleBank:
+	__slots__ = "name", "data", "offset_in_pack"
+	name: str
+	data: bytearray
+	offset_in_pack: int
+
+	def __init__(self, name: str):
+		self.name = name
+		self.data = bytearray()
+		self.offset_in_pack = 0
+
+sample_banks: dict[str, SampleBank] = {}
 
 class SoundRef:
-	__slots__ = "offset_in_data", "freq"
+	__slots__ = "sample_bank", "offset_in_bank", "freq"
 
-	def __init__(self, path: str):
-		global out_sample_data
+	def __init__(self, sample_bank: SampleBank, path: str):
 		full_path = conv_sample_dir + "/" + path + ".samplebin"
 		with open(full_path, "rb") as samplebin_handle:
 			samplebin_bytes = samplebin_handle.read()
+		self.sample_bank = sample_bank
 		self.freq = struct.unpack("<H", samplebin_bytes[0:2])[0]
-		self.offset_in_data = len(out_sample_data)
-		out_sample_data += samplebin_bytes[4:]
-		assert len(out_sample_data) % 8 == 0 # SPU memory is referenced in units of 8 bytes, so it must be aligned to that
+		self.offset_in_bank = len(sample_bank.data)
+		sample_bank.data += samplebin_bytes[4:]
+		assert len(sample_bank.data) % 8 == 0 # SPU memory is referenced in units of 8 bytes, so it must be aligned to that
+		assert self.offset_in_bank // 8 <= 0xFFFF
 
 loaded_sounds: dict[str, SoundRef] = {}
 
 class BankDef:
-	__slots__ = "sound_refs"
+	__slots__ = "sample_bank", "sound_refs"
 
+	sample_bank: SampleBank
 	sound_refs: list[SoundRef | None]
 
-	def __init__(self):
+	def __init__(self, sample_bank: SampleBank):
+		self.sample_bank = sample_bank
 		self.sound_refs = []
 
 	def add_null(self):
@@ -51,16 +70,18 @@ class BankDef:
 	def add(self, sound_path: str):
 		loaded = loaded_sounds.get(sound_path)
 		if loaded is None:
-			loaded = SoundRef(sound_path)
+			loaded = SoundRef(self.sample_bank, sound_path)
 			loaded_sounds[sound_path] = loaded
 		self.sound_refs.append(loaded)
 
-	def build_table(self, out: bytearray):
+	def build_table(self, out: bytearray, sample_bank_indices: dict[str, int]):
+		out += struct.pack("<I", sample_bank_indices[self.sample_bank.name])
 		for ref in self.sound_refs:
 			if ref is None:
 				out += b"\0\0\0\0"
 			else:
-				out += struct.pack("<HH", ref.freq, (4096 + ref.offset_in_data) // 8)
+				# the address is relative to where the game puts the sample bank
+				out += struct.pack("<HH", ref.freq, ref.offset_in_bank // 8)
 
 all_banks: list[BankDef] = []
 
@@ -75,8 +96,11 @@ def process_json_ifdef(value):
 for bank_file_name in bank_files:
 	with open(bank_dir + "/" + bank_file_name, "r") as bank_handle:
 		bank_json = json.load(bank_handle)
-		cur_bank = BankDef()
-		sound_path_prefix = process_json_ifdef(bank_json["sample_bank"]) + "/"
+		sample_bank_name = process_json_ifdef(bank_json["sample_bank"])
+		if sample_bank_name not in sample_banks:
+			sample_banks[sample_bank_name] = SampleBank(sample_bank_name)
+		cur_bank = BankDef(sample_banks[sample_bank_name])
+		sound_path_prefix = sample_bank_name + "/"
 		for instrument_name in bank_json["instrument_list"]:
 			if instrument_name is None:
 				cur_bank.add_null()
@@ -90,15 +114,33 @@ for bank_file_name in bank_files:
 				cur_bank.add(sound_path_prefix + sound_name)
 		all_banks.append(cur_bank)
 
+# each sample bank starts on a sector so it can be read on its own, and is padded for the SPU DMA
+out_sample_data = bytearray()
+for sample_bank in sample_banks.values():
+	while len(out_sample_data) % SECTOR_SIZE != 0:
+		out_sample_data += b"\0"
+	sample_bank.offset_in_pack = len(out_sample_data)
+	while len(sample_bank.data) % SPU_DMA_BLOCK != 0:
+		sample_bank.data += b"\0"
+	out_sample_data += sample_bank.data
+
+# the table starts with the counts, then where each sample bank is in the data and how big it is,
+# then the offset of each instrument bank in words, and the instrument banks:
+# the index of their sample bank followed by the frequency and address of each instrument's sample
 out_table = bytearray()
-first_sound_def_off = align_up(len(all_banks) * 2, 4)
+out_table += struct.pack("<HH", len(all_banks), len(sample_banks))
+sample_bank_indices: dict[str, int] = {}
+for sample_bank in sample_banks.values():
+	sample_bank_indices[sample_bank.name] = len(sample_bank_indices)
+	out_table += struct.pack("<II", sample_bank.offset_in_pack, len(sample_bank.data))
+first_sound_def_off = align_up(len(out_table) + len(all_banks) * 2, 4)
 for b in all_banks:
 	out_table += struct.pack("<H", first_sound_def_off // 4)
-	first_sound_def_off += len(b.sound_refs) * 4
+	first_sound_def_off += 4 + len(b.sound_refs) * 4
 for b in all_banks:
 	while len(out_table) % 4 != 0:
 		out_table += b"\0"
-	b.build_table(out_table)
+	b.build_table(out_table, sample_bank_indices)
 
 with open(out_sound_table_path, "wb") as table_handle:
 	table_handle.write(out_table)
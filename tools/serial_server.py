@@ -13,13 +13,18 @@ import traceback
 
 connected = False
 
-async def shell(reader: telnetlib3.TelnetReader, writer: telnetlib3.TelnetWriter, archive_path: pathlib.Path, max_chunk_size: int):
+TRACE_BEGIN = "--- profiler trace begin ---"
+TRACE_END = "--- profiler trace end ---"
+
+async def shell(reader: telnetlib3.TelnetReader, writer: telnetlib3.TelnetWriter, archive_path: pathlib.Path, max_chunk_size: int, trace_path: pathlib.Path):
 	global connected, loaded_files, loaded_file_ids
 	connected = True
 	print("[server] connected")
 	with open(archive_path, "rb") as f:
 		loaded_bytes = f.read()
 	midline = False
+	line = ""
+	trace = None # lines of the profiler trace being received
 	last_request = time.time()
 	while True:
 		r = await reader.readexactly(1)
@@ -55,6 +60,28 @@ async def shell(reader: telnetlib3.TelnetReader, writer: telnetlib3.TelnetWriter
 				print("[server] warning: game is expecting data")
 			case c:
 				c = c.decode()
+				if c != '\n':
+					line += c
+				elif line == TRACE_BEGIN:
+					trace = []
+					line = ""
+					midline = False
+					print("\n[server] receiving a profiler trace", flush=True)
+					continue
+				elif line == TRACE_END and trace is not None:
+					with open(trace_path, "w") as f:
+						f.write("\n".join(trace) + "\n")
+					print(f"[server] wrote a profiler trace to {trace_path}", flush=True)
+					trace = None
+					line = ""
+					midline = False
+					continue
+				else:
+					if trace is not None:
+						trace.append(line)
+					line = ""
+				if trace is not None:
+					continue
 				if not midline:
 					print("[stdout] ", end="", flush=True)
 				print(c, end="", flush=True)
@@ -66,6 +93,7 @@ async def main():
 	parser.add_argument("serial_address", type = str, default = "localhost:6699")
 	parser.add_argument("-s", "--slow", action = "store_true", default = False, help = "use 115200 baud instead of 518400")
 	parser.add_argument("-c", "--chunk", type = int, default = 1024, help = "max chunk size")
+	parser.add_argument("-t", "--trace", type = pathlib.Path, default = "profile_trace.json", help = "where to write profiler traces (PROFILE=1 builds, sent when pressing L2)")
 	args = parser.parse_args()
 	assert args.serial_address
 	parts = args.serial_address.split(":")
@@ -79,7 +107,7 @@ async def main():
 	while True:
 		try:
 			reader, writer = await telnetlib3.open_connection(ip, port, force_binary=True, encoding=False, tspeed=(speed, speed))
-			await shell(reader, writer, args.archive_path, args.chunk)
+			await shell(reader, writer, args.archive_path, args.chunk, args.trace)
 			await writer.protocol.waiter_closed
 		except Exception as e:
 			if connected:
@@ -1,14 +1,37 @@
 import sys
 import os
-import enum
+import json
+import math
 
-if len(sys.argv) < 4:
-	print(f"usage: {sys.argv[0]} <jp/us/eu/sh> <00_sound_player.s> <output.c>\n")
+if len(sys.argv) < 5:
+	print(f"usage: {sys.argv[0]} <jp/us/eu/sh> <00_sound_player.s> <sound_bank_json_dir> <output.c>\n")
 	exit()
 
 game_version = sys.argv[1]
 in_path = sys.argv[2]
-out_path = sys.argv[3]
+bank_dir = sys.argv[3]
+out_path = sys.argv[4]
+
+# must match SfxOp in src/port/audio_data.h
+OP_WAIT = 0x80
+OP_BANK = 0x81
+OP_INSTR = 0x82
+OP_ENVELOPE = 0x83
+OP_RELEASE = 0x84
+OP_PAN = 0x85
+OP_LAYER = 0x86
+OP_FREE_LAYER = 0x87
+OP_PORTAMENTO = 0x88
+OP_PORTAMENTO_OFF = 0x89
+OP_LEGATO = 0x8A
+OP_JUMP = 0x8B
+OP_END = 0xFF
+
+MAX_LAYERS = 4
+# the sound player's envelopes step once per audio update, 4 per frame at 60 fps
+N64_UPDATES_PER_SECOND = 240
+SPU_SAMPLE_RATE = 44100
+DEFAULT_RELEASE_RATE = 0x20
 
 def split_instruction(line: str):
 	line = line.strip()
@@ -20,15 +43,19 @@ def split_instruction(line: str):
 with open(in_path, "r") as in_handle:
 	asm_lines = in_handle.readlines()
 
-out_c_defines = []
+# the lines that are kept for this version, labels included, and where each label is in them
+lines: list[list[str]] = []
+labels: dict[str, int] = {}
+constants: dict[str, str] = {}
+conditions = {
+	"#ifdef VERSION_JP": game_version == "jp",
+	"#ifndef VERSION_JP": game_version != "jp",
+	"#ifdef VERSION_SH": game_version == "sh",
+	"#if defined(VERSION_EU) || defined(VERSION_SH)": game_version == "eu" or game_version == "sh",
+}
+kept = [True] # one entry per #if that's open, whether its lines are kept
 
-cur_definition_name: str | None = None
-cur_definition_lines: list[str] | None = None
-definitions: dict[str, list[str]] = {}
-definition_first_lines: dict[str, int] = {}
-skipping_until_else_or_endif = False
-
-for line_idx, line in enumerate(asm_lines):
+for line in asm_lines:
 	if line == "#include \"seq_macros.inc\"\n":
 		continue
 	line = line.strip()
@@ -36,102 +63,297 @@ for line_idx, line in enumerate(asm_lines):
 		continue
 	if (comment_idx := line.find("//")) != -1:
 		line = line[0:comment_idx].rstrip()
-	if skipping_until_else_or_endif:
-		if line == "#else" or line == "#endif":
-			skipping_until_else_or_endif = False
-		continue
 	if line.startswith("#"):
 		if line == "#endif":
-			pass
+			kept.pop()
 		elif line == "#else":
-			skipping_until_else_or_endif = True
-		elif line == "#ifdef VERSION_JP":
-			skipping_until_else_or_endif = game_version != "jp"
-		elif line == "#ifndef VERSION_JP":
-			skipping_until_else_or_endif = game_version == "jp"
-		elif line == "#ifdef VERSION_SH":
-			skipping_until_else_or_endif = game_version != "sh"
-		elif line == "#if defined(VERSION_EU) || defined(VERSION_SH)":
-			skipping_until_else_or_endif = game_version != "eu" and game_version != "sh"
+			kept[-1] = kept[-2] and not kept[-1]
+		elif line in conditions:
+			kept.append(kept[-1] and conditions[line])
 		else:
 			raise ValueError(f"unhandled directive in line '{line}'")
 		continue
-	elif line.startswith(".set "):
+	if not kept[-1]:
+		continue
+	if line.startswith(".set "):
 		parts = split_instruction(line)
-		out_c_defines.append(f"#define {parts[1]} {parts[2]}\n")
+		constants[parts[1]] = parts[2]
+		continue
 	if line.endswith(":"):
-		if cur_definition_name is not None:
-			definitions[cur_definition_name] = cur_definition_lines
-		cur_definition_name = line[0:-1]
-		cur_definition_lines = []
-		definition_first_lines[cur_definition_name] = line_idx + 1
-	elif cur_definition_name is not None:
-		cur_definition_lines.append(line)
+		labels[line[0:-1]] = len(lines)
+	lines.append(split_instruction(line))
 
-out_sfx_defs = []
+def value(arg: str) -> int:
+	for name, replacement in constants.items():
+		arg = arg.replace(name, replacement)
+	return int(eval(arg, {"__builtins__": {}}))
 
-def get_first_note_in_layer(which: str) -> tuple[str, str, str, str]:
-	for line_idx in range(definition_first_lines[which], len(asm_lines)):
-		parts = split_instruction(asm_lines[line_idx])
-		match parts[0]:
-			case "layer_end":
-				break
-			case "layer_note0":
-				return parts[1], parts[2], parts[3], parts[4]
-			case "layer_note1":
-				return parts[1], parts[2], parts[3], "0"
-	return "39", "0", "0", "0"
-
-def make_sfx_def(which: str):
-	bank: str | None = None
-	instrument: str | None = None
-	note: str | None = None
-	delay: str | None = None
-	velocity: str | None = None
-	gate: str | None = None
-	for line in definitions[which]:
-		parts = line.split(" ")
-		match parts[0]:
-			case "chan_setbank":
-				bank = parts[1]
-			case "chan_setinstr":
-				instrument = parts[1]
-			case "chan_setlayer":
-				note, delay, velocity, gate = get_first_note_in_layer(parts[2])
-				break
-	if bank is None:
-		bank = "0" # TODO
-	if instrument is None:
-		instrument = "0" # TODO
-	assert bank is not None and instrument is not None
-	if note is None:
-		note = "39"
-		delay = "0"
-		velocity = "127"
-		gate = "0"
-	out_sfx_defs.append(f"\t(SfxDef) {{.bank_id={bank},.sample_id={instrument},.note={note},.gate={gate},.velocity={velocity}}},\n")
-	#print(which, bank, instrument)
-	return bank, instrument
+# SPU envelopes, see the ADSR section of psx-spx:
+# each phase moves the level by step << max(0, 11 - shift) every 1 << max(0, shift - 11) samples,
+# exponential decreases scale that by the level
+def spu_phase_seconds(shift: int, step: int, exponential: bool, start: int, end: int) -> float:
+	per_sample = (step << max(0, 11 - shift)) / (1 << max(0, shift - 11))
+	if exponential:
+		return math.log(start / max(end, 1)) / (per_sample / 0x8000) / SPU_SAMPLE_RATE
+	return abs(end - start) / per_sample / SPU_SAMPLE_RATE
+
+def closest_shift(max_shift: int, step: int, exponential: bool, start: int, end: int, seconds: float) -> int:
+	seconds = max(seconds, 1 / SPU_SAMPLE_RATE)
+	return min(range(max_shift + 1), key = lambda shift: abs(math.log(spu_phase_seconds(shift, step, exponential, start, end) / seconds)))
+
+def release_shift(release_rate: int) -> int:
+	# the N64 fades the released notes out by release_rate * 24 per update, from at most 32767
+	seconds = 32767 / ((release_rate or DEFAULT_RELEASE_RATE) * 24) / N64_UPDATES_PER_SECOND
+	return closest_shift(31, 8, False, 0x7FFF, 0, seconds)
+
+def envelope_to_adsr(points: list[tuple[int, int]]) -> tuple[int, int]:
+	# points are (updates, level) the envelope moves through in a straight line, until it hangs or loops
+	# the SPU gets the attack up to the loudest point, an exponential decay to where it stops and a sustain that holds it
+	time = 0
+	peak = 0
+	attack_time = 0
+	last_level = 0
+	last_time = 0
+	for delay, level in points:
+		if delay >= 32000: # holds the level for as long as the note plays
+			break
+		time += delay
+		if level > peak:
+			peak = level
+			attack_time = time
+		last_level = level
+		last_time = time
+	if peak == 0:
+		return 0x000F, 0x1FC0 # instant attack, holds at full volume
+	attack_shift = closest_shift(31, 7, False, 0, 0x7FFF, attack_time / N64_UPDATES_PER_SECOND)
+	sustain_level = min(max(round(last_level / peak * 16) - 1, 0), 15)
+	decay_shift = 0
+	if sustain_level < 15:
+		decay_shift = closest_shift(15, 8, True, 0x7FFF, (sustain_level + 1) * 0x800, (last_time - attack_time) / N64_UPDATES_PER_SECOND)
+	adsr1 = attack_shift << 10 | decay_shift << 4 | sustain_level
+	if last_level * 32 < peak:
+		# fades out for good, what's left of the lowest sustain level goes in about as long again
+		sustain_shift = closest_shift(31, 8, False, 0x800, 0, (last_time - attack_time) / N64_UPDATES_PER_SECOND)
+		adsr2 = 1 << 14 | sustain_shift << 8
+	else:
+		adsr2 = 0x1F << 8 | 3 << 6 # the slowest increase, holds the level
+	return adsr1, adsr2
+
+def parse_envelope(label: str) -> list[tuple[int, int]]:
+	points = []
+	for parts in lines[labels[label] + 1:]:
+		if parts[0] != "envelope_line":
+			break
+		delay, level = parts[1].split()
+		points.append((value(delay), value(level)))
+	return points
+
+def json_ifdef(value):
+	if type(value) is dict and (ifdef := value.get("ifdef")) is not None:
+		if len(ifdef) == 1 and ifdef[0] == "VERSION_SH":
+			return value["then"] if game_version == "sh" else value["else"]
+		else:
+			raise ValueError(f"unhandled ifdef condition '{ifdef}'")
+	return value
+
+# same banks, in the same order, as tools/psx_sample_pack.py
+bank_files = sorted(os.listdir(bank_dir))[0:11]
+instrument_adsrs: list[list[tuple[int, int]]] = []
+for bank_file_name in bank_files:
+	with open(bank_dir + "/" + bank_file_name, "r") as bank_handle:
+		bank_json = json.load(bank_handle)
+	adsrs = []
+	for instrument_name in bank_json["instrument_list"]:
+		if instrument_name is None:
+			adsrs.append((0, 0))
+			continue
+		instrument = bank_json["instruments"][instrument_name]
+		points = [tuple(p) for p in json_ifdef(bank_json["envelopes"][instrument["envelope"]]) if type(p) is list and type(p[0]) is int]
+		adsr1, adsr2 = envelope_to_adsr(points)
+		adsrs.append((adsr1, adsr2 | release_shift(instrument["release_rate"])))
+	instrument_adsrs.append(adsrs)
+
+def var(value: int) -> list[int]:
+	assert 0 <= value < 0x8000
+	return [value] if value < 0x80 else [0x80 | value >> 8, value & 0xFF]
+
+def u16(value: int) -> list[int]:
+	return [value & 0xFF, value >> 8]
+
+# anything that isn't listed ends the script, it's either waiting on the game or running the channel's main loop
+LAYER_IGNORED = {"layer_setshortnotevelocity", "layer_setshortnotedefaultplaypercentage", "layer_setshortnoteduration"}
+CHANNEL_IGNORED = {
+	"chan_setnotepriority", "chan_reservenotes", "chan_unreservenotes", "chan_setreverb", "chan_setvibratoextent", "chan_setvibratorate",
+	"chan_setvolscale", "chan_setpanmix", "chan_stereoheadseteffects", "chan_largenoteson", "chan_setval", "chan_iowriteval", "chan_ioreadval",
+	"chan_writeseq_nextinstr", "chan_writeseq", "chan_readseq", "chan_subtract", "chan_setmutebhv", "chan_beqz", "chan_bltz", "chan_bgez",
+	"chan_setdyntable",
+}
+
+def compile_layer(out: list[int], label: str):
+	# follows the calls, unrolls the loops and inlines the jumps to what this layer hasn't played yet,
+	# a jump back to something it has becomes SFX_OP_JUMP
+	transpose = 0
+	delay = 0
+	emitted: dict[tuple[int, int], int] = {}
+	calls: list[int] = []
+	loops: list[list[int]] = [] # [first line, times left]
+	pc = labels[label]
+	for _ in range(10000):
+		if not calls and not loops and (pc, transpose) not in emitted:
+			emitted[(pc, transpose)] = len(out)
+		parts = lines[pc]
+		pc += 1
+		cmd = parts[0]
+		if cmd.endswith(":") or cmd in LAYER_IGNORED:
+			continue
+		elif cmd in ("layer_note0", "layer_note1", "layer_note1_long", "layer_note2"):
+			note = min(max(value(parts[1]) + transpose, 0), 0x7F)
+			if cmd == "layer_note2":
+				velocity, gate = value(parts[2]), value(parts[3])
+			else:
+				delay = value(parts[2])
+				velocity = value(parts[3])
+				gate = value(parts[4]) if cmd == "layer_note0" else 0
+			out += [note, velocity, gate, *var(delay)]
+		elif cmd in ("layer_delay", "layer_delay_long"):
+			out += [OP_WAIT, *var(value(parts[1]))]
+		elif cmd == "layer_transpose":
+			transpose = value(parts[1])
+		elif cmd == "layer_setinstr":
+			if value(parts[1]) < 0x7F:
+				out += [OP_INSTR, value(parts[1])]
+		elif cmd == "layer_setpan":
+			out += [OP_PAN, value(parts[1])]
+		elif cmd == "layer_portamento":
+			out += [OP_PORTAMENTO, value(parts[1]), min(max(value(parts[2]) + transpose, 0), 0x7F), min(value(parts[3]), 0xFF)]
+		elif cmd == "layer_disableportamento":
+			out += [OP_PORTAMENTO_OFF]
+		elif cmd in ("layer_somethingon", "layer_somethingoff"):
+			out += [OP_LEGATO, 1 if cmd == "layer_somethingon" else 0]
+		elif cmd == "layer_call":
+			calls.append(pc)
+			pc = labels[parts[1]]
+		elif cmd == "layer_loop":
+			loops.append([pc, value(parts[1]) or 256])
+		elif cmd == "layer_loopend":
+			loops[-1][1] -= 1
+			if loops[-1][1] > 0:
+				pc = loops[-1][0]
+			else:
+				loops.pop()
+		elif cmd == "layer_jump":
+			target = (labels[parts[1]], transpose)
+			if target in emitted:
+				out += [OP_JUMP, *u16(emitted[target])]
+				return
+			pc = target[0]
+		elif cmd == "layer_end" and calls:
+			pc = calls.pop()
+		else:
+			break
+	out.append(OP_END)
+
+def compile_sound(label: str) -> list[int]:
+	# the channel's ops first, then the layers they start in the order they're started
+	out: list[int] = []
+	wait = 0 # consecutive waits go out as one
+	layers: list[tuple[int, str]] = []
+	calls: list[int] = []
+	loops: list[list[int]] = []
+	visited: set[int] = set()
+	pc = labels[label]
+	for _ in range(10000):
+		parts = lines[pc]
+		pc += 1
+		cmd = parts[0]
+		if cmd.endswith(":") or cmd in CHANNEL_IGNORED:
+			continue
+		if cmd in ("chan_delay1", "chan_delay"):
+			wait += value(parts[1]) if cmd == "chan_delay" else 1
+			continue
+		if wait and cmd not in ("chan_loop", "chan_loopend", "chan_call", "chan_jump", "chan_end"):
+			out += [OP_WAIT, *var(wait)]
+			wait = 0
+		if cmd == "chan_setbank":
+			out += [OP_BANK, value(parts[1])]
+		elif cmd == "chan_setinstr":
+			if value(parts[1]) < 0x7F:
+				out += [OP_INSTR, value(parts[1])]
+		elif cmd == "chan_setenvelope":
+			adsr1, adsr2 = envelope_to_adsr(parse_envelope(parts[1]))
+			out += [OP_ENVELOPE, *u16(adsr1), *u16(adsr2)]
+		elif cmd == "chan_setdecayrelease":
+			out += [OP_RELEASE, release_shift(value(parts[1]))]
+		elif cmd == "chan_setpan":
+			out += [OP_PAN, value(parts[1])]
+		elif cmd == "chan_setlayer":
+			index = value(parts[1])
+			if index < MAX_LAYERS:
+				out += [OP_LAYER, index, 0, 0]
+				layers.append((len(out) - 2, parts[2]))
+		elif cmd == "chan_freelayer":
+			out += [OP_FREE_LAYER, value(parts[1])]
+		elif cmd == "chan_call":
+			calls.append(pc)
+			pc = labels[parts[1]]
+		elif cmd == "chan_loop":
+			loops.append([pc, value(parts[1]) or 256])
+		elif cmd == "chan_loopend":
+			loops[-1][1] -= 1
+			if loops[-1][1] > 0:
+				pc = loops[-1][0]
+			else:
+				loops.pop()
+		elif cmd == "chan_jump" and labels[parts[1]] not in visited:
+			visited.add(labels[parts[1]])
+			pc = labels[parts[1]]
+		elif cmd == "chan_end" and calls:
+			pc = calls.pop()
+		else:
+			break
+	out.append(OP_END)
+	for offset_pos, layer_label in layers:
+		out[offset_pos:offset_pos + 2] = u16(len(out))
+		compile_layer(out, layer_label)
+	assert len(out) < 0x10000
+	return out
+
+out_scripts: dict[tuple[int, ...], int] = {}
+out_sfx_defs = []
+out_sfx_counts = []
 
 def make_channel_table_def(which: str):
-	out_sfx_defs.append("(SfxDef[]) {\n")
-	for line in definitions[which]:
-		parts = line.split(" ")
-		if parts[0] == "sound_ref":
-			make_sfx_def(parts[1])
+	out_sfx_defs.append("(const SfxDef[]) {\n")
+	count = 0
+	for parts in lines[labels[which] + 1:]:
+		if parts[0] != "sound_ref":
+			break
+		count += 1
+		script = tuple(compile_sound(parts[1]))
+		if script[0] == OP_END:
+			out_sfx_defs.append("\t{NULL},\n")
+			continue
+		if script not in out_scripts:
+			out_scripts[script] = len(out_scripts)
+		out_sfx_defs.append(f"\t{{sfx_script_{out_scripts[script]}}},\n")
 	out_sfx_defs.append("},\n")
+	out_sfx_counts.append(count)
 
-for line in definitions["sequence_start"]:
-	parts = line.split(" ")
-	match parts[0]:
-		case "seq_startchannel":
-			make_channel_table_def(parts[2] + "_table")
-
-#print(definitions)
+for parts in lines[labels["sequence_start"] + 1:]:
+	if parts[0].endswith(":"):
+		break
+	if parts[0] == "seq_startchannel":
+		make_channel_table_def(parts[2] + "_table")
 
 with open(out_path, "w") as out_handle:
 	out_handle.write("#include <port/audio_data.h>\n")
-	out_handle.writelines(out_c_defines)
-	out_handle.write("SfxDef* sfx_defs_per_channel[] = {\n")
+	for script, idx in out_scripts.items():
+		out_handle.write(f"static const u8 sfx_script_{idx}[] = {{{','.join(str(b) for b in script)}}};\n")
+	out_handle.write("const SfxDef* sfx_defs_per_channel[] = {\n")
 	out_handle.writelines(out_sfx_defs)
-	out_handle.write("};")
+	out_handle.write("};\n")
+	out_handle.write(f"const u16 sfx_count_per_channel[] = {{{', '.join(str(c) for c in out_sfx_counts)}}};\n")
+	out_handle.write("const u32* sfx_instrument_adsr[] = {\n")
+	for adsrs in instrument_adsrs:
+		out_handle.write(f"\t(const u32[]) {{{','.join(hex(a1 | a2 << 16) for a1, a2 in adsrs)}}},\n")
+	out_handle.write("};\n")